@@ -0,0 +1,264 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "AsterLibraryImporter.h"
+#include "AsterSignatureParser.h"
+#include "DesktopServices.h"
+#include "DynamicObject.h"
+#include "Filename.h"
+#include "ModelServices.h"
+#include "ObjectResource.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "ProgressTracker.h"
+#include "Signature.h"
+#include "SignatureDataDescriptor.h"
+#include "SignatureFileDescriptor.h"
+#include "SignatureSet.h"
+#include "SpectralVersion.h"
+#include "StringUtilities.h"
+#include "TypeConverter.h"
+#include "Units.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtGui/QFileDialog>
+
+#include <algorithm>
+
+REGISTER_PLUGIN_BASIC(SpectralAster, AsterLibraryImporter);
+
+namespace
+{
+   // large enough to keep the threads busy, small enough that an abort is seen promptly
+   const std::vector<std::string>::size_type sParseChunkSize = 64;
+}
+
+AsterLibraryImporter::AsterLibraryImporter()
+{
+   setDescriptorId("{4F0C6A1E-93D2-4B7E-A5C8-2D61E07B9F35}");
+   setName("ASTER Spectral Library Importer");
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setDescription("Import a directory or list of ASTER Spectral Library signatures into a single signature set.");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+   setMenuLocation("[Spectral]\\Support Tools\\Import ASTER Spectral Library");
+   setAbortSupported(true);
+}
+
+AsterLibraryImporter::~AsterLibraryImporter()
+{}
+
+bool AsterLibraryImporter::getInputSpecification(PlugInArgList*& pInArgList)
+{
+   VERIFY((pInArgList = Service<PlugInManagerServices>()->getPlugInArgList()) != NULL);
+   VERIFY(pInArgList->addArg<Progress>(Executable::ProgressArg(), NULL, Executable::ProgressArgDescription()));
+   VERIFY(pInArgList->addArg<Filename>("Directory", NULL, "Directory which is searched, including its "
+      "subdirectories, for *.spectrum.txt files. In interactive mode, the user is asked for a directory if "
+      "neither this nor \"Filenames\" is specified."));
+   VERIFY(pInArgList->addArg<std::vector<Filename*> >("Filenames", NULL, "ASTER signature files to import in "
+      "addition to those found in \"Directory\"."));
+   VERIFY(pInArgList->addArg<std::string>("Library Name", std::string("ASTER Spectral Library"),
+      "Name of the signature set which is created."));
+   return true;
+}
+
+bool AsterLibraryImporter::getOutputSpecification(PlugInArgList*& pOutArgList)
+{
+   VERIFY((pOutArgList = Service<PlugInManagerServices>()->getPlugInArgList()) != NULL);
+   VERIFY(pOutArgList->addArg<SignatureSet>("Signature Set", NULL, "Signature set containing the imported "
+      "signatures."));
+   return true;
+}
+
+bool AsterLibraryImporter::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
+{
+   VERIFY(pInArgList != NULL);
+   ProgressTracker progress(pInArgList->getPlugInArgValue<Progress>(Executable::ProgressArg()),
+      "Importing ASTER spectral library", "spectral", "B6E1D2F7-08C4-4A93-9E5B-71C3F4A2D860");
+
+   std::vector<std::string> filenames;
+   std::vector<Filename*> filenameArgs;
+   pInArgList->getPlugInArgValue<std::vector<Filename*> >("Filenames", filenameArgs);
+   for (std::vector<Filename*>::const_iterator iter = filenameArgs.begin(); iter != filenameArgs.end(); ++iter)
+   {
+      if (*iter != NULL && !(*iter)->getFullPathAndName().empty())
+      {
+         filenames.push_back((*iter)->getFullPathAndName());
+      }
+   }
+
+   std::string directory;
+   Filename* pDirectory = pInArgList->getPlugInArgValue<Filename>("Directory");
+   if (pDirectory != NULL)
+   {
+      directory = pDirectory->getFullPathAndName();
+   }
+   else if (filenames.empty() && !isBatch())
+   {
+      Service<DesktopServices> pDesktop;
+      directory = QFileDialog::getExistingDirectory(pDesktop->getMainWidget(),
+         "ASTER Library Directory").toStdString();
+      if (directory.empty())
+      {
+         progress.report("User aborted the operation.", 0, ABORT, true);
+         return false;
+      }
+   }
+   if (!directory.empty())
+   {
+      findFiles(directory, filenames);
+   }
+   if (filenames.empty())
+   {
+      progress.report("No ASTER signature files were found.", 0, ERRORS, true);
+      return false;
+   }
+
+   std::string libraryName;
+   pInArgList->getPlugInArgValue<std::string>("Library Name", libraryName);
+   if (libraryName.empty())
+   {
+      libraryName = "ASTER Spectral Library";
+   }
+
+   // The files are parsed on separate threads; the model is only changed below on this thread.
+   // They are parsed in chunks so the progress is updated and an abort is seen between chunks.
+   std::vector<AsterSignatureParser::ParsedSignature> signatures(filenames.size());
+   for (std::vector<std::string>::size_type index = 0; index < filenames.size(); ++index)
+   {
+      signatures[index].mFilename = filenames[index];
+   }
+   std::string parseMessage = "Parsing " + StringUtilities::toDisplayString(filenames.size()) +
+      " ASTER signature files";
+   for (std::vector<AsterSignatureParser::ParsedSignature>::size_type chunkBegin = 0;
+      chunkBegin < signatures.size(); chunkBegin += sParseChunkSize)
+   {
+      if (isAborted())
+      {
+         progress.report("User aborted the operation.", 0, ABORT, true);
+         return false;
+      }
+      progress.report(parseMessage, static_cast<int>(50.0 * chunkBegin / signatures.size()), NORMAL);
+
+      std::vector<AsterSignatureParser::ParsedSignature>::size_type chunkEnd =
+         std::min(chunkBegin + sParseChunkSize, signatures.size());
+      AsterSignatureParser::parseFiles(signatures.begin() + chunkBegin, signatures.begin() + chunkEnd);
+   }
+
+   Service<ModelServices> pModel;
+   ModelResource<SignatureSet> pSignatureSet(dynamic_cast<SignatureSet*>(pModel->createElement(libraryName,
+      TypeConverter::toString<SignatureSet>(), NULL)));
+   if (pSignatureSet.get() == NULL)
+   {
+      progress.report("Unable to create the signature set. An element named \"" + libraryName +
+         "\" may already exist.", 0, ERRORS, true);
+      return false;
+   }
+
+   unsigned int numSkipped = 0;
+   std::vector<Signature*> setSignatures;
+   setSignatures.reserve(signatures.size());
+   for (std::vector<AsterSignatureParser::ParsedSignature>::size_type index = 0; index < signatures.size(); ++index)
+   {
+      if (isAborted())
+      {
+         progress.report("User aborted the operation.", 0, ABORT, true);
+         return false;
+      }
+      progress.report("Creating signatures", 50 + static_cast<int>(50.0 * index / signatures.size()), NORMAL);
+
+      const AsterSignatureParser::ParsedSignature& signature = signatures[index];
+      if (!signature.mValid)
+      {
+         ++numSkipped;
+         continue;
+      }
+
+      Signature* pSignature = dynamic_cast<Signature*>(pModel->createElement(signature.mFilename,
+         TypeConverter::toString<Signature>(), pSignatureSet.get()));
+      if (pSignature == NULL)
+      {
+         ++numSkipped;
+         continue;
+      }
+      pSignature->setData("Wavelength", signature.mWavelengths);
+      pSignature->setData("Reflectance", signature.mValues);
+
+      FactoryResource<Units> pReflectanceUnits;
+      VERIFY(pReflectanceUnits.get() != NULL);
+      pReflectanceUnits->setUnitType(signature.mUnitType);
+      pReflectanceUnits->setUnitName(signature.mUnitName);
+      pReflectanceUnits->setScaleFromStandard(1.0);
+
+      SignatureDataDescriptor* pDataDescriptor =
+         dynamic_cast<SignatureDataDescriptor*>(pSignature->getDataDescriptor());
+      VERIFY(pDataDescriptor != NULL);
+      pDataDescriptor->setUnits("Reflectance", pReflectanceUnits.get());
+
+      FactoryResource<SignatureFileDescriptor> pFileDescriptor;
+      VERIFY(pFileDescriptor.get() != NULL);
+      pFileDescriptor->setFilename(signature.mFilename);
+      pFileDescriptor->setUnits("Reflectance", pReflectanceUnits.get());
+      pDataDescriptor->setFileDescriptor(pFileDescriptor.get());
+
+      FactoryResource<DynamicObject> pMetadata;
+      VERIFY(pMetadata.get() != NULL);
+      AsterSignatureParser::getMetadata(signature, *pMetadata.get());
+      pSignature->getMetadata()->setAttribute("ASTER Signature", *(pMetadata.get()));
+
+      setSignatures.push_back(pSignature);
+   }
+
+   if (setSignatures.empty())
+   {
+      progress.report("None of the files are valid ASTER signature files.", 0, ERRORS, true);
+      return false;
+   }
+   if (pSignatureSet->insertSignatures(setSignatures) == false)
+   {
+      progress.report("Unable to add signatures to signature set.", 0, ERRORS, true);
+      return false;
+   }
+
+   if (numSkipped > 0)
+   {
+      progress.report("Unable to import " + StringUtilities::toDisplayString(numSkipped) + " of the " +
+         StringUtilities::toDisplayString(signatures.size()) + " files.", 100, WARNING, true);
+   }
+   if (pOutArgList != NULL)
+   {
+      pOutArgList->setPlugInArgValue("Signature Set", pSignatureSet.get());
+   }
+   pSignatureSet.release();
+   progress.report("ASTER spectral library imported", 100, NORMAL);
+   progress.upALevel();
+   return true;
+}
+
+void AsterLibraryImporter::findFiles(const std::string& directory, std::vector<std::string>& filenames) const
+{
+   QStringList filters;
+   filters << "*.spectrum.txt";
+   std::vector<std::string> found;
+   QDirIterator iter(QString::fromStdString(directory), filters, QDir::Files, QDirIterator::Subdirectories);
+   while (iter.hasNext())
+   {
+      found.push_back(iter.next().toStdString());
+   }
+
+   // the directory order depends on the platform, so the signatures are sorted to give the same library each time
+   std::sort(found.begin(), found.end());
+   filenames.insert(filenames.end(), found.begin(), found.end());
+}
@@ -0,0 +1,39 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef ASTERLIBRARYIMPORTER_H
+#define ASTERLIBRARYIMPORTER_H
+
+#include "AlgorithmShell.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Imports a directory or list of ASTER signature files into a single signature set.
+ *
+ * The files are parsed on separate threads before the signatures are created,
+ * which is much faster than importing each file with the ASTER Spectral Signature
+ * Importer when building a library from the whole ASTER collection.
+ */
+class AsterLibraryImporter : public AlgorithmShell
+{
+public:
+   AsterLibraryImporter();
+   virtual ~AsterLibraryImporter();
+
+   virtual bool getInputSpecification(PlugInArgList*& pInArgList);
+   virtual bool getOutputSpecification(PlugInArgList*& pOutArgList);
+   virtual bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+
+private:
+   void findFiles(const std::string& directory, std::vector<std::string>& filenames) const;
+};
+
+#endif
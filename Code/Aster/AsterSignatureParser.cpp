@@ -0,0 +1,328 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AsterSignatureParser.h"
+#include "DynamicObject.h"
+#include "SpectralUtilities.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QRegExp>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QtConcurrentMap>
+
+// The *.spectrum.txt files do not have a formal file format specification.
+// The ASTER Spectral Library v2.0 documentation indicates that the header is
+// 26 lines, but one file on the v2.0 CD differs, so the signature values are
+// taken to start at the first line of doubles after an empty line at or after
+// the 25th line.
+const unsigned char HEADER_LINE_COUNT = 26;
+
+namespace
+{
+   // the characters that are white space in the "C" locale
+   bool isSpace(char value)
+   {
+      return value == ' ' || value == '\t' || value == '\n' || value == '\v' || value == '\f' || value == '\r';
+   }
+
+   // returns the end of the line starting at pBegin, not including a trailing carriage return
+   const char* findLineEnd(const char* pBegin, const char* pEnd, const char*& pNext)
+   {
+      const char* pLineEnd = pBegin;
+      while (pLineEnd != pEnd && *pLineEnd != '\n')
+      {
+         ++pLineEnd;
+      }
+      pNext = (pLineEnd == pEnd) ? pEnd : pLineEnd + 1;
+      if (pLineEnd != pBegin && *(pLineEnd - 1) == '\r')
+      {
+         --pLineEnd;
+      }
+      return pLineEnd;
+   }
+
+   // plain decimal numbers are converted in place; any other token is converted as QString always has
+   double parseValue(const char* pBegin, const char* pEnd, bool& valid)
+   {
+      double value(0.0);
+      valid = SpectralUtilities::parseDecimal(pBegin, pEnd, value);
+      if (!valid)
+      {
+         value = QString::fromLatin1(pBegin, static_cast<int>(pEnd - pBegin)).toDouble(&valid);
+      }
+      return value;
+   }
+
+   void setValue(std::vector<std::pair<std::string, std::string> >& metadata, const std::string& key,
+      const std::string& value)
+   {
+      for (std::vector<std::pair<std::string, std::string> >::iterator iter = metadata.begin();
+         iter != metadata.end(); ++iter)
+      {
+         if (iter->first == key)
+         {
+            iter->second = value;
+            return;
+         }
+      }
+      metadata.push_back(std::make_pair(key, value));
+   }
+
+   std::string* getValue(std::vector<std::pair<std::string, std::string> >& metadata, const std::string& key)
+   {
+      for (std::vector<std::pair<std::string, std::string> >::iterator iter = metadata.begin();
+         iter != metadata.end(); ++iter)
+      {
+         if (iter->first == key)
+         {
+            return &iter->second;
+         }
+      }
+      return NULL;
+   }
+
+   void parseWithData(AsterSignatureParser::ParsedSignature& signature)
+   {
+      AsterSignatureParser::parseFile(signature, true);
+   }
+}
+
+bool AsterSignatureParser::isAsterFile(const std::string& filename)
+{
+   if (filename.empty())
+   {
+      return false;
+   }
+
+   QFile sigFile(QString::fromStdString(filename));
+   if (!sigFile.open(QIODevice::ReadOnly))
+   {
+      return false;
+   }
+
+   //make sure the file starts with "Name:" to ensure it's a valid ASTER sig
+   char fileStart[6];
+   if (sigFile.read(fileStart, 5) != 5)
+   {
+      return false;
+   }
+   return std::string(fileStart, 5) == "Name:";
+}
+
+bool AsterSignatureParser::parseFile(ParsedSignature& signature, bool readData)
+{
+   signature.mValid = false;
+   signature.mMetadata.clear();
+   signature.mWavelengths.clear();
+   signature.mValues.clear();
+   if (signature.mFilename.empty())
+   {
+      return false;
+   }
+
+   QFile sigFile(QString::fromStdString(signature.mFilename));
+   if (!sigFile.open(QIODevice::ReadOnly))
+   {
+      return false;
+   }
+
+   //make sure the file starts with "Name:" to ensure it's a valid ASTER sig
+   QByteArray contents = sigFile.readAll();
+   if (!contents.startsWith("Name:"))
+   {
+      return false;
+   }
+   const char* pPos = contents.constData();
+   const char* pEnd = pPos + contents.size();
+
+   std::string lastKeyParsed = "";
+   bool foundSigValues = false;
+   unsigned int numSigFloats = 0;
+   bool foundEmptyLine = true;
+   unsigned int lineCount = 0;
+   const char* pSigStart = NULL;
+   while (pPos != pEnd && !foundSigValues && lineCount <= HEADER_LINE_COUNT)
+   {
+      const char* pNext = NULL;
+      const char* pLineEnd = findLineEnd(pPos, pEnd, pNext);
+      QString line = QString::fromLocal8Bit(pPos, static_cast<int>(pLineEnd - pPos));
+      if (line.indexOf(":") == -1)
+      {
+         if (!line.isEmpty())
+         {
+            if (lineCount >= HEADER_LINE_COUNT - 1)
+            {
+               //is it the start of signature values or a value for a key that spans lines.
+               bool containOnlyDoubles = true;
+               QRegExp whitespace("\\s+");
+               QStringList parts = line.split(whitespace, QString::SkipEmptyParts);
+               for (QStringList::iterator iter = parts.begin(); iter != parts.end(); ++iter)
+               {
+                  bool valid = false;
+                  iter->toDouble(&valid);
+                  if (!valid)
+                  {
+                     containOnlyDoubles = false;
+                     break;
+                  }
+               }
+               if (foundEmptyLine && containOnlyDoubles && !parts.isEmpty())
+               {
+                  //only count lines consisting only of doubles as the start of the sig
+                  //section if it was preceded by an empty line.
+                  foundSigValues = true;
+                  numSigFloats = parts.size();
+                  pSigStart = pPos;
+               }
+            }
+            if (!foundSigValues && !lastKeyParsed.empty())
+            {
+               //non empty line that isn't whitespace separated doubles (e.g. start of sig values)
+               //so must be continuation of value for a key
+               std::string* pValue = getValue(signature.mMetadata, lastKeyParsed);
+               if (pValue != NULL)
+               {
+                  *pValue += " " + line.trimmed().toStdString();
+               }
+            }
+         }
+      }
+      else
+      {
+         QStringList parts = line.split(":");
+         QString key = parts.takeFirst().trimmed();
+         lastKeyParsed = key.toStdString();
+         QString value = parts.join(":").trimmed();
+         setValue(signature.mMetadata, key.toStdString(), value.toStdString());
+      }
+      foundEmptyLine = line.trimmed().isEmpty();
+      ++lineCount;
+      pPos = pNext;
+   }
+
+   if (!foundSigValues || numSigFloats != 2)
+   {
+      //no sigs or invalid amount of numbers
+      return false;
+   }
+
+   std::string* pYUnits = getValue(signature.mMetadata, "Y Units");
+   std::string* pXUnits = getValue(signature.mMetadata, "X Units");
+   std::string* pFirstColumn = getValue(signature.mMetadata, "First Column");
+   std::string* pSecondColumn = getValue(signature.mMetadata, "Second Column");
+   if (pFirstColumn == NULL || *pFirstColumn != "X" || pSecondColumn == NULL || *pSecondColumn != "Y")
+   {
+      return false;
+   }
+
+   QString xUnits = QString::fromStdString(pXUnits == NULL ? std::string() : *pXUnits).toLower();
+   if (xUnits.indexOf("wavelength") == -1)
+   {
+      return false;
+   }
+
+   QString yUnits = QString::fromStdString(pYUnits == NULL ? std::string() : *pYUnits).toLower();
+   if (yUnits.indexOf("reflec") != -1)
+   {
+      signature.mUnitType = REFLECTANCE;
+      signature.mUnitName = "Reflectance";
+   }
+   else if (yUnits.indexOf("trans") != -1)
+   {
+      signature.mUnitType = TRANSMITTANCE;
+      signature.mUnitName = "Transmittance";
+   }
+   else
+   {
+      return false;
+   }
+
+   if (readData)
+   {
+      // each line of exactly two values is a wavelength and a percentage; other lines are skipped
+      signature.mWavelengths.reserve((pEnd - pSigStart) / 16);
+      signature.mValues.reserve((pEnd - pSigStart) / 16);
+      for (pPos = pSigStart; pPos != pEnd; )
+      {
+         const char* pNext = NULL;
+         const char* pLineEnd = findLineEnd(pPos, pEnd, pNext);
+         const char* pTokens[2][2];
+         int numTokens = 0;
+         for (const char* pChar = pPos; pChar != pLineEnd && numTokens <= 2; )
+         {
+            while (pChar != pLineEnd && isSpace(*pChar))
+            {
+               ++pChar;
+            }
+            if (pChar == pLineEnd)
+            {
+               break;
+            }
+            const char* pTokenEnd = pChar;
+            while (pTokenEnd != pLineEnd && !isSpace(*pTokenEnd))
+            {
+               ++pTokenEnd;
+            }
+            if (numTokens < 2)
+            {
+               pTokens[numTokens][0] = pChar;
+               pTokens[numTokens][1] = pTokenEnd;
+            }
+            ++numTokens;
+            pChar = pTokenEnd;
+         }
+
+         if (numTokens == 2)
+         {
+            bool validWave = false;
+            bool validY = false;
+            double wavelength = parseValue(pTokens[0][0], pTokens[0][1], validWave);
+            double yValue = parseValue(pTokens[1][0], pTokens[1][1], validY);
+            if (validWave && validY)
+            {
+               signature.mWavelengths.push_back(wavelength);
+               signature.mValues.push_back(yValue / 100.0);
+            }
+         }
+         pPos = pNext;
+      }
+
+      if (signature.mWavelengths.empty())
+      {
+         return false;
+      }
+   }
+
+   signature.mValid = true;
+   return true;
+}
+
+void AsterSignatureParser::parseFiles(std::vector<ParsedSignature>::iterator begin,
+   std::vector<ParsedSignature>::iterator end)
+{
+#ifndef QT_NO_CONCURRENT
+   QtConcurrent::blockingMap(begin, end, parseWithData);
+#else
+   for (std::vector<ParsedSignature>::iterator iter = begin; iter != end; ++iter)
+   {
+      parseWithData(*iter);
+   }
+#endif
+}
+
+void AsterSignatureParser::getMetadata(const ParsedSignature& signature, DynamicObject& metadata)
+{
+   for (std::vector<std::pair<std::string, std::string> >::const_iterator iter = signature.mMetadata.begin();
+      iter != signature.mMetadata.end(); ++iter)
+   {
+      metadata.setAttribute(iter->first, iter->second);
+   }
+}
@@ -0,0 +1,93 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef ASTERSIGNATUREPARSER_H
+#define ASTERSIGNATUREPARSER_H
+
+#include "TypesFile.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class DynamicObject;
+
+/**
+ * Parses the *.spectrum.txt files of the ASTER Spectral Library.
+ *
+ * The file is read at once and the data lines are split and converted in place
+ * rather than through a QString per line. Nothing here touches the Opticks model,
+ * so several files can be parsed at once.
+ */
+namespace AsterSignatureParser
+{
+   struct ParsedSignature
+   {
+      ParsedSignature() :
+         mUnitType(REFLECTANCE),
+         mValid(false)
+      {}
+
+      std::string mFilename;
+      std::vector<std::pair<std::string, std::string> > mMetadata;   // the header keys and values in file order
+      UnitType mUnitType;
+      std::string mUnitName;
+      std::vector<double> mWavelengths;
+      std::vector<double> mValues;                                   // converted from percent
+      bool mValid;
+   };
+
+   /**
+    * Checks whether a file starts like an ASTER signature file.
+    *
+    * @param filename
+    *        The full path of the file.
+    *
+    * @return \c true if the file starts with "Name:", \c false otherwise.
+    */
+   bool isAsterFile(const std::string& filename);
+
+   /**
+    * Parses an ASTER signature file.
+    *
+    * @param signature
+    *        The signature whose file is parsed. ParsedSignature::mFilename must be set.
+    * @param readData
+    *        If \c false, only the header is parsed.
+    *
+    * @return \c true if the header describes a signature of wavelengths and
+    *         reflectance or transmittance values and, if \em readData is \c true,
+    *         the file contains at least one pair of values; \c false otherwise.
+    *         ParsedSignature::mValid is set to the same value.
+    */
+   bool parseFile(ParsedSignature& signature, bool readData);
+
+   /**
+    * Parses the header and data of several ASTER signature files on separate threads.
+    *
+    * @param begin
+    *        The first signature to parse. ParsedSignature::mFilename must be set for each
+    *        one, and ParsedSignature::mValid is set to whether it was parsed.
+    * @param end
+    *        One past the last signature to parse.
+    */
+   void parseFiles(std::vector<ParsedSignature>::iterator begin, std::vector<ParsedSignature>::iterator end);
+
+   /**
+    * Copies the header of a parsed signature into a metadata object.
+    *
+    * @param signature
+    *        The parsed signature.
+    * @param metadata
+    *        Receives each header key as a string attribute.
+    */
+   void getMetadata(const ParsedSignature& signature, DynamicObject& metadata);
+}
+
+#endif
@@ -48,8 +48,6 @@ class CemAlgorithm : public AlgorithmPattern
    bool postprocess();
    bool initialize(void* pAlgorithmData);
    RasterElement* createResults(int numRows, int numColumns, const std::string& sigName);
-   bool resampleSpectrum(Signature* pSignature, std::vector<double>& resampledAmplitude, 
-      Wavelengths* pWavelengths, std::vector<int>& resampledBands);
    bool canAbort() const;
    bool doAbort();
    void computeWoper(std::vector<double>& pSpectrum, double* pSmm,
@@ -8,6 +8,8 @@
  */
 
 #include <QtCore/QFile>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentMap>
 #include <QtGui/QFileDialog>
 #include <QtGui/QMessageBox>
 
@@ -23,7 +25,6 @@
 #include "Filename.h"
 #include "MatrixFunctions.h"
 #include "MessageLogResource.h"
-#include "ModelServices.h"
 #include "PlugInArgList.h"
 #include "PlugInManagerServices.h"
 #include "PlugInResource.h"
@@ -36,10 +37,123 @@
 #include "switchOnEncoding.h"
 #include "Units.h"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
 
+namespace
+{
+   // number of AOI rows read by each task when gathering the AOI spectra
+   const int sRowsPerTask = 16;
+
+   struct AoiRows
+   {
+      unsigned int mElement;
+      int mStartRow;
+      int mEndRow;
+      int mStartColumn;
+      int mEndColumn;
+   };
+
+   struct AoiSpectrumSums
+   {
+      std::vector<double> mSums;
+      std::vector<unsigned int> mCounts;
+   };
+
+   template<typename T>
+   void accumulateSpectrum(T* pPixel, double* pSums, unsigned int numBands)
+   {
+      for (unsigned int band = 0; band < numBands; ++band)
+      {
+         pSums[band] += pPixel[band];
+      }
+   }
+
+   /**
+    *  Sums the full spectrum of every selected pixel in a block of rows of one AOI
+    *  with a single BIP read. The sums for each AOI are stored contiguously.
+    */
+   struct AoiSpectrumMap
+   {
+      typedef AoiRows input_type;
+      typedef AoiSpectrumSums result_type;
+
+      AoiSpectrumMap(RasterElement* pElement, const std::vector<const BitMask*>& masks) :
+         mpElement(pElement),
+         mpDescriptor(NULL),
+         mMasks(masks),
+         mNumBands(0),
+         mEncoding(INT1UBYTE)
+      {
+         VERIFYNRV(mpElement != NULL);
+         mpDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpElement->getDataDescriptor());
+         VERIFYNRV(mpDescriptor != NULL);
+         mNumBands = mpDescriptor->getBandCount();
+         mEncoding = mpDescriptor->getDataType();
+      }
+
+      result_type operator()(const input_type& rows) const
+      {
+         AoiSpectrumSums results;
+         results.mSums.resize(mMasks.size() * mNumBands, 0.0);
+         results.mCounts.resize(mMasks.size(), 0);
+         VERIFYRV(mpDescriptor != NULL, results);
+
+         const BitMask* pMask = mMasks[rows.mElement];
+         double* pSums = &results.mSums[rows.mElement * mNumBands];
+         FactoryResource<DataRequest> pRequest;
+         pRequest->setInterleaveFormat(BIP);
+         pRequest->setRows(mpDescriptor->getActiveRow(rows.mStartRow), mpDescriptor->getActiveRow(rows.mEndRow));
+         pRequest->setColumns(mpDescriptor->getActiveColumn(rows.mStartColumn),
+            mpDescriptor->getActiveColumn(rows.mEndColumn));
+         DataAccessor accessor = mpElement->getDataAccessor(pRequest.release());
+         VERIFYRV(accessor.isValid(), results);
+
+         for (int row = rows.mStartRow; row <= rows.mEndRow; ++row)
+         {
+            for (int column = rows.mStartColumn; column <= rows.mEndColumn; ++column)
+            {
+               if (pMask->getPixel(column, row) == true)
+               {
+                  accessor->toPixel(row, column);
+                  VERIFYRV(accessor.isValid(), results);
+                  switchOnEncoding(mEncoding, accumulateSpectrum, accessor->getColumn(), pSums, mNumBands);
+                  ++results.mCounts[rows.mElement];
+               }
+            }
+         }
+
+         return results;
+      }
+
+      RasterElement* mpElement;
+      const RasterDataDescriptor* mpDescriptor;
+      const std::vector<const BitMask*>& mMasks;
+      unsigned int mNumBands;
+      EncodingType mEncoding;
+   };
+
+   void aoiSpectrumReduce(AoiSpectrumSums& total, const AoiSpectrumSums& partial)
+   {
+      if (total.mSums.empty())
+      {
+         total = partial;
+         return;
+      }
+
+      for (std::vector<double>::size_type index = 0; index < total.mSums.size(); ++index)
+      {
+         total.mSums[index] += partial.mSums[index];
+      }
+      for (std::vector<unsigned int>::size_type index = 0; index < total.mCounts.size(); ++index)
+      {
+         total.mCounts[index] += partial.mCounts[index];
+      }
+   }
+}
+
 ElmCore::ElmCore() :
    mpProgress(NULL),
    mpRasterElement(NULL),
@@ -343,14 +457,15 @@ bool ElmCore::computeResults(const vector<Signature*>& pSignatures,
    }
 
    string errorMessage;
-   const int polynomialOrder = 2;
    const int numElements = static_cast<int>(pAoiElements.size());
    const int numWavelengths = static_cast<int>(mCenterWavelengths.size());
-   vector<double> referenceValues(totalNumPoints);
-   vector<double> pixelValues(totalNumPoints);
-   vector<double> coefficients(polynomialOrder);
+   const unsigned int numBands = mpRasterDataDescriptor->getBandCount();
+   VERIFY(numWavelengths <= static_cast<int>(numBands));
 
    MatrixFunctions::MatrixResource<double> pReferenceSpectra(numElements, numWavelengths);
+   vector<const BitMask*> masks(numElements, static_cast<const BitMask*>(NULL));
+   vector<AoiRows> rowBlocks;
+   AoiSpectrumSums totals;
    if (pReferenceSpectra.get() == NULL)
    {
       errorMessage += "Unable to allocate memory for computation.\n";
@@ -362,114 +477,116 @@ bool ElmCore::computeResults(const vector<Signature*>& pSignatures,
    }
    else
    {
-      double percent = 0;
-      const double step = 100.0 / numWavelengths;
-      Service<ModelServices> pModel;
-      for (int band = 0; band < numWavelengths; ++band)
+      // Split the bounding box of each AOI into blocks of rows to be read in parallel
+      const int maxRow = static_cast<int>(mpRasterDataDescriptor->getRowCount());
+      const int maxCol = static_cast<int>(mpRasterDataDescriptor->getColumnCount());
+      for (int element = 0; element < numElements; ++element)
       {
-         DimensionDescriptor activeBand = mpRasterDataDescriptor->getActiveBand(band);
-         if (activeBand.isValid() == false)
+         masks[element] = pAoiElements[element]->getSelectedPoints();
+         if (masks[element] == NULL)
          {
-            errorMessage += "Active Band is invalid.\n";
+            errorMessage += "getSelectedPoints() returned NULL.\n";
             break;
          }
 
-         FactoryResource<DataRequest> pRequest;
-         if (pRequest.get() == NULL)
+         BitMaskIterator it(masks[element], mpRasterElement);
+         int x1, y1, x2, y2;
+         it.getBoundingBox(x1, y1, x2, y2);
+         if (x1 < 0 || y1 < 0 || x2 > maxCol || y2 > maxRow)
          {
-            errorMessage += "FactoryResource<DataRequest> returned NULL.\n";
+            errorMessage += "The AOI cannot contain points outside the image.\n";
             break;
          }
 
-         pRequest->setBands(activeBand, activeBand);
-         DataAccessor daAccessor = mpRasterElement->getDataAccessor(pRequest.release());
-         if (daAccessor.isValid() == false)
+         for (int row = y1; row <= y2; row += sRowsPerTask)
          {
-            errorMessage += "Unable to obtain a DataAccessor.\n";
-            break;
+            AoiRows block;
+            block.mElement = static_cast<unsigned int>(element);
+            block.mStartRow = row;
+            block.mEndRow = min(row + sRowsPerTask - 1, y2);
+            block.mStartColumn = x1;
+            block.mEndColumn = x2;
+            rowBlocks.push_back(block);
          }
+      }
+   }
 
-         unsigned int numPointsProcessed = 0;
-         for (int element = 0; element < numElements && daAccessor.isValid(); ++element)
+   if (errorMessage.empty() == true)
+   {
+      // Gather the summed spectrum of every AOI in one pass over the AOI pixels
+      AoiSpectrumMap spectrumMap(mpRasterElement, masks);
+#ifndef QT_NO_CONCURRENT
+      QFuture<AoiSpectrumSums> sums = QtConcurrent::mappedReduced(rowBlocks.begin(), rowBlocks.end(),
+         spectrumMap, aoiSpectrumReduce, QtConcurrent::UnorderedReduce);
+      while (sums.isRunning())
+      {
+         const int progressRange = sums.progressMaximum() - sums.progressMinimum();
+         if (mpProgress != NULL && progressRange > 0)
          {
-            const BitMask* pMask = pAoiElements[element]->getSelectedPoints();
-            if (pMask == NULL)
-            {
-               errorMessage += "getSelectedPoints() returned NULL.\n";
-               break;
-            }
-            BitMaskIterator it(pMask, mpRasterElement);
-            int x1, y1, x2, y2;
-            it.getBoundingBox(x1, y1, x2, y2);
-            const int maxRow = static_cast<int>(mpRasterDataDescriptor->getRowCount());
-            const int maxCol = static_cast<int>(mpRasterDataDescriptor->getColumnCount());
-            if (x1 < 0 || y1 < 0 || x2 > maxCol || y2 > maxRow)
-            {
-               errorMessage += "The AOI cannot contain points outside the image.\n";
-               break;
-            }
-
-            for (int yCount = y1; yCount <= y2 && daAccessor.isValid(); ++yCount)
-            {
-               for (int xCount = x1; xCount <= x2 && daAccessor.isValid(); ++xCount)
-               {
-                  if (it.getPixel(xCount, yCount) == true)
-                  {
-                     referenceValues[numPointsProcessed] = pReferenceSpectra[element][band];
-                     daAccessor->toPixel(yCount, xCount);
-                     if (daAccessor.isValid() == false)
-                     {
-                        errorMessage += "Unable to read from the DataAccessor.\n";
-                        break;
-                     }
-
-                     pixelValues[numPointsProcessed++] =
-                        pModel->getDataValue(mpRasterDataDescriptor->getDataType(), daAccessor->getColumn(), 0);
-                  }
-               }
-            }
+            mpProgress->updateProgress("Computing Gains/Offsets...",
+               90 * (sums.progressValue() - sums.progressMinimum()) / progressRange, NORMAL);
          }
+         QThread::yieldCurrentThread();
+      }
+      totals = sums.result();
+#else
+      for (vector<AoiRows>::const_iterator iter = rowBlocks.begin(); iter != rowBlocks.end(); ++iter)
+      {
+         aoiSpectrumReduce(totals, spectrumMap(*iter));
+      }
+#endif
+
+      unsigned int numPointsProcessed = 0;
+      for (vector<unsigned int>::const_iterator iter = totals.mCounts.begin(); iter != totals.mCounts.end(); ++iter)
+      {
+         numPointsProcessed += *iter;
+      }
 
-         if (numPointsProcessed != totalNumPoints && errorMessage.empty() == true)
+      if (numPointsProcessed != static_cast<unsigned int>(totalNumPoints))
+      {
+         errorMessage = "Not all points could be processed.\n";
+      }
+   }
+
+   if (errorMessage.empty() == true)
+   {
+      // Every pixel in an AOI shares the reference value of its signature, so the least squares fit of
+      // pixel = offset + gain * reference for each band needs only the per AOI sums.
+      // The sums are centered on the mean reference value to keep the normal equations well conditioned.
+      for (int band = 0; band < numWavelengths; ++band)
+      {
+         double referenceMean = 0.0;
+         double pixelSum = 0.0;
+         for (int element = 0; element < numElements; ++element)
          {
-            errorMessage = "Not all points could be processed.\n";
+            referenceMean += totals.mCounts[element] * pReferenceSpectra[element][band];
+            pixelSum += totals.mSums[element * numBands + band];
          }
-         else
-         {
-            const int numRows = totalNumPoints;
-            const int numCols = polynomialOrder;
-            MatrixFunctions::MatrixResource<double> pMatrix(numRows, numCols);
-            if (pMatrix.get() == NULL)
-            {
-               errorMessage = "Unable to allocate memory to run ELM.\n";
-            }
-            else
-            {
-               for (int row = 0; row < numRows; ++row)
-               {
-                  basisFunction(referenceValues[row], pMatrix[row], numCols);
-               }
+         referenceMean /= totalNumPoints;
 
-               if (MatrixFunctions::solveLinearEquation(&coefficients.front(),
-                  pMatrix, &pixelValues.front(), numRows, numCols) == false)
-               {
-                  errorMessage = "Unable to solve the linear equation.\n";
-               }
-            }
+         double referenceVariance = 0.0;
+         double covariance = 0.0;
+         for (int element = 0; element < numElements; ++element)
+         {
+            const double deviation = pReferenceSpectra[element][band] - referenceMean;
+            referenceVariance += totals.mCounts[element] * deviation * deviation;
+            covariance += deviation * totals.mSums[element * numBands + band];
          }
 
-         if (errorMessage.empty() == false)
+         if (referenceVariance <= 0.0)
          {
+            errorMessage = "Unable to solve the linear equation.\n";
             break;
          }
 
-         pGainsOffsets[band][1] = coefficients[0]; // save offsets
-         pGainsOffsets[band][0] = coefficients[1]; // save gains
-         percent += step;
-         if (mpProgress != NULL)
-         {
-            mpProgress->updateProgress("Computing Gains/Offsets...", static_cast<int>(percent), NORMAL);
-         }
+         const double gain = covariance / referenceVariance;
+         pGainsOffsets[band][1] = pixelSum / totalNumPoints - gain * referenceMean; // save offsets
+         pGainsOffsets[band][0] = gain; // save gains
+      }
+
+      if (mpProgress != NULL && errorMessage.empty() == true)
+      {
+         mpProgress->updateProgress("Computing Gains/Offsets...", 100, NORMAL);
       }
    }
 
@@ -633,12 +750,3 @@ bool ElmCore::applyResults(double** pGainsOffsets)
    pStep->finalize();
    return true;
 }
-
-void ElmCore::basisFunction(double scale, double* pCoefficients, int numCoeffs)
-{
-   pCoefficients[0] = 1.0;
-   for (int coeff = 1; coeff < numCoeffs; ++coeff)
-   {
-      pCoefficients[coeff] = pCoefficients[coeff - 1] * scale;
-   }
-}
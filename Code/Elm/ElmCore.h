@@ -73,7 +73,6 @@ private:
 
    bool readSignatureFiles(const std::vector<Signature*>& pSignatures, double** pReferenceSpectra);
    bool applyResults(double** pGainsOffsets);
-   void basisFunction(double scale, double* pCoefficients, int numCoeffs);
 
    template<typename T>
    void scaleCube(T* pData, double** pGainsOffsets);
@@ -0,0 +1,227 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "DataAccessor.h"
+#include "DataAccessorImpl.h"
+#include "DataRequest.h"
+#include "GainOffsetPager.h"
+#include "ObjectResource.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "RasterDataDescriptor.h"
+#include "RasterElement.h"
+#include "SpectralVersion.h"
+#include "switchOnEncoding.h"
+
+#include <algorithm>
+
+using namespace std;
+
+REGISTER_PLUGIN_BASIC(SpectralIarr, GainOffsetPager);
+
+namespace
+{
+   template<typename T>
+   void readPixel(T* pData, double* pValues, unsigned int numValues)
+   {
+      for (unsigned int index = 0; index < numValues; ++index)
+      {
+         pValues[index] = static_cast<double>(pData[index]);
+      }
+   }
+
+   template<typename T>
+   void writeValues(T* pData, const vector<double>& values)
+   {
+      for (vector<double>::size_type index = 0; index < values.size(); ++index)
+      {
+         pData[index] = static_cast<T>(values[index]);
+      }
+   }
+}
+
+GainOffsetRasterPage::GainOffsetRasterPage(unsigned int rows, unsigned int columns, unsigned int bands,
+                                           unsigned int bytesPerElement) :
+   mData(static_cast<size_t>(rows) * columns * bands * bytesPerElement),
+   mRows(rows),
+   mColumns(columns),
+   mBands(bands)
+{
+}
+
+GainOffsetRasterPage::~GainOffsetRasterPage()
+{
+}
+
+void* GainOffsetRasterPage::getRawData()
+{
+   return mData.empty() ? NULL : &mData.front();
+}
+
+unsigned int GainOffsetRasterPage::getNumRows()
+{
+   return mRows;
+}
+
+unsigned int GainOffsetRasterPage::getNumColumns()
+{
+   return mColumns;
+}
+
+unsigned int GainOffsetRasterPage::getNumBands()
+{
+   return mBands;
+}
+
+unsigned int GainOffsetRasterPage::getInterlineBytes()
+{
+   return 0;
+}
+
+GainOffsetPager::GainOffsetPager() :
+   mpElement(NULL),
+   mpSource(NULL)
+{
+   setName("Gain Offset Pager");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setDescription("Computes the data of a raster element on demand by applying a gain and offset to each band "
+                  "of a source raster element.");
+   setDescriptorId("{4C6A2E1B-8F3D-4B7A-9E25-6D1F0C8A7B39}");
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+}
+
+GainOffsetPager::~GainOffsetPager()
+{
+}
+
+bool GainOffsetPager::getInputSpecification(PlugInArgList*& pArgList)
+{
+   VERIFY((pArgList = Service<PlugInManagerServices>()->getPlugInArgList()) != NULL);
+   VERIFY(pArgList->addArg<RasterElement>("Raster Element", NULL, "Raster element to be paged."));
+   VERIFY(pArgList->addArg<RasterElement>("Source Element", NULL, "Raster element from which the paged data is "
+      "computed. It must have the same dimensions as the paged element."));
+   VERIFY(pArgList->addArg<vector<double> >("Gains", "Gain applied to each band of the source element. The plug-in "
+      "will fail to execute if the user does not pass a value in for this argument."));
+   VERIFY(pArgList->addArg<vector<double> >("Offsets", "Offset added to each band of the source element after the "
+      "gain is applied. The plug-in will fail to execute if the user does not pass a value in for this argument."));
+   return true;
+}
+
+bool GainOffsetPager::execute(PlugInArgList* pInputArgList, PlugInArgList* pOutputArgList)
+{
+   VERIFY(pInputArgList != NULL);
+   mpElement = pInputArgList->getPlugInArgValue<RasterElement>("Raster Element");
+   mpSource = pInputArgList->getPlugInArgValue<RasterElement>("Source Element");
+   VERIFY(mpElement != NULL && mpSource != NULL);
+   VERIFY(pInputArgList->getPlugInArgValue<vector<double> >("Gains", mGains));
+   VERIFY(pInputArgList->getPlugInArgValue<vector<double> >("Offsets", mOffsets));
+
+   const RasterDataDescriptor* pDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpElement->getDataDescriptor());
+   const RasterDataDescriptor* pSourceDescriptor =
+      dynamic_cast<const RasterDataDescriptor*>(mpSource->getDataDescriptor());
+   VERIFY(pDescriptor != NULL && pSourceDescriptor != NULL);
+   VERIFY(pDescriptor->getRowCount() == pSourceDescriptor->getRowCount());
+   VERIFY(pDescriptor->getColumnCount() == pSourceDescriptor->getColumnCount());
+   VERIFY(pDescriptor->getBandCount() == pSourceDescriptor->getBandCount());
+   VERIFY(mGains.size() == pDescriptor->getBandCount() && mOffsets.size() == pDescriptor->getBandCount());
+
+   return true;
+}
+
+RasterPage* GainOffsetPager::getPage(DataRequest* pOriginalRequest,
+                                     DimensionDescriptor startRow,
+                                     DimensionDescriptor startColumn,
+                                     DimensionDescriptor startBand)
+{
+   VERIFYRV(pOriginalRequest != NULL && mpElement != NULL && mpSource != NULL, NULL);
+   if (pOriginalRequest->getWritable())
+   {
+      return NULL;
+   }
+
+   const RasterDataDescriptor* pDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpElement->getDataDescriptor());
+   const RasterDataDescriptor* pSourceDescriptor =
+      dynamic_cast<const RasterDataDescriptor*>(mpSource->getDataDescriptor());
+   VERIFYRV(pDescriptor != NULL && pSourceDescriptor != NULL, NULL);
+   VERIFYRV(startRow.isActiveNumberValid() && startColumn.isActiveNumberValid() && startBand.isActiveNumberValid(),
+      NULL);
+
+   // The page covers the requested rows, the remainder of each row and, unless the request is BSQ,
+   // the remaining bands
+   const InterleaveFormatType interleave = pOriginalRequest->getInterleaveFormat();
+   const unsigned int firstRow = startRow.getActiveNumber();
+   const unsigned int firstColumn = startColumn.getActiveNumber();
+   const unsigned int firstBand = startBand.getActiveNumber();
+   VERIFYRV(firstRow < pDescriptor->getRowCount() && firstColumn < pDescriptor->getColumnCount() &&
+      firstBand < pDescriptor->getBandCount(), NULL);
+   const unsigned int numRows = min(max(pOriginalRequest->getConcurrentRows(), 1U),
+      pDescriptor->getRowCount() - firstRow);
+   const unsigned int numColumns = pDescriptor->getColumnCount() - firstColumn;
+   const unsigned int numBands = (interleave == BSQ ? 1 : pDescriptor->getBandCount() - firstBand);
+
+   // Read the source a pixel at a time so every band of a pixel is contiguous regardless of how the
+   // source is paged
+   FactoryResource<DataRequest> pSourceRequest;
+   VERIFYRV(pSourceRequest.get() != NULL, NULL);
+   pSourceRequest->setInterleaveFormat(interleave == BSQ ? BSQ : BIP);
+   pSourceRequest->setRows(pSourceDescriptor->getActiveRow(firstRow),
+      pSourceDescriptor->getActiveRow(firstRow + numRows - 1), numRows);
+   pSourceRequest->setColumns(pSourceDescriptor->getActiveColumn(firstColumn),
+      pSourceDescriptor->getActiveColumn(firstColumn + numColumns - 1), numColumns);
+   pSourceRequest->setBands(pSourceDescriptor->getActiveBand(firstBand),
+      pSourceDescriptor->getActiveBand(firstBand + numBands - 1), numBands);
+   DataAccessor sourceAccessor = mpSource->getDataAccessor(pSourceRequest.release());
+   VERIFYRV(sourceAccessor.isValid(), NULL);
+
+   const EncodingType sourceType = pSourceDescriptor->getDataType();
+   vector<double> pixel(numBands);
+   vector<double> values(static_cast<size_t>(numRows) * numColumns * numBands);
+   for (unsigned int row = 0; row < numRows; ++row)
+   {
+      sourceAccessor->toPixel(firstRow + row, firstColumn);
+      for (unsigned int column = 0; column < numColumns; ++column)
+      {
+         VERIFYRV(sourceAccessor.isValid(), NULL);
+         switchOnEncoding(sourceType, readPixel, sourceAccessor->getColumn(), &pixel.front(), numBands);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            size_t index = 0;
+            if (interleave == BIL)
+            {
+               index = (static_cast<size_t>(row) * numBands + band) * numColumns + column;
+            }
+            else
+            {
+               index = (static_cast<size_t>(row) * numColumns + column) * numBands + band;
+            }
+            values[index] = pixel[band] * mGains[firstBand + band] + mOffsets[firstBand + band];
+         }
+         sourceAccessor->nextColumn();
+      }
+   }
+
+   GainOffsetRasterPage* pPage = new GainOffsetRasterPage(numRows, numColumns, numBands,
+      pDescriptor->getBytesPerElement());
+   switchOnEncoding(pDescriptor->getDataType(), writeValues, pPage->getRawData(), values);
+   return pPage;
+}
+
+void GainOffsetPager::releasePage(RasterPage* pPage)
+{
+   delete dynamic_cast<GainOffsetRasterPage*>(pPage);
+}
+
+int GainOffsetPager::getSupportedRequestVersion() const
+{
+   return 1;
+}
@@ -0,0 +1,73 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef GAINOFFSETPAGER_H
+#define GAINOFFSETPAGER_H
+
+#include "RasterPage.h"
+#include "RasterPagerShell.h"
+
+#include <vector>
+
+class RasterDataDescriptor;
+class RasterElement;
+
+class GainOffsetRasterPage : public RasterPage
+{
+public:
+   GainOffsetRasterPage(unsigned int rows, unsigned int columns, unsigned int bands, unsigned int bytesPerElement);
+   void* getRawData();
+   unsigned int getNumRows();
+   unsigned int getNumColumns();
+   unsigned int getNumBands();
+   unsigned int getInterlineBytes();
+
+protected:
+   ~GainOffsetRasterPage();
+   friend class GainOffsetPager;
+
+private:
+   std::vector<char> mData;
+   unsigned int mRows;
+   unsigned int mColumns;
+   unsigned int mBands;
+};
+
+/**
+ *  Pages a raster element whose values are computed on demand from a source
+ *  raster element as source * gain + offset, with one gain and offset per band.
+ *
+ *  Each page is read from the source when it is requested and converted to the
+ *  data type of the paged element, so the corrected cube is never written in
+ *  full. Exporting the paged element materializes the corrected values.
+ *
+ *  The paged element must have the same rows, columns and bands as the source.
+ *  Use SpectralUtilities::createGainOffsetElement() to create one.
+ */
+class GainOffsetPager : public RasterPagerShell
+{
+public:
+   GainOffsetPager();
+   ~GainOffsetPager();
+
+   bool getInputSpecification(PlugInArgList*& pArgList);
+   bool execute(PlugInArgList* pInputArgList, PlugInArgList* pOutputArgList);
+   RasterPage* getPage(DataRequest* pOriginalRequest, DimensionDescriptor startRow,
+      DimensionDescriptor startColumn, DimensionDescriptor startBand);
+   void releasePage(RasterPage* pPage);
+   int getSupportedRequestVersion() const;
+
+private:
+   RasterElement* mpElement;
+   RasterElement* mpSource;
+   std::vector<double> mGains;
+   std::vector<double> mOffsets;
+};
+
+#endif
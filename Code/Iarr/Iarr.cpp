@@ -10,6 +10,8 @@
 #include <QtCore/QDir>
 #include <QtCore/QFileInfo>
 #include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentMap>
 #include <QtGui/QMessageBox>
 
 #include "AoiElement.h"
@@ -29,6 +31,7 @@
 #include "RasterUtilities.h"
 #include "SpatialDataView.h"
 #include "SpatialDataWindow.h"
+#include "SpectralUtilities.h"
 #include "SpectralVersion.h"
 #include "StringUtilities.h"
 #include "switchOnEncoding.h"
@@ -36,15 +39,129 @@
 #include "Undo.h"
 #include "Units.h"
 
+#include <algorithm>
 #include <fstream>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
 
 REGISTER_PLUGIN_BASIC(SpectralIarr, Iarr);
 
+namespace
+{
+   // number of sampled rows read by each task when computing the band averages
+   const unsigned int sRowsPerTask = 16;
+
+   struct GainSums
+   {
+      GainSums() :
+         mCount(0)
+      {}
+
+      std::vector<double> mSums;
+      unsigned int mCount;
+   };
+
+   template<typename T>
+   void accumulatePixel(T* pPixel, std::vector<double>& sums)
+   {
+      for (std::vector<double>::size_type band = 0; band < sums.size(); ++band)
+      {
+         sums[band] += pPixel[band];
+      }
+   }
+
+   /**
+    *  Sums every band of the sampled pixels in a range of rows with a single BIP read.
+    *  Rows are given as the first row and one past the last row, and only every
+    *  mRowStep'th row starting from the first is read.
+    */
+   struct GainSumsMap
+   {
+      typedef std::pair<unsigned int, unsigned int> input_type;
+      typedef GainSums result_type;
+
+      GainSumsMap(RasterElement* pElement, const BitMask* pBitMask, unsigned int rowStep, unsigned int columnStep) :
+         mpElement(pElement),
+         mpDescriptor(NULL),
+         mpBitMask(pBitMask),
+         mRowStep(rowStep),
+         mColumnStep(columnStep),
+         mNumBands(0),
+         mNumColumns(0),
+         mBytesPerPixel(0),
+         mEncoding(INT1UBYTE)
+      {
+         VERIFYNRV(mpElement != NULL);
+         mpDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpElement->getDataDescriptor());
+         VERIFYNRV(mpDescriptor != NULL);
+         mNumBands = mpDescriptor->getBandCount();
+         mNumColumns = mpDescriptor->getColumnCount();
+         mBytesPerPixel = mpDescriptor->getBytesPerElement() * mNumBands;
+         mEncoding = mpDescriptor->getDataType();
+      }
+
+      result_type operator()(const input_type& rows) const
+      {
+         GainSums results;
+         VERIFYRV(mpDescriptor != NULL, results);
+         results.mSums.resize(mNumBands, 0.0);
+
+         FactoryResource<DataRequest> pRequest;
+         pRequest->setInterleaveFormat(BIP);
+         pRequest->setRows(mpDescriptor->getActiveRow(rows.first), mpDescriptor->getActiveRow(rows.second - 1));
+         DataAccessor accessor = mpElement->getDataAccessor(pRequest.release());
+         VERIFYRV(accessor.isValid(), results);
+
+         for (unsigned int row = rows.first; row < rows.second; row += mRowStep)
+         {
+            accessor->toPixel(row, 0);
+            VERIFYRV(accessor.isValid(), results);
+            char* pRow = reinterpret_cast<char*>(accessor->getRow());
+            for (unsigned int column = 0; column < mNumColumns; column += mColumnStep)
+            {
+               if (mpBitMask == NULL || mpBitMask->getPixel(column, row) == true)
+               {
+                  switchOnEncoding(mEncoding, accumulatePixel, pRow + column * mBytesPerPixel, results.mSums);
+                  ++results.mCount;
+               }
+            }
+         }
+
+         return results;
+      }
+
+      RasterElement* mpElement;
+      const RasterDataDescriptor* mpDescriptor;
+      const BitMask* mpBitMask;
+      unsigned int mRowStep;
+      unsigned int mColumnStep;
+      unsigned int mNumBands;
+      unsigned int mNumColumns;
+      unsigned int mBytesPerPixel;
+      EncodingType mEncoding;
+   };
+
+   void gainSumsReduce(GainSums& total, const GainSums& partial)
+   {
+      if (total.mSums.empty())
+      {
+         total.mSums = partial.mSums;
+      }
+      else
+      {
+         for (std::vector<double>::size_type band = 0; band < total.mSums.size(); ++band)
+         {
+            total.mSums[band] += partial.mSums[band];
+         }
+      }
+      total.mCount += partial.mCount;
+   }
+}
+
 Iarr::Iarr() :
    mpProgress(NULL),
    mpInputRasterElement(NULL),
@@ -327,8 +444,8 @@ bool Iarr::getInputSpecification(PlugInArgList*& pArgList)
          "cube or AOI will be iterated over."));
 
       VERIFY(pArgList->addArg<EncodingType>("Output Data Type", mOutputDataType, "The data type for the output of IARR."));
-      VERIFY(pArgList->addArg<bool>("In Memory", mInMemory, "Flag for whether the cube should be loaded entirely into "
-         "memory for IARR."));
+      VERIFY(pArgList->addArg<bool>("In Memory", mInMemory, "Flag for whether the results should be computed into "
+         "memory. Otherwise they are computed from the input cube on demand and written out only when exported."));
 
       VERIFY(pArgList->addArg<bool>("Display Results", mDisplayResults, "Flag for whether the results of IARR should "
          "be displayed."));
@@ -626,15 +743,24 @@ RasterElement* Iarr::runAlgorithm()
    VERIFYRV(pStep.get() != NULL, NULL);
    ErrorLog errorLog(pStep.get(), mpProgress);
 
-   // Create a Raster Element for output
+   // Make sure that any existing results can be replaced and create an in-memory Raster Element for output
    // This work is done here so that if it fails the user is informed before actually running the algorithm
-   ModelResource<RasterElement> pOutputRasterElement(createOutputRasterElement());
-   if (pOutputRasterElement.get() == NULL)
+   const string outputRasterElementName = mpInputRasterElement->getName() + " - " + getName();
+   if (destroyExistingOutput(outputRasterElementName) == false)
    {
       errorLog.setError("Unable to create a Raster Element.");
       return NULL;
    }
 
+   ModelResource<RasterElement> pOutputRasterElement(mInMemory ?
+      createOutputRasterElement(outputRasterElementName, NULL) : NULL);
+
+   // If creating a RasterElement fails in memory, compute the results on demand instead
+   if (pOutputRasterElement.get() == NULL)
+   {
+      mInMemory = false;
+   }
+
    // Calculate (or load) gains
    vector<double> gains;
    if (determineGains(gains) == false)
@@ -644,34 +770,48 @@ RasterElement* Iarr::runAlgorithm()
    }
 
    // Apply the gains to the RasterElement
-   if (applyGains(gains, pOutputRasterElement.get()) == false)
+   if (mInMemory == true && applyGains(gains, pOutputRasterElement.get()) == false)
    {
       errorLog.setError("Unable to apply gains.");
       return NULL;
    }
 
+   // Otherwise present the input data with the gains applied as it is read rather than writing a scaled copy
+   RasterElement* pResults = (mInMemory == true ? pOutputRasterElement.release() :
+      createOutputRasterElement(outputRasterElementName, &gains));
+   if (pResults == NULL)
+   {
+      errorLog.setError("Unable to create a Raster Element.");
+      return NULL;
+   }
+
    // Update mpProgress
    if (mpProgress != NULL)
    {
       mpProgress->updateProgress("Finished.", 100, NORMAL);
    }
 
-   return pOutputRasterElement.release();
+   return pResults;
 }
 
-RasterElement* Iarr::createOutputRasterElement()
+bool Iarr::destroyExistingOutput(const string& outputRasterElementName)
 {
-   StepResource pStep("Create output Raster Element", "spectral", "F10ED0BB-AE4D-4948-A9D9-7AF87543D2D6");
-   VERIFYRV(pStep.get() != NULL, NULL);
+   StepResource pStep("Destroy existing output Raster Element", "spectral", "0E7C1A5D-3B92-4F6E-8D41-A2C95B07E613");
+   VERIFY(pStep.get() != NULL);
    ErrorLog errorLog(pStep.get(), mpProgress);
 
-   const string outputRasterElementName = mpInputRasterElement->getName() + " - " + getName();
-
    // If an IARR Raster Element already exists, make sure that the user wants to recreate it
    // In batch mode, do not prompt the user; simply destroy the Raster Element
+   // Results computed on demand are children of the input Raster Element, so check there as well
    Service<ModelServices> pModelServices;
    RasterElement* pExistingRasterElement = dynamic_cast<RasterElement*>
       (pModelServices->getElement(outputRasterElementName, TypeConverter::toString<RasterElement>(), NULL));
+   if (pExistingRasterElement == NULL)
+   {
+      pExistingRasterElement = dynamic_cast<RasterElement*>(pModelServices->getElement(outputRasterElementName,
+         TypeConverter::toString<RasterElement>(), mpInputRasterElement));
+   }
+
    if (pExistingRasterElement != NULL)
    {
       const string message = "A Raster Element containing the " + getName() + " results already exists.\n"
@@ -682,16 +822,25 @@ RasterElement* Iarr::createOutputRasterElement()
          QMessageBox::Yes, QMessageBox::No) == QMessageBox::No)
       {
          errorLog.setError("A Raster Element containing the " + getName() + " results already exists.");
-         return NULL;
+         return false;
       }
 
       if (pModelServices->destroyElement(pExistingRasterElement) == false)
       {
          errorLog.setError("Model Services failed to destroy the existing " + getName() + " Raster Element.");
-         return NULL;
+         return false;
       }
    }
 
+   return true;
+}
+
+RasterElement* Iarr::createOutputRasterElement(const string& outputRasterElementName, const vector<double>* pGains)
+{
+   StepResource pStep("Create output Raster Element", "spectral", "F10ED0BB-AE4D-4948-A9D9-7AF87543D2D6");
+   VERIFYRV(pStep.get() != NULL, NULL);
+   ErrorLog errorLog(pStep.get(), mpProgress);
+
    RasterDataDescriptor* pInputRasterDataDescriptor =
       dynamic_cast<RasterDataDescriptor*>(mpInputRasterElement->getDataDescriptor());
    VERIFYRV(pInputRasterDataDescriptor != NULL, NULL);
@@ -699,22 +848,27 @@ RasterElement* Iarr::createOutputRasterElement()
    const unsigned int numRows = pInputRasterDataDescriptor->getRowCount();
    const unsigned int numColumns = pInputRasterDataDescriptor->getColumnCount();
 
-   // Create a RasterElement to store the results of the calculation
-   RasterElement* pOutputRasterElement = RasterUtilities::createRasterElement(outputRasterElementName, numRows,
-      numColumns, numBands, mOutputDataType, pInputRasterDataDescriptor->getInterleaveFormat(), mInMemory);
-   if (pOutputRasterElement == NULL)
+   RasterElement* pOutputRasterElement = NULL;
+   if (pGains == NULL)
    {
-      // If creating a RasterElement fails in memory, try to create it on disk
-      if (mInMemory == true)
+      // Create a RasterElement in memory to store the results of the calculation
+      pOutputRasterElement = RasterUtilities::createRasterElement(outputRasterElementName, numRows,
+         numColumns, numBands, mOutputDataType, pInputRasterDataDescriptor->getInterleaveFormat(), true);
+      if (pOutputRasterElement == NULL)
       {
-         mInMemory = false;
-         pOutputRasterElement = RasterUtilities::createRasterElement(outputRasterElementName, numRows,
-            numColumns, numBands, mOutputDataType, pInputRasterDataDescriptor->getInterleaveFormat(), mInMemory);
+         errorLog.addWarning("Unable to create a Raster Element in memory. The results will be computed on demand.");
+         return NULL;
       }
-
+   }
+   else
+   {
+      // Create a RasterElement which applies the gains to the input data as it is accessed
+      const vector<double> offsets(numBands, 0.0);
+      pOutputRasterElement = SpectralUtilities::createGainOffsetElement(outputRasterElementName,
+         mpInputRasterElement, *pGains, offsets, mOutputDataType);
       if (pOutputRasterElement == NULL)
       {
-         errorLog.setError("Raster Utilities failed to create a Raster Element for " + getName() + " results.");
+         errorLog.setError("Unable to create a Raster Element to compute the " + getName() + " results on demand.");
          return NULL;
       }
    }
@@ -758,8 +912,6 @@ bool Iarr::determineGains(vector<double>& gains)
    VERIFY(pInputRasterDataDescriptor != NULL);
    const unsigned int numBands = pInputRasterDataDescriptor->getBandCount();
    const unsigned int numRows = pInputRasterDataDescriptor->getRowCount();
-   const unsigned int numColumns = pInputRasterDataDescriptor->getColumnCount();
-   const EncodingType inputDataType = pInputRasterDataDescriptor->getDataType();
 
    gains.clear();
    if (mInputFilename.empty() == false)
@@ -804,77 +956,76 @@ bool Iarr::determineGains(vector<double>& gains)
          }
       }
 
-      // Set the maximum completion percentage to 99.9% so that mpProgress does not disappear between bands
-      const double calculateAverageStep = 99.9 / (numRows / mRowStepFactor);
-      for (unsigned int band = 0; band < numBands; ++band)
+      // Sum every band in a single BIP pass over the sampled rows. Each task reads a block of rows
+      // into its own accumulators, which are combined as the tasks complete.
+      vector<pair<unsigned int, unsigned int> > rowBlocks;
+      const unsigned int rowsPerBlock = sRowsPerTask * mRowStepFactor;
+      for (unsigned int row = 0; row < numRows; row += rowsPerBlock)
       {
-         // Build a name to identify this band
-         stringstream bandName;
-         bandName << "Band " << (band + 1) << "/" << (numBands);
-
-         // Obtain a DataAccessor for this band for pInputRasterElement
-         DimensionDescriptor activeBand = pInputRasterDataDescriptor->getActiveBand(band);
-         if (activeBand.isValid() == false)
-         {
-            errorLog.setError("Active Band is invalid for " + bandName.str() + ".");
-            return false;
-         }
-
-         FactoryResource<DataRequest> pRequest;
-         VERIFY(pRequest.get() != NULL);
-         pRequest->setBands(activeBand, activeBand);
-         DataAccessor daAccessor = mpInputRasterElement->getDataAccessor(pRequest.release());
-         if (daAccessor.isValid() == false)
-         {
-            errorLog.setError("Unable to obtain a Data Accessor for " + bandName.str() + ".");
-            return false;
-         }
+         rowBlocks.push_back(make_pair(row, min(row + rowsPerBlock, numRows)));
+      }
 
-         double percent = 0.0;
-         double totalValue = 0.0;
-         unsigned int totalCounted = 0;
-         for (unsigned int row = 0; row < numRows && daAccessor.isValid(); row += mRowStepFactor)
+      GainSumsMap sumsMap(mpInputRasterElement, pBitMask, mRowStepFactor, mColumnStepFactor);
+      GainSums totals;
+#ifndef QT_NO_CONCURRENT
+      QFuture<GainSums> sums = QtConcurrent::mappedReduced(rowBlocks.begin(), rowBlocks.end(), sumsMap,
+         gainSumsReduce, QtConcurrent::UnorderedReduce);
+      bool isCancelling = false;
+      while (sums.isRunning())
+      {
+         if (isCancelling == false)
          {
-            // Update mpProgress
             if (mpProgress != NULL)
             {
-               percent += calculateAverageStep;
-               mpProgress->updateProgress(bandName.str() + ": Calculating Gain (Step 1/2)",
-                  static_cast<int>(percent), NORMAL);
-
-               // Check if the operation has been cancelled
-               if (isAborted() == true)
-               {
-                  errorLog.aborted();
-                  return false;
-               }
+               // Set the maximum completion percentage to 99.9% so that mpProgress does not disappear
+               const int progressRange = sums.progressMaximum() - sums.progressMinimum();
+               const double percent = progressRange <= 0 ? 0.0 :
+                  99.9 * (sums.progressValue() - sums.progressMinimum()) / progressRange;
+               mpProgress->updateProgress("Calculating Gains (Step 1/2)", static_cast<int>(percent), NORMAL);
             }
-
-            for (unsigned int column = 0; column < numColumns && daAccessor.isValid(); column += mColumnStepFactor)
+            if (isAborted() == true)
             {
-               if (pBitMask == NULL || pBitMask->getPixel(column, row) == true)
-               {
-                  daAccessor->toPixel(row, column);
-                  if (daAccessor.isValid() == false)
-                  {
-                     errorLog.setError("Unable to read from the Data Accessor for " + bandName.str() + ".");
-                     return false;
-                  }
-
-                  totalValue += Service<ModelServices>()->getDataValue(inputDataType, daAccessor->getColumn(), 0);
-                  ++totalCounted;
-               }
+               sums.cancel();
+               isCancelling = true;
             }
          }
+         QThread::yieldCurrentThread();
+      }
 
-#pragma message(__FILE__ "(" STRING(__LINE__) ") : warning : Use \"fabs(totalValue / totalCounted)\"? (dadkins)")
-         if (totalCounted == 0)
+      if (sums.isCanceled() == true)
+      {
+         errorLog.aborted();
+         return false;
+      }
+      totals = sums.result();
+#else
+      for (vector<pair<unsigned int, unsigned int> >::const_iterator iter = rowBlocks.begin();
+         iter != rowBlocks.end(); ++iter)
+      {
+         if (mpProgress != NULL)
          {
-            errorLog.setError("Unable to compute an average value.\nNo pixels within the image are selected.");
+            mpProgress->updateProgress("Calculating Gains (Step 1/2)",
+               static_cast<int>(99.9 * iter->first / numRows), NORMAL);
+         }
+         if (isAborted() == true)
+         {
+            errorLog.aborted();
             return false;
          }
+         gainSumsReduce(totals, sumsMap(*iter));
+      }
+#endif
 
-         const double averageValue = totalValue / totalCounted;
+#pragma message(__FILE__ "(" STRING(__LINE__) ") : warning : Use \"fabs(totalValue / totalCounted)\"? (dadkins)")
+      if (totals.mCount == 0 || totals.mSums.size() != numBands)
+      {
+         errorLog.setError("Unable to compute an average value.\nNo pixels within the image are selected.");
+         return false;
+      }
+
+      for (unsigned int band = 0; band < numBands; ++band)
+      {
+         const double averageValue = totals.mSums[band] / totals.mCount;
          double gain = 1.0;
          if (averageValue != 0.0)
          {
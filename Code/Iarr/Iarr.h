@@ -67,7 +67,9 @@ private:
    bool extractAndValidateInputArguments(PlugInArgList* pInputArgList);
    SpatialDataWindow* createWindow(const std::string& windowName);
    RasterElement* runAlgorithm();
-   RasterElement* createOutputRasterElement();
+   bool destroyExistingOutput(const std::string& outputRasterElementName);
+   RasterElement* createOutputRasterElement(const std::string& outputRasterElementName,
+      const std::vector<double>* pGains);
    bool determineGains(std::vector<double>& gains);
    bool applyGains(const std::vector<double>& gains, RasterElement* pOutputRasterElement);
 
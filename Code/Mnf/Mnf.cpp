@@ -29,6 +29,7 @@
 #include "MessageLogResource.h"
 #include "Mnf.h"
 #include "MnfDlg.h"
+#include "MnfMath.h"
 #include "ModelServices.h"
 #include "ObjectResource.h"
 #include "PlugInArg.h"
@@ -45,12 +46,14 @@
 #include "SpectralVersion.h"
 #include "Statistics.h"
 #include "StatisticsDlg.h"
+#include "StringUtilities.h"
 #include "switchOnEncoding.h"
 #include "TypeConverter.h"
 #include "Undo.h"
 #include "Units.h"
 #include "Wavelengths.h"
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <math.h>
@@ -98,41 +101,8 @@ namespace
       }
    }
 
-   template<class T>
-   void computeMnfColumn(T *pData, double* pMnfData, double** pCoefficients, unsigned int numBands,
-      unsigned int numComponents)
-   {
-      for (unsigned int comp = 0; comp < numComponents; ++comp)
-      {
-         pMnfData[comp] = 0.0;
-         for (unsigned int band = 0; band < numBands; ++band)
-         {
-            pMnfData[comp] += pCoefficients[band][comp] * static_cast<double>(pData[band]);
-         }
-      }
-   }
-
-   template <class T>
-   void computeMnfRow(T* pData, double* pMnfData,  double** pCoefficients, unsigned int numCols,
-      unsigned int numBands, unsigned int numComponents)
-   {
-      T* pColumn = pData;
-      double* pValue = pMnfData;
-
-      for (unsigned int col = 0; col < numCols; ++col)
-      {
-         for (unsigned int comp = 0; comp < numComponents; ++comp)
-         {
-            pValue[comp] = 0.0;
-            for (unsigned int band = 0; band < numBands; ++band)
-            {
-               pValue[comp] += (pCoefficients[band][comp] * static_cast<double>(pColumn[band]));
-            }
-         }
-         pValue += numComponents;
-         pColumn += numBands;
-      }
-   }
+   // maximum number of values held in a tile of input pixels when computing the MNF components
+   const size_t sMaxTileValues = 4 * 1024 * 1024;
 }
 
 REGISTER_PLUGIN_BASIC(SpectralMnf, Mnf);
@@ -154,6 +124,8 @@ Mnf::Mnf() :
    mpProcessingAoi(NULL),
    mpNoiseAoi(NULL),
    mNumComponentsToUse(0),
+   mOutputDataType(FLT4BYTES),
+   mbDenoise(false),
    mbUseSnrValPlot(false),
    mbDisplayResults(true),
    mNoiseStatisticsMethod(DIFFDATA)
@@ -206,6 +178,12 @@ bool Mnf::getInputSpecification(PlugInArgList*& pArgList)
          "calculated."));
       VERIFY(pArgList->addArg<unsigned int>("Number of Components", 0, "Number of bands produced in the resulting "
          "raster element."));
+      VERIFY(pArgList->addArg<EncodingType>("Output Data Type", mOutputDataType, "The data type of the resulting "
+         "raster element. Must be either " + StringUtilities::toDisplayString(FLT4BYTES) + " or " +
+         StringUtilities::toDisplayString(FLT8BYTES) + "."));
+      VERIFY(pArgList->addArg<bool>("Denoise", false, "Flag for whether the data should be reconstructed from the "
+         "first \"Number of Components\" components in a single pass instead of producing the MNF components. The "
+         "result is returned in \"Denoised Data Cube\"."));
       VERIFY(pArgList->addArg<bool>("Display Results", false, "Flag for whether the results of the MNF transform "
          "should be displayed."));
    }
@@ -219,6 +197,8 @@ bool Mnf::getOutputSpecification(PlugInArgList*& pArgList)
    pArgList = mpPlugInMgr->getPlugInArgList();
    VERIFY(pArgList != NULL);
    VERIFY(pArgList->addArg<RasterElement>("MNF Data Cube", NULL, "Raster element resulting from the MNF transform."));
+   VERIFY(pArgList->addArg<RasterElement>("Denoised Data Cube", NULL, "Raster element reconstructed from the leading "
+      "MNF components when denoising."));
    return true;
 }
 
@@ -272,6 +252,8 @@ bool Mnf::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
                mSaveCoefficientsFilename = dlg.getCoefficientsFilename();
             }
 
+            mOutputDataType = dlg.getOutputDataType();
+            mbDenoise = dlg.performDenoise();
             mbUseSnrValPlot = dlg.selectNumComponentsFromPlot();
             if (!mbUseSnrValPlot)
             {
@@ -462,7 +444,7 @@ bool Mnf::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
       // Set the values in the output arg list
       if (pOutArgList != NULL)
       {
-         VERIFY(pOutArgList->setPlugInArgValue("MNF Data Cube", mpMnfRaster.get()));
+         VERIFY(pOutArgList->setPlugInArgValue(mbDenoise ? "Denoised Data Cube" : "MNF Data Cube", mpMnfRaster.get()));
       }
 
       if (mpProgress != NULL)
@@ -635,6 +617,16 @@ bool Mnf::extractInputArgs(const PlugInArgList* pArgList)
          return false;
       }
 
+      VERIFY(pArgList->getPlugInArgValue<EncodingType>("Output Data Type", mOutputDataType));
+      if (mOutputDataType != FLT4BYTES && mOutputDataType != FLT8BYTES)
+      {
+         mMessage = "The output data type must be either " + StringUtilities::toDisplayString(FLT4BYTES) +
+            " or " + StringUtilities::toDisplayString(FLT8BYTES) + ".";
+         mpStep->finalize(Message::Failure, mMessage);
+         return false;
+      }
+
+      VERIFY(pArgList->getPlugInArgValue<bool>("Denoise", mbDenoise));
       VERIFY(pArgList->getPlugInArgValue<bool>("Display Results", mbDisplayResults));
    }
 
@@ -667,7 +659,7 @@ bool Mnf::createMnfCube()
    {
       loc = outputName.length();
    }
-   outputName = outputName.insert(loc, "_mnf");
+   outputName = outputName.insert(loc, mbDenoise ? "_denoised" : "_mnf");
 
    unsigned int numRows = mNumRows;
    unsigned int numCols = mNumColumns;
@@ -685,14 +677,16 @@ bool Mnf::createMnfCube()
       return false;
    }
 
+   // denoising reconstructs every band of the original data
+   unsigned int numBands = mbDenoise ? mNumBands : mNumComponentsToUse;
    RasterElement* pMnfRaster = RasterUtilities::createRasterElement(outputName, numRows, numCols,
-      mNumComponentsToUse, FLT8BYTES, BIP, true, NULL);
+      numBands, mOutputDataType, BIP, true, NULL);
 
    // if can't create in memory, then try on_disk
    if (pMnfRaster == NULL)
    {
       pMnfRaster = RasterUtilities::createRasterElement(outputName, numRows, numCols,
-         mNumComponentsToUse, FLT8BYTES, BIP, false, NULL);
+         numBands, mOutputDataType, BIP, false, NULL);
    }
 
    if (pMnfRaster == NULL)
@@ -724,18 +718,44 @@ bool Mnf::createMnfCube()
    // copy classification from mpRaster
    mpMnfRaster->copyClassification(mpRaster);
 
-   // Bad values
-   vector<int>badValue(1);
-   badValue[0] = 0;
-   pRdd->setBadValues(badValue);
+   if (mbDenoise)
+   {
+      // the denoised data has the same bad values, units and wavelengths as the original data
+      const RasterDataDescriptor* pOrigDesc =
+         dynamic_cast<const RasterDataDescriptor*>(mpRaster->getDataDescriptor());
+      VERIFY(pOrigDesc != NULL);
+      pRdd->setBadValues(pOrigDesc->getBadValues());
+
+      const Units* pOrigUnits = pOrigDesc->getUnits();
+      Units* pUnits = pRdd->getUnits();
+      if (pOrigUnits != NULL && pUnits != NULL)
+      {
+         pUnits->setUnitType(pOrigUnits->getUnitType());
+         pUnits->setUnitName(pOrigUnits->getUnitName());
+         pUnits->setScaleFromStandard(pOrigUnits->getScaleFromStandard());
+      }
 
-   // Units
-   Units* pUnits = pRdd->getUnits();
-   if (pUnits != NULL)
+      FactoryResource<Wavelengths> pWavelengths;
+      if (pWavelengths->initializeFromDynamicObject(mpRaster->getMetadata(), false))
+      {
+         pWavelengths->applyToDynamicObject(mpMnfRaster->getMetadata());
+      }
+   }
+   else
    {
-      pUnits->setUnitType(CUSTOM_UNIT);
-      pUnits->setUnitName("MNF Value");
-      pUnits->setScaleFromStandard(1.0);
+      // Bad values
+      vector<int>badValue(1);
+      badValue[0] = 0;
+      pRdd->setBadValues(badValue);
+
+      // Units
+      Units* pUnits = pRdd->getUnits();
+      if (pUnits != NULL)
+      {
+         pUnits->setUnitType(CUSTOM_UNIT);
+         pUnits->setUnitName("MNF Value");
+         pUnits->setScaleFromStandard(1.0);
+      }
    }
 
    if (isAborted())
@@ -767,7 +787,7 @@ bool Mnf::computeMnfValues()
    unsigned int colOffset = it.getColumnOffset();
    unsigned int rowOffset = it.getRowOffset();
 
-   if (mnfNumBands != mNumComponentsToUse)
+   if (mnfNumBands != (mbDenoise ? mNumBands : mNumComponentsToUse))
    {
       mMessage = "The dimensions of the MNF RasterElement are not correct.";
       if (mpProgress != NULL)
@@ -807,10 +827,6 @@ bool Mnf::computeMnfValues()
    }
    // Initialize progress bar variables
    int currentProgress = 0;
-   int count = 0;
-
-   void* pMnfData = NULL;
-   void* pOrigData = NULL;
 
    FactoryResource<DataRequest> pBipRequest;
    pBipRequest->setInterleaveFormat(BIP);
@@ -849,45 +865,147 @@ bool Mnf::computeMnfValues()
       return false;
    }
 
-   double* pValues = NULL;
-   for (unsigned int row = 0; row < mnfNumRows; ++row)
+   vector<double> coefficients;
+   if (mbDenoise)
+   {
+      if (!computeDenoiseMatrix(coefficients))
+      {
+         if (mpProgress != NULL)
+         {
+            mpProgress->updateProgress(mMessage, 0, ERRORS);
+         }
+
+         mpStep->finalize(Message::Failure, mMessage);
+         return false;
+      }
+   }
+   else
+   {
+      // copy the coefficients for only the requested components into contiguous storage
+      coefficients.resize(static_cast<size_t>(mNumBands) * mNumComponentsToUse);
+      for (unsigned int band = 0; band < mNumBands; ++band)
+      {
+         for (unsigned int comp = 0; comp < mNumComponentsToUse; ++comp)
+         {
+            coefficients[static_cast<size_t>(band) * mNumComponentsToUse + comp] = mpMnfTransformMatrix[band][comp];
+         }
+      }
+   }
+
+   // the pixels are processed in tiles of whole rows - each tile is a pixels x bands matrix
+   // which is multiplied by the bands x components transform or the bands x bands denoise matrix
+   const size_t valuesPerRow = static_cast<size_t>(mnfNumCols) * max(mNumBands, mnfNumBands);
+   const unsigned int tileRows = static_cast<unsigned int>(
+      min(static_cast<size_t>(mnfNumRows), max(static_cast<size_t>(1), sMaxTileValues / valuesPerRow)));
+   const size_t tilePixels = static_cast<size_t>(tileRows) * mnfNumCols;
+   vector<double> pixelValues(tilePixels * mNumBands);
+   vector<double> mnfValues(tilePixels * mnfNumBands);
+   vector<double> zeroValues(mnfNumBands, 0.0);
+   vector<char> selected;
+   vector<double> unselectedValues;
+   if (pMask != NULL)
+   {
+      selected.resize(tilePixels);
+      if (mbDenoise)
+      {
+         unselectedValues.resize(tilePixels * mNumBands);
+      }
+   }
+
+   for (unsigned int startRow = 0; startRow < mnfNumRows; startRow += tileRows)
    {
       if (isAborted())
       {
          break;
       }
 
-      VERIFY(origAccessor.isValid());
-      VERIFY(mnfAccessor.isValid());
-      if (pMask == NULL)
+      // gather the tile's pixels - only selected pixels are kept when processing an AOI
+      unsigned int endRow = min(startRow + tileRows, mnfNumRows);
+      unsigned int numPixels = 0;
+      unsigned int numUnselected = 0;
+      for (unsigned int row = startRow; row < endRow; ++row)
       {
-         pOrigData = origAccessor->getRow();
-         pValues = reinterpret_cast<double*>(mnfAccessor->getRow());
-         switchOnEncoding(eDataType, computeMnfRow, pOrigData, pValues,
-            mpMnfTransformMatrix, mNumColumns, mNumBands, mNumComponentsToUse);
+         VERIFY(origAccessor.isValid());
+         if (pMask == NULL)
+         {
+            switchOnEncoding(eDataType, MnfMath::convertToDouble, origAccessor->getRow(),
+               &pixelValues[static_cast<size_t>(numPixels) * mNumBands],
+               static_cast<size_t>(mnfNumCols) * mNumBands);
+            numPixels += mnfNumCols;
+         }
+         else
+         {
+            char* pSelected = &selected[static_cast<size_t>(row - startRow) * mnfNumCols];
+            for (unsigned int col = 0; col < mnfNumCols; ++col)
+            {
+               pSelected[col] = pMask->getPixel(col + colOffset, row + rowOffset) ? 1 : 0;
+               if (pSelected[col] != 0)
+               {
+                  switchOnEncoding(eDataType, MnfMath::convertToDouble, origAccessor->getColumn(),
+                     &pixelValues[static_cast<size_t>(numPixels) * mNumBands], mNumBands);
+                  ++numPixels;
+               }
+               else if (mbDenoise)
+               {
+                  switchOnEncoding(eDataType, MnfMath::convertToDouble, origAccessor->getColumn(),
+                     &unselectedValues[static_cast<size_t>(numUnselected) * mNumBands], mNumBands);
+                  ++numUnselected;
+               }
+               origAccessor->nextColumn();
+            }
+         }
+         origAccessor->nextRow();
       }
-      else
+
+      MnfMath::multiply(&pixelValues.front(), &coefficients.front(), &mnfValues.front(),
+         numPixels, mNumBands, mnfNumBands);
+
+      // write the components - pixels outside the AOI are set to the bad value of zero
+      // when denoising, pixels outside the AOI are copied from the original data
+      const double* pValues = &mnfValues.front();
+      const double* pUnselectedValues = unselectedValues.empty() ? NULL : &unselectedValues.front();
+      for (unsigned int row = startRow; row < endRow; ++row)
       {
-         for (unsigned int col = 0; col < mnfNumCols; ++col)
+         VERIFY(mnfAccessor.isValid());
+         if (pMask == NULL)
          {
-            if (pMask->getPixel(col + colOffset, row + rowOffset))
+            switchOnEncoding(mnfDataType, MnfMath::convertFromDouble, mnfAccessor->getRow(), pValues,
+               static_cast<size_t>(mnfNumCols) * mnfNumBands);
+            pValues += static_cast<size_t>(mnfNumCols) * mnfNumBands;
+         }
+         else
+         {
+            const char* pSelected = &selected[static_cast<size_t>(row - startRow) * mnfNumCols];
+            for (unsigned int col = 0; col < mnfNumCols; ++col)
             {
-               pOrigData = origAccessor->getColumn();
-               pValues = reinterpret_cast<double*>(mnfAccessor->getColumn());
-               switchOnEncoding(eDataType, computeMnfColumn, pOrigData, pValues,
-                  mpMnfTransformMatrix, mNumBands, mNumComponentsToUse);
+               if (pSelected[col] != 0)
+               {
+                  switchOnEncoding(mnfDataType, MnfMath::convertFromDouble, mnfAccessor->getColumn(), pValues,
+                     mnfNumBands);
+                  pValues += mnfNumBands;
+               }
+               else if (pUnselectedValues != NULL)
+               {
+                  switchOnEncoding(mnfDataType, MnfMath::convertFromDouble, mnfAccessor->getColumn(),
+                     pUnselectedValues, mnfNumBands);
+                  pUnselectedValues += mnfNumBands;
+               }
+               else
+               {
+                  switchOnEncoding(mnfDataType, MnfMath::convertFromDouble, mnfAccessor->getColumn(),
+                     &zeroValues.front(), mnfNumBands);
+               }
+               mnfAccessor->nextColumn();
             }
-            origAccessor->nextColumn();
-            mnfAccessor->nextColumn();
          }
+         mnfAccessor->nextRow();
       }
-      origAccessor->nextRow();
-      mnfAccessor->nextRow();
 
-      currentProgress = 100 * (row + 1) / mnfNumRows;
+      currentProgress = 100 * endRow / mnfNumRows;
       if (mpProgress != NULL)
       {
-         mpProgress->updateProgress("Generating MNF data cube...", currentProgress, NORMAL);
+         mpProgress->updateProgress(mbDenoise ? "Generating denoised data cube..." : "Generating MNF data cube...",
+            currentProgress, NORMAL);
       }
    }
 
@@ -905,6 +1023,36 @@ bool Mnf::computeMnfValues()
    return true;
 }
 
+bool Mnf::computeDenoiseMatrix(vector<double>& coefficients)
+{
+   // Projecting onto the leading components and reconstructing from them are both linear, so the forward
+   // transform truncated to those components and the matching rows of its inverse collapse into one matrix.
+   MatrixFunctions::MatrixResource<double> pInverseMatrix(mNumBands, mNumBands);
+   double** pInverse = pInverseMatrix;
+   if (pInverse == NULL || !MatrixFunctions::invertSquareMatrix2D(pInverse,
+      const_cast<const double**>(mpMnfTransformMatrix), static_cast<int>(mNumBands)))
+   {
+      mMessage = "Unable to compute the inverse of the MNF transform.";
+      return false;
+   }
+
+   vector<double> forward(static_cast<size_t>(mNumBands) * mNumComponentsToUse);
+   vector<double> inverse(static_cast<size_t>(mNumComponentsToUse) * mNumBands);
+   for (unsigned int band = 0; band < mNumBands; ++band)
+   {
+      for (unsigned int comp = 0; comp < mNumComponentsToUse; ++comp)
+      {
+         forward[static_cast<size_t>(band) * mNumComponentsToUse + comp] = mpMnfTransformMatrix[band][comp];
+         inverse[static_cast<size_t>(comp) * mNumBands + band] = pInverse[comp][band];
+      }
+   }
+
+   coefficients.resize(static_cast<size_t>(mNumBands) * mNumBands);
+   MnfMath::multiply(&forward.front(), &inverse.front(), &coefficients.front(),
+      mNumBands, mNumComponentsToUse, mNumBands);
+   return true;
+}
+
 bool Mnf::createMnfView()
 {
    if (mbDisplayResults)
@@ -1129,202 +1277,94 @@ bool Mnf::calculateEigenValues()
       return false;
    }
 
-   if (!performCholeskyDecomp(pSigCovar, pEigenValues, mNumBands, mNumBands))
-   {
-      // mMessage set in performCholeskyDecomp
-      pStep->finalize(Message::Failure, mMessage);
-      if (mpProgress != NULL)
-      {
-         mpProgress->updateProgress(mMessage, 100, ERRORS);
-      }
-      return false;
-   }
-   if (isAborted())
+   // the linear algebra below works on contiguous row major copies of the covariance matrices
+   const size_t numValues = static_cast<size_t>(mNumBands) * mNumBands;
+   vector<double> lower(numValues);
+   vector<double> noiseFraction(numValues);
+   for (unsigned int row = 0; row < mNumBands; ++row)
    {
-      return false;
+      copy(pSigCovar[row], pSigCovar[row] + mNumBands, lower.begin() + static_cast<size_t>(row) * mNumBands);
    }
 
-   // set diagonal terms and zero out upper triangle
-   for (unsigned int i = 0; i < mNumBands; ++i)
-   {
-      for (unsigned int j = i; j < mNumBands; ++j)
-      {
-         if (i == j)
-         {
-            pSigCovar[i][j] = pEigenValues[i];
-         }
-         else
-         {
-            pSigCovar[i][j] = 0.0;
-         }
-      }
-   }
+   // signal covariance = L * L'
+   MnfMath::choleskyDecompose(lower, mNumBands);
    if (isAborted())
    {
       return false;
    }
 
-   // compute Li (inverse of lower triangle)
-   MatrixFunctions::MatrixResource<double> lowerInverse(mNumBands, mNumBands);
-   double** pLi = lowerInverse;
-   int numRows = static_cast<int>(mNumBands);
-   if (!MatrixFunctions::invertSquareMatrix2D(pLi, const_cast<const double**>(pSigCovar), numRows))
-   {
-      mMessage = "Unable to invert matrix.";
-      pStep->finalize(Message::Failure, mMessage);
-      if (mpProgress != NULL)
-      {
-         mpProgress->updateProgress(mMessage, 100, ERRORS);
-      }
-      return false;
-   }
-
-   // make sure upper triangle of pLi is zeroed out.
-   for (unsigned int i = 0; i < mNumBands; ++i)
+   // compute Li * noise covariance * Li' with two triangular solves rather than forming Li.
+   // The first solve gives Li * N, and since N is symmetric its transpose is N * Li'.
    {
-      for (unsigned int j = i; j < mNumBands; ++j)
-      {
-         if (i != j)
-         {
-            pLi[i][j] = 0.0;
-         }
-      }
-   }
-
-   double sum(0.0);
-   {
-   // scope existence of these matrices so can recover memory
-      MatrixFunctions::MatrixResource<double> lowerInverseTranspose(mNumBands, mNumBands);
-      double** pLiT = lowerInverseTranspose;
-      MatrixFunctions::MatrixResource<double> intermediateMatrix(mNumBands, mNumBands);
-      double** pIntermed = intermediateMatrix;
-      for (unsigned int i = 0; i < mNumBands; ++i)
-      {
-         for (unsigned int j = 0; j < mNumBands; ++j)
-         {
-            pLiT[i][j] = pLi[j][i];
-         }
-      }
-      if (isAborted())
-      {
-         return false;
-      }
-
-      // compute Li * mpNoiseCovar, reuse pSigCov to store intermediate results
+      vector<double> intermediate(numValues);
       for (unsigned int row = 0; row < mNumBands; ++row)
       {
-         for (unsigned int col = 0; col < mNumBands; ++col)
-         {
-            sum = 0.0;
-            for (unsigned int index = 0; index < mNumBands; ++index)
-            {
-               sum += pLi[row][index] * mpNoiseCovarMatrix[index][col];
-            }
-            pSigCovar[row][col] = sum;
-         }
+         copy(mpNoiseCovarMatrix[row], mpNoiseCovarMatrix[row] + mNumBands,
+            intermediate.begin() + static_cast<size_t>(row) * mNumBands);
       }
+      MnfMath::solveLower(lower, mNumBands, intermediate, mNumBands);
       if (isAborted())
       {
          return false;
       }
-      // and now multiple above result (currently in pSigCover) by transpose of Li
+
       for (unsigned int row = 0; row < mNumBands; ++row)
       {
          for (unsigned int col = 0; col < mNumBands; ++col)
          {
-            sum = 0.0;
-            for (unsigned int index = 0; index < mNumBands; ++index)
-            {
-               sum += pSigCovar[row][index] * pLiT[index][col];
-            }
-            pIntermed[row][col] = sum;
+            noiseFraction[static_cast<size_t>(row) * mNumBands + col] =
+               intermediate[static_cast<size_t>(col) * mNumBands + row];
          }
       }
+      MnfMath::solveLower(lower, mNumBands, noiseFraction, mNumBands);
       if (isAborted())
       {
          return false;
       }
-
-      // make sure matrix is symmetrical
-      if (MatrixFunctions::isMatrixSymmetric(const_cast<const double**>(pIntermed), mNumBands, 0.00000001) == false)
-      {
-         for (unsigned int row = 0; row < mNumBands; ++row)
-         {
-            for (unsigned int col = 0; col < mNumBands; ++col)
-            {
-               double avg = (pIntermed[row][col] + pIntermed[col][row]) / 2.0;
-               pIntermed[row][col] = avg;
-               pIntermed[col][row] = avg;
-            }
-         }
-      }
-      if (isAborted())
-      {
-         return false;
-      }
-
-      // Get the eigenvalues and eigenvectors. Store the eigenvectors in mpMnfTransformMatrix for future use.
-      try
-      {
-         if (MatrixFunctions::getEigenvalues(const_cast<const double**>(pIntermed),
-            pEigenValues, mpMnfTransformMatrix, mNumBands) == false)
-         {
-            pStep->finalize(Message::Failure, "Unable to calculate eigenvalues.");
-            if (mpProgress != NULL)
-            {
-               mpProgress->updateProgress(pStep->getFailureMessage(), 100, ERRORS);
-            }
-            return false;
-         }
-      }
-      catch (...)
-      {
-         pStep->finalize(Message::Failure, "Unable to calculate eigenvalues.");
-         if (mpProgress != NULL)
-         {
-            mpProgress->updateProgress(pStep->getFailureMessage(), 100, ERRORS);
-         }
-         return false;
-      }
-   }
-   if (isAborted())
-   {
-      return false;
    }
 
-   // Now a little more manipulation - reuse pSigCovar to hold intermediate results.
-   // We also need to use the transpose of the eigen vectors from mpMnfTransformMatrix,
-   // so instead of accessing [row][index], we'll access [index][row]
+   // make sure matrix is symmetrical
    for (unsigned int row = 0; row < mNumBands; ++row)
    {
-      for (unsigned int col = 0; col < mNumBands; ++col)
+      for (unsigned int col = 0; col < row; ++col)
       {
-         sum = 0.0;
-         for (unsigned int index = 0; index < mNumBands; ++index)
-         {
-            sum += mpMnfTransformMatrix[index][row] * pLi[index][col];
-         }
-         pSigCovar[row][col] = sum;
+         double& upper = noiseFraction[static_cast<size_t>(col) * mNumBands + row];
+         double& lowerValue = noiseFraction[static_cast<size_t>(row) * mNumBands + col];
+         double avg = (upper + lowerValue) / 2.0;
+         upper = avg;
+         lowerValue = avg;
       }
    }
-   if (isAborted())
+
+   if (mpProgress != NULL)
    {
-      return false;
+      mpProgress->updateProgress("Calculating Eigen Values...", 50, NORMAL);
    }
 
-   // a final transpose
-   for (unsigned int i = 0; i < mNumBands; ++i)
+   // Get the eigenvalues. Eigenvectors are computed later, once the number of components is known.
+   MnfMath::SymmetricEigenSolver eigenSolver;
+   if (!eigenSolver.decompose(noiseFraction, mNumBands))
    {
-      for (unsigned int j = 0; j < mNumBands; ++j)
+      mMessage = "Unable to calculate eigenvalues.";
+      pStep->finalize(Message::Failure, mMessage);
+      if (mpProgress != NULL)
       {
-         mpMnfTransformMatrix[i][j] = pSigCovar[j][i];
+         mpProgress->updateProgress(mMessage, 100, ERRORS);
       }
+      return false;
    }
    if (isAborted())
    {
       return false;
    }
 
+   // the solver returns ascending eigenvalues, most noisy is listed first here
+   const vector<double>& ascendingValues = eigenSolver.getEigenvalues();
+   for (lBandIndex = 0; lBandIndex < mNumBands; ++lBandIndex)
+   {
+      pEigenValues[lBandIndex] = ascendingValues[mNumBands - 1 - lBandIndex];
+   }
+
    if (mpProgress != NULL)
    {
       mpProgress->updateProgress("Calculating Eigen Values...", 80, NORMAL);
@@ -1359,11 +1399,6 @@ bool Mnf::calculateEigenValues()
       return false;
    }
 
-   if (mpProgress != NULL)
-   {
-      mpProgress->updateProgress("Calculation of Eigen Values completed", 100, NORMAL);
-   }
-
    // check if user wanted to select num components based on SNR value plot
    if (mbUseSnrValPlot)
    {
@@ -1386,22 +1421,48 @@ bool Mnf::calculateEigenValues()
       return false;
    }
 
-   // and finally reverse the order of the components since it currently has most noisy as first component
-   double tmpDbl(0.0);
-   for (unsigned int comp = 0; comp < mNumBands / 2; ++comp)
+   // The saved transform and the denoise reconstruction need every component. Otherwise only the
+   // eigenvectors for the components being used are computed. The least noisy components have the
+   // smallest eigenvalues, so the vectors come back in component order.
+   unsigned int numVectors = mNumBands;
+   if (mSaveCoefficientsFilename.empty() && !mbDenoise)
    {
-      for (unsigned int index = 0; index < mNumBands; ++index)
+      numVectors = min(max(mNumComponentsToUse, 1U), mNumBands);
+   }
+   vector<double> transform;
+   if (!eigenSolver.getEigenvectors(0, numVectors, transform))
+   {
+      mMessage = "Unable to calculate eigenvectors.";
+      pStep->finalize(Message::Failure, mMessage);
+      if (mpProgress != NULL)
       {
-         tmpDbl = mpMnfTransformMatrix[index][comp];
-         mpMnfTransformMatrix[index][comp] = mpMnfTransformMatrix[index][mNumBands - comp -1];
-         mpMnfTransformMatrix[index][mNumBands - comp -1] = tmpDbl;
+         mpProgress->updateProgress(mMessage, 100, ERRORS);
       }
+      return false;
+   }
+   if (isAborted())
+   {
+      return false;
+   }
+
+   // the transform is Li' * eigenvectors
+   MnfMath::solveLowerTranspose(lower, mNumBands, transform, numVectors);
+   for (unsigned int row = 0; row < mNumBands; ++row)
+   {
+      const double* pTransformRow = &transform[static_cast<size_t>(row) * numVectors];
+      copy(pTransformRow, pTransformRow + numVectors, mpMnfTransformMatrix[row]);
+      fill(mpMnfTransformMatrix[row] + numVectors, mpMnfTransformMatrix[row] + mNumBands, 0.0);
    }
    if (isAborted())
    {
       return false;
    }
 
+   if (mpProgress != NULL)
+   {
+      mpProgress->updateProgress("Calculation of Eigen Values completed", 100, NORMAL);
+   }
+
    pStep->finalize(Message::Success);
 
    return true;
@@ -1709,6 +1770,20 @@ bool Mnf::readInMnfTransform(const string& filename)
       mpStep->finalize(Message::Failure, mMessage);
       return false;
    }
+   if (mbDenoise && lnumComponents != mNumBands)
+   {
+      mMessage = "Denoising requires an MNF transform file which contains every component.";
+      if (mpProgress != NULL)
+      {
+         mpProgress->updateProgress(mMessage, 0, ERRORS);
+      }
+
+      mpStep->finalize(Message::Failure, mMessage);
+      return false;
+   }
+
+   // denoising needs the full transform to compute its inverse
+   unsigned int numComponentsToRead = mbDenoise ? lnumComponents : mNumComponentsToUse;
    bool success = !isAborted();
    if (lnumComponents < mNumComponentsToUse)
    {
@@ -1727,7 +1802,7 @@ bool Mnf::readInMnfTransform(const string& filename)
       {
          for (unsigned int col = 0; col < lnumComponents; ++col)
          {
-            if (col < mNumComponentsToUse)
+            if (col < numComponentsToRead)
             {
                numFieldsRead = fscanf(pFile, "%lg ", &(mpMnfTransformMatrix[row][col]));
             }
@@ -2012,42 +2087,6 @@ RasterElement* Mnf::createDifferenceRaster(AoiElement* pAoi)
    return pDiffRaster.release();
 }
 
-bool Mnf::performCholeskyDecomp(double** pMatrix, double* pVector, int numRows, int numCols)
-{
-   if (pMatrix == NULL || pVector == NULL || numRows < 1 || numRows != numCols)
-   {
-      mMessage = "Invalid input to the Cholesky Decomposition method.";
-         return false;
-   }
-
-   double sum(0.0);
-   for (int i = 0; i < numRows; ++i)
-   {
-      for (int j = i; j < numCols; ++j)
-      {
-         sum = pMatrix[i][j];
-         for (int k = i - 1; k >= 0; --k)
-         {
-            sum -= pMatrix[i][k] * pMatrix[j][k];
-         }
-         if (i == j)
-         {
-            if (sum <= 0.0)
-            {
-               sum = 0.0001;
-            }
-            pVector[i] = sqrt(sum);
-         }
-         else
-         {
-            pMatrix[j][i] = sum / pVector[i];
-         }
-      }
-   }
-
-   return true;
-}
-
 bool Mnf::computeCovarianceMatrix(RasterElement* pRaster, double **pMatrix, std::string info,
                                        AoiElement* pAoi, int rowFactor, int columnFactor)
 {
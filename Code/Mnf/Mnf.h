@@ -52,6 +52,7 @@ protected:
    bool calculateEigenValues();
    bool createMnfCube();
    bool computeMnfValues();
+   bool computeDenoiseMatrix(std::vector<double>& coefficients);
    bool createMnfView();
    void initializeNoiseMethods();
    AoiElement* getAoiElement(const std::string& aoiName, RasterElement* pRaster);
@@ -63,7 +64,6 @@ protected:
    bool readMatrixFromFile(QString filename, double **pData, int numBands, const std::string &caption);
    bool writeMatrixToFile(QString filename, const double **pData, int numBands, const std::string &caption);
    bool generateNoiseStatistics();
-   bool performCholeskyDecomp(double** pMatrix, double* pVector, int numRows, int numCols);
 
 private:
    Service<PlugInManagerServices> mpPlugInMgr;
@@ -94,6 +94,8 @@ private:
    AoiElement* mpNoiseAoi;
    std::string mPreviousNoiseFilename;
    unsigned int mNumComponentsToUse;
+   EncodingType mOutputDataType;
+   bool mbDenoise;
    bool mbUseSnrValPlot;
    bool mbDisplayResults;
    std::string mMessage;
@@ -123,12 +123,30 @@ MnfDlg::MnfDlg(const std::string& saveFilename, const vector<string>& aoiList, u
    pCompLayout->addWidget(mpComponentsSpin);
    pCompLayout->addStretch();
 
+   QLabel* pDataTypeLabel = new QLabel("Data Type:", pOutputGroup);
+   mpDataTypeCombo = new QComboBox(pOutputGroup);
+   mpDataTypeCombo->setEditable(false);
+   mpDataTypeCombo->addItem(QString::fromStdString(StringUtilities::toDisplayString(FLT4BYTES)));
+   mpDataTypeCombo->addItem(QString::fromStdString(StringUtilities::toDisplayString(FLT8BYTES)));
+
+   QHBoxLayout* pDataTypeLayout = new QHBoxLayout();
+   pDataTypeLayout->setMargin(0);
+   pDataTypeLayout->setSpacing(5);
+   pDataTypeLayout->addWidget(pDataTypeLabel, 0, Qt::AlignLeft);
+   pDataTypeLayout->addWidget(mpDataTypeCombo);
+   pDataTypeLayout->addStretch();
+
+   mpDenoiseCheck = new QCheckBox("Denoise (reconstruct bands from components)", pOutputGroup);
+   mpDenoiseCheck->setChecked(false);
+
    QVBoxLayout* pLayout = new QVBoxLayout();
    pOutputGroup->setLayout(pLayout);
    pLayout->setMargin(10);
    pLayout->setSpacing(5);
    pLayout->addLayout(pCompLayout);
-   pLayout->addWidget(mpFromSnrPlot);;
+   pLayout->addWidget(mpFromSnrPlot);
+   pLayout->addLayout(pDataTypeLayout);
+   pLayout->addWidget(mpDenoiseCheck);
    pLayout->addStretch();
 
    VERIFYNRV(connect(mpFromSnrPlot, SIGNAL(toggled(bool)), mpComponentsSpin, SLOT(setDisabled(bool))));
@@ -222,6 +240,16 @@ unsigned int MnfDlg::getNumComponents() const
    return ulComponents;
 }
 
+EncodingType MnfDlg::getOutputDataType() const
+{
+   return StringUtilities::fromDisplayString<EncodingType>(mpDataTypeCombo->currentText().toStdString());
+}
+
+bool MnfDlg::performDenoise() const
+{
+   return mpDenoiseCheck->isChecked();
+}
+
 string MnfDlg::getRoiName() const
 {
    string strRoiName;
@@ -42,6 +42,8 @@ public:
 
    bool selectNumComponentsFromPlot();
    unsigned int getNumComponents() const;
+   EncodingType getOutputDataType() const;
+   bool performDenoise() const;
 
    void setNoiseStatisticsMethods(QStringList& methods);
 
@@ -60,6 +62,8 @@ private:
    QCheckBox* mpRoiCheck;
    QComboBox* mpRoiCombo;
    QCheckBox* mpFromSnrPlot;
+   QComboBox* mpDataTypeCombo;
+   QCheckBox* mpDenoiseCheck;
    FileBrowser* mpCoefficientsFilename;
 };
 
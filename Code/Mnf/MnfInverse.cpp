@@ -19,6 +19,7 @@
 #include "MatrixFunctions.h"
 #include "MessageLogResource.h"
 #include "MnfInverse.h"
+#include "MnfMath.h"
 #include "ObjectResource.h"
 #include "PlugInArgList.h"
 #include "PlugInManagerServices.h"
@@ -31,20 +32,32 @@
 #include "SpatialDataWindow.h"
 #include "SpecialMetadata.h"
 #include "SpectralVersion.h"
+#include "StringUtilities.h"
+#include "switchOnEncoding.h"
 #include "Undo.h"
 #include "Units.h"
 
 #include <QtCore/QString>
 #include <QtGui/QFileDialog>
+#include <QtGui/QInputDialog>
 
+#include <algorithm>
 #include <list>
 #include <vector>
 
+namespace
+{
+   // maximum number of values held in a tile of MNF pixels when computing the inverse
+   const size_t sMaxTileValues = 4 * 1024 * 1024;
+}
+
 REGISTER_PLUGIN_BASIC(SpectralMnf, MnfInverse);
 
 MnfInverse::MnfInverse() :
    mpRaster(NULL),
    mbDisplayResults(true),
+   mNumComponentsToUse(0),
+   mOutputDataType(FLT4BYTES),
    mNumColumns(0),
    mNumRows(0),
    mNumBands(0)
@@ -79,6 +92,14 @@ bool MnfInverse::getInputSpecification(PlugInArgList*& pArgList)
    {
       VERIFY(pArgList->addArg<Filename>("Transform Filename", NULL, "Location of the results from a previously "
          "performed MNF transform."));
+      VERIFY(pArgList->addArg<unsigned int>("Number of Components", 0, "Number of leading MNF components used to "
+         "reconstruct the data. A value of 0 uses every component in the raster element. This is ignored if "
+         "\"Components\" is specified."));
+      VERIFY(pArgList->addArg<std::vector<unsigned int> >("Components", NULL, "Zero-based indices of the MNF "
+         "components used to reconstruct the data. All other components are treated as zero."));
+      VERIFY(pArgList->addArg<EncodingType>("Output Data Type", mOutputDataType, "The data type of the resulting "
+         "raster element. Must be either " + StringUtilities::toDisplayString(FLT4BYTES) + " or " +
+         StringUtilities::toDisplayString(FLT8BYTES) + "."));
       VERIFY(pArgList->addArg<bool>("Display Results", false, "Flag for whether the results of the MNF inverse "
          "transform should be displayed."));
    }
@@ -152,6 +173,18 @@ bool MnfInverse::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
       }
 
       mTransformFilename = filename.toStdString();
+
+      bool ok(false);
+      int numComponents = QInputDialog::getInteger(Service<DesktopServices>()->getMainWidget(),
+         "Minimum Noise Fraction Inverse Transform", "Number of components to use:", static_cast<int>(mNumBands),
+         1, static_cast<int>(mNumBands), 1, &ok);
+      if (ok == false)
+      {
+         mMessage = "MNF Inverse aborted by user";
+         pStep->finalize(Message::Abort, mMessage);
+         return false;
+      }
+      mNumComponentsToUse = static_cast<unsigned int>(numComponents);
    }
 
    if (mTransformFilename.empty())
@@ -164,6 +197,14 @@ bool MnfInverse::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
 
    pStep->addProperty("Transform Filename", mTransformFilename);
 
+   if (!selectComponents())
+   {
+      updateProgress(mMessage, 0, ERRORS);
+      pStep->finalize(Message::Failure, mMessage);
+      return false;
+   }
+   pStep->addProperty("Number of Components", static_cast<unsigned int>(mComponents.size()));
+
    unsigned int bandsInTransform(0);
    unsigned int numComponents(0);
    if (!getInfoFromTransformFile(mTransformFilename, bandsInTransform, numComponents))
@@ -295,7 +336,7 @@ bool MnfInverse::extractInputArgs(const PlugInArgList* pArgList)
 
    EncodingType dataType = pDescriptor->getDataType();
    std::string unitName = pDescriptor->getUnits()->getUnitName();
-   if (dataType != FLT8BYTES || unitName != "MNF Value")
+   if ((dataType != FLT4BYTES && dataType != FLT8BYTES) || unitName != "MNF Value")
    {
       mMessage = "This is not a valid MNF data set!";
       return false;
@@ -317,12 +358,54 @@ bool MnfInverse::extractInputArgs(const PlugInArgList* pArgList)
          return false;
       }
 
+      pArgList->getPlugInArgValue<unsigned int>("Number of Components", mNumComponentsToUse);
+      std::vector<unsigned int>* pComponents = pArgList->getPlugInArgValue<std::vector<unsigned int> >("Components");
+      if (pComponents != NULL)
+      {
+         mComponents = *pComponents;
+      }
+
+      VERIFY(pArgList->getPlugInArgValue<EncodingType>("Output Data Type", mOutputDataType));
+      if (mOutputDataType != FLT4BYTES && mOutputDataType != FLT8BYTES)
+      {
+         mMessage = "The output data type must be either " + StringUtilities::toDisplayString(FLT4BYTES) +
+            " or " + StringUtilities::toDisplayString(FLT8BYTES) + ".";
+         return false;
+      }
+
       pArgList->getPlugInArgValue<bool>("Display Results", mbDisplayResults);
    }
 
    return true;
 }
 
+bool MnfInverse::selectComponents()
+{
+   if (mComponents.empty())
+   {
+      if (mNumComponentsToUse == 0 || mNumComponentsToUse > mNumBands)
+      {
+         mNumComponentsToUse = mNumBands;
+      }
+      for (unsigned int comp = 0; comp < mNumComponentsToUse; ++comp)
+      {
+         mComponents.push_back(comp);
+      }
+   }
+   else
+   {
+      std::sort(mComponents.begin(), mComponents.end());
+      mComponents.erase(std::unique(mComponents.begin(), mComponents.end()), mComponents.end());
+      if (mComponents.back() >= mNumBands)
+      {
+         mMessage = "The components to use must be less than the number of bands in the MNF raster element.";
+         return false;
+      }
+   }
+
+   return true;
+}
+
 bool MnfInverse::getInfoFromTransformFile(std::string& filename, unsigned int& numBands,
                                                   unsigned int& numComponents)
 {
@@ -476,13 +559,13 @@ RasterElement* MnfInverse::createInverseRaster(std::string name, unsigned int nu
       Service<ModelServices>()->destroyElement(pElem);
    }
    RasterElement* pInverseRaster = RasterUtilities::createRasterElement(name, numRows, numColumns,
-      numBands, FLT8BYTES, BIP, true, NULL);
+      numBands, mOutputDataType, BIP, true, NULL);
 
    // if it wasn't created in memory, try to create on disk
    if (pInverseRaster == NULL)
    {
       pInverseRaster = RasterUtilities::createRasterElement(name, numRows, numColumns,
-         numBands, FLT8BYTES, BIP, false, NULL);
+         numBands, mOutputDataType, BIP, false, NULL);
    }
 
    if (pInverseRaster == NULL)
@@ -496,7 +579,7 @@ RasterElement* MnfInverse::createInverseRaster(std::string name, unsigned int nu
 bool MnfInverse::computeInverse(RasterElement* pInvRaster, double** pInvTransform,
                     unsigned int numBands, unsigned int numComponents)
 {
-   if (pInvRaster == NULL || pInvTransform == NULL || numBands == 0 || numComponents == 0)
+   if (pInvRaster == NULL || pInvTransform == NULL || numBands == 0 || numComponents == 0 || mComponents.empty())
    {
       mMessage = "Input parameters are invalid.";
       return false;
@@ -507,6 +590,7 @@ bool MnfInverse::computeInverse(RasterElement* pInvRaster, double** pInvTransfor
    unsigned int numInvRows = pInvDesc->getRowCount();
    unsigned int numInvCols = pInvDesc->getColumnCount();
    unsigned int numInvBands = pInvDesc->getBandCount();
+   EncodingType invDataType = pInvDesc->getDataType();
 
    if (numInvCols != mNumColumns || numInvRows != mNumRows)
    {
@@ -514,40 +598,89 @@ bool MnfInverse::computeInverse(RasterElement* pInvRaster, double** pInvTransfor
       return false;
    }
 
+   const RasterDataDescriptor* pOrigDesc = dynamic_cast<const RasterDataDescriptor*>(mpRaster->getDataDescriptor());
+   VERIFY(pOrigDesc != NULL);
+   EncodingType origDataType = pOrigDesc->getDataType();
+
+   // only the rows of the inverse for the selected components take part in the reconstruction
+   const unsigned int numSelected = static_cast<unsigned int>(mComponents.size());
+   std::vector<double> inverse(static_cast<size_t>(numSelected) * numInvBands);
+   for (unsigned int index = 0; index < numSelected; ++index)
+   {
+      std::copy(pInvTransform[mComponents[index]], pInvTransform[mComponents[index]] + numInvBands,
+         inverse.begin() + static_cast<size_t>(index) * numInvBands);
+   }
+   const bool allComponents = (numSelected == mNumBands);
+
    FactoryResource<DataRequest> pOrigRqt;
    pOrigRqt->setInterleaveFormat(BIP);
+   pOrigRqt->setColumns(pOrigDesc->getActiveColumn(0), pOrigDesc->getActiveColumn(mNumColumns - 1), mNumColumns);
    DataAccessor origAcc = mpRaster->getDataAccessor(pOrigRqt.release());
    FactoryResource<DataRequest> pInvRqt;
+   pInvRqt->setInterleaveFormat(BIP);
+   pInvRqt->setColumns(pInvDesc->getActiveColumn(0), pInvDesc->getActiveColumn(mNumColumns - 1), mNumColumns);
    pInvRqt->setWritable(true);
    DataAccessor invAcc = pInvRaster->getDataAccessor(pInvRqt.release());
 
-   double* pOrigData(NULL);
-   double* pInvData(NULL);
-   for (unsigned int row = 0; row < mNumRows; ++row)
+   // each tile of rows is a pixels x components matrix multiplied by the components x bands inverse
+   const size_t valuesPerRow = static_cast<size_t>(mNumColumns) * std::max(mNumBands, numInvBands);
+   const unsigned int tileRows = static_cast<unsigned int>(
+      std::min(static_cast<size_t>(mNumRows), std::max(static_cast<size_t>(1), sMaxTileValues / valuesPerRow)));
+   const size_t tilePixels = static_cast<size_t>(tileRows) * mNumColumns;
+   std::vector<double> pixelValues(static_cast<size_t>(mNumColumns) * mNumBands);
+   std::vector<double> compValues(tilePixels * numSelected);
+   std::vector<double> invValues(tilePixels * numInvBands);
+
+   for (unsigned int startRow = 0; startRow < mNumRows; startRow += tileRows)
    {
-      for (unsigned int col = 0; col < mNumColumns; ++col)
+      if (isAborted())
       {
-         if (isAborted())
+         return false;
+      }
+
+      unsigned int endRow = std::min(startRow + tileRows, mNumRows);
+      double* pCompValues = &compValues.front();
+      for (unsigned int row = startRow; row < endRow; ++row)
+      {
+         VERIFY(origAcc.isValid());
+         if (allComponents)
          {
-            return false;
+            switchOnEncoding(origDataType, MnfMath::convertToDouble, origAcc->getRow(), pCompValues,
+               static_cast<size_t>(mNumColumns) * mNumBands);
+            pCompValues += static_cast<size_t>(mNumColumns) * mNumBands;
          }
-         VERIFY(origAcc.isValid());
-         VERIFY(invAcc.isValid());
-         pOrigData = reinterpret_cast<double*>(origAcc->getColumn());
-         pInvData = reinterpret_cast<double*>(invAcc->getColumn());
-         for (unsigned int comp = 0; comp < numInvBands; ++comp)
+         else
          {
-            for (unsigned int band = 0; band < mNumBands; ++band)
+            switchOnEncoding(origDataType, MnfMath::convertToDouble, origAcc->getRow(), &pixelValues.front(),
+               pixelValues.size());
+            const double* pPixel = &pixelValues.front();
+            for (unsigned int col = 0; col < mNumColumns; ++col)
             {
-               pInvData[comp] += pOrigData[band] * pInvTransform[band][comp];
+               for (unsigned int index = 0; index < numSelected; ++index)
+               {
+                  *pCompValues++ = pPixel[mComponents[index]];
+               }
+               pPixel += mNumBands;
             }
          }
-         origAcc->nextColumn();
-         invAcc->nextColumn();
+         origAcc->nextRow();
       }
-      origAcc->nextRow();
-      invAcc->nextRow();
-      updateProgress("Computing Inverse data values...", (row + 1) * 100 / mNumRows, NORMAL);
+
+      const unsigned int numPixels = (endRow - startRow) * mNumColumns;
+      MnfMath::multiply(&compValues.front(), &inverse.front(), &invValues.front(),
+         numPixels, numSelected, numInvBands);
+
+      const double* pInvValues = &invValues.front();
+      for (unsigned int row = startRow; row < endRow; ++row)
+      {
+         VERIFY(invAcc.isValid());
+         switchOnEncoding(invDataType, MnfMath::convertFromDouble, invAcc->getRow(), pInvValues,
+            static_cast<size_t>(mNumColumns) * numInvBands);
+         pInvValues += static_cast<size_t>(mNumColumns) * numInvBands;
+         invAcc->nextRow();
+      }
+
+      updateProgress("Computing Inverse data values...", endRow * 100 / mNumRows, NORMAL);
    }
 
    return true;
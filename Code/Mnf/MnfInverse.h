@@ -12,6 +12,7 @@
 
 #include "AlgorithmShell.h"
 #include "Progress.h"
+#include "TypesFile.h"
 
 #include <string>
 #include <vector>
@@ -36,6 +37,7 @@ protected:
    bool readInMnfTransform(const std::string& filename, double** pTransform, std::vector<double>& wavelengths);
    RasterElement* createInverseRaster(std::string name, unsigned int numRows,
       unsigned int numColumns, unsigned int numBands);
+   bool selectComponents();
    bool computeInverse(RasterElement* pInvRaster, double** pInvTransform,
       unsigned int numBands, unsigned int numComponents);
    bool createInverseView(RasterElement* pInvRaster);
@@ -49,6 +51,9 @@ private:
    std::string mMessage;
    std::string mTransformFilename;
    bool mbDisplayResults;
+   unsigned int mNumComponentsToUse;
+   std::vector<unsigned int> mComponents;
+   EncodingType mOutputDataType;
    unsigned int mNumColumns;
    unsigned int mNumRows;
    unsigned int mNumBands;
@@ -0,0 +1,813 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "MnfMath.h"
+
+#include <QtCore/QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+   // block sizes chosen so a block of the right hand matrix fits in L2 cache
+   const unsigned int sInnerBlockSize = 128;
+   const unsigned int sColumnBlockSize = 256;
+
+   // minimum number of rows or columns handed to each thread
+   const unsigned int sRowBlockSize = 64;
+
+   // width of the column panels in the Cholesky factorization
+   const unsigned int sPanelSize = 64;
+
+   // the number of inverse iteration steps used for each eigenvector
+   const unsigned int sInverseIterations = 4;
+
+   // maximum number of implicit QL iterations per eigenvalue
+   const unsigned int sMaxQlIterations = 60;
+
+   typedef std::pair<unsigned int, unsigned int> Range;
+
+   /**
+    *  Calls \em body for consecutive ranges of [\em start, \em end), in parallel
+    *  when concurrency is available.
+    */
+   template<class Body>
+   void forEachBlock(unsigned int start, unsigned int end, unsigned int blockSize, const Body& body)
+   {
+      if (start >= end)
+      {
+         return;
+      }
+#ifndef QT_NO_CONCURRENT
+      std::vector<Range> blocks;
+      for (unsigned int index = start; index < end; index += blockSize)
+      {
+         blocks.push_back(std::make_pair(index, std::min(index + blockSize, end)));
+      }
+      if (blocks.size() > 1)
+      {
+         QtConcurrent::blockingMap(blocks, body);
+         return;
+      }
+#endif
+      body(std::make_pair(start, end));
+   }
+
+   struct BlockedProduct
+   {
+      typedef void result_type;
+
+      BlockedProduct(const double* pLeft, const double* pRight, double* pResults,
+         unsigned int numInner, unsigned int numColumns) :
+         mpLeft(pLeft),
+         mpRight(pRight),
+         mpResults(pResults),
+         mNumInner(numInner),
+         mNumColumns(numColumns)
+      {}
+
+      void operator()(const Range& rows) const
+      {
+         std::fill(mpResults + static_cast<size_t>(rows.first) * mNumColumns,
+            mpResults + static_cast<size_t>(rows.second) * mNumColumns, 0.0);
+
+         for (unsigned int startCol = 0; startCol < mNumColumns; startCol += sColumnBlockSize)
+         {
+            unsigned int endCol = std::min(startCol + sColumnBlockSize, mNumColumns);
+            for (unsigned int startInner = 0; startInner < mNumInner; startInner += sInnerBlockSize)
+            {
+               unsigned int endInner = std::min(startInner + sInnerBlockSize, mNumInner);
+               for (unsigned int row = rows.first; row < rows.second; ++row)
+               {
+                  const double* pLeftRow = mpLeft + static_cast<size_t>(row) * mNumInner;
+                  double* pResultRow = mpResults + static_cast<size_t>(row) * mNumColumns;
+                  for (unsigned int inner = startInner; inner < endInner; ++inner)
+                  {
+                     const double value = pLeftRow[inner];
+                     const double* pRightRow = mpRight + static_cast<size_t>(inner) * mNumColumns;
+                     for (unsigned int col = startCol; col < endCol; ++col)
+                     {
+                        pResultRow[col] += value * pRightRow[col];
+                     }
+                  }
+               }
+            }
+         }
+      }
+
+      const double* mpLeft;
+      const double* mpRight;
+      double* mpResults;
+      unsigned int mNumInner;
+      unsigned int mNumColumns;
+   };
+
+   /**
+    *  Computes the panel columns [mStart, mEnd) of L for a block of rows below the
+    *  diagonal block. Each row only reads itself and the factored diagonal block.
+    */
+   struct CholeskyPanelSolve
+   {
+      typedef void result_type;
+
+      CholeskyPanelSolve(double* pMatrix, unsigned int size, unsigned int start, unsigned int end) :
+         mpMatrix(pMatrix),
+         mSize(size),
+         mStart(start),
+         mEnd(end)
+      {}
+
+      void operator()(const Range& rows) const
+      {
+         for (unsigned int row = rows.first; row < rows.second; ++row)
+         {
+            double* pRow = mpMatrix + static_cast<size_t>(row) * mSize;
+            for (unsigned int col = mStart; col < mEnd; ++col)
+            {
+               const double* pColRow = mpMatrix + static_cast<size_t>(col) * mSize;
+               double sum = pRow[col];
+               for (unsigned int k = mStart; k < col; ++k)
+               {
+                  sum -= pRow[k] * pColRow[k];
+               }
+               pRow[col] = sum / pColRow[col];
+            }
+         }
+      }
+
+      double* mpMatrix;
+      unsigned int mSize;
+      unsigned int mStart;
+      unsigned int mEnd;
+   };
+
+   /**
+    *  Subtracts the contribution of the panel columns [mStart, mEnd) from the lower
+    *  triangle of the trailing submatrix for a block of rows. This reads the panel
+    *  of other rows, so every row of the panel must be solved first.
+    */
+   struct CholeskyTrailingUpdate
+   {
+      typedef void result_type;
+
+      CholeskyTrailingUpdate(double* pMatrix, unsigned int size, unsigned int start, unsigned int end) :
+         mpMatrix(pMatrix),
+         mSize(size),
+         mStart(start),
+         mEnd(end)
+      {}
+
+      void operator()(const Range& rows) const
+      {
+         for (unsigned int row = rows.first; row < rows.second; ++row)
+         {
+            double* pRow = mpMatrix + static_cast<size_t>(row) * mSize;
+            for (unsigned int col = mEnd; col <= row; ++col)
+            {
+               const double* pColRow = mpMatrix + static_cast<size_t>(col) * mSize;
+               double sum = 0.0;
+               for (unsigned int k = mStart; k < mEnd; ++k)
+               {
+                  sum += pRow[k] * pColRow[k];
+               }
+               pRow[col] -= sum;
+            }
+         }
+      }
+
+      double* mpMatrix;
+      unsigned int mSize;
+      unsigned int mStart;
+      unsigned int mEnd;
+   };
+
+   struct TriangularSolve
+   {
+      typedef void result_type;
+
+      TriangularSolve(const double* pLower, unsigned int size, double* pValues, unsigned int numColumns,
+         bool transpose) :
+         mpLower(pLower),
+         mSize(size),
+         mpValues(pValues),
+         mNumColumns(numColumns),
+         mTranspose(transpose)
+      {}
+
+      void operator()(const Range& columns) const
+      {
+         for (unsigned int step = 0; step < mSize; ++step)
+         {
+            const unsigned int row = mTranspose ? mSize - 1 - step : step;
+            double* pRow = mpValues + static_cast<size_t>(row) * mNumColumns;
+            const unsigned int first = mTranspose ? row + 1 : 0;
+            const unsigned int last = mTranspose ? mSize : row;
+            for (unsigned int k = first; k < last; ++k)
+            {
+               // L(row, k) for the forward solve, L(k, row) for the transposed solve
+               const double factor = mTranspose ? mpLower[static_cast<size_t>(k) * mSize + row] :
+                  mpLower[static_cast<size_t>(row) * mSize + k];
+               if (factor == 0.0)
+               {
+                  continue;
+               }
+               const double* pSolved = mpValues + static_cast<size_t>(k) * mNumColumns;
+               for (unsigned int col = columns.first; col < columns.second; ++col)
+               {
+                  pRow[col] -= factor * pSolved[col];
+               }
+            }
+
+            const double diagonal = mpLower[static_cast<size_t>(row) * mSize + row];
+            for (unsigned int col = columns.first; col < columns.second; ++col)
+            {
+               pRow[col] /= diagonal;
+            }
+         }
+      }
+
+      const double* mpLower;
+      unsigned int mSize;
+      double* mpValues;
+      unsigned int mNumColumns;
+      bool mTranspose;
+   };
+
+   /**
+    *  Solves (T - shift * I) x = b in place for the symmetric tridiagonal T using
+    *  Gaussian elimination with partial pivoting. Zero pivots are replaced by
+    *  \em tiny so a shift equal to an eigenvalue still yields a solution.
+    */
+   void solveShiftedTridiagonal(const std::vector<double>& diagonal, const std::vector<double>& offDiagonal,
+      double shift, double tiny, std::vector<double>& values)
+   {
+      const unsigned int size = static_cast<unsigned int>(diagonal.size());
+      std::vector<double> u0(size);
+      std::vector<double> u1(size, 0.0);
+      std::vector<double> u2(size, 0.0);
+      std::vector<double> multipliers(size, 0.0);
+      std::vector<char> swapped(size, 0);
+
+      double pivot = diagonal[0] - shift;
+      double upper = size > 1 ? offDiagonal[0] : 0.0;
+      for (unsigned int row = 0; row + 1 < size; ++row)
+      {
+         const double below = offDiagonal[row];
+         const double nextDiagonal = diagonal[row + 1] - shift;
+         const double nextUpper = row + 2 < size ? offDiagonal[row + 1] : 0.0;
+         if (fabs(pivot) >= fabs(below))
+         {
+            if (pivot == 0.0)
+            {
+               pivot = tiny;
+            }
+            const double multiplier = below / pivot;
+            u0[row] = pivot;
+            u1[row] = upper;
+            multipliers[row] = multiplier;
+            pivot = nextDiagonal - multiplier * upper;
+            upper = nextUpper;
+         }
+         else
+         {
+            const double multiplier = pivot / below;
+            u0[row] = below;
+            u1[row] = nextDiagonal;
+            u2[row] = nextUpper;
+            multipliers[row] = multiplier;
+            swapped[row] = 1;
+            pivot = upper - multiplier * nextDiagonal;
+            upper = -multiplier * nextUpper;
+         }
+      }
+      u0[size - 1] = (pivot == 0.0 ? tiny : pivot);
+
+      for (unsigned int row = 0; row + 1 < size; ++row)
+      {
+         if (swapped[row] != 0)
+         {
+            std::swap(values[row], values[row + 1]);
+         }
+         values[row + 1] -= multipliers[row] * values[row];
+      }
+
+      for (unsigned int step = 0; step < size; ++step)
+      {
+         const unsigned int row = size - 1 - step;
+         double value = values[row];
+         if (row + 1 < size)
+         {
+            value -= u1[row] * values[row + 1];
+         }
+         if (row + 2 < size)
+         {
+            value -= u2[row] * values[row + 2];
+         }
+         values[row] = value / u0[row];
+      }
+   }
+
+   bool normalize(std::vector<double>& values)
+   {
+      double largest = 0.0;
+      for (std::vector<double>::const_iterator iter = values.begin(); iter != values.end(); ++iter)
+      {
+         largest = std::max(largest, fabs(*iter));
+      }
+      if (largest == 0.0)
+      {
+         return false;
+      }
+
+      double norm = 0.0;
+      for (std::vector<double>::iterator iter = values.begin(); iter != values.end(); ++iter)
+      {
+         *iter /= largest;
+         norm += *iter * *iter;
+      }
+      norm = sqrt(norm);
+      for (std::vector<double>::iterator iter = values.begin(); iter != values.end(); ++iter)
+      {
+         *iter /= norm;
+      }
+
+      return true;
+   }
+
+   /**
+    *  Computes tridiagonal eigenvectors by inverse iteration for a group of close
+    *  eigenvalues. Members of the group are kept orthogonal to one another.
+    */
+   struct TridiagonalEigenvectors
+   {
+      typedef void result_type;
+
+      TridiagonalEigenvectors(const std::vector<double>& diagonal, const std::vector<double>& offDiagonal,
+         const std::vector<double>& eigenvalues, double norm, std::vector<std::vector<double> >& vectors) :
+         mDiagonal(diagonal),
+         mOffDiagonal(offDiagonal),
+         mEigenvalues(eigenvalues),
+         mNorm(norm),
+         mVectors(vectors)
+      {}
+
+      void operator()(const Range& group) const
+      {
+         const unsigned int size = static_cast<unsigned int>(mDiagonal.size());
+         const double epsilon = std::numeric_limits<double>::epsilon();
+         const double tiny = std::max(epsilon * mNorm, std::numeric_limits<double>::min());
+         const double separation = 10.0 * epsilon * mNorm;
+
+         double previousShift = 0.0;
+         for (unsigned int index = group.first; index < group.second; ++index)
+         {
+            // nudge coincident shifts apart so each member converges to a different direction
+            double shift = mEigenvalues[index];
+            if (index > group.first && shift - previousShift < separation)
+            {
+               shift = previousShift + separation;
+            }
+            previousShift = shift;
+
+            std::vector<double>& eigenvector = mVectors[index];
+            eigenvector.resize(size);
+            unsigned int seed = 1 + index;
+            for (unsigned int row = 0; row < size; ++row)
+            {
+               seed = seed * 1103515245 + 12345;
+               eigenvector[row] = 0.5 + static_cast<double>((seed >> 16) & 0x7fff) / 32768.0;
+            }
+
+            for (unsigned int iteration = 0; iteration < sInverseIterations; ++iteration)
+            {
+               normalize(eigenvector);
+               solveShiftedTridiagonal(mDiagonal, mOffDiagonal, shift, tiny, eigenvector);
+               for (int pass = 0; pass < 2; ++pass)
+               {
+                  for (unsigned int other = group.first; other < index; ++other)
+                  {
+                     const std::vector<double>& otherVector = mVectors[other];
+                     double dot = 0.0;
+                     for (unsigned int row = 0; row < size; ++row)
+                     {
+                        dot += eigenvector[row] * otherVector[row];
+                     }
+                     for (unsigned int row = 0; row < size; ++row)
+                     {
+                        eigenvector[row] -= dot * otherVector[row];
+                     }
+                  }
+               }
+            }
+            normalize(eigenvector);
+         }
+      }
+
+      const std::vector<double>& mDiagonal;
+      const std::vector<double>& mOffDiagonal;
+      const std::vector<double>& mEigenvalues;
+      double mNorm;
+      std::vector<std::vector<double> >& mVectors;
+   };
+
+   /**
+    *  Applies the Householder reflections from the tridiagonal reduction to
+    *  eigenvectors of the tridiagonal matrix and stores the results as columns.
+    */
+   struct BackTransform
+   {
+      typedef void result_type;
+
+      BackTransform(const std::vector<double>& reflectors, const std::vector<double>& scales, unsigned int size,
+         const std::vector<std::vector<double> >& vectors, unsigned int first, unsigned int count,
+         std::vector<double>& results) :
+         mReflectors(reflectors),
+         mScales(scales),
+         mSize(size),
+         mVectors(vectors),
+         mFirst(first),
+         mCount(count),
+         mResults(results)
+      {}
+
+      void operator()(const Range& columns) const
+      {
+         std::vector<double> values;
+         for (unsigned int column = columns.first; column < columns.second; ++column)
+         {
+            values = mVectors[mFirst + column];
+            for (unsigned int step = 0; step + 2 < mSize; ++step)
+            {
+               const unsigned int reflection = mSize - 3 - step;
+               const double scale = mScales[reflection];
+               if (scale == 0.0)
+               {
+                  continue;
+               }
+
+               // the reflection vector is stored below the diagonal of row major column "reflection"
+               // with an implicit leading one
+               double dot = values[reflection + 1];
+               for (unsigned int row = reflection + 2; row < mSize; ++row)
+               {
+                  dot += mReflectors[static_cast<size_t>(row) * mSize + reflection] * values[row];
+               }
+               dot *= scale;
+               values[reflection + 1] -= dot;
+               for (unsigned int row = reflection + 2; row < mSize; ++row)
+               {
+                  values[row] -= dot * mReflectors[static_cast<size_t>(row) * mSize + reflection];
+               }
+            }
+
+            for (unsigned int row = 0; row < mSize; ++row)
+            {
+               mResults[static_cast<size_t>(row) * mCount + column] = values[row];
+            }
+         }
+      }
+
+      const std::vector<double>& mReflectors;
+      const std::vector<double>& mScales;
+      unsigned int mSize;
+      const std::vector<std::vector<double> >& mVectors;
+      unsigned int mFirst;
+      unsigned int mCount;
+      std::vector<double>& mResults;
+   };
+}
+
+void MnfMath::multiply(const double* pLeft, const double* pRight, double* pResults,
+   unsigned int numRows, unsigned int numInner, unsigned int numColumns)
+{
+   if (pLeft == NULL || pRight == NULL || pResults == NULL || numRows == 0 || numColumns == 0)
+   {
+      return;
+   }
+
+   forEachBlock(0, numRows, sRowBlockSize, BlockedProduct(pLeft, pRight, pResults, numInner, numColumns));
+}
+
+void MnfMath::choleskyDecompose(std::vector<double>& matrix, unsigned int size)
+{
+   if (matrix.size() < static_cast<size_t>(size) * size)
+   {
+      return;
+   }
+
+   double* pMatrix = &matrix.front();
+   for (unsigned int start = 0; start < size; start += sPanelSize)
+   {
+      const unsigned int end = std::min(start + sPanelSize, size);
+
+      // factor the diagonal block; earlier panels have already been subtracted from it
+      for (unsigned int col = start; col < end; ++col)
+      {
+         double* pColRow = pMatrix + static_cast<size_t>(col) * size;
+         double sum = pColRow[col];
+         for (unsigned int k = start; k < col; ++k)
+         {
+            sum -= pColRow[k] * pColRow[k];
+         }
+         if (sum <= 0.0)
+         {
+            sum = 0.0001;
+         }
+         pColRow[col] = sqrt(sum);
+
+         for (unsigned int row = col + 1; row < end; ++row)
+         {
+            double* pRow = pMatrix + static_cast<size_t>(row) * size;
+            sum = pRow[col];
+            for (unsigned int k = start; k < col; ++k)
+            {
+               sum -= pRow[k] * pColRow[k];
+            }
+            pRow[col] = sum / pColRow[col];
+         }
+      }
+
+      // the trailing update reads the panel of other rows, so it waits for the whole panel to be solved
+      forEachBlock(end, size, sRowBlockSize, CholeskyPanelSolve(pMatrix, size, start, end));
+      forEachBlock(end, size, sRowBlockSize, CholeskyTrailingUpdate(pMatrix, size, start, end));
+   }
+
+   for (unsigned int row = 0; row < size; ++row)
+   {
+      std::fill(pMatrix + static_cast<size_t>(row) * size + row + 1, pMatrix + static_cast<size_t>(row + 1) * size,
+         0.0);
+   }
+}
+
+void MnfMath::solveLower(const std::vector<double>& lower, unsigned int size,
+   std::vector<double>& values, unsigned int numColumns)
+{
+   if (size == 0 || numColumns == 0 || lower.size() < static_cast<size_t>(size) * size ||
+      values.size() < static_cast<size_t>(size) * numColumns)
+   {
+      return;
+   }
+
+   forEachBlock(0, numColumns, sRowBlockSize,
+      TriangularSolve(&lower.front(), size, &values.front(), numColumns, false));
+}
+
+void MnfMath::solveLowerTranspose(const std::vector<double>& lower, unsigned int size,
+   std::vector<double>& values, unsigned int numColumns)
+{
+   if (size == 0 || numColumns == 0 || lower.size() < static_cast<size_t>(size) * size ||
+      values.size() < static_cast<size_t>(size) * numColumns)
+   {
+      return;
+   }
+
+   forEachBlock(0, numColumns, sRowBlockSize,
+      TriangularSolve(&lower.front(), size, &values.front(), numColumns, true));
+}
+
+MnfMath::SymmetricEigenSolver::SymmetricEigenSolver() :
+   mSize(0)
+{}
+
+bool MnfMath::SymmetricEigenSolver::decompose(const std::vector<double>& matrix, unsigned int size)
+{
+   mSize = 0;
+   mEigenvalues.clear();
+   if (size == 0 || matrix.size() < static_cast<size_t>(size) * size)
+   {
+      return false;
+   }
+
+   // work on a full symmetric copy built from the lower triangle
+   mReflectors.resize(static_cast<size_t>(size) * size);
+   for (unsigned int row = 0; row < size; ++row)
+   {
+      for (unsigned int col = 0; col <= row; ++col)
+      {
+         const double value = matrix[static_cast<size_t>(row) * size + col];
+         mReflectors[static_cast<size_t>(row) * size + col] = value;
+         mReflectors[static_cast<size_t>(col) * size + row] = value;
+      }
+   }
+
+   mReflectorScales.assign(size, 0.0);
+   mDiagonal.assign(size, 0.0);
+   mOffDiagonal.assign(size, 0.0);
+
+   // Householder reduction to tridiagonal form. The reflection for column k is kept below the
+   // subdiagonal of column k with an implicit leading one; the remaining matrix stays symmetric.
+   double* pA = &mReflectors.front();
+   std::vector<double> reflection(size);
+   std::vector<double> product(size);
+   for (unsigned int k = 0; k + 2 < size; ++k)
+   {
+      const unsigned int length = size - k - 1;
+      double sigma = 0.0;
+      for (unsigned int i = 1; i < length; ++i)
+      {
+         const double value = pA[static_cast<size_t>(k + 1 + i) * size + k];
+         sigma += value * value;
+      }
+
+      const double leading = pA[static_cast<size_t>(k + 1) * size + k];
+      mDiagonal[k] = pA[static_cast<size_t>(k) * size + k];
+      if (sigma == 0.0)
+      {
+         mOffDiagonal[k] = leading;
+         mReflectorScales[k] = 0.0;
+         continue;
+      }
+
+      const double mu = sqrt(leading * leading + sigma);
+      const double first = (leading <= 0.0 ? leading - mu : -sigma / (leading + mu));
+      const double scale = 2.0 * first * first / (sigma + first * first);
+      reflection[0] = 1.0;
+      for (unsigned int i = 1; i < length; ++i)
+      {
+         double& stored = pA[static_cast<size_t>(k + 1 + i) * size + k];
+         stored /= first;
+         reflection[i] = stored;
+      }
+      mReflectorScales[k] = scale;
+      mOffDiagonal[k] = mu;
+
+      // p = scale * A22 * v, w = p - (scale / 2) * (p.v) * v, A22 -= v * w' + w * v'
+      double dot = 0.0;
+      for (unsigned int i = 0; i < length; ++i)
+      {
+         const double* pRow = pA + static_cast<size_t>(k + 1 + i) * size + k + 1;
+         double sum = 0.0;
+         for (unsigned int j = 0; j < length; ++j)
+         {
+            sum += pRow[j] * reflection[j];
+         }
+         product[i] = scale * sum;
+         dot += product[i] * reflection[i];
+      }
+      const double correction = 0.5 * scale * dot;
+      for (unsigned int i = 0; i < length; ++i)
+      {
+         product[i] -= correction * reflection[i];
+      }
+      for (unsigned int i = 0; i < length; ++i)
+      {
+         double* pRow = pA + static_cast<size_t>(k + 1 + i) * size + k + 1;
+         const double vi = reflection[i];
+         const double wi = product[i];
+         for (unsigned int j = 0; j < length; ++j)
+         {
+            pRow[j] -= vi * product[j] + wi * reflection[j];
+         }
+      }
+   }
+   if (size > 1)
+   {
+      mDiagonal[size - 2] = pA[static_cast<size_t>(size - 2) * size + size - 2];
+      mOffDiagonal[size - 2] = pA[static_cast<size_t>(size - 1) * size + size - 2];
+   }
+   mDiagonal[size - 1] = pA[static_cast<size_t>(size - 1) * size + size - 1];
+
+   // implicit QL without eigenvectors
+   std::vector<double> values(mDiagonal);
+   std::vector<double> offDiagonal(mOffDiagonal);
+   const double epsilon = std::numeric_limits<double>::epsilon();
+   const int last = static_cast<int>(size) - 1;
+   for (int l = 0; l <= last; ++l)
+   {
+      unsigned int iteration = 0;
+      int m = l;
+      do
+      {
+         for (m = l; m < last; ++m)
+         {
+            const double magnitude = fabs(values[m]) + fabs(values[m + 1]);
+            if (fabs(offDiagonal[m]) <= epsilon * magnitude)
+            {
+               break;
+            }
+         }
+         if (m != l)
+         {
+            if (iteration++ == sMaxQlIterations)
+            {
+               return false;
+            }
+
+            double g = (values[l + 1] - values[l]) / (2.0 * offDiagonal[l]);
+            double r = sqrt(g * g + 1.0);
+            g = values[m] - values[l] + offDiagonal[l] / (g + (g >= 0.0 ? r : -r));
+            double s = 1.0;
+            double c = 1.0;
+            double p = 0.0;
+            int i = m - 1;
+            for (; i >= l; --i)
+            {
+               double f = s * offDiagonal[i];
+               const double b = c * offDiagonal[i];
+               r = sqrt(f * f + g * g);
+               offDiagonal[i + 1] = r;
+               if (r == 0.0)
+               {
+                  values[i + 1] -= p;
+                  offDiagonal[m] = 0.0;
+                  break;
+               }
+               s = f / r;
+               c = g / r;
+               g = values[i + 1] - p;
+               r = (values[i] - g) * s + 2.0 * c * b;
+               p = s * r;
+               values[i + 1] = g + p;
+               g = c * r - b;
+            }
+            if (r == 0.0 && i >= l)
+            {
+               continue;
+            }
+            values[l] -= p;
+            offDiagonal[l] = g;
+            offDiagonal[m] = 0.0;
+         }
+      }
+      while (m != l);
+   }
+
+   std::sort(values.begin(), values.end());
+   mEigenvalues.swap(values);
+   mSize = size;
+   return true;
+}
+
+const std::vector<double>& MnfMath::SymmetricEigenSolver::getEigenvalues() const
+{
+   return mEigenvalues;
+}
+
+bool MnfMath::SymmetricEigenSolver::getEigenvectors(unsigned int first, unsigned int count,
+   std::vector<double>& eigenvectors) const
+{
+   if (mSize == 0 || count == 0 || first + count > mSize)
+   {
+      return false;
+   }
+
+   double norm = 0.0;
+   for (unsigned int row = 0; row < mSize; ++row)
+   {
+      double rowSum = fabs(mDiagonal[row]);
+      if (row > 0)
+      {
+         rowSum += fabs(mOffDiagonal[row - 1]);
+      }
+      if (row + 1 < mSize)
+      {
+         rowSum += fabs(mOffDiagonal[row]);
+      }
+      norm = std::max(norm, rowSum);
+   }
+   if (norm == 0.0)
+   {
+      norm = 1.0;
+   }
+
+   // eigenvalues closer than this are solved together so their vectors can be kept orthogonal
+   const double clusterGap = 1.0e-3 * norm;
+   std::vector<Range> groups;
+   unsigned int groupStart = first;
+   for (unsigned int index = first + 1; index < first + count; ++index)
+   {
+      if (mEigenvalues[index] - mEigenvalues[index - 1] > clusterGap)
+      {
+         groups.push_back(std::make_pair(groupStart, index));
+         groupStart = index;
+      }
+   }
+   groups.push_back(std::make_pair(groupStart, first + count));
+
+   std::vector<std::vector<double> > vectors(mSize);
+   TridiagonalEigenvectors solve(mDiagonal, mOffDiagonal, mEigenvalues, norm, vectors);
+#ifndef QT_NO_CONCURRENT
+   QtConcurrent::blockingMap(groups, solve);
+#else
+   for (std::vector<Range>::const_iterator iter = groups.begin(); iter != groups.end(); ++iter)
+   {
+      solve(*iter);
+   }
+#endif
+
+   eigenvectors.resize(static_cast<size_t>(mSize) * count);
+   forEachBlock(0, count, 1, BackTransform(mReflectors, mReflectorScales, mSize, vectors, first, count,
+      eigenvectors));
+
+   return true;
+}
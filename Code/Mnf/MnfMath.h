@@ -0,0 +1,184 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef MNFMATH_H
+#define MNFMATH_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Linear algebra helpers shared by the MNF forward and inverse transforms.
+ *
+ * All matrices are stored contiguously in row-major order.
+ */
+namespace MnfMath
+{
+   /**
+    *  Computes the product of two row-major matrices.
+    *
+    *  The rows of \em pLeft are split into blocks which are multiplied in
+    *  parallel. Each block is processed in cache sized pieces of the inner
+    *  and column dimensions so the active part of \em pRight stays resident.
+    *
+    *  @param   pLeft
+    *           The \em numRows x \em numInner left hand matrix, e.g. a tile of
+    *           BIP pixels.
+    *  @param   pRight
+    *           The \em numInner x \em numColumns right hand matrix, e.g. the
+    *           transform coefficients.
+    *  @param   pResults
+    *           The \em numRows x \em numColumns destination matrix. Any previous
+    *           contents are overwritten.
+    *  @param   numRows
+    *           The number of rows in \em pLeft and \em pResults.
+    *  @param   numInner
+    *           The number of columns in \em pLeft and rows in \em pRight.
+    *  @param   numColumns
+    *           The number of columns in \em pRight and \em pResults.
+    */
+   void multiply(const double* pLeft, const double* pRight, double* pResults,
+      unsigned int numRows, unsigned int numInner, unsigned int numColumns);
+
+   /**
+    *  Computes the Cholesky factor of a symmetric positive definite matrix in place.
+    *
+    *  The matrix is factored one column panel at a time. After each panel is
+    *  factored, the rows below it and the trailing submatrix are updated in
+    *  parallel row blocks. A non-positive pivot is replaced by 0.0001 so a
+    *  nearly singular covariance matrix still produces a usable factor.
+    *
+    *  @param   matrix
+    *           On input, the \em size x \em size symmetric matrix. On output,
+    *           the lower triangular factor L with the upper triangle set to zero.
+    *  @param   size
+    *           The number of rows and columns in \em matrix.
+    */
+   void choleskyDecompose(std::vector<double>& matrix, unsigned int size);
+
+   /**
+    *  Solves L * X = B in place for a lower triangular L.
+    *
+    *  The columns of B are split into blocks which are solved in parallel.
+    *
+    *  @param   lower
+    *           The \em size x \em size lower triangular matrix L.
+    *  @param   size
+    *           The number of rows and columns in \em lower.
+    *  @param   values
+    *           On input, the \em size x \em numColumns matrix B. On output, X.
+    *  @param   numColumns
+    *           The number of columns in \em values.
+    */
+   void solveLower(const std::vector<double>& lower, unsigned int size,
+      std::vector<double>& values, unsigned int numColumns);
+
+   /**
+    *  Solves transpose(L) * X = B in place for a lower triangular L.
+    *
+    *  @param   lower
+    *           The \em size x \em size lower triangular matrix L.
+    *  @param   size
+    *           The number of rows and columns in \em lower.
+    *  @param   values
+    *           On input, the \em size x \em numColumns matrix B. On output, X.
+    *  @param   numColumns
+    *           The number of columns in \em values.
+    */
+   void solveLowerTranspose(const std::vector<double>& lower, unsigned int size,
+      std::vector<double>& values, unsigned int numColumns);
+
+   /**
+    *  Eigen decomposition of a real symmetric matrix.
+    *
+    *  The matrix is reduced to tridiagonal form with Householder reflections.
+    *  All of the eigenvalues are then found with the implicit QL algorithm,
+    *  which is inexpensive once the matrix is tridiagonal. Eigenvectors are
+    *  only computed when they are requested, by inverse iteration on the
+    *  tridiagonal matrix followed by the inverse of the reduction. Callers that
+    *  only need a few components avoid the cost of forming the rest.
+    */
+   class SymmetricEigenSolver
+   {
+   public:
+      SymmetricEigenSolver();
+
+      /**
+       *  Reduces the matrix and computes its eigenvalues.
+       *
+       *  @param   matrix
+       *           The \em size x \em size symmetric matrix. Only the lower
+       *           triangle is used.
+       *  @param   size
+       *           The number of rows and columns in \em matrix.
+       *
+       *  @return  \c true if the eigenvalues converged, \c false otherwise.
+       */
+      bool decompose(const std::vector<double>& matrix, unsigned int size);
+
+      /**
+       *  Returns all of the eigenvalues in ascending order.
+       */
+      const std::vector<double>& getEigenvalues() const;
+
+      /**
+       *  Computes eigenvectors for a range of eigenvalues.
+       *
+       *  @param   first
+       *           The index into getEigenvalues() of the first eigenvalue.
+       *  @param   count
+       *           The number of eigenvectors to compute.
+       *  @param   eigenvectors
+       *           Receives a size x \em count matrix. Column \em i holds the
+       *           unit eigenvector for eigenvalue \em first + \em i.
+       *
+       *  @return  \c true if the eigenvectors were computed, \c false if
+       *           decompose() has not succeeded or the range is invalid.
+       */
+      bool getEigenvectors(unsigned int first, unsigned int count, std::vector<double>& eigenvectors) const;
+
+   private:
+      unsigned int mSize;
+      std::vector<double> mReflectors;
+      std::vector<double> mReflectorScales;
+      std::vector<double> mDiagonal;
+      std::vector<double> mOffDiagonal;
+      std::vector<double> mEigenvalues;
+   };
+
+   /**
+    *  Converts raw data values to double.
+    *
+    *  This is intended to be called with switchOnEncoding().
+    */
+   template<class T>
+   void convertToDouble(T* pData, double* pValues, size_t numValues)
+   {
+      for (size_t index = 0; index < numValues; ++index)
+      {
+         pValues[index] = static_cast<double>(pData[index]);
+      }
+   }
+
+   /**
+    *  Converts double values to the raw data type.
+    *
+    *  This is intended to be called with switchOnEncoding().
+    */
+   template<class T>
+   void convertFromDouble(T* pData, const double* pValues, size_t numValues)
+   {
+      for (size_t index = 0; index < numValues; ++index)
+      {
+         pData[index] = static_cast<T>(pValues[index]);
+      }
+   }
+}
+
+#endif
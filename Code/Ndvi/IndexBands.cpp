@@ -0,0 +1,47 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "IndexBands.h"
+#include "PlugInArgList.h"
+#include "RasterDataDescriptor.h"
+#include "RasterUtilities.h"
+
+DimensionDescriptor IndexBands::selectBand(PlugInArgList* pInArgList, const std::string& argName,
+   const std::string& bandName, double low, double high, const RasterDataDescriptor* pDesc,
+   std::string& errorMessage)
+{
+   if (pDesc == NULL)
+   {
+      errorMessage = "No raster data descriptor specified.";
+      return DimensionDescriptor();
+   }
+
+   //If a value was provided in the input arguments, it is an ORIGINAL band number.
+   //Note: Convert to zero based, user entered 1 based band index!! If zero is entered
+   //for a bandNumber, this becomes int_max, which will be an invalid band number anyways,
+   //so don't worry about decrementing zero in unsigned!
+   unsigned int bandNumber;
+   if (pInArgList != NULL && pInArgList->getPlugInArgValue<unsigned int>(argName, bandNumber))
+   {
+      DimensionDescriptor band = pDesc->getOriginalBand(bandNumber - 1);
+      if (!band.isValid())
+      {
+         errorMessage = "Specified " + bandName + " band not available.";
+      }
+      return band;
+   }
+
+   // Filter wavelength data and select the appropriate band
+   DimensionDescriptor band = RasterUtilities::findBandWavelengthMatch(low, high, pDesc);
+   if (!band.isValid())
+   {
+      errorMessage = "No bands fall in the " + bandName + " wavelength range.";
+   }
+   return band;
+}
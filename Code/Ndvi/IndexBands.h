@@ -0,0 +1,64 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef INDEXBANDS_H
+#define INDEXBANDS_H
+
+#include "DimensionDescriptor.h"
+
+#include <string>
+
+class PlugInArgList;
+class RasterDataDescriptor;
+
+/**
+ * Band selection shared by the vegetation and water index plug-ins.
+ */
+namespace IndexBands
+{
+   // Wavelength range definitions in micrometers
+   const double blueBandLow = 0.450;
+   const double blueBandHigh = 0.520;
+   const double greenBandLow = 0.520;
+   const double greenBandHigh = 0.600;
+   const double redBandLow = 0.630;
+   const double redBandHigh = 0.690;
+   const double nirBandLow = 0.760;
+   const double nirBandHigh = 1.000;
+
+   /**
+    *  Selects the band to use for one wavelength range.
+    *
+    *  If \em argName is set in the argument list, it is interpreted as a one
+    *  based original band number. Otherwise the band is found by matching
+    *  the band wavelengths against the range.
+    *
+    *  @param   pInArgList
+    *           The argument list containing the optional band number.
+    *  @param   argName
+    *           The name of the optional band number argument.
+    *  @param   bandName
+    *           The name of the band used in error messages, e.g. "red".
+    *  @param   low
+    *           The low end of the wavelength range in micrometers.
+    *  @param   high
+    *           The high end of the wavelength range in micrometers.
+    *  @param   pDesc
+    *           The descriptor of the raster element being processed.
+    *  @param   errorMessage
+    *           Set to a description of the problem if no band can be selected.
+    *
+    *  @return  The selected band, or an invalid DimensionDescriptor if no band
+    *           could be selected.
+    */
+   DimensionDescriptor selectBand(PlugInArgList* pInArgList, const std::string& argName, const std::string& bandName,
+      double low, double high, const RasterDataDescriptor* pDesc, std::string& errorMessage);
+}
+
+#endif
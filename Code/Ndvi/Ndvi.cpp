@@ -10,6 +10,7 @@
 #include "ApplicationServices.h"
 #include "AppVerify.h"
 #include "DesktopServices.h"
+#include "IndexBands.h"
 #include "Ndvi.h"
 #include "NdviDlg.h"
 #include "PlugInArgList.h"
@@ -27,14 +28,7 @@
 
 REGISTER_PLUGIN_BASIC(NdviModule, Ndvi);
 
-namespace
-{
-   // Wavelength range definitions for red and NIR in micrometers
-   const double redBandLow = 0.630;
-   const double redBandHigh = 0.690;
-   const double nirBandLow = 0.760;
-   const double nirBandHigh = 1.000;
-}
+using namespace IndexBands;
 
 Ndvi::Ndvi() :
    mbDisplayResults(Service<ApplicationServices>()->isInteractive()),
@@ -128,40 +122,18 @@ bool Ndvi::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
    }
    else
    {
-      //If values were provided in input arguments, they are ORIGINAL band numbers.
-      //Translate to active band numbers and get dimension descriptor for requested band.
-      //Note: Convert to zero based, user entered 1 based band index!! If zero is entered
-      //for a bandNumber, this becomes int_max, which will be an invalid band number anyways,
-      //so don't worry about decrementing zero in unsigned!
-      unsigned int redBandNumber;
-      if (pInArgList->getPlugInArgValue<unsigned int>("Red Band Number", redBandNumber))
-      {
-         redBandDD = pDesc->getOriginalBand(redBandNumber - 1);
-         if (!redBandDD.isValid())
-         {
-            progress.report("Specified red band not available.", 0, ERRORS, true);
-            return false;
-         }
-      }
-      else if (!redBandDD.isValid())
+      std::string errorMessage;
+      redBandDD = selectBand(pInArgList, "Red Band Number", "red", redBandLow, redBandHigh, pDesc, errorMessage);
+      if (!redBandDD.isValid())
       {
-         progress.report("No bands fall in the red wavelength range.", 0, ERRORS, true);
+         progress.report(errorMessage, 0, ERRORS, true);
          return false;
       }
 
-      unsigned int nirBandNumber;
-      if (pInArgList->getPlugInArgValue<unsigned int>("NIR Band Number", nirBandNumber))
-      {
-         nirBandDD = pDesc->getOriginalBand(nirBandNumber - 1);
-         if (!nirBandDD.isValid())
-         {
-            progress.report("Specified NIR band not available.", 0, ERRORS, true);
-            return false;
-         }
-      }
-      else if (!nirBandDD.isValid())
+      nirBandDD = selectBand(pInArgList, "NIR Band Number", "NIR", nirBandLow, nirBandHigh, pDesc, errorMessage);
+      if (!nirBandDD.isValid())
       {
-         progress.report("No bands fall in the NIR wavelength range.", 0, ERRORS, true);
+         progress.report(errorMessage, 0, ERRORS, true);
          return false;
       }
       VERIFY(pInArgList->getPlugInArgValue<bool>("Display Results", mbDisplayResults));
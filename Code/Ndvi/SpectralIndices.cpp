@@ -0,0 +1,537 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "ApplicationServices.h"
+#include "AppVerify.h"
+#include "DataAccessor.h"
+#include "DataAccessorImpl.h"
+#include "DataRequest.h"
+#include "DesktopServices.h"
+#include "DynamicObject.h"
+#include "IndexBands.h"
+#include "ModelServices.h"
+#include "ObjectResource.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "ProgressTracker.h"
+#include "RasterDataDescriptor.h"
+#include "RasterElement.h"
+#include "RasterUtilities.h"
+#include "SpatialDataView.h"
+#include "SpatialDataWindow.h"
+#include "SpecialMetadata.h"
+#include "SpectralIndices.h"
+#include "SpectralIndicesDlg.h"
+#include "SpectralVersion.h"
+#include "switchOnEncoding.h"
+#include "TypeConverter.h"
+#include "Undo.h"
+#include "Wavelengths.h"
+
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentMap>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+REGISTER_PLUGIN_BASIC(NdviModule, SpectralIndices);
+
+using namespace IndexBands;
+
+namespace
+{
+   enum IndexType { NDVI_INDEX, NDWI_INDEX, SAVI_INDEX, EVI_INDEX, NUM_INDICES };
+   enum BandType { BLUE_BAND, GREEN_BAND, RED_BAND, NIR_BAND, NUM_BANDS };
+
+   const char* const sIndexNames[NUM_INDICES] = { "NDVI", "NDWI", "SAVI", "EVI" };
+   const char* const sBandNames[NUM_BANDS] = { "blue", "green", "red", "NIR" };
+   const char* const sBandTitles[NUM_BANDS] = { "Blue", "Green", "Red", "NIR" };
+   const char* const sBandArgs[NUM_BANDS] =
+      { "Blue Band Number", "Green Band Number", "Red Band Number", "NIR Band Number" };
+   const double sBandLow[NUM_BANDS] = { blueBandLow, greenBandLow, redBandLow, nirBandLow };
+   const double sBandHigh[NUM_BANDS] = { blueBandHigh, greenBandHigh, redBandHigh, nirBandHigh };
+
+   // number of rows computed by each task
+   const unsigned int sRowsPerTask = 64;
+
+   std::string getComputeArgName(int index)
+   {
+      return std::string("Compute ") + sIndexNames[index];
+   }
+
+   bool isBandNeeded(int index, int band)
+   {
+      switch (index)
+      {
+      case NDVI_INDEX:
+      case SAVI_INDEX:
+         return band == RED_BAND || band == NIR_BAND;
+      case NDWI_INDEX:
+         return band == GREEN_BAND || band == NIR_BAND;
+      case EVI_INDEX:
+         return band == BLUE_BAND || band == RED_BAND || band == NIR_BAND;
+      default:
+         return false;
+      }
+   }
+
+   float normalizedDifference(float first, float second)
+   {
+      const float sum = first + second;
+      return sum == 0.0f ? 0.0f : (first - second) / sum;
+   }
+
+   template<typename T>
+   void convertRow(T* pData, float* pValues, unsigned int numValues)
+   {
+      for (unsigned int index = 0; index < numValues; ++index)
+      {
+         pValues[index] = static_cast<float>(pData[index]);
+      }
+   }
+
+   struct RowBlock
+   {
+      unsigned int mStartRow;
+      unsigned int mEndRow;
+   };
+
+   /**
+    *  Computes every selected index for a block of rows.
+    *
+    *  Each distinct band is read once into a float buffer and shared by all of the
+    *  indices. The results are written directly into the BIP result data.
+    */
+   struct IndexMap
+   {
+      typedef RowBlock input_type;
+      typedef unsigned int result_type;
+
+      IndexMap(RasterElement* pElement, const std::vector<DimensionDescriptor>& bands,
+         const std::vector<int>& bandSlots, const std::vector<int>& indices, float* pResults, double soilFactor) :
+         mpElement(pElement),
+         mpDescriptor(NULL),
+         mBands(bands),
+         mBandSlots(bandSlots),
+         mIndices(indices),
+         mpResults(pResults),
+         mSoilFactor(static_cast<float>(soilFactor)),
+         mNumColumns(0)
+      {
+         VERIFYNRV(mpElement != NULL);
+         mpDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpElement->getDataDescriptor());
+         VERIFYNRV(mpDescriptor != NULL);
+         mNumColumns = mpDescriptor->getColumnCount();
+      }
+
+      result_type operator()(const input_type& rows) const
+      {
+         VERIFYRV(mpDescriptor != NULL && mpResults != NULL, 0);
+         const unsigned int numPixels = (rows.mEndRow - rows.mStartRow) * mNumColumns;
+         std::vector<std::vector<float> > bandValues(mBands.size(), std::vector<float>(numPixels));
+         for (std::vector<DimensionDescriptor>::size_type band = 0; band < mBands.size(); ++band)
+         {
+            FactoryResource<DataRequest> pRequest;
+            pRequest->setInterleaveFormat(BSQ);
+            pRequest->setRows(mpDescriptor->getActiveRow(rows.mStartRow), mpDescriptor->getActiveRow(rows.mEndRow - 1));
+            pRequest->setBands(mBands[band], mBands[band]);
+            DataAccessor accessor = mpElement->getDataAccessor(pRequest.release());
+            for (unsigned int row = rows.mStartRow; row < rows.mEndRow; ++row)
+            {
+               VERIFYRV(accessor.isValid(), 0);
+               switchOnEncoding(mpDescriptor->getDataType(), convertRow, accessor->getRow(),
+                  &bandValues[band][(row - rows.mStartRow) * mNumColumns], mNumColumns);
+               accessor->nextRow();
+            }
+         }
+
+         const float* pBands[NUM_BANDS] = { NULL, NULL, NULL, NULL };
+         for (int band = 0; band < NUM_BANDS; ++band)
+         {
+            if (mBandSlots[band] >= 0)
+            {
+               pBands[band] = &bandValues[mBandSlots[band]].front();
+            }
+         }
+
+         float* pResults = mpResults + static_cast<size_t>(rows.mStartRow) * mNumColumns * mIndices.size();
+         for (unsigned int pixel = 0; pixel < numPixels; ++pixel)
+         {
+            for (std::vector<int>::const_iterator iter = mIndices.begin(); iter != mIndices.end(); ++iter)
+            {
+               float value = 0.0f;
+               switch (*iter)
+               {
+               case NDVI_INDEX:
+                  value = normalizedDifference(pBands[NIR_BAND][pixel], pBands[RED_BAND][pixel]);
+                  break;
+               case NDWI_INDEX:
+                  value = normalizedDifference(pBands[GREEN_BAND][pixel], pBands[NIR_BAND][pixel]);
+                  break;
+               case SAVI_INDEX:
+               {
+                  const float nir = pBands[NIR_BAND][pixel];
+                  const float red = pBands[RED_BAND][pixel];
+                  const float denominator = nir + red + mSoilFactor;
+                  value = denominator == 0.0f ? 0.0f : (1.0f + mSoilFactor) * (nir - red) / denominator;
+                  break;
+               }
+               case EVI_INDEX:
+               {
+                  const float nir = pBands[NIR_BAND][pixel];
+                  const float red = pBands[RED_BAND][pixel];
+                  const float denominator = nir + 6.0f * red - 7.5f * pBands[BLUE_BAND][pixel] + 1.0f;
+                  value = denominator == 0.0f ? 0.0f : 2.5f * (nir - red) / denominator;
+                  break;
+               }
+               default:
+                  break;
+               }
+               *pResults++ = value;
+            }
+         }
+
+         return rows.mEndRow - rows.mStartRow;
+      }
+
+      RasterElement* mpElement;
+      const RasterDataDescriptor* mpDescriptor;
+      const std::vector<DimensionDescriptor>& mBands;
+      const std::vector<int>& mBandSlots;
+      const std::vector<int>& mIndices;
+      float* mpResults;
+      float mSoilFactor;
+      unsigned int mNumColumns;
+   };
+
+   void rowCountReduce(unsigned int& total, const unsigned int& rows)
+   {
+      total += rows;
+   }
+}
+
+SpectralIndices::SpectralIndices() :
+   mbDisplayResults(Service<ApplicationServices>()->isInteractive()),
+   mSoilFactor(0.5)
+{
+   setName("Spectral Indices");
+   setDescriptorId("{6e0f3b52-8d1a-4c7e-9f25-b4a1d36c8e90}");
+   setDescription("Calculate NDVI, NDWI, SAVI and EVI in a single pass using wavelength information to "
+      "determine which bands to process.");
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setMenuLocation("[Spectral]\\Transforms\\Spectral Indices");
+   setAbortSupported(true);
+   setWizardSupported(true);
+}
+
+SpectralIndices::~SpectralIndices()
+{}
+
+bool SpectralIndices::getInputSpecification(PlugInArgList*& pInArgList)
+{
+   VERIFY(pInArgList = Service<PlugInManagerServices>()->getPlugInArgList());
+   VERIFY(pInArgList->addArg<Progress>(Executable::ProgressArg(), NULL, Executable::ProgressArgDescription()));
+   VERIFY(pInArgList->addArg<RasterElement>(Executable::DataElementArg(), NULL, "Raster element on which the "
+      "indices will be calculated."));
+
+   if (isBatch())
+   {
+      for (int index = 0; index < NUM_INDICES; ++index)
+      {
+         VERIFY(pInArgList->addArg<bool>(getComputeArgName(index), true, std::string("Optional argument: Whether "
+            "or not to calculate ") + sIndexNames[index] + ". Default is true."));
+      }
+      for (int band = 0; band < NUM_BANDS; ++band)
+      {
+         VERIFY(pInArgList->addArg<unsigned int>(sBandArgs[band], std::string("Optional argument: Band number of ") +
+            sBandNames[band] + " band. If no band is specified, will attempt wavelength match to find " +
+            sBandNames[band] + " band."));
+      }
+      VERIFY(pInArgList->addArg<double>("SAVI Soil Factor", mSoilFactor, "Optional argument: Soil brightness "
+         "correction factor used by SAVI. SAVI and EVI expect the data to be reflectance scaled from 0 to 1. "
+         "Default is 0.5."));
+      VERIFY(pInArgList->addArg<bool>("Display Results", mbDisplayResults, "Optional Argument: Whether or not "
+         "to display the result of the operation. Default is true in interactive application mode, false "
+         "in batch application mode."));
+   }
+   return true;
+}
+
+bool SpectralIndices::getOutputSpecification(PlugInArgList*& pOutArgList)
+{
+   VERIFY(pOutArgList = Service<PlugInManagerServices>()->getPlugInArgList());
+   VERIFY(pOutArgList->addArg<RasterElement>("Spectral Indices Result", NULL, "Raster element containing one "
+      "band for each calculated index."));
+   return true;
+}
+
+bool SpectralIndices::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
+{
+   VERIFY(pInArgList);
+   ProgressTracker progress(pInArgList->getPlugInArgValue<Progress>(Executable::ProgressArg()),
+      "Calculating spectral indices", "spectral", "{2c4d9a71-5e3b-4f08-a6c2-7d91e0b5f3a4}");
+   RasterElement* pElement = pInArgList->getPlugInArgValue<RasterElement>(Executable::DataElementArg());
+   if (pElement == NULL)
+   {
+      progress.report("No RasterElement specified.", 0, ERRORS, true);
+      return false;
+   }
+
+   RasterDataDescriptor* pDesc = static_cast<RasterDataDescriptor*>(pElement->getDataDescriptor());
+   VERIFY(pDesc != NULL);
+
+   bool computeIndex[NUM_INDICES] = { true, true, true, true };
+   if (isBatch())
+   {
+      for (int index = 0; index < NUM_INDICES; ++index)
+      {
+         VERIFY(pInArgList->getPlugInArgValue<bool>(getComputeArgName(index), computeIndex[index]));
+      }
+      VERIFY(pInArgList->getPlugInArgValue<double>("SAVI Soil Factor", mSoilFactor));
+      VERIFY(pInArgList->getPlugInArgValue<bool>("Display Results", mbDisplayResults));
+   }
+
+   // Select each band needed by the requested indices. In interactive mode, the user chooses the
+   // indices and bands starting from the wavelength matches. In batch mode, every requested index
+   // must be calculated.
+   std::vector<DimensionDescriptor> bandDDs(NUM_BANDS);
+   std::string bandErrors[NUM_BANDS];
+   for (int band = 0; band < NUM_BANDS; ++band)
+   {
+      bandDDs[band] = selectBand(isBatch() ? pInArgList : NULL, sBandArgs[band], sBandNames[band],
+         sBandLow[band], sBandHigh[band], pDesc, bandErrors[band]);
+   }
+
+   if (!isBatch())
+   {
+      FactoryResource<Wavelengths> pWavelengths;
+      pWavelengths->initializeFromDynamicObject(pDesc->getMetadata(), true);
+      std::vector<std::string> indexNames(sIndexNames, sIndexNames + NUM_INDICES);
+      std::vector<std::string> bandLabels;
+      for (int band = 0; band < NUM_BANDS; ++band)
+      {
+         bandLabels.push_back(QString("%1 Band (%2 - %3)").arg(sBandTitles[band])
+            .arg(Wavelengths::convertValue(sBandLow[band], MICRONS, pWavelengths->getUnits()))
+            .arg(Wavelengths::convertValue(sBandHigh[band], MICRONS, pWavelengths->getUnits())).toStdString());
+      }
+      std::vector<std::vector<bool> > bandsNeeded(NUM_INDICES, std::vector<bool>(NUM_BANDS));
+      for (int index = 0; index < NUM_INDICES; ++index)
+      {
+         for (int band = 0; band < NUM_BANDS; ++band)
+         {
+            bandsNeeded[index][band] = isBandNeeded(index, band);
+         }
+      }
+
+      SpectralIndicesDlg dlg(pDesc, indexNames, bandLabels, bandsNeeded, bandDDs, mSoilFactor,
+         Service<DesktopServices>()->getMainWidget());
+      if (dlg.exec() == QDialog::Rejected)
+      {
+         progress.report("User canceled operation.", 0, ABORT, true);
+         return false;
+      }
+
+      for (int index = 0; index < NUM_INDICES; ++index)
+      {
+         computeIndex[index] = dlg.isIndexSelected(index);
+      }
+      for (int band = 0; band < NUM_BANDS; ++band)
+      {
+         const int activeBand = dlg.getBand(band);
+         bandDDs[band] = activeBand < 0 ? DimensionDescriptor() :
+            pDesc->getActiveBand(static_cast<unsigned int>(activeBand));
+      }
+      mSoilFactor = dlg.getSoilFactor();
+      mbDisplayResults = dlg.getDisplayResults();
+   }
+
+   std::vector<int> indices;
+   std::vector<std::string> indexNames;
+   std::vector<int> bandSlots(NUM_BANDS, -1);
+   std::vector<DimensionDescriptor> bands;
+   for (int index = 0; index < NUM_INDICES; ++index)
+   {
+      if (computeIndex[index] == false)
+      {
+         continue;
+      }
+
+      std::string errorMessage;
+      for (int band = 0; band < NUM_BANDS && errorMessage.empty(); ++band)
+      {
+         if (isBandNeeded(index, band) && !bandDDs[band].isValid())
+         {
+            errorMessage = bandErrors[band];
+         }
+      }
+
+      if (errorMessage.empty() == false)
+      {
+         if (isBatch())
+         {
+            progress.report(errorMessage, 0, ERRORS, true);
+            return false;
+         }
+         progress.report(std::string(sIndexNames[index]) + " will not be calculated. " + errorMessage,
+            0, WARNING, true);
+         continue;
+      }
+
+      // Each distinct band is only read once even if it is selected for more than one range
+      for (int band = 0; band < NUM_BANDS; ++band)
+      {
+         if (isBandNeeded(index, band) && bandSlots[band] < 0)
+         {
+            std::vector<DimensionDescriptor>::iterator iter = std::find(bands.begin(), bands.end(), bandDDs[band]);
+            bandSlots[band] = static_cast<int>(iter - bands.begin());
+            if (iter == bands.end())
+            {
+               bands.push_back(bandDDs[band]);
+            }
+         }
+      }
+      indices.push_back(index);
+      indexNames.push_back(sIndexNames[index]);
+   }
+
+   if (indices.empty())
+   {
+      progress.report("No indices can be calculated.", 0, ERRORS, true);
+      return false;
+   }
+
+   // Create the result
+   const std::string resultName = "Spectral Indices Result";
+   Service<ModelServices> pModel;
+   DataElement* pExisting = pModel->getElement(resultName, TypeConverter::toString<RasterElement>(), pElement);
+   if (pExisting != NULL)
+   {
+      pModel->destroyElement(pExisting);
+   }
+
+   const unsigned int numRows = pDesc->getRowCount();
+   const unsigned int numColumns = pDesc->getColumnCount();
+   ModelResource<RasterElement> pResult(RasterUtilities::createRasterElement(resultName, numRows, numColumns,
+      static_cast<unsigned int>(indices.size()), FLT4BYTES, BIP, true, pElement));
+   if (pResult.get() == NULL || pResult->getRawData() == NULL)
+   {
+      progress.report("Unable to create the result raster element.", 0, ERRORS, true);
+      return false;
+   }
+
+   RasterDataDescriptor* pResultDesc = static_cast<RasterDataDescriptor*>(pResult->getDataDescriptor());
+   VERIFY(pResultDesc != NULL);
+   pResultDesc->getMetadata()->setAttributeByPath(SPECIAL_METADATA_NAME + "/" + BAND_METADATA_NAME + "/" +
+      NAMES_METADATA_NAME, indexNames);
+
+   // Calculate the indices for blocks of rows in parallel
+   std::vector<RowBlock> rowBlocks;
+   for (unsigned int row = 0; row < numRows; row += sRowsPerTask)
+   {
+      RowBlock block;
+      block.mStartRow = row;
+      block.mEndRow = std::min(row + sRowsPerTask, numRows);
+      rowBlocks.push_back(block);
+   }
+
+   progress.report("Calculating spectral indices", 5, NORMAL);
+   IndexMap indexMap(pElement, bands, bandSlots, indices, reinterpret_cast<float*>(pResult->getRawData()),
+      mSoilFactor);
+   unsigned int rowsCalculated = 0;
+#ifndef QT_NO_CONCURRENT
+   QFuture<unsigned int> future = QtConcurrent::mappedReduced(rowBlocks.begin(), rowBlocks.end(), indexMap,
+      rowCountReduce, QtConcurrent::UnorderedReduce);
+   bool isCancelling = false;
+   while (future.isRunning())
+   {
+      if (isCancelling)
+      {
+         progress.report("Cleaning up processing threads. Please wait.", 99, NORMAL);
+      }
+      else
+      {
+         const int progressRange = future.progressMaximum() - future.progressMinimum();
+         if (progressRange > 0)
+         {
+            progress.report("Calculating spectral indices",
+               5 + 90 * (future.progressValue() - future.progressMinimum()) / progressRange, NORMAL);
+         }
+         if (isAborted())
+         {
+            future.cancel();
+            isCancelling = true;
+            setAbortSupported(false);
+         }
+      }
+      QThread::yieldCurrentThread();
+   }
+   if (future.isCanceled())
+   {
+      progress.report("User canceled operation.", 100, ABORT, true);
+      return false;
+   }
+   rowsCalculated = future.result();
+#else
+   for (std::vector<RowBlock>::const_iterator iter = rowBlocks.begin(); iter != rowBlocks.end(); ++iter)
+   {
+      if (isAborted())
+      {
+         progress.report("User canceled operation.", 100, ABORT, true);
+         return false;
+      }
+      rowCountReduce(rowsCalculated, indexMap(*iter));
+      progress.report("Calculating spectral indices", 5 + 90 * iter->mEndRow / numRows, NORMAL);
+   }
+#endif
+
+   if (rowsCalculated != numRows)
+   {
+      progress.report("Unable to calculate the indices for all rows.", 0, ERRORS, true);
+      return false;
+   }
+   pResult->updateData();
+
+   if (mbDisplayResults && Service<ApplicationServices>()->isInteractive())
+   {
+      Service<DesktopServices> pDesktop;
+      SpatialDataWindow* pWindow = static_cast<SpatialDataWindow*>(pDesktop->createWindow(
+         pElement->getName() + " - " + getName(), SPATIAL_DATA_WINDOW));
+      SpatialDataView* pView = (pWindow == NULL) ? NULL : pWindow->getSpatialDataView();
+      if (pView == NULL)
+      {
+         pDesktop->deleteWindow(pWindow);
+         progress.report("Unable to display the results.", 0, WARNING, true);
+      }
+      else
+      {
+         UndoLock lock(pView);
+         if (pView->setPrimaryRasterElement(pResult.get()) == false ||
+            pView->createLayer(RASTER, pResult.get()) == NULL)
+         {
+            progress.report("Unable to display the results.", 0, WARNING, true);
+         }
+      }
+   }
+
+   if (pOutArgList != NULL)
+   {
+      pOutArgList->setPlugInArgValue("Spectral Indices Result", pResult.get());
+   }
+
+   pResult.release();
+   progress.report("Spectral Indices Calculation Complete", 100, NORMAL);
+   progress.upALevel();
+   return true;
+}
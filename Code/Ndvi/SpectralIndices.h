@@ -0,0 +1,37 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef SPECTRALINDICES_H__
+#define SPECTRALINDICES_H__
+
+#include "AlgorithmShell.h"
+
+/**
+ * Computes any combination of NDVI, NDWI, SAVI and EVI in a single pass.
+ *
+ * Each band needed by the selected indices is read once per block of rows
+ * and every index is computed from the same values, so the result is one
+ * multi-band float raster with a band per index.
+ */
+class SpectralIndices : public AlgorithmShell
+{
+public:
+   SpectralIndices();
+   virtual ~SpectralIndices();
+
+   virtual bool getInputSpecification(PlugInArgList*& pInArgList);
+   virtual bool getOutputSpecification(PlugInArgList*& pOutArgList);
+   virtual bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+
+private:
+   bool mbDisplayResults;
+   double mSoilFactor;
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "ObjectResource.h"
+#include "RasterDataDescriptor.h"
+#include "RasterUtilities.h"
+#include "SpectralIndicesDlg.h"
+#include "Wavelengths.h"
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtGui/QCheckBox>
+#include <QtGui/QComboBox>
+#include <QtGui/QDialogButtonBox>
+#include <QtGui/QDoubleSpinBox>
+#include <QtGui/QGridLayout>
+#include <QtGui/QGroupBox>
+#include <QtGui/QLabel>
+#include <QtGui/QMessageBox>
+
+SpectralIndicesDlg::SpectralIndicesDlg(const RasterDataDescriptor* pDataDescriptor,
+   const std::vector<std::string>& indexNames, const std::vector<std::string>& bandLabels,
+   const std::vector<std::vector<bool> >& bandsNeeded, const std::vector<DimensionDescriptor>& bands,
+   double soilFactor, QWidget* pParent) :
+   QDialog(pParent),
+   mIndexNames(indexNames),
+   mBandLabels(bandLabels),
+   mBandsNeeded(bandsNeeded),
+   mpSoilFactor(NULL),
+   mpDisplayResults(NULL)
+{
+   VERIFYNRV(pDataDescriptor != NULL);
+   VERIFYNRV(bandsNeeded.size() == indexNames.size() && bands.size() == bandLabels.size());
+
+   setWindowTitle("Spectral Indices");
+
+   // Indices
+   QGroupBox* pIndexGroup = new QGroupBox("Indices", this);
+   QGridLayout* pIndexLayout = new QGridLayout(pIndexGroup);
+   for (std::vector<std::string>::size_type index = 0; index < indexNames.size(); ++index)
+   {
+      QCheckBox* pCheck = new QCheckBox(QString::fromStdString(indexNames[index]), pIndexGroup);
+      pCheck->setChecked(true);
+      pIndexLayout->addWidget(pCheck, static_cast<int>(index), 0);
+      mIndexChecks.push_back(pCheck);
+   }
+
+   // Bands - each item shows the band name and its center wavelength
+   FactoryResource<Wavelengths> pWavelengths;
+   pWavelengths->initializeFromDynamicObject(pDataDescriptor->getMetadata(), true);
+   const std::vector<double>& centerValues = pWavelengths->getCenterValues();
+   std::vector<std::string> bandNames = RasterUtilities::getBandNames(pDataDescriptor);
+   QStringList bandItems;
+   for (std::vector<std::string>::size_type band = 0; band < bandNames.size(); ++band)
+   {
+      QString item = QString::fromStdString(bandNames[band]);
+      if (band < centerValues.size())
+      {
+         item += QString(" (%1)").arg(centerValues[band]);
+      }
+      bandItems.append(item);
+   }
+
+   QGroupBox* pBandGroup = new QGroupBox("Bands", this);
+   QGridLayout* pBandLayout = new QGridLayout(pBandGroup);
+   for (std::vector<std::string>::size_type band = 0; band < bandLabels.size(); ++band)
+   {
+      QLabel* pLabel = new QLabel(QString::fromStdString(bandLabels[band]) + ":", pBandGroup);
+      QComboBox* pCombo = new QComboBox(pBandGroup);
+      pCombo->addItems(bandItems);
+      pCombo->setCurrentIndex(bands[band].isValid() ? static_cast<int>(bands[band].getActiveNumber()) : -1);
+      pBandLayout->addWidget(pLabel, static_cast<int>(band), 0);
+      pBandLayout->addWidget(pCombo, static_cast<int>(band), 1);
+      pBandLayout->setColumnStretch(1, 10);
+      mBandCombos.push_back(pCombo);
+   }
+
+   // Options
+   QLabel* pSoilLabel = new QLabel("SAVI Soil Factor:", this);
+   mpSoilFactor = new QDoubleSpinBox(this);
+   mpSoilFactor->setRange(0.0, 1.0);
+   mpSoilFactor->setSingleStep(0.05);
+   mpSoilFactor->setDecimals(3);
+   mpSoilFactor->setValue(soilFactor);
+   mpDisplayResults = new QCheckBox("Display Results", this);
+   mpDisplayResults->setChecked(true);
+
+   // OK and Cancel buttons
+   QDialogButtonBox* pButtonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel,
+      Qt::Horizontal, this);
+   VERIFYNR(connect(pButtonBox, SIGNAL(accepted()), this, SLOT(accept())));
+   VERIFYNR(connect(pButtonBox, SIGNAL(rejected()), this, SLOT(reject())));
+
+   QGridLayout* pLayout = new QGridLayout(this);
+   pLayout->setMargin(10);
+   pLayout->setSpacing(5);
+   pLayout->addWidget(pIndexGroup, 0, 0, 1, 2);
+   pLayout->addWidget(pBandGroup, 0, 2, 1, 2);
+   pLayout->addWidget(pSoilLabel, 1, 0);
+   pLayout->addWidget(mpSoilFactor, 1, 1);
+   pLayout->addWidget(mpDisplayResults, 2, 0, 1, 2);
+   pLayout->addWidget(pButtonBox, 3, 0, 1, 4, Qt::AlignRight);
+   pLayout->setColumnStretch(3, 10);
+}
+
+SpectralIndicesDlg::~SpectralIndicesDlg()
+{}
+
+bool SpectralIndicesDlg::isIndexSelected(unsigned int index) const
+{
+   VERIFY(index < mIndexChecks.size());
+   return mIndexChecks[index]->isChecked();
+}
+
+int SpectralIndicesDlg::getBand(unsigned int band) const
+{
+   VERIFYRV(band < mBandCombos.size(), -1);
+   return mBandCombos[band]->currentIndex();
+}
+
+double SpectralIndicesDlg::getSoilFactor() const
+{
+   return mpSoilFactor->value();
+}
+
+bool SpectralIndicesDlg::getDisplayResults() const
+{
+   return mpDisplayResults->isChecked();
+}
+
+void SpectralIndicesDlg::accept()
+{
+   bool anySelected = false;
+   for (std::vector<QCheckBox*>::size_type index = 0; index < mIndexChecks.size(); ++index)
+   {
+      if (mIndexChecks[index]->isChecked() == false)
+      {
+         continue;
+      }
+
+      anySelected = true;
+      for (std::vector<QComboBox*>::size_type band = 0; band < mBandCombos.size(); ++band)
+      {
+         if (mBandsNeeded[index][band] && mBandCombos[band]->currentIndex() < 0)
+         {
+            QMessageBox::warning(this, windowTitle(), QString("%1 needs the %2. Please select a band from "
+               "the list or clear %1.").arg(QString::fromStdString(mIndexNames[index]))
+               .arg(QString::fromStdString(mBandLabels[band])));
+            return;
+         }
+      }
+   }
+
+   if (anySelected == false)
+   {
+      QMessageBox::warning(this, windowTitle(), "No indices are selected. Please select at least one index.");
+      return;
+   }
+
+   QDialog::accept();
+}
@@ -0,0 +1,83 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef SPECTRALINDICESDLG_H
+#define SPECTRALINDICESDLG_H
+
+#include "DimensionDescriptor.h"
+
+#include <QtGui/QDialog>
+
+#include <string>
+#include <vector>
+
+class QCheckBox;
+class QComboBox;
+class QDoubleSpinBox;
+class RasterDataDescriptor;
+
+/**
+ * Lets the user choose which spectral indices are calculated and which band
+ * is used for each wavelength range.
+ */
+class SpectralIndicesDlg : public QDialog
+{
+   Q_OBJECT
+
+public:
+   /**
+    *  Creates the dialog.
+    *
+    *  @param   pDataDescriptor
+    *           The descriptor of the raster element being processed.
+    *  @param   indexNames
+    *           The name of each index.
+    *  @param   bandLabels
+    *           The label of each wavelength range, e.g. "Red Band (0.63 - 0.69)".
+    *  @param   bandsNeeded
+    *           For each index, whether each wavelength range is used by it.
+    *  @param   bands
+    *           The initially selected band for each wavelength range. Invalid
+    *           descriptors leave the range without a selection.
+    *  @param   soilFactor
+    *           The initial SAVI soil factor.
+    *  @param   pParent
+    *           The parent widget.
+    */
+   SpectralIndicesDlg(const RasterDataDescriptor* pDataDescriptor, const std::vector<std::string>& indexNames,
+      const std::vector<std::string>& bandLabels, const std::vector<std::vector<bool> >& bandsNeeded,
+      const std::vector<DimensionDescriptor>& bands, double soilFactor, QWidget* pParent);
+   virtual ~SpectralIndicesDlg();
+
+   bool isIndexSelected(unsigned int index) const;
+
+   /**
+    *  Returns the band selected for a wavelength range.
+    *
+    *  @return  The active band number, or -1 if no band is selected.
+    */
+   int getBand(unsigned int band) const;
+
+   double getSoilFactor() const;
+   bool getDisplayResults() const;
+
+public slots:
+   virtual void accept();
+
+private:
+   std::vector<std::string> mIndexNames;
+   std::vector<std::string> mBandLabels;
+   std::vector<std::vector<bool> > mBandsNeeded;
+   std::vector<QCheckBox*> mIndexChecks;
+   std::vector<QComboBox*> mBandCombos;
+   QDoubleSpinBox* mpSoilFactor;
+   QCheckBox* mpDisplayResults;
+};
+
+#endif
@@ -9,26 +9,46 @@
 
 #include "AppConfig.h"
 #include "GaussianResampler.h"
+#include "ResamplingMatrix.h"
 
+#include <algorithm>
 #include <math.h>
 
-double GaussianResampler::resamplePoint(IndexPair indices, double toWavelength, double toFwhm)
+void GaussianResampler::addWeights(IndexPair indices, double toWavelength, double toFwhm,
+   ResamplingMatrix& matrix)
 {
+   // The source wavelengths are sorted, so the bands within the support are found with a binary search.
+   // The bracketing bands are always used so each target has at least one weight.
+   std::vector<double>::const_iterator first = mFromWavelengths.begin();
+   std::vector<double>::const_iterator last = mFromWavelengths.end();
+   if (mSupport > 0.0)
+   {
+      const double halfWidth = mSupport * toFwhm;
+      first = std::lower_bound(mFromWavelengths.begin(), mFromWavelengths.end(), toWavelength - halfWidth);
+      last = std::upper_bound(first, mFromWavelengths.end(), toWavelength + halfWidth);
+   }
+
+   unsigned int start = std::min(static_cast<unsigned int>(first - mFromWavelengths.begin()),
+      static_cast<unsigned int>(indices.mLeftIndex));
+   unsigned int stop = std::max(static_cast<unsigned int>(last - mFromWavelengths.begin()),
+      static_cast<unsigned int>(indices.mRightIndex + 1));
+
    unsigned int i;
-   double value = 0.0;
    double scale = 0.0;
    double sigma = toFwhm / (2.0*sqrt(2.0*log(2.0)));
+   std::vector<double> probabilities(stop - start);
    
-   for (i = 0; i < mFromData.size(); ++i)
+   for (i = start; i < stop; ++i)
    {
       double ratio = (toWavelength-mFromWavelengths[i])/sigma;
       double exponent = -ratio*ratio*0.5;
       double probability = 1.0 / (sigma * sqrt(2.0*PI)) * exp(exponent);
       scale += probability;
-      value += mFromData[i] * probability;
+      probabilities[i - start] = probability;
    }
 
-   value /= scale;
-
-   return value;
+   for (i = start; i < stop; ++i)
+   {
+      matrix.addWeight(i, probabilities[i - start] / scale);
+   }
 }
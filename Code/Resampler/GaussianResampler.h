@@ -15,10 +15,21 @@
 class GaussianResampler : public Interpolator
 {
 public:
-   GaussianResampler(const std::vector<double>& fromWavelengths, const std::vector<double>& fromData, double dropOutWindow) :
-      Interpolator(fromWavelengths, fromData, dropOutWindow) {}
+   /**
+    *  @param   support
+    *           Only source wavelengths within this many FWHMs of a target
+    *           wavelength contribute to it. Values less than or equal to
+    *           zero use every source wavelength. At 3 FWHM the omitted
+    *           weights are below exp(-24.9) of the peak weight, and resampled
+    *           values are within 1e-9 of the full support values for source
+    *           values from 0 to 1 (ResamplerImp::runTest17).
+    */
+   GaussianResampler(const std::vector<double>& fromWavelengths, double dropOutWindow, double support) :
+      Interpolator(fromWavelengths, dropOutWindow), mSupport(support) {}
 private:
-   double resamplePoint(IndexPair indices, double toWavelength, double toFwhm);
+   void addWeights(IndexPair indices, double toWavelength, double toFwhm, ResamplingMatrix& matrix);
+
+   const double mSupport;
 };
 
 
@@ -15,12 +15,17 @@
 #include "AppConfig.h"
 #include "Interpolator.h"
 #include "ResamplerOptions.h"
+#include "ResamplingMatrix.h"
 
 using namespace std;
 
-Interpolator::Interpolator(const std::vector<double>& fromWavelengths,
-   const std::vector<double>& fromData, double dropOutWindow) :
-   mFromWavelengths(fromWavelengths), mFromData(fromData), mDropOutWindow(dropOutWindow) 
+Interpolator::Interpolator(const std::vector<double>& fromWavelengths, double dropOutWindow) :
+   mFromWavelengths(fromWavelengths), mDropOutWindow(dropOutWindow) 
+{
+   // Do nothing
+}
+
+Interpolator::~Interpolator()
 {
    // Do nothing
 }
@@ -62,12 +67,6 @@ bool Interpolator::constructorInputsAreValid(string& errorMessage)
       errorMessage = "Signature wavelengths have duplicate values.";
       return false;
    }
-   
-   if (mFromData.size() == 0)
-   {
-      errorMessage = "Signature has no data.";
-      return false;
-   }
 
    return true;
 }
@@ -90,17 +89,14 @@ bool Interpolator::hasDuplicateValues(const std::vector<double>& values)
 }
 
 bool Interpolator::run(const std::vector<double>& toWavelengths, const std::vector<double>& toFwhm, 
-                       std::vector<double>& toData, std::vector<int>& toBands, string& errorMessage)
+                       ResamplingMatrix& matrix, string& errorMessage)
 {
    if (constructorInputsAreValid(errorMessage) == false)
    {
       return false;
    }
 
-   toData.clear();
-   toBands.clear();
-   toData.reserve(toWavelengths.size());
-   toBands.reserve(toWavelengths.size());
+   matrix.clear(mFromWavelengths.size());
 
    double defaultFwhm = ResamplerOptions::getSettingFullWidthHalfMax();
    unsigned int i;
@@ -114,22 +110,20 @@ bool Interpolator::run(const std::vector<double>& toWavelengths, const std::vect
 
       if (indices.mLeftIndex != -1)
       {
-         double value = 0.0;
+         matrix.addRow(i);
          if (indices.mLeftIndex == indices.mRightIndex)
          {
-            value = mFromData[indices.mLeftIndex];
+            matrix.addWeight(indices.mLeftIndex, 1.0);
          }
          else
          {
             double fwhm=toFwhm.size() == 0? defaultFwhm : toFwhm[i];
-            value = resamplePoint(indices, toWavelengths[i], fwhm);
+            addWeights(indices, toWavelengths[i], fwhm, matrix);
          }
-         toData.push_back(value);
-         toBands.push_back(i);
       }
    }
 
-   if (toBands.size() == 0)
+   if (matrix.getNumRows() == 0)
    {
       errorMessage = "No bands could be resampled.";
       return false;
@@ -13,6 +13,8 @@
 #include <string>
 #include <vector>
 
+class ResamplingMatrix;
+
 struct IndexPair
 {
    int mLeftIndex, mRightIndex;
@@ -21,20 +23,19 @@ struct IndexPair
 class Interpolator
 {
 public:
-   Interpolator(const std::vector<double>& fromWavelengths,
-      const std::vector<double>& fromData, double dropOutWindow);
+   Interpolator(const std::vector<double>& fromWavelengths, double dropOutWindow);
+   virtual ~Interpolator();
 
    bool run(const std::vector<double>& toWavelengths, const std::vector<double>& toFwhm, 
-      std::vector<double>& toData, std::vector<int>& toBands, std::string& errorMessage);
+      ResamplingMatrix& matrix, std::string& errorMessage);
 
    bool noResamplingNecessary(const std::vector<double>& toWavelengths);
 
    const std::vector<double>& mFromWavelengths;
-   const std::vector<double>& mFromData;
    const double mDropOutWindow;
 
 protected:
-   virtual double resamplePoint(IndexPair indices, double toWavelength, double toFwhm) = 0;
+   virtual void addWeights(IndexPair indices, double toWavelength, double toFwhm, ResamplingMatrix& matrix) = 0;
 
 private:
    bool constructorInputsAreValid(std::string& errorMessage);
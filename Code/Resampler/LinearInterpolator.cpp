@@ -8,18 +8,19 @@
  */
 
 #include "LinearInterpolator.h"
+#include "ResamplingMatrix.h"
 
-LinearInterpolator::LinearInterpolator(const std::vector<double>& fromWavelengths,
-   const std::vector<double>& fromData, double dropOutWindow) :
-   Interpolator(fromWavelengths, fromData, dropOutWindow)
+LinearInterpolator::LinearInterpolator(const std::vector<double>& fromWavelengths, double dropOutWindow) :
+   Interpolator(fromWavelengths, dropOutWindow)
 {
    // Do nothing
 }
 
-double LinearInterpolator::resamplePoint(IndexPair indices, double toWavelength, double toFwhm)
+void LinearInterpolator::addWeights(IndexPair indices, double toWavelength, double toFwhm,
+   ResamplingMatrix& matrix)
 {
-   return mFromData[indices.mLeftIndex] +
-      (toWavelength-mFromWavelengths[indices.mLeftIndex]) *
-      (mFromData[indices.mRightIndex]-mFromData[indices.mLeftIndex]) /
+   const double fraction = (toWavelength-mFromWavelengths[indices.mLeftIndex]) /
       (mFromWavelengths[indices.mRightIndex]-mFromWavelengths[indices.mLeftIndex]);
+   matrix.addWeight(indices.mLeftIndex, 1.0 - fraction);
+   matrix.addWeight(indices.mRightIndex, fraction);
 }
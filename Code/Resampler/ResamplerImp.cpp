@@ -13,14 +13,66 @@
 #include "Progress.h"
 #include "ResamplerImp.h"
 #include "ResamplerOptions.h"
+#include "ResamplingMatrix.h"
 #include "SpectralVersion.h"
 #include "SplineInterpolator.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+
+#include <algorithm>
+#include <list>
 #include <memory>
 
 using namespace std;
 
 REGISTER_PLUGIN_BASIC(SpectralResampler, ResamplerImp);
 
+namespace
+{
+   // Resampling weights only depend on the wavelengths and options, so the matrices built for the most
+   // recently used combinations are shared by every Resampler instance.
+   struct MatrixKey
+   {
+      vector<double> mFromWavelengths;
+      vector<double> mToWavelengths;
+      vector<double> mToFwhm;
+      string mMethod;
+      double mDropOutWindow;
+      double mDefaultFwhm;
+      double mGaussianSupport;
+
+      bool operator==(const MatrixKey& other) const
+      {
+         return mDropOutWindow == other.mDropOutWindow && mDefaultFwhm == other.mDefaultFwhm &&
+            mGaussianSupport == other.mGaussianSupport && mMethod == other.mMethod &&
+            mFromWavelengths == other.mFromWavelengths && mToWavelengths == other.mToWavelengths &&
+            mToFwhm == other.mToFwhm;
+      }
+   };
+
+   typedef list<pair<MatrixKey, ResamplingMatrix> > MatrixCache;
+
+   const MatrixCache::size_type sMaxCachedMatrices = 16;
+   MatrixCache sMatrixCache;
+   QMutex sMatrixCacheMutex;
+
+   // Must be called with sMatrixCacheMutex locked. The matrix is moved to the front of the cache.
+   const ResamplingMatrix* findCachedMatrix(const MatrixKey& key)
+   {
+      for (MatrixCache::iterator iter = sMatrixCache.begin(); iter != sMatrixCache.end(); ++iter)
+      {
+         if (iter->first == key)
+         {
+            sMatrixCache.splice(sMatrixCache.begin(), sMatrixCache, iter);
+            return &sMatrixCache.front().second;
+         }
+      }
+
+      return NULL;
+   }
+}
+
 ResamplerImp::ResamplerImp()
 {
    setCreator("Ball Aerospace & Technologies Corp.");
@@ -48,7 +100,7 @@ bool ResamplerImp::runOperationalTests(Progress* pProgress, ostream& failure)
 bool ResamplerImp::runAllTests(Progress* pProgress, ostream& failure) 
 {
    double percent = 0.0;
-   const int numTests = 16;
+   const int numTests = 17;
    const double step = 100.0 / numTests;
 
    if (runTest1(failure) == false)
@@ -221,6 +273,17 @@ bool ResamplerImp::runAllTests(Progress* pProgress, ostream& failure)
       return false;
    }
 
+   if (pProgress != NULL)
+   {
+      percent += step;
+      pProgress->updateProgress("Running Resampler Tests...", static_cast<int>(percent), NORMAL);
+   }
+
+   if (runTest17(failure) == false)
+   {
+      return false;
+   }
+
    if (pProgress != NULL)
    {
       pProgress->updateProgress("Resampler Tests Complete", percent, NORMAL);
@@ -1114,6 +1177,76 @@ bool ResamplerImp::runTest16(ostream& failure)
    return true;
 }
 
+bool ResamplerImp::runTest17(ostream& failure)
+{
+   // Gaussian resampling with the default support must match resampling with every source band
+   // to within the tolerance documented in GaussianResampler.h
+   const double support = 3.0;
+   const double tolerance = 1e-9;
+   unsigned int seed = 17;
+   const unsigned int numFromBands[] = { 50, 150, 250 };
+   for (unsigned int test = 0; test < sizeof(numFromBands) / sizeof(numFromBands[0]); ++test)
+   {
+      // irregularly spaced source bands from 0.4 to 2.5 microns with values from 0 to 1
+      vector<double> fromWavelengths;
+      vector<double> fromData;
+      const double spacing = 2.1 / numFromBands[test];
+      for (unsigned int band = 0; band < numFromBands[test]; ++band)
+      {
+         seed = seed * 1103515245 + 12345;
+         fromWavelengths.push_back(0.4 + spacing * (band + 0.5 * ((seed >> 16) & 0x7fff) / 32768.0));
+         seed = seed * 1103515245 + 12345;
+         fromData.push_back(((seed >> 16) & 0x7fff) / 32768.0);
+      }
+
+      // target bands whose FWHM ranges from less than to several times the source spacing
+      vector<double> toWavelengths;
+      vector<double> toFwhm;
+      for (unsigned int band = 0; band < 40; ++band)
+      {
+         toWavelengths.push_back(0.45 + band * 0.05);
+         toFwhm.push_back(spacing * (0.5 + 0.25 * (band % 20)));
+      }
+
+      ResamplingMatrix truncatedMatrix;
+      ResamplingMatrix fullMatrix;
+      string errorMessage;
+      if (createMatrix(fromWavelengths, toWavelengths, toFwhm, ResamplerOptions::GaussianMethod(), 1.0, support,
+            truncatedMatrix, errorMessage) == false ||
+         createMatrix(fromWavelengths, toWavelengths, toFwhm, ResamplerOptions::GaussianMethod(), 1.0, 0.0,
+            fullMatrix, errorMessage) == false)
+      {
+         failure << "ResamplerTestCase17 failed. Resampler reported \"" << errorMessage << "\".";
+         return false;
+      }
+
+      if (truncatedMatrix.getToBands() != fullMatrix.getToBands() ||
+         truncatedMatrix.getNumRows() != toWavelengths.size())
+      {
+         failure << "ResamplerTestCase17 failed. Truncated support changed the resampled bands.";
+         return false;
+      }
+
+      vector<double> truncatedData(truncatedMatrix.getNumRows());
+      vector<double> fullData(fullMatrix.getNumRows());
+      truncatedMatrix.apply(&fromData.front(), &truncatedData.front());
+      fullMatrix.apply(&fromData.front(), &fullData.front());
+      double maxDifference = 0.0;
+      for (unsigned int i = 0; i < fullData.size(); ++i)
+      {
+         maxDifference = max(maxDifference, fabs(truncatedData[i] - fullData[i]));
+      }
+      if (maxDifference > tolerance)
+      {
+         failure << "ResamplerTestCase17 failed. Truncated support differs from full support by " <<
+            maxDifference << " for " << numFromBands[test] << " source bands.";
+         return false;
+      }
+   }
+
+   return true;
+}
+
 bool ResamplerImp::runPositiveTest(const string& testName, ostream& failure, const vector<double>& expectedData,
    const vector<int>& expectedBands, const vector<double>& fromData, vector<double>& toData,
    const vector<double>& fromWavelengths, const vector<double>& toWavelengths, 
@@ -1207,99 +1340,100 @@ bool ResamplerImp::execute(const vector<double>& fromData,
    vector<double>& toData, const vector<double>& fromWavelengths, const vector<double>& toWavelengths, 
    const vector<double>& toFwhm, vector<int>& toBands, string& errorMessage, const string& resamplerMethod)
 {
-   vector<double> sortedFromWavelengths, sortedFromData, 
-      sortedToWavelengths, sortedToData, sortedToFwhm;
-   vector<int> sortedToBands;
-
-   if (sortInputData(fromWavelengths, fromData, toWavelengths, toFwhm,
-         sortedFromWavelengths, sortedFromData, sortedToWavelengths, 
-         sortedToFwhm, sortedToBands, errorMessage) == false)
+   if (fromData.size() != fromWavelengths.size())
    {
+      errorMessage = "Number of input data values differs from number of input wavelengths.";
       return false;
-   }
+   }   
 
-   auto_ptr<Interpolator> pInterpolator;
-   const double dropOutWindow = ResamplerOptions::getSettingDropOutWindow();
-   if (resamplerMethod == ResamplerOptions::LinearMethod())
+   QMutexLocker lock(&sMatrixCacheMutex);
+   const ResamplingMatrix* pMatrix = getCachedMatrix(fromWavelengths, toWavelengths, toFwhm, resamplerMethod,
+      errorMessage);
+   if (pMatrix == NULL)
    {
-      pInterpolator = auto_ptr<Interpolator>
-         (new LinearInterpolator(sortedFromWavelengths, sortedFromData, dropOutWindow));
-   }
-   else if (resamplerMethod == ResamplerOptions::CubicSplineMethod())
-   {
-      pInterpolator = auto_ptr<Interpolator>
-         (new SplineInterpolator(sortedFromWavelengths, sortedFromData,  dropOutWindow));
+      return false;
    }
-   else if (resamplerMethod == ResamplerOptions::GaussianMethod())
+
+   toData.resize(pMatrix->getNumRows());
+   toBands = pMatrix->getToBands();
+   if (toData.empty() == false)
    {
-      pInterpolator = auto_ptr<Interpolator>
-         (new GaussianResampler(sortedFromWavelengths, sortedFromData,  dropOutWindow));
+      pMatrix->apply(&fromData.front(), &toData.front());
    }
 
-   if (pInterpolator.get() == NULL)
+   return true;
+}
+
+bool ResamplerImp::getResamplingMatrix(const vector<double>& fromWavelengths, const vector<double>& toWavelengths,
+   const vector<double>& toFwhm, ResamplingMatrix& matrix, string& errorMessage)
+{
+   QMutexLocker lock(&sMatrixCacheMutex);
+   const ResamplingMatrix* pMatrix = getCachedMatrix(fromWavelengths, toWavelengths, toFwhm,
+      ResamplerOptions::getSettingResamplerMethod(), errorMessage);
+   if (pMatrix == NULL)
    {
-      errorMessage = "Unable to create interpolator for resampling.";
       return false;
    }
 
-   if (pInterpolator->noResamplingNecessary(toWavelengths))
-   {
-      copy(fromData.begin(), fromData.end(), back_inserter(toData));
-      for (unsigned int i = 0; i < fromData.size(); ++i)
+   matrix = *pMatrix;
+   return true;
+}
+
+const ResamplingMatrix* ResamplerImp::getCachedMatrix(const vector<double>& fromWavelengths,
+   const vector<double>& toWavelengths, const vector<double>& toFwhm, const string& resamplerMethod,
+   string& errorMessage)
+{
+   MatrixKey key;
+   key.mFromWavelengths = fromWavelengths;
+   key.mToWavelengths = toWavelengths;
+   key.mToFwhm = toFwhm;
+   key.mMethod = resamplerMethod;
+   key.mDropOutWindow = ResamplerOptions::getSettingDropOutWindow();
+   key.mDefaultFwhm = ResamplerOptions::getSettingFullWidthHalfMax();
+   key.mGaussianSupport = ResamplerOptions::getSettingGaussianSupport();
+
+   const ResamplingMatrix* pMatrix = findCachedMatrix(key);
+   if (pMatrix == NULL)
+   {
+      ResamplingMatrix matrix;
+      if (createMatrix(fromWavelengths, toWavelengths, toFwhm, resamplerMethod,
+         key.mDropOutWindow, key.mGaussianSupport, matrix, errorMessage) == false)
       {
-         toBands.push_back(i);
+         return NULL;
       }
-   }
-   else
-   {
-      if (pInterpolator->run(sortedToWavelengths, sortedToFwhm, toData, toBands, errorMessage) == false)
+
+      sMatrixCache.push_front(make_pair(key, matrix));
+      if (sMatrixCache.size() > sMaxCachedMatrices)
       {
-         return false;
+         sMatrixCache.pop_back();
       }
+      pMatrix = &sMatrixCache.front().second;
+   }
 
-      sortOutputData(sortedToBands, toBands, toData);
-   }      
-
-   return true;
+   return pMatrix;
 }
 
-bool ResamplerImp::sortInputData(const vector<double>& fromWavelengths, const vector<double>& fromData, 
-              const vector<double>& toWavelengths, const vector<double>& toFwhm,
-              vector<double>& sortedFromWavelengths, vector<double>& sortedFromData, 
-              vector<double>& sortedToWavelengths, vector<double>& sortedToFwhm,
-              vector<int>& sortedToBands, string& errorMessage)
+bool ResamplerImp::createMatrix(const vector<double>& fromWavelengths, const vector<double>& toWavelengths,
+   const vector<double>& toFwhm, const string& resamplerMethod, double dropOutWindow,
+   double gaussianSupport, ResamplingMatrix& matrix, string& errorMessage)
 {
-   if (fromData.size() != fromWavelengths.size())
-   {
-      errorMessage = "Number of input data values differs from number of input wavelengths.";
-      return false;
-   }   
-   
-   // for efficiency, reserve space for results
-   sortedFromWavelengths.reserve(fromWavelengths.size());
-   sortedFromData.reserve(fromData.size());
-   sortedToWavelengths.reserve(toWavelengths.size());
-   sortedToFwhm.reserve(toFwhm.size());
-   sortedToBands.reserve(toWavelengths.size());
-
-   // construct vector of wavelength/data pairs
-   typedef vector<pair<double,double> > VecPair;
-   VecPair fromPairs;
+   // sort the source and target wavelengths, remembering their original indices
+   vector<pair<double, int> > fromPairs;
    fromPairs.reserve(fromWavelengths.size());
    for (int i=0; i<(int)fromWavelengths.size(); ++i)
    {
-      pair<double,double> temp; 
-      temp.first = fromWavelengths[i];
-      temp.second = fromData[i];
-      fromPairs.push_back(temp);
+      fromPairs.push_back(make_pair(fromWavelengths[i], i));
    }
    sort(fromPairs.begin(), fromPairs.end());
 
-   // extract the wavelengths and data from the sorted pairs
-   for (VecPair::const_iterator iter=fromPairs.begin(); iter!=fromPairs.end(); ++iter)
+   vector<double> sortedFromWavelengths;
+   vector<int> sortedFromIndices;
+   sortedFromWavelengths.reserve(fromPairs.size());
+   sortedFromIndices.reserve(fromPairs.size());
+   for (vector<pair<double, int> >::const_iterator iter=fromPairs.begin(); iter!=fromPairs.end(); ++iter)
    {
       sortedFromWavelengths.push_back(iter->first);
-      sortedFromData.push_back(iter->second);
+      sortedFromIndices.push_back(iter->second);
    }
 
    typedef vector<Triplet> VecTrip;
@@ -1315,7 +1449,11 @@ bool ResamplerImp::sortInputData(const vector<double>& fromWavelengths, const ve
    }
    sort(toTriplets.begin(), toTriplets.end());
 
-   // extract the wavelengths, fwhm and indices from the sorted triplets
+   vector<double> sortedToWavelengths, sortedToFwhm;
+   vector<int> sortedToBands;
+   sortedToWavelengths.reserve(toTriplets.size());
+   sortedToFwhm.reserve(toFwhm.size());
+   sortedToBands.reserve(toTriplets.size());
    for (VecTrip::const_iterator iter=toTriplets.begin(); iter != toTriplets.end(); ++iter)
    {
       sortedToWavelengths.push_back(iter->mWavelength);
@@ -1323,32 +1461,46 @@ bool ResamplerImp::sortInputData(const vector<double>& fromWavelengths, const ve
       sortedToBands.push_back(iter->mBand);
    }
 
-   return true;
-}
-
-void ResamplerImp::sortOutputData(const vector<int>& sortedToBands,
-   vector<int>& toBands, vector<double>& toData)
-{
-   vector<int> sortedOriginalBands;
-   sortedOriginalBands.reserve(toData.size());
-
-   typedef vector<pair<int,double> > VecPair;
-   VecPair pairs;
-   pairs.reserve(toData.size());
-
-   for (unsigned int i=0; i<toBands.size(); ++i)
+   auto_ptr<Interpolator> pInterpolator;
+   if (resamplerMethod == ResamplerOptions::LinearMethod())
    {
-      pair<int,double> temp;
-      temp.first = sortedToBands[toBands[i]];
-      temp.second = toData.at(i);
-      pairs.push_back(temp);
+      pInterpolator = auto_ptr<Interpolator>(new LinearInterpolator(sortedFromWavelengths, dropOutWindow));
+   }
+   else if (resamplerMethod == ResamplerOptions::CubicSplineMethod())
+   {
+      pInterpolator = auto_ptr<Interpolator>(new SplineInterpolator(sortedFromWavelengths, dropOutWindow));
+   }
+   else if (resamplerMethod == ResamplerOptions::GaussianMethod())
+   {
+      pInterpolator = auto_ptr<Interpolator>(new GaussianResampler(sortedFromWavelengths, dropOutWindow,
+         gaussianSupport));
    }
 
-   sort(pairs.begin(), pairs.end());
+   if (pInterpolator.get() == NULL)
+   {
+      errorMessage = "Unable to create interpolator for resampling.";
+      return false;
+   }
 
-   for (unsigned int j=0; j<toData.size(); ++j)
+   if (pInterpolator->noResamplingNecessary(toWavelengths))
    {
-      toBands[j] = pairs[j].first;
-      toData[j] = pairs[j].second;
+      // the data is used as is, in its original order
+      matrix.clear(fromWavelengths.size());
+      for (unsigned int i = 0; i < fromWavelengths.size(); ++i)
+      {
+         matrix.addRow(i);
+         matrix.addWeight(i, 1.0);
+      }
    }
+   else
+   {
+      if (pInterpolator->run(sortedToWavelengths, sortedToFwhm, matrix, errorMessage) == false)
+      {
+         return false;
+      }
+
+      matrix.reorder(sortedFromIndices, sortedToBands);
+   }
+
+   return true;
 }
@@ -14,6 +14,8 @@
 #include "PlugInShell.h"
 #include "Testable.h"
 
+class ResamplingMatrix;
+
 class ResamplerImp : public PlugInShell, public Resampler, public Testable
 {
 public:
@@ -29,6 +31,20 @@ public:
       const std::vector<double>& toFwhm, std::vector<int>& toBands, std::string& errorMessage,
       const std::string& resamplerMethod);
 
+   /**
+    *  Gets the weights used to resample between two sets of wavelengths.
+    *
+    *  The method, drop out window and default FWHM are taken from the
+    *  current Resampler settings. The matrix is shared with execute(), so
+    *  resampling many spectra with the same wavelengths only builds it once.
+    *
+    *  @return  \c true if the matrix was obtained, \c false otherwise, in
+    *           which case \em errorMessage describes the problem.
+    */
+   static bool getResamplingMatrix(const std::vector<double>& fromWavelengths,
+      const std::vector<double>& toWavelengths, const std::vector<double>& toFwhm, ResamplingMatrix& matrix,
+      std::string& errorMessage);
+
    bool runOperationalTests(Progress* pProgress, std::ostream& failure) ;
    bool runAllTests(Progress* pProgress, std::ostream& failure) ;
 
@@ -49,6 +65,7 @@ private:
    bool runTest14(std::ostream& failure);
    bool runTest15(std::ostream& failure);
    bool runTest16(std::ostream& failure);
+   bool runTest17(std::ostream& failure);
 
    bool runPositiveTest(const std::string& testName, std::ostream& failure, const std::vector<double>& expectedData,
       const std::vector<int>& expectedBands, const std::vector<double>& fromData, std::vector<double>& toData,
@@ -62,13 +79,14 @@ private:
       const std::vector<double>& toFwhm, std::vector<int>& toBands, std::string& errorMessage,
       const std::string& resamplerMethod);
 
-   bool sortInputData(const std::vector<double>& fromWavelengths, const std::vector<double>& fromData, 
-                 const std::vector<double>& toWavelengths, const std::vector<double>& toFwhm,
-                 std::vector<double>& sortedFromWavelengths, std::vector<double>& sortedFromData, 
-                 std::vector<double>& sortedToWavelengths, std::vector<double>& sortedToFwhm,
-                 std::vector<int>& sortedToBands, std::string& errorMessage);
+   // returns the cached matrix, creating it if necessary; the matrix cache must be locked by the caller
+   static const ResamplingMatrix* getCachedMatrix(const std::vector<double>& fromWavelengths,
+      const std::vector<double>& toWavelengths, const std::vector<double>& toFwhm,
+      const std::string& resamplerMethod, std::string& errorMessage);
 
-   void sortOutputData(const std::vector<int>& sortedToBands, std::vector<int>& toBands, std::vector<double>& toData);
+   static bool createMatrix(const std::vector<double>& fromWavelengths, const std::vector<double>& toWavelengths,
+      const std::vector<double>& toFwhm, const std::string& resamplerMethod, double dropOutWindow,
+      double gaussianSupport, ResamplingMatrix& matrix, std::string& errorMessage);
 
    // construct vector of wavelength/fwhm/index triplets
    struct Triplet
@@ -46,6 +46,14 @@ ResamplerOptions::ResamplerOptions()
    mpFullWidthHalfMax->setDecimals(6);
    mpFullWidthHalfMax->setSuffix(" m");
 
+   QLabel* pGaussianSupport = new QLabel("Gaussian Support:");
+   mpGaussianSupport = new QDoubleSpinBox;
+   mpGaussianSupport->setToolTip("Only source bands within this many FWHMs of a target wavelength are used\n"
+      "by the Gaussian method. A value of 0 uses every source band.");
+   mpGaussianSupport->setRange(0.0, 100.0);
+   mpGaussianSupport->setDecimals(2);
+   mpGaussianSupport->setSuffix(" FWHM");
+
    mpUseFillValue = new QCheckBox("Use fill value:");
    mpUseFillValue->setToolTip("Check to ensure the resampled signatures have a value for every wavelength\ncenter. "
       "If an input signature does not have spectral coverage for one of the\ntarget wavelengths, the fill value "
@@ -64,9 +72,11 @@ ResamplerOptions::ResamplerOptions()
    pGridLayout->addWidget(mpDropOutWindow, 1, 2);
    pGridLayout->addWidget(pFullWidthHalfMax, 2, 0);
    pGridLayout->addWidget(mpFullWidthHalfMax, 2, 2);
-   pGridLayout->addWidget(mpUseFillValue, 3, 0);
-   pGridLayout->addWidget(mpFillValue, 3, 2);
-   pGridLayout->setRowStretch(4, 10);
+   pGridLayout->addWidget(pGaussianSupport, 3, 0);
+   pGridLayout->addWidget(mpGaussianSupport, 3, 2);
+   pGridLayout->addWidget(mpUseFillValue, 4, 0);
+   pGridLayout->addWidget(mpFillValue, 4, 2);
+   pGridLayout->setRowStretch(5, 10);
    pGridLayout->setColumnStretch(3, 10);
 
    LabeledSection* pSection = new LabeledSection(pLayoutWidget, "Resampler Options", this);
@@ -78,6 +88,7 @@ ResamplerOptions::ResamplerOptions()
    VERIFYNRV(connect(mpUseFillValue, SIGNAL(toggled(bool)), mpFillValue, SLOT(setEnabled(bool))));
    mpDropOutWindow->setValue(ResamplerOptions::getSettingDropOutWindow());
    mpFullWidthHalfMax->setValue(ResamplerOptions::getSettingFullWidthHalfMax());
+   mpGaussianSupport->setValue(ResamplerOptions::getSettingGaussianSupport());
    mpUseFillValue->setChecked(ResamplerOptions::getSettingUseFillValue());
    mpFillValue->setValue(ResamplerOptions::getSettingSignatureFillValue());
 
@@ -106,6 +117,7 @@ void ResamplerOptions::applyChanges()
    ResamplerOptions::setSettingResamplerMethod(mpMethod->currentText().toStdString());
    ResamplerOptions::setSettingDropOutWindow(mpDropOutWindow->value());
    ResamplerOptions::setSettingFullWidthHalfMax(mpFullWidthHalfMax->value());
+   ResamplerOptions::setSettingGaussianSupport(mpGaussianSupport->value());
    ResamplerOptions::setSettingUseFillValue(mpUseFillValue->isChecked());
    ResamplerOptions::setSettingSignatureFillValue(mpFillValue->value());
 }
@@ -113,4 +125,5 @@ void ResamplerOptions::applyChanges()
 void ResamplerOptions::currentIndexChanged(int newIndex)
 {
    mpFullWidthHalfMax->setEnabled(mpMethod->currentText().toStdString() == GaussianMethod());
+   mpGaussianSupport->setEnabled(mpMethod->currentText().toStdString() == GaussianMethod());
 }
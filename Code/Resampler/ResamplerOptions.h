@@ -33,6 +33,7 @@ public:
    SETTING(ResamplerMethod, Resampler, std::string, LinearMethod());
    SETTING(DropOutWindow, Resampler, double, 0.05);
    SETTING(FullWidthHalfMax, Resampler, double, 0.01);
+   SETTING(GaussianSupport, Resampler, double, 3.0);
    SETTING(UseFillValue, Resampler, bool,false);
    SETTING(SignatureFillValue, Resampler, double, -10.0);
 
@@ -98,6 +99,7 @@ private:
    QComboBox* mpMethod;
    QDoubleSpinBox* mpDropOutWindow;
    QDoubleSpinBox* mpFullWidthHalfMax;
+   QDoubleSpinBox* mpGaussianSupport;
    QCheckBox* mpUseFillValue;
    QDoubleSpinBox* mpFillValue;
 };
@@ -9,44 +9,197 @@
 
 #include "AppVerify.h"
 #include "CommonSignatureMetadataKeys.h"
+#include "DataAccessor.h"
+#include "DataAccessorImpl.h"
+#include "DataRequest.h"
 #include "DataVariant.h"
 #include "DesktopServices.h"
 #include "Filename.h"
 #include "LayerList.h"
+#include "ModelServices.h"
 #include "ObjectResource.h"
 #include "PlugInArgList.h"
 #include "PlugInManagerServices.h"
 #include "PlugInRegistration.h"
 #include "PlugInResource.h"
 #include "ProgressTracker.h"
+#include "RasterDataDescriptor.h"
 #include "RasterElement.h"
+#include "RasterUtilities.h"
 #include "Resampler.h"
+#include "ResamplerImp.h"
 #include "ResamplerOptions.h"
 #include "ResamplerPlugIn.h"
 #include "ResamplerPlugInDlg.h"
+#include "ResamplingMatrix.h"
 #include "Signature.h"
 #include "SignatureDataDescriptor.h"
 #include "SignatureSet.h"
 #include "SpatialDataView.h"
 #include "SpectralVersion.h"
 #include "StringUtilities.h"
+#include "switchOnEncoding.h"
 #include "Units.h"
 #include "Wavelengths.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 #include <QtCore/QFile>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentMap>
 
 REGISTER_PLUGIN_BASIC(SpectralResampler, ResamplerPlugIn);
 
+namespace
+{
+   // number of rows resampled by each task when resampling a raster element
+   const unsigned int sRowsPerTask = 16;
+
+   template<typename T>
+   void convertToDouble(T* pData, double* pValues, unsigned int numValues)
+   {
+      for (unsigned int index = 0; index < numValues; ++index)
+      {
+         pValues[index] = static_cast<double>(pData[index]);
+      }
+   }
+
+   /**
+    *  Resamples every pixel in a block of rows by applying the resampling matrix to the BIP rows.
+    *  The resampled pixels are written to the in-memory BIP result. Resampled values which use a
+    *  bad source value are set to the output bad value.
+    */
+   struct RasterResampleMap
+   {
+      typedef std::pair<unsigned int, unsigned int> input_type;
+      typedef unsigned int result_type;
+
+      RasterResampleMap(RasterElement* pRaster, const ResamplingMatrix& matrix,
+         const std::vector<unsigned int>& outputBands, unsigned int numOutputBands, float fillValue,
+         float outputBadValue, float* pResults) :
+         mpRaster(pRaster),
+         mpDescriptor(NULL),
+         mMatrix(matrix),
+         mOutputBands(outputBands),
+         mNumOutputBands(numOutputBands),
+         mFillValue(fillValue),
+         mOutputBadValue(outputBadValue),
+         mpResults(pResults)
+      {
+         VERIFYNRV(mpRaster != NULL);
+         mpDescriptor = dynamic_cast<const RasterDataDescriptor*>(mpRaster->getDataDescriptor());
+         if (mpDescriptor != NULL)
+         {
+            const std::vector<int>& badValues = mpDescriptor->getBadValues();
+            mBadValues.assign(badValues.begin(), badValues.end());
+            std::sort(mBadValues.begin(), mBadValues.end());
+         }
+      }
+
+      result_type operator()(const input_type& rows) const
+      {
+         VERIFYRV(mpDescriptor != NULL && mpResults != NULL, 0);
+         const unsigned int numColumns = mpDescriptor->getColumnCount();
+         const unsigned int numBands = mpDescriptor->getBandCount();
+         const unsigned int numResampled = mMatrix.getNumRows();
+         std::vector<double> fromData(numColumns * numBands);
+         std::vector<double> toData(numColumns * numResampled);
+         std::vector<char> badSources(numBands);
+         std::vector<char> badRows;
+
+         FactoryResource<DataRequest> pRequest;
+         pRequest->setInterleaveFormat(BIP);
+         pRequest->setRows(mpDescriptor->getActiveRow(rows.first), mpDescriptor->getActiveRow(rows.second - 1));
+         DataAccessor accessor = mpRaster->getDataAccessor(pRequest.release());
+         for (unsigned int row = rows.first; row < rows.second; ++row)
+         {
+            VERIFYRV(accessor.isValid(), 0);
+            switchOnEncoding(mpDescriptor->getDataType(), convertToDouble, accessor->getRow(),
+               &fromData.front(), numColumns * numBands);
+            accessor->nextRow();
+
+            mMatrix.apply(&fromData.front(), &toData.front(), numColumns);
+
+            float* pResults = mpResults + static_cast<size_t>(row) * numColumns * mNumOutputBands;
+            std::fill(pResults, pResults + numColumns * mNumOutputBands, mFillValue);
+            for (unsigned int column = 0; column < numColumns; ++column)
+            {
+               const double* pResampled = &toData[column * numResampled];
+               for (unsigned int band = 0; band < numResampled; ++band)
+               {
+                  pResults[mOutputBands[band]] = static_cast<float>(pResampled[band]);
+               }
+
+               if (findBadSources(&fromData[column * numBands], badSources))
+               {
+                  mMatrix.findRowsUsing(badSources, badRows);
+                  for (unsigned int band = 0; band < numResampled; ++band)
+                  {
+                     if (badRows[band] != 0)
+                     {
+                        pResults[mOutputBands[band]] = mOutputBadValue;
+                     }
+                  }
+               }
+               pResults += mNumOutputBands;
+            }
+         }
+
+         return rows.second - rows.first;
+      }
+
+      // flags the values of a pixel which are source bad values
+      bool findBadSources(const double* pValues, std::vector<char>& badSources) const
+      {
+         if (mBadValues.empty())
+         {
+            return false;
+         }
+
+         bool found = false;
+         for (std::vector<char>::size_type band = 0; band < badSources.size(); ++band)
+         {
+            badSources[band] = std::binary_search(mBadValues.begin(), mBadValues.end(), pValues[band]) ? 1 : 0;
+            found = found || badSources[band] != 0;
+         }
+         return found;
+      }
+
+      RasterElement* mpRaster;
+      const RasterDataDescriptor* mpDescriptor;
+      const ResamplingMatrix& mMatrix;
+      const std::vector<unsigned int>& mOutputBands;
+      unsigned int mNumOutputBands;
+      float mFillValue;
+      float mOutputBadValue;
+      std::vector<double> mBadValues;
+      float* mpResults;
+   };
+
+   void destroySignatures(const std::vector<Signature*>& signatures)
+   {
+      Service<ModelServices> pModel;
+      for (std::vector<Signature*>::const_iterator iter = signatures.begin(); iter != signatures.end(); ++iter)
+      {
+         pModel->destroyElement(*iter);
+      }
+   }
+
+   void rowCountReduce(unsigned int& total, const unsigned int& rows)
+   {
+      total += rows;
+   }
+}
+
 ResamplerPlugIn::ResamplerPlugIn()
 {
    setName("Spectral Resampler");
    setDescriptorId("{D20D4C10-B9B8-4ADB-85FA-105446430966}");
    setSubtype("Algorithm");
    setShortDescription("Run Spectral Resampler");
-   setDescription("Resample spectral signatures to a set of wavelengths.");
+   setDescription("Resample spectral signatures or the spectral axis of a raster element to a set of wavelengths.");
    setMenuLocation("[Spectral]/Support Tools/Spectral Resampler");
    setAbortSupported(true);
    setCopyright(SPECTRAL_COPYRIGHT);
@@ -75,6 +228,9 @@ bool ResamplerPlugIn::getInputSpecification(PlugInArgList*& pArgList)
          "The signatures to be resampled"));
       VERIFY(pArgList->addArg<Signature>("Signature to resample", NULL,
          "The signature to be resampled. If arg \"Signatures to resample\" is provided, this arg will be ignored."));
+      VERIFY(pArgList->addArg<RasterElement>("Raster to resample", NULL,
+         "The raster element whose spectral axis will be resampled. The resampled raster element is created in\n"
+         "memory with one band for each target wavelength that could be resampled."));
       VERIFY(pArgList->addArg<DataElement>("Data element wavelength source", NULL,
          "The signatures will be resampled to the wavelengths from this data element."));
       VERIFY(pArgList->addArg<Filename>("Wavelengths Filename", NULL,
@@ -108,6 +264,8 @@ bool ResamplerPlugIn::getOutputSpecification(PlugInArgList*& pArgList)
    VERIFY(pArgList != NULL);
    VERIFY(pArgList->addArg<std::vector<Signature*> >("Resampled signatures", NULL,
       "The resampled signatures"));
+   VERIFY(pArgList->addArg<RasterElement>("Resampled raster", NULL,
+      "The resampled raster element if arg \"Raster to resample\" was provided."));
 
    return true;
 }
@@ -131,6 +289,7 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
    double fillValue = ResamplerOptions::getSettingSignatureFillValue();
 
    std::vector<Signature*> originalSignatures;
+   RasterElement* pRaster(NULL);
    std::auto_ptr<std::vector<Signature*> > pResampledSignatures(new std::vector<Signature*>);
    std::string errorMsg;
 
@@ -145,7 +304,8 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
             originalSignatures.push_back(pSignature);
          }
       }
-      if (originalSignatures.empty())
+      pRaster = pInArgList->getPlugInArgValue<RasterElement>("Raster to resample");
+      if (originalSignatures.empty() && pRaster == NULL)
       {
          progress.report("No signatures are available to be resampled.", 0, ERRORS, true);
          return false;
@@ -258,11 +418,16 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
 
    unsigned int numSigs = originalSignatures.size();
    unsigned int numSigsResampled(0);
+   std::vector<Signature*> createdSignatures;
    progress.report("Begin resampling signatures...", 0, NORMAL);
    for (unsigned int index = 0; index < numSigs; ++index)
    {
       if (isAborted())
       {
+         ResamplerOptions::setSettingResamplerMethod(configMethod);
+         ResamplerOptions::setSettingDropOutWindow(configDropout);
+         ResamplerOptions::setSettingFullWidthHalfMax(configFwhm);
+         destroySignatures(createdSignatures);
          progress.report("Resampling aborted by user", 100 * index / numSigs, ABORT, true);
          return false;
       }
@@ -360,6 +525,7 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
             continue;
          }
          pDesc->setUnits(dataName, originalSignatures[index]->getUnits(dataName));
+         createdSignatures.push_back(pSignature.get());
          pResampledSignatures->push_back(pSignature.release());
          ++numSigsResampled;
       }
@@ -368,11 +534,25 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
       progress.report(progressStr, (index + 1) * 100 / numSigs, NORMAL);
    }
 
+   RasterElement* pResampledRaster(NULL);
+   if (pRaster != NULL)
+   {
+      pResampledRaster = resampleRaster(pRaster, pWavelengths.get(), useFillValue, fillValue, progress, errorMsg);
+   }
+
    // reset config options
    ResamplerOptions::setSettingResamplerMethod(configMethod);
    ResamplerOptions::setSettingDropOutWindow(configDropout);
    ResamplerOptions::setSettingFullWidthHalfMax(configFwhm);
 
+   if (pRaster != NULL && pResampledRaster == NULL)
+   {
+      // the resampled signatures are only kept if everything was resampled
+      destroySignatures(createdSignatures);
+      progress.report(errorMsg, 0, ERRORS, true);
+      return false;
+   }
+
    if (numSigsResampled == numSigs)
    {
       progress.report("Complete", 100, NORMAL);
@@ -386,6 +566,7 @@ bool ResamplerPlugIn::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgL
    }
 
    VERIFY(pOutArgList->setPlugInArgValue("Resampled signatures", pResampledSignatures.release()));
+   VERIFY(pOutArgList->setPlugInArgValue("Resampled raster", pResampledRaster));
    return true;
 }
 
@@ -564,4 +745,170 @@ bool ResamplerPlugIn::needToResample(const Signature* pSig, const Wavelengths* p
       }
    }
    return false;
-}
\ No newline at end of file
+}
+
+RasterElement* ResamplerPlugIn::resampleRaster(RasterElement* pRaster, const Wavelengths* pWavelengths,
+   bool useFillValue, double fillValue, ProgressTracker& progress, std::string& errorMsg)
+{
+   VERIFYRV(pRaster != NULL && pWavelengths != NULL, NULL);
+   const RasterDataDescriptor* pDesc = dynamic_cast<const RasterDataDescriptor*>(pRaster->getDataDescriptor());
+   VERIFYRV(pDesc != NULL, NULL);
+
+   FactoryResource<Wavelengths> pFromWavelengths;
+   pFromWavelengths->initializeFromDynamicObject(pRaster->getMetadata(), false);
+   const std::vector<double>& fromWavelengths = pFromWavelengths->getCenterValues();
+   if (fromWavelengths.size() != pDesc->getBandCount())
+   {
+      errorMsg = "Raster element \"" + pRaster->getDisplayName(true) +
+         "\" does not have a center wavelength for every band.";
+      return NULL;
+   }
+
+   const std::vector<double>& toWavelengths = pWavelengths->getCenterValues();
+   std::vector<double> toFwhm = pWavelengths->getFwhm();
+   if (toFwhm.size() != toWavelengths.size())
+   {
+      toFwhm.clear();  // Resampler will use the default config setting fwhm if this vector is empty
+   }
+   if (toWavelengths.empty())
+   {
+      errorMsg = "No target wavelengths are available for resampling the raster element.";
+      return NULL;
+   }
+
+   // The same weights are applied to every pixel, so they are computed once
+   ResamplingMatrix matrix;
+   if (ResamplerImp::getResamplingMatrix(fromWavelengths, toWavelengths, toFwhm, matrix, errorMsg) == false)
+   {
+      return NULL;
+   }
+
+   // Determine the output band for each resampled wavelength
+   const std::vector<int>& toBands = matrix.getToBands();
+   std::vector<unsigned int> outputBands(toBands.size());
+   std::vector<double> outputWavelengths;
+   std::vector<double> outputFwhm;
+   for (unsigned int i = 0; i < toBands.size(); ++i)
+   {
+      outputBands[i] = useFillValue ? static_cast<unsigned int>(toBands[i]) : i;
+   }
+   if (useFillValue)
+   {
+      outputWavelengths = toWavelengths;
+      outputFwhm = toFwhm;
+   }
+   else
+   {
+      for (std::vector<int>::const_iterator iter = toBands.begin(); iter != toBands.end(); ++iter)
+      {
+         outputWavelengths.push_back(toWavelengths[*iter]);
+         if (toFwhm.empty() == false)
+         {
+            outputFwhm.push_back(toFwhm[*iter]);
+         }
+      }
+   }
+
+   const unsigned int numRows = pDesc->getRowCount();
+   const unsigned int numColumns = pDesc->getColumnCount();
+   const unsigned int numOutputBands = static_cast<unsigned int>(outputWavelengths.size());
+   std::string resampledName = pRaster->getName() + "_resampled";
+   ModelResource<RasterElement> pResampled(RasterUtilities::createRasterElement(resampledName, numRows,
+      numColumns, numOutputBands, FLT4BYTES, BIP, true, NULL));
+
+   // probably not needed but just in case resampled name already used
+   for (int suffix = 2; pResampled.get() == NULL && suffix < 100; ++suffix)
+   {
+      pResampled = ModelResource<RasterElement>(RasterUtilities::createRasterElement(
+         resampledName + StringUtilities::toDisplayString(suffix), numRows, numColumns, numOutputBands,
+         FLT4BYTES, BIP, true, NULL));
+   }
+   if (pResampled.get() == NULL || pResampled->getRawData() == NULL)
+   {
+      errorMsg = "Unable to create the resampled raster element.";
+      return NULL;
+   }
+
+   FactoryResource<Wavelengths> pOutputWavelengths;
+   pOutputWavelengths->setCenterValues(outputWavelengths, MICRONS);
+   if (outputFwhm.size() == outputWavelengths.size())
+   {
+      pOutputWavelengths->setFwhm(outputFwhm);
+   }
+   pOutputWavelengths->applyToDynamicObject(pResampled->getMetadata());
+
+   std::vector<std::pair<unsigned int, unsigned int> > rowBlocks;
+   for (unsigned int row = 0; row < numRows; row += sRowsPerTask)
+   {
+      rowBlocks.push_back(std::make_pair(row, std::min(row + sRowsPerTask, numRows)));
+   }
+
+   // resampled values which use a bad source value are set to the first source bad value
+   const std::vector<int>& badValues = pDesc->getBadValues();
+   float outputBadValue = 0.0f;
+   if (badValues.empty() == false)
+   {
+      outputBadValue = static_cast<float>(badValues.front());
+      RasterDataDescriptor* pResampledDesc = dynamic_cast<RasterDataDescriptor*>(pResampled->getDataDescriptor());
+      VERIFYRV(pResampledDesc != NULL, NULL);
+      pResampledDesc->setBadValues(std::vector<int>(1, badValues.front()));
+   }
+
+   RasterResampleMap resampleMap(pRaster, matrix, outputBands, numOutputBands, static_cast<float>(fillValue),
+      outputBadValue, reinterpret_cast<float*>(pResampled->getRawData()));
+   unsigned int rowsResampled = 0;
+#ifndef QT_NO_CONCURRENT
+   QFuture<unsigned int> future = QtConcurrent::mappedReduced(rowBlocks.begin(), rowBlocks.end(), resampleMap,
+      rowCountReduce, QtConcurrent::UnorderedReduce);
+   bool isCancelling = false;
+   while (future.isRunning())
+   {
+      if (isCancelling)
+      {
+         progress.report("Cleaning up processing threads. Please wait.", 99, NORMAL);
+      }
+      else
+      {
+         const int progressRange = future.progressMaximum() - future.progressMinimum();
+         if (progressRange > 0)
+         {
+            progress.report("Resampling raster element",
+               100 * (future.progressValue() - future.progressMinimum()) / progressRange, NORMAL);
+         }
+         if (isAborted())
+         {
+            future.cancel();
+            isCancelling = true;
+         }
+      }
+      QThread::yieldCurrentThread();
+   }
+   if (future.isCanceled())
+   {
+      errorMsg = "Resampling aborted by user";
+      return NULL;
+   }
+   rowsResampled = future.result();
+#else
+   for (std::vector<std::pair<unsigned int, unsigned int> >::const_iterator iter = rowBlocks.begin();
+      iter != rowBlocks.end(); ++iter)
+   {
+      if (isAborted())
+      {
+         errorMsg = "Resampling aborted by user";
+         return NULL;
+      }
+      rowCountReduce(rowsResampled, resampleMap(*iter));
+      progress.report("Resampling raster element", 100 * iter->second / numRows, NORMAL);
+   }
+#endif
+
+   if (rowsResampled != numRows)
+   {
+      errorMsg = "Unable to resample every row of the raster element.";
+      return NULL;
+   }
+
+   pResampled->updateData();
+   return pResampled.release();
+}
@@ -15,6 +15,8 @@
 #include <string>
 
 class PlugInArgList;
+class ProgressTracker;
+class RasterElement;
 class Signature;
 class Wavelengths;
 
@@ -32,6 +34,8 @@ protected:
    bool getWavelengthsFromElement(const DataElement* pElement, Wavelengths* pWavelengths, std::string& errorMsg);
    bool getWavelengthsFromFile(const std::string& filename, Wavelengths* pWavelengths, std::string& errorMsg);
    bool needToResample(const Signature* pSig, const Wavelengths* pWavelengths);
+   RasterElement* resampleRaster(RasterElement* pRaster, const Wavelengths* pWavelengths, bool useFillValue,
+      double fillValue, ProgressTracker& progress, std::string& errorMsg);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "ResamplingMatrix.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+ResamplingMatrix::ResamplingMatrix() :
+   mNumSources(0),
+   mRowStarts(1, 0)
+{
+   // Do nothing
+}
+
+void ResamplingMatrix::clear(unsigned int numSources)
+{
+   mNumSources = numSources;
+   mToBands.clear();
+   mRowStarts.assign(1, 0);
+   mSources.clear();
+   mWeights.clear();
+}
+
+void ResamplingMatrix::addRow(int toBand)
+{
+   mToBands.push_back(toBand);
+   mRowStarts.push_back(static_cast<unsigned int>(mWeights.size()));
+}
+
+void ResamplingMatrix::addWeight(int source, double weight)
+{
+   mSources.push_back(source);
+   mWeights.push_back(weight);
+   ++mRowStarts.back();
+}
+
+void ResamplingMatrix::reorder(const vector<int>& sources, const vector<int>& toBands)
+{
+   vector<pair<int, unsigned int> > rows;
+   rows.reserve(mToBands.size());
+   for (unsigned int row = 0; row < mToBands.size(); ++row)
+   {
+      rows.push_back(make_pair(toBands[mToBands[row]], row));
+   }
+   sort(rows.begin(), rows.end());
+
+   ResamplingMatrix reordered;
+   reordered.clear(mNumSources);
+   for (vector<pair<int, unsigned int> >::const_iterator iter = rows.begin(); iter != rows.end(); ++iter)
+   {
+      reordered.addRow(iter->first);
+      for (unsigned int index = mRowStarts[iter->second]; index < mRowStarts[iter->second + 1]; ++index)
+      {
+         reordered.addWeight(sources[mSources[index]], mWeights[index]);
+      }
+   }
+
+   swap(mToBands, reordered.mToBands);
+   swap(mRowStarts, reordered.mRowStarts);
+   swap(mSources, reordered.mSources);
+   swap(mWeights, reordered.mWeights);
+}
+
+unsigned int ResamplingMatrix::getNumSources() const
+{
+   return mNumSources;
+}
+
+unsigned int ResamplingMatrix::getNumRows() const
+{
+   return static_cast<unsigned int>(mToBands.size());
+}
+
+const vector<int>& ResamplingMatrix::getToBands() const
+{
+   return mToBands;
+}
+
+void ResamplingMatrix::apply(const double* pFromData, double* pToData, unsigned int numSpectra) const
+{
+   const unsigned int numRows = getNumRows();
+   for (unsigned int spectrum = 0; spectrum < numSpectra; ++spectrum)
+   {
+      for (unsigned int row = 0; row < numRows; ++row)
+      {
+         double value = 0.0;
+         for (unsigned int index = mRowStarts[row]; index < mRowStarts[row + 1]; ++index)
+         {
+            value += mWeights[index] * pFromData[mSources[index]];
+         }
+         *pToData++ = value;
+      }
+      pFromData += mNumSources;
+   }
+}
+
+void ResamplingMatrix::findRowsUsing(const vector<char>& sources, vector<char>& rows) const
+{
+   const unsigned int numRows = getNumRows();
+   rows.assign(numRows, 0);
+   for (unsigned int row = 0; row < numRows; ++row)
+   {
+      for (unsigned int index = mRowStarts[row]; index < mRowStarts[row + 1]; ++index)
+      {
+         if (sources[mSources[index]] != 0)
+         {
+            rows[row] = 1;
+            break;
+         }
+      }
+   }
+}
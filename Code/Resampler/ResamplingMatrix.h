@@ -0,0 +1,99 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef RESAMPLINGMATRIX_H
+#define RESAMPLINGMATRIX_H
+
+#include <vector>
+
+/**
+ * Sparse target x source weight matrix which resamples spectra.
+ *
+ * Each row holds the weights applied to the source values to produce one
+ * resampled value. Rows are stored contiguously in compressed row form so
+ * a matrix built once for a pair of wavelength sets can be applied to any
+ * number of spectra.
+ */
+class ResamplingMatrix
+{
+public:
+   ResamplingMatrix();
+
+   /**
+    *  Removes all rows from the matrix.
+    *
+    *  @param   numSources
+    *           The number of source values each spectrum must contain.
+    */
+   void clear(unsigned int numSources);
+
+   /**
+    *  Starts a new row. Weights added afterward belong to this row.
+    *
+    *  @param   toBand
+    *           The index of the target band produced by the row.
+    */
+   void addRow(int toBand);
+
+   /**
+    *  Adds a weight to the current row.
+    */
+   void addWeight(int source, double weight);
+
+   /**
+    *  Maps the matrix built for sorted wavelengths back to the caller's order.
+    *
+    *  @param   sources
+    *           The original index of each sorted source value.
+    *  @param   toBands
+    *           The original index of each sorted target band. The rows are
+    *           reordered so the original target indices are ascending.
+    */
+   void reorder(const std::vector<int>& sources, const std::vector<int>& toBands);
+
+   unsigned int getNumSources() const;
+   unsigned int getNumRows() const;
+
+   /**
+    *  Returns the target band index of each row.
+    */
+   const std::vector<int>& getToBands() const;
+
+   /**
+    *  Resamples a set of spectra.
+    *
+    *  @param   pFromData
+    *           \em numSpectra spectra of getNumSources() values each, stored contiguously.
+    *  @param   pToData
+    *           Receives \em numSpectra spectra of getNumRows() values each.
+    *  @param   numSpectra
+    *           The number of spectra to resample.
+    */
+   void apply(const double* pFromData, double* pToData, unsigned int numSpectra = 1) const;
+
+   /**
+    *  Finds the rows which use any of a set of source values.
+    *
+    *  @param   sources
+    *           Nonzero for each of the getNumSources() source values to look for.
+    *  @param   rows
+    *           Receives nonzero for each of the getNumRows() rows with a weight
+    *           for one of the sources.
+    */
+   void findRowsUsing(const std::vector<char>& sources, std::vector<char>& rows) const;
+
+private:
+   unsigned int mNumSources;
+   std::vector<int> mToBands;
+   std::vector<unsigned int> mRowStarts;
+   std::vector<int> mSources;
+   std::vector<double> mWeights;
+};
+
+#endif
@@ -7,88 +7,132 @@
  * http://www.gnu.org/licenses/lgpl.html
  */
 
+#include "ResamplingMatrix.h"
 #include "SplineInterpolator.h"
 
+#include <algorithm>
+#include <math.h>
+
 using namespace std;
-SplineInterpolator::SplineInterpolator(const vector<double>& fromWavelengths,
-   const vector<double>& fromData, double dropOutWindow) :
-   Interpolator(fromWavelengths, fromData, dropOutWindow), y2(fromWavelengths.size())
-{
-   const double endPointDerivative = 2.0e30; // signals endpoint second derivative = 0.0
 
-   spline(fromWavelengths, fromData, fromData.size(), endPointDerivative, endPointDerivative, y2);
+namespace
+{
+   // weights smaller than this fraction of the largest weight in a row are dropped
+   const double sWeightTolerance = 1e-12;
 }
 
-double SplineInterpolator::resamplePoint(IndexPair indices, double toWavelength, double toFwhm)
+SplineInterpolator::SplineInterpolator(const vector<double>& fromWavelengths, double dropOutWindow) :
+   Interpolator(fromWavelengths, dropOutWindow)
 {
-   return splint(mFromData.size(), mFromWavelengths, mFromData, y2, toWavelength);
+   // Do nothing
 }
 
-void SplineInterpolator::spline(const vector<double>& x, const vector<double>& y,
-   int n, double yp1, double ypn, vector<double>& y2)
+/*
+The natural cubic spline is linear in the source values, so each resampled value is a weighted sum of them.
+The weights combine the two bracketing source values with the second derivatives at the bracketing knots.
+*/
+void SplineInterpolator::addWeights(IndexPair indices, double toWavelength, double toFwhm,
+   ResamplingMatrix& matrix)
 {
-   int i, k;
-   double p, qn, sig, un;
-   vector<double> u(n);
+   const int n = static_cast<int>(mFromWavelengths.size());
+   int k, klo, khi;
+   double h, a, b;
 
-   if (yp1 > 0.99e30)
+   klo = 0;
+   khi = n-1;
+   while (khi-klo > 1) 
    {
-      y2[0] = u[0] = 0.0;
+      k=(khi+klo) >> 1;
+      if (mFromWavelengths[k] > toWavelength)
+      {
+         khi=k;
+      }
+      else
+      {
+         klo=k;
+      }
    }
-   else
+   h = mFromWavelengths[khi]-mFromWavelengths[klo];
+   a = (mFromWavelengths[khi]-toWavelength)/h;
+   b = (toWavelength-mFromWavelengths[klo])/h;
+
+   const vector<double>& loWeights = getSecondDerivativeWeights(klo);
+   const vector<double>& hiWeights = getSecondDerivativeWeights(khi);
+   const double loScale = (a*a*a-a)*(h*h)/6.0;
+   const double hiScale = (b*b*b-b)*(h*h)/6.0;
+
+   vector<double> weights(n);
+   double maxWeight = 0.0;
+   for (int i = 0; i < n; ++i)
    {
-      y2[0] = -0.5;
-      u[0]  = (3.0/(x[1]-x[0]))*((y[1]-y[0])/(x[1]-x[0])-yp1);
+      weights[i] = loScale*loWeights[i] + hiScale*hiWeights[i];
+      if (i == klo)
+      {
+         weights[i] += a;
+      }
+      if (i == khi)
+      {
+         weights[i] += b;
+      }
+      maxWeight = max(maxWeight, fabs(weights[i]));
    }
 
-   for (i=1; i<n-1; i++)
+   for (int i = 0; i < n; ++i)
    {
-      sig=(x[i]-x[i-1])/(x[i+1]-x[i-1]);
-      p = sig*y2[i-1]+2.0;
-      y2[i]=(sig-1.0)/p;
-      u[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
-      u[i]=(6.0*u[i]/(x[i+1]-x[i-1])-sig*u[i-1])/p;
+      if (fabs(weights[i]) > maxWeight * sWeightTolerance)
+      {
+         matrix.addWeight(i, weights[i]);
+      }
    }
+}
 
-   if (ypn > 0.99e30)
+/*
+The interior second derivatives solve the symmetric tridiagonal system T * y2 = D * y with zero second
+derivatives at the end points. Row k of inverse(T) * D is transpose(D) * z where T * z = e(k), so each
+row only needs one tridiagonal solve.
+*/
+const vector<double>& SplineInterpolator::getSecondDerivativeWeights(int knot)
+{
+   map<int, vector<double> >::iterator iter = mSecondDerivativeWeights.find(knot);
+   if (iter != mSecondDerivativeWeights.end())
    {
-      qn = un = 0.0;
+      return iter->second;
    }
-   else
+
+   const vector<double>& x = mFromWavelengths;
+   const int n = static_cast<int>(x.size());
+   vector<double>& weights = mSecondDerivativeWeights[knot];
+   weights.assign(n, 0.0);
+   if (knot <= 0 || knot >= n-1)
    {
-      qn = 0.5;
-      un = (3.0/(x[n-1]-x[n-2]))*(ypn-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
+      return weights;
    }
 
-   y2[n-1] = (un-qn*u[n-2])/(qn*y2[n-2]+1.0);
-   for (k=n-2; k>=0; k--)
+   // Solve T * z = e(knot) for the interior knots 1 to n-2 with the Thomas algorithm
+   vector<double> z(n, 0.0);
+   vector<double> c(n, 0.0);
+   for (int i = 1; i < n-1; ++i)
    {
-      y2[k] = y2[k]*y2[k+1]+u[k];
+      const double lower = (i > 1) ? (x[i]-x[i-1])/6.0 : 0.0;
+      const double upper = (i < n-2) ? (x[i+1]-x[i])/6.0 : 0.0;
+      const double p = (x[i+1]-x[i-1])/3.0 - lower*c[i-1];
+      c[i] = upper/p;
+      z[i] = ((i == knot ? 1.0 : 0.0) - lower*z[i-1])/p;
+   }
+   for (int i = n-3; i >= 1; --i)
+   {
+      z[i] -= c[i]*z[i+1];
    }
-}
-
-double SplineInterpolator::splint(int n, const vector<double>& xorgn,
-   const vector<double>& yorgn, const vector<double>& y2, double x)
-{
-   int k, klo, khi;
-   double h, a, b;
 
-   klo = 0;
-   khi = n-1;
-   while (khi-klo > 1) 
+   // Apply the transpose of the second difference operator D
+   for (int i = 1; i < n-1; ++i)
    {
-      k=(khi+klo) >> 1;
-      if (xorgn[k] > x)
-      {
-         khi=k;
-      }
-      else
-      {
-         klo=k;
-      }
+      const double left = 1.0/(x[i]-x[i-1]);
+      const double right = 1.0/(x[i+1]-x[i]);
+      weights[i-1] += z[i]*left;
+      weights[i] -= z[i]*(left+right);
+      weights[i+1] += z[i]*right;
    }
-   h = xorgn[khi]-xorgn[klo];
-   a = (xorgn[khi]-x)/h;
-   b = (x-xorgn[klo])/h;
-   return a*yorgn[klo]+b*yorgn[khi]+((a*a*a-a)*y2[klo]+(b*b*b-b)*y2[khi])*(h*h)/6.0;
+
+   return weights;
 }
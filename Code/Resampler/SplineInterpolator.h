@@ -12,21 +12,19 @@
 
 #include "Interpolator.h"
 
+#include <map>
+
 class SplineInterpolator : public Interpolator
 {
 public:
-   SplineInterpolator(const std::vector<double>& fromWavelengths,
-      const std::vector<double>& fromData, double dropOutWindow);
+   SplineInterpolator(const std::vector<double>& fromWavelengths, double dropOutWindow);
 private:
-   double resamplePoint(IndexPair indices, double toWavelength, double toFwhm);
-
-   static void spline(const std::vector<double>& x, const std::vector<double>& y, int n,
-      double yp1, double ypn, std::vector<double>& y2);
+   void addWeights(IndexPair indices, double toWavelength, double toFwhm, ResamplingMatrix& matrix);
 
-   static double splint(int n, const std::vector<double>& xorgn,
-      const std::vector<double>& yorgn, const std::vector<double>& y2, double x);
+   const std::vector<double>& getSecondDerivativeWeights(int knot);
 
-   std::vector<double> y2;
+   // weights of the source values in the natural spline second derivative at each knot
+   std::map<int, std::vector<double> > mSecondDerivativeWeights;
 };
 
 
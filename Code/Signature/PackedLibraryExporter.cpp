@@ -0,0 +1,122 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "FileDescriptor.h"
+#include "PackedLibraryExporter.h"
+#include "PackedLibraryFile.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "ProgressTracker.h"
+#include "Signature.h"
+#include "SignatureSet.h"
+#include "SpectralVersion.h"
+#include "StringUtilities.h"
+#include "TypeConverter.h"
+
+using namespace std;
+
+REGISTER_PLUGIN_BASIC(SpectralSignature, PackedLibraryExporter);
+
+PackedLibraryExporter::PackedLibraryExporter()
+{
+   setDescriptorId("{A59B7FDD-8671-4FEB-9562-D569E411E9E6}");
+   setName("Packed Spectral Library Exporter");
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setShortDescription("Export spectral signature libraries to a single packed file.");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+   setExtensions("Packed Spectral Library Files (*.psl)");
+   setSubtype(TypeConverter::toString<SignatureSet>());
+}
+
+PackedLibraryExporter::~PackedLibraryExporter()
+{
+}
+
+bool PackedLibraryExporter::getInputSpecification(PlugInArgList*& pInArgList)
+{
+   VERIFY((pInArgList = Service<PlugInManagerServices>()->getPlugInArgList()) != NULL);
+   VERIFY(pInArgList->addArg<Progress>(Executable::ProgressArg(), NULL, Executable::ProgressArgDescription()));
+   VERIFY(pInArgList->addArg<SignatureSet>(Exporter::ExportItemArg(), NULL, "Spectral library to be exported."));
+   VERIFY(pInArgList->addArg<FileDescriptor>(Exporter::ExportDescriptorArg(), NULL, "File descriptor for the "
+      "output file."));
+   return true;
+}
+
+bool PackedLibraryExporter::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
+{
+   VERIFY(pInArgList != NULL);
+   ProgressTracker progress(pInArgList->getPlugInArgValue<Progress>(Executable::ProgressArg()),
+      "Exporting packed spectral library", "spectral", "8F33E175-5BC8-4638-B88A-6304FB6E05BB");
+
+   SignatureSet* pSignatureSet = pInArgList->getPlugInArgValue<SignatureSet>(Exporter::ExportItemArg());
+   VERIFY(pSignatureSet != NULL);
+   FileDescriptor* pFileDescriptor = pInArgList->getPlugInArgValue<FileDescriptor>(Exporter::ExportDescriptorArg());
+   VERIFY(pFileDescriptor != NULL);
+   if (pFileDescriptor->getFilename().getFileName().empty())
+   {
+      progress.report("Invalid export file name.", 0, ERRORS, true);
+      return false;
+   }
+
+   vector<Signature*> setSignatures;
+   getSignatures(pSignatureSet, setSignatures);
+   vector<Signature*>::size_type numSignatures = setSignatures.size();
+   vector<Signature*> signatures;
+   for (vector<Signature*>::const_iterator it = setSignatures.begin(); it != setSignatures.end(); ++it)
+   {
+      if (PackedLibraryFile::canWrite(*it))
+      {
+         signatures.push_back(*it);
+      }
+   }
+   if (signatures.empty())
+   {
+      progress.report("No signatures to export.", 0, ERRORS, true);
+      return false;
+   }
+   if (signatures.size() < numSignatures)
+   {
+      progress.report(StringUtilities::toDisplayString(numSignatures - signatures.size()) + " signatures do not "
+         "contain \"Wavelength\" and \"Reflectance\" data of the same size and will not be exported.",
+         0, WARNING, true);
+   }
+
+   progress.report("Writing the packed spectral library", 10, NORMAL);
+   if (PackedLibraryFile::write(pFileDescriptor->getFilename().getFullPathAndName(), pSignatureSet->getName(),
+      pSignatureSet->getMetadata(), signatures) == false)
+   {
+      progress.report("Unable to write the packed spectral library.", 0, ERRORS, true);
+      return false;
+   }
+
+   progress.report("Exported packed spectral library.", 100, NORMAL);
+   progress.upALevel();
+   return true;
+}
+
+void PackedLibraryExporter::getSignatures(const SignatureSet* pSignatureSet, vector<Signature*>& signatures) const
+{
+   vector<Signature*> setSignatures = pSignatureSet->getSignatures();
+   for (vector<Signature*>::const_iterator it = setSignatures.begin(); it != setSignatures.end(); ++it)
+   {
+      const SignatureSet* pSubSet = dynamic_cast<const SignatureSet*>(*it);
+      if (pSubSet != NULL)
+      {
+         getSignatures(pSubSet, signatures);
+      }
+      else if (*it != NULL)
+      {
+         signatures.push_back(*it);
+      }
+   }
+}
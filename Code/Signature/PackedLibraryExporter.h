@@ -0,0 +1,39 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef PACKEDLIBRARYEXPORTER_H
+#define PACKEDLIBRARYEXPORTER_H
+
+#include "ExporterShell.h"
+
+#include <vector>
+
+class Signature;
+class SignatureSet;
+
+/**
+ * Exports a signature set to a single packed spectral library file.
+ *
+ * The signatures of any signature sets in the set are written as
+ * signatures of the exported library.
+ */
+class PackedLibraryExporter : public ExporterShell
+{
+public:
+   PackedLibraryExporter();
+   ~PackedLibraryExporter();
+
+   bool getInputSpecification(PlugInArgList*& pInArgList);
+   bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+
+private:
+   void getSignatures(const SignatureSet* pSignatureSet, std::vector<Signature*>& signatures) const;
+};
+
+#endif
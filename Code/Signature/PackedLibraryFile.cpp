@@ -0,0 +1,464 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "DataVariant.h"
+#include "DynamicObject.h"
+#include "PackedLibraryFile.h"
+#include "Signature.h"
+#include "TypeConverter.h"
+#include "Units.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCryptographicHash>
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+using namespace std;
+
+namespace
+{
+   // Increment the version when the file layout changes.
+   const char sLibraryMagic[8] = { 'S', 'P', 'E', 'C', 'P', 'L', 'I', 'B' };
+   const quint32 sLibraryVersion = 1;
+   const quint32 sByteOrderMark = 0x01020304;
+   const int sChecksumSize = 20;
+
+   // the checksum is computed in pieces since QCryptographicHash takes an int length
+   const qint64 sChecksumBlockSize = 1 << 26;
+
+   struct LibraryHeader
+   {
+      char mMagic[8];
+      quint32 mVersion;
+      quint32 mByteOrder;
+      quint32 mNumSignatures;
+      quint32 mReserved;
+      quint64 mNumWavelengths;         // doubles in the wavelength table
+      quint64 mNumValues;              // doubles in the reflectance matrix
+      quint64 mMetadataSize;           // bytes in the metadata block
+      char mChecksum[sChecksumSize];   // SHA-1 of everything after the header
+      char mPadding[4];
+   };
+
+   struct LibraryEntry
+   {
+      quint64 mWavelengthOffset;       // first wavelength in the wavelength table
+      quint64 mValueOffset;            // first value in the reflectance matrix
+      quint64 mMetadataOffset;         // first byte of the signature record in the metadata block
+      quint32 mNumValues;
+      qint32 mUnitType;
+      double mUnitScale;
+   };
+
+   // each section is a whole number of doubles, so the doubles of every section are aligned in a mapped file
+   qint64 getEntriesOffset()
+   {
+      return static_cast<qint64>(sizeof(LibraryHeader));
+   }
+
+   qint64 getWavelengthsOffset(const LibraryHeader& header)
+   {
+      return getEntriesOffset() + static_cast<qint64>(header.mNumSignatures) * sizeof(LibraryEntry);
+   }
+
+   qint64 getValuesOffset(const LibraryHeader& header)
+   {
+      return getWavelengthsOffset(header) + static_cast<qint64>(header.mNumWavelengths) * sizeof(double);
+   }
+
+   qint64 getMetadataOffset(const LibraryHeader& header)
+   {
+      return getValuesOffset(header) + static_cast<qint64>(header.mNumValues) * sizeof(double);
+   }
+
+   QByteArray getChecksum(QFile& file, qint64 offset)
+   {
+      QCryptographicHash hash(QCryptographicHash::Sha1);
+      if (file.seek(offset) == false)
+      {
+         return QByteArray();
+      }
+      while (file.atEnd() == false)
+      {
+         QByteArray block = file.read(sChecksumBlockSize);
+         if (block.isEmpty())
+         {
+            return QByteArray();
+         }
+         hash.addData(block);
+      }
+
+      return hash.result();
+   }
+
+   /**
+    * A record in the metadata block is a count followed by that many null terminated strings:
+    * the fixed strings of the record and then the type, name and value of each metadata
+    * attribute. Metadata attributes which are objects are not written.
+    */
+   void appendString(QByteArray& block, const string& value)
+   {
+      block.append(value.c_str(), static_cast<int>(value.size()) + 1);
+   }
+
+   void appendRecord(QByteArray& block, const vector<string>& fixedStrings, const DynamicObject* pMetadata)
+   {
+      vector<string> attributes;
+      if (pMetadata != NULL)
+      {
+         vector<string> names;
+         pMetadata->getAttributeNames(names);
+         for (vector<string>::const_iterator name = names.begin(); name != names.end(); ++name)
+         {
+            const DataVariant& value = pMetadata->getAttribute(*name);
+            if (value.isValid() && value.getTypeName() != TypeConverter::toString<DynamicObject>())
+            {
+               attributes.push_back(value.getTypeName());
+               attributes.push_back(*name);
+               attributes.push_back(value.toXmlString());
+            }
+         }
+      }
+
+      quint32 numStrings = static_cast<quint32>(fixedStrings.size() + attributes.size());
+      block.append(reinterpret_cast<const char*>(&numStrings), sizeof(numStrings));
+      for (vector<string>::const_iterator it = fixedStrings.begin(); it != fixedStrings.end(); ++it)
+      {
+         appendString(block, *it);
+      }
+      for (vector<string>::const_iterator it = attributes.begin(); it != attributes.end(); ++it)
+      {
+         appendString(block, *it);
+      }
+   }
+
+   const vector<double>* getData(const Signature* pSignature, const string& component)
+   {
+      return dv_cast<vector<double> >(&pSignature->getData(component));
+   }
+
+   struct LessByValue
+   {
+      bool operator()(const vector<double>* pLeft, const vector<double>* pRight) const
+      {
+         return *pLeft < *pRight;
+      }
+   };
+}
+
+PackedLibraryFile::PackedLibraryFile() :
+   mpData(NULL),
+   mSize(0)
+{}
+
+PackedLibraryFile::~PackedLibraryFile()
+{
+   close();
+}
+
+bool PackedLibraryFile::open(const string& filename)
+{
+   close();
+   mFile.setFileName(QString::fromStdString(filename));
+   if (mFile.open(QIODevice::ReadOnly) == false)
+   {
+      return false;
+   }
+   mSize = mFile.size();
+   if (mSize < static_cast<qint64>(sizeof(LibraryHeader)))
+   {
+      close();
+      return false;
+   }
+   mpData = mFile.map(0, mSize);
+   if (mpData == NULL)
+   {
+      close();
+      return false;
+   }
+
+   LibraryHeader header;
+   memcpy(&header, mpData, sizeof(header));
+   bool valid = memcmp(header.mMagic, sLibraryMagic, sizeof(sLibraryMagic)) == 0 &&
+      header.mVersion == sLibraryVersion && header.mByteOrder == sByteOrderMark &&
+      header.mNumWavelengths <= static_cast<quint64>(mSize / sizeof(double)) &&
+      header.mNumValues <= static_cast<quint64>(mSize / sizeof(double)) &&
+      header.mMetadataSize <= static_cast<quint64>(mSize) &&
+      getMetadataOffset(header) + static_cast<qint64>(header.mMetadataSize) == mSize;
+   if (valid == false)
+   {
+      close();
+   }
+
+   return valid;
+}
+
+void PackedLibraryFile::close()
+{
+   if (mpData != NULL)
+   {
+      mFile.unmap(const_cast<uchar*>(mpData));
+      mpData = NULL;
+   }
+   mFile.close();
+   mSize = 0;
+}
+
+bool PackedLibraryFile::verifyChecksum() const
+{
+   if (mpData == NULL)
+   {
+      return false;
+   }
+
+   // read the file rather than the mapping so a checksum of a large file does not keep all of it resident
+   QFile file(mFile.fileName());
+   if (file.open(QIODevice::ReadOnly) == false)
+   {
+      return false;
+   }
+   QByteArray checksum = getChecksum(file, sizeof(LibraryHeader));
+
+   const LibraryHeader* pHeader = reinterpret_cast<const LibraryHeader*>(mpData);
+   return checksum.size() == sChecksumSize && memcmp(checksum.constData(), pHeader->mChecksum, sChecksumSize) == 0;
+}
+
+unsigned int PackedLibraryFile::getNumSignatures() const
+{
+   if (mpData == NULL)
+   {
+      return 0;
+   }
+
+   return reinterpret_cast<const LibraryHeader*>(mpData)->mNumSignatures;
+}
+
+bool PackedLibraryFile::readLibrary(string& name, DynamicObject* pMetadata) const
+{
+   vector<string> strings(1);
+   if (mpData == NULL || readRecord(0, strings, pMetadata) == false)
+   {
+      return false;
+   }
+   name = strings[0];
+
+   return true;
+}
+
+bool PackedLibraryFile::readSignature(unsigned int index, PackedSignature& signature, DynamicObject* pMetadata) const
+{
+   if (index >= getNumSignatures())
+   {
+      return false;
+   }
+
+   LibraryHeader header;
+   memcpy(&header, mpData, sizeof(header));
+   LibraryEntry entry;
+   memcpy(&entry, mpData + getEntriesOffset() + static_cast<qint64>(index) * sizeof(LibraryEntry), sizeof(entry));
+   if (entry.mWavelengthOffset > header.mNumWavelengths ||
+      entry.mNumValues > header.mNumWavelengths - entry.mWavelengthOffset ||
+      entry.mValueOffset > header.mNumValues ||
+      entry.mNumValues > header.mNumValues - entry.mValueOffset)
+   {
+      return false;
+   }
+
+   vector<string> strings(2);
+   if (readRecord(entry.mMetadataOffset, strings, pMetadata) == false)
+   {
+      return false;
+   }
+   signature.mName = strings[0];
+   signature.mUnitName = strings[1];
+   signature.mUnitType = static_cast<UnitType>(static_cast<UnitTypeEnum>(entry.mUnitType));
+   signature.mUnitScale = entry.mUnitScale;
+
+   const double* pWavelengths =
+      reinterpret_cast<const double*>(mpData + getWavelengthsOffset(header)) + entry.mWavelengthOffset;
+   const double* pValues = reinterpret_cast<const double*>(mpData + getValuesOffset(header)) + entry.mValueOffset;
+   signature.mWavelengths.assign(pWavelengths, pWavelengths + entry.mNumValues);
+   signature.mValues.assign(pValues, pValues + entry.mNumValues);
+
+   return true;
+}
+
+bool PackedLibraryFile::readRecord(quint64 offset, vector<string>& strings, DynamicObject* pMetadata) const
+{
+   LibraryHeader header;
+   memcpy(&header, mpData, sizeof(header));
+   if (offset > header.mMetadataSize || header.mMetadataSize - offset < sizeof(quint32))
+   {
+      return false;
+   }
+
+   const char* pBlock = reinterpret_cast<const char*>(mpData + getMetadataOffset(header));
+   const char* pEnd = pBlock + header.mMetadataSize;
+   const char* pRecord = pBlock + offset;
+   quint32 numStrings = 0;
+   memcpy(&numStrings, pRecord, sizeof(numStrings));
+   pRecord += sizeof(numStrings);
+   if (numStrings < strings.size() || (numStrings - strings.size()) % 3 != 0)
+   {
+      return false;
+   }
+
+   // each string takes at least its terminator, so a corrupt count cannot allocate more strings than fit
+   if (numStrings > static_cast<quint64>(pEnd - pRecord))
+   {
+      return false;
+   }
+
+   vector<string> values(numStrings);
+   for (quint32 i = 0; i < numStrings; ++i)
+   {
+      const char* pTerminator = find(pRecord, pEnd, '\0');
+      if (pTerminator == pEnd)
+      {
+         return false;
+      }
+      values[i].assign(pRecord, pTerminator);
+      pRecord = pTerminator + 1;
+   }
+   copy(values.begin(), values.begin() + strings.size(), strings.begin());
+
+   if (pMetadata != NULL)
+   {
+      for (vector<string>::size_type i = strings.size(); i < values.size(); i += 3)
+      {
+         DataVariant value;
+         if (value.fromXmlString(values[i], values[i + 2]) != DataVariant::SUCCESS)
+         {
+            value = DataVariant(values[i + 2]);
+         }
+         pMetadata->setAttribute(values[i + 1], value);
+      }
+   }
+
+   return true;
+}
+
+bool PackedLibraryFile::canWrite(const Signature* pSignature)
+{
+   if (pSignature == NULL)
+   {
+      return false;
+   }
+
+   const vector<double>* pWavelengths = getData(pSignature, "Wavelength");
+   const vector<double>* pValues = getData(pSignature, "Reflectance");
+   return pWavelengths != NULL && pValues != NULL && pWavelengths->size() == pValues->size();
+}
+
+bool PackedLibraryFile::write(const string& filename, const string& libraryName,
+   const DynamicObject* pLibraryMetadata, const vector<Signature*>& signatures)
+{
+   LibraryHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.mMagic, sLibraryMagic, sizeof(sLibraryMagic));
+   header.mVersion = sLibraryVersion;
+   header.mByteOrder = sByteOrderMark;
+   header.mNumSignatures = static_cast<quint32>(signatures.size());
+
+   // signatures with the same wavelengths share one copy of them in the wavelength table
+   vector<LibraryEntry> entries(signatures.size());
+   vector<const vector<double>*> wavelengthTable;
+   map<const vector<double>*, quint64, LessByValue> wavelengthOffsets;
+   QByteArray metadataBlock;
+   appendRecord(metadataBlock, vector<string>(1, libraryName), pLibraryMetadata);
+   for (vector<Signature*>::size_type sig = 0; sig < signatures.size(); ++sig)
+   {
+      const Signature* pSignature = signatures[sig];
+      VERIFY(canWrite(pSignature));
+      const vector<double>* pWavelengths = getData(pSignature, "Wavelength");
+      const Units* pUnits = pSignature->getUnits("Reflectance");
+
+      LibraryEntry& entry = entries[sig];
+      map<const vector<double>*, quint64, LessByValue>::const_iterator wavelengthOffset =
+         wavelengthOffsets.find(pWavelengths);
+      if (wavelengthOffset == wavelengthOffsets.end())
+      {
+         wavelengthOffset = wavelengthOffsets.insert(make_pair(pWavelengths, header.mNumWavelengths)).first;
+         wavelengthTable.push_back(pWavelengths);
+         header.mNumWavelengths += pWavelengths->size();
+      }
+      entry.mWavelengthOffset = wavelengthOffset->second;
+      entry.mValueOffset = header.mNumValues;
+      entry.mMetadataOffset = static_cast<quint64>(metadataBlock.size());
+      entry.mNumValues = static_cast<quint32>(pWavelengths->size());
+      entry.mUnitType = static_cast<qint32>((pUnits == NULL) ? REFLECTANCE : pUnits->getUnitType());
+      entry.mUnitScale = (pUnits == NULL) ? 1.0 : pUnits->getScaleFromStandard();
+      header.mNumValues += pWavelengths->size();
+
+      vector<string> fixedStrings;
+      fixedStrings.push_back(pSignature->getName());
+      fixedStrings.push_back((pUnits == NULL) ? string("Reflectance") : pUnits->getUnitName());
+      appendRecord(metadataBlock, fixedStrings, pSignature->getMetadata());
+   }
+   header.mMetadataSize = static_cast<quint64>(metadataBlock.size());
+
+   QString finalFilename = QString::fromStdString(filename);
+   QString tempFilename = finalFilename + ".tmp";
+   QFile libraryFile(tempFilename);
+   if (libraryFile.open(QIODevice::ReadWrite | QIODevice::Truncate) == false)
+   {
+      return false;
+   }
+
+   // the header is written again with the checksum once the rest of the file is complete
+   bool success = libraryFile.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+   if (success && entries.empty() == false)
+   {
+      qint64 numBytes = static_cast<qint64>(entries.size() * sizeof(LibraryEntry));
+      success = libraryFile.write(reinterpret_cast<const char*>(&entries.front()), numBytes) == numBytes;
+   }
+   for (vector<const vector<double>*>::const_iterator it = wavelengthTable.begin();
+      success && it != wavelengthTable.end(); ++it)
+   {
+      qint64 numBytes = static_cast<qint64>((*it)->size() * sizeof(double));
+      success = (*it)->empty() ||
+         libraryFile.write(reinterpret_cast<const char*>(&(*it)->front()), numBytes) == numBytes;
+   }
+   for (vector<Signature*>::const_iterator it = signatures.begin(); success && it != signatures.end(); ++it)
+   {
+      const vector<double>* pValues = getData(*it, "Reflectance");
+      qint64 numBytes = static_cast<qint64>(pValues->size() * sizeof(double));
+      success = pValues->empty() ||
+         libraryFile.write(reinterpret_cast<const char*>(&pValues->front()), numBytes) == numBytes;
+   }
+   success = success && libraryFile.write(metadataBlock) == metadataBlock.size();
+   if (success)
+   {
+      QByteArray checksum = getChecksum(libraryFile, sizeof(header));
+      success = checksum.size() == sChecksumSize;
+      if (success)
+      {
+         memcpy(header.mChecksum, checksum.constData(), sChecksumSize);
+         success = libraryFile.seek(0) &&
+            libraryFile.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+      }
+   }
+   libraryFile.close();
+
+   // replace any existing library with the complete file
+   if (success)
+   {
+      QFile::remove(finalFilename);
+      success = QFile::rename(tempFilename, finalFilename);
+   }
+   if (success == false)
+   {
+      QFile::remove(tempFilename);
+   }
+
+   return success;
+}
@@ -0,0 +1,143 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef PACKEDLIBRARYFILE_H
+#define PACKEDLIBRARYFILE_H
+
+#include "TypesFile.h"
+
+#include <QtCore/QFile>
+
+#include <string>
+#include <vector>
+
+class DynamicObject;
+class Signature;
+
+/**
+ * A spectral library stored in a single file which is read by mapping it into memory.
+ *
+ * The file is a fixed size header followed by four sections:
+ *   - a table with an entry for each signature,
+ *   - a wavelength table holding each distinct set of signature wavelengths once,
+ *   - a reflectance matrix holding the values of all signatures end to end,
+ *   - a metadata block with the library name and metadata followed by the name, unit name
+ *     and metadata of each signature.
+ *
+ * An entry locates its signature in the other sections, so a signature is read by copying
+ * its wavelengths and values out of the mapped file without parsing any text. The header
+ * holds a SHA-1 checksum of everything after the header.
+ */
+class PackedLibraryFile
+{
+public:
+   struct PackedSignature
+   {
+      std::string mName;
+      std::string mUnitName;
+      UnitType mUnitType;
+      double mUnitScale;                  // Units::getScaleFromStandard()
+      std::vector<double> mWavelengths;
+      std::vector<double> mValues;
+   };
+
+   PackedLibraryFile();
+   ~PackedLibraryFile();
+
+   /**
+    *  Maps a file and checks its layout.
+    *
+    *  @param   filename
+    *           The full path of the file.
+    *
+    *  @return  \c true if the file is a packed library whose sections fit in the file,
+    *           \c false otherwise.
+    */
+   bool open(const std::string& filename);
+   void close();
+
+   /**
+    *  Compares the checksum in the header with the contents of the file.
+    *
+    *  @return  \c true if the file is open and its contents match the checksum, \c false otherwise.
+    */
+   bool verifyChecksum() const;
+
+   unsigned int getNumSignatures() const;
+
+   /**
+    *  Reads the library name and metadata.
+    *
+    *  @param   name
+    *           Receives the name of the library.
+    *  @param   pMetadata
+    *           Receives the library metadata. This may be \c NULL.
+    *
+    *  @return  \c true if the library record is valid, \c false otherwise.
+    */
+   bool readLibrary(std::string& name, DynamicObject* pMetadata) const;
+
+   /**
+    *  Reads a signature.
+    *
+    *  @param   index
+    *           The index of the signature in the file.
+    *  @param   signature
+    *           Receives the signature.
+    *  @param   pMetadata
+    *           Receives the signature metadata. This may be \c NULL.
+    *
+    *  @return  \c true if the entry of the signature is valid, \c false otherwise.
+    */
+   bool readSignature(unsigned int index, PackedSignature& signature, DynamicObject* pMetadata) const;
+
+   /**
+    *  Writes a packed library.
+    *
+    *  The file is written under a temporary name and then renamed, so an existing
+    *  library is only replaced by a complete file.
+    *
+    *  @param   filename
+    *           The full path of the file.
+    *  @param   libraryName
+    *           The name of the library.
+    *  @param   pLibraryMetadata
+    *           The library metadata. This may be \c NULL.
+    *  @param   signatures
+    *           The signatures to write. Every signature must have "Wavelength" and
+    *           "Reflectance" data of the same size as vector<double>.
+    *
+    *  @return  \c true if the file was written, \c false otherwise.
+    */
+   static bool write(const std::string& filename, const std::string& libraryName,
+      const DynamicObject* pLibraryMetadata, const std::vector<Signature*>& signatures);
+
+   /**
+    *  Checks whether a signature can be written to a packed library.
+    *
+    *  @param   pSignature
+    *           The signature to check.
+    *
+    *  @return  \c true if the signature has "Wavelength" and "Reflectance" data of the
+    *           same size as vector<double>, \c false otherwise.
+    */
+   static bool canWrite(const Signature* pSignature);
+
+private:
+   PackedLibraryFile(const PackedLibraryFile& rhs);
+   PackedLibraryFile& operator=(const PackedLibraryFile& rhs);
+
+   bool readRecord(quint64 offset, std::vector<std::string>& strings, DynamicObject* pMetadata) const;
+
+   QFile mFile;
+   const uchar* mpData;
+   qint64 mSize;
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "DataDescriptor.h"
+#include "DynamicObject.h"
+#include "ImportDescriptor.h"
+#include "ModelServices.h"
+#include "ObjectResource.h"
+#include "PackedLibraryFile.h"
+#include "PackedLibraryImporter.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "ProgressTracker.h"
+#include "Signature.h"
+#include "SignatureDataDescriptor.h"
+#include "SignatureFileDescriptor.h"
+#include "SignatureSet.h"
+#include "SpectralVersion.h"
+#include "StringUtilities.h"
+#include "TypeConverter.h"
+#include "Units.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QString>
+
+using namespace std;
+
+REGISTER_PLUGIN_BASIC(SpectralSignature, PackedLibraryImporter);
+
+namespace
+{
+   // signatures from nested sets may share a name once they are in one library
+   string getUniqueName(const string& name, const DataElement* pParent)
+   {
+      Service<ModelServices> pModel;
+      string uniqueName = name;
+      for (unsigned int count = 2; pModel->getElement(uniqueName, TypeConverter::toString<Signature>(),
+         pParent) != NULL; ++count)
+      {
+         uniqueName = name + " (" + StringUtilities::toDisplayString(count) + ")";
+      }
+
+      return uniqueName;
+   }
+}
+
+PackedLibraryImporter::PackedLibraryImporter()
+{
+   setDescriptorId("{85D72A1C-4A57-4AD6-8E2B-440DC828BBEE}");
+   setName("Packed Spectral Library Importer");
+   setSubtype("Signature Set");
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setShortDescription("Import packed spectral signature libraries.");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+   setExtensions("Packed Spectral Library Files (*.psl)");
+   setAbortSupported(true);
+}
+
+PackedLibraryImporter::~PackedLibraryImporter()
+{
+}
+
+unsigned char PackedLibraryImporter::getFileAffinity(const string& filename)
+{
+   PackedLibraryFile library;
+   return library.open(filename) ? CAN_LOAD : CAN_NOT_LOAD;
+}
+
+vector<ImportDescriptor*> PackedLibraryImporter::getImportDescriptors(const string& filename)
+{
+   vector<ImportDescriptor*> descriptors;
+   if (filename.empty())
+   {
+      return descriptors;
+   }
+
+   PackedLibraryFile library;
+   if (library.open(filename) == false)
+   {
+      return descriptors;
+   }
+
+   FactoryResource<DynamicObject> pMetadata;
+   VERIFYRV(pMetadata.get() != NULL, descriptors);
+   string datasetName;
+   if (library.readLibrary(datasetName, pMetadata.get()) == false)
+   {
+      return descriptors;
+   }
+   if (datasetName.empty())
+   {
+      datasetName = QFileInfo(QString::fromStdString(filename)).completeBaseName().toStdString();
+   }
+
+   ImportDescriptorResource pImportDescriptor(datasetName, TypeConverter::toString<SignatureSet>());
+   VERIFYRV(pImportDescriptor.get() != NULL, descriptors);
+   DataDescriptor* pDataDescriptor = pImportDescriptor->getDataDescriptor();
+   VERIFYRV(pDataDescriptor != NULL, descriptors);
+   FactoryResource<SignatureFileDescriptor> pFileDescriptor;
+   VERIFYRV(pFileDescriptor.get() != NULL, descriptors);
+   pFileDescriptor->setFilename(filename);
+   pDataDescriptor->setFileDescriptor(pFileDescriptor.get());
+   pDataDescriptor->setMetadata(pMetadata.get());
+   descriptors.push_back(pImportDescriptor.release());
+   return descriptors;
+}
+
+bool PackedLibraryImporter::getInputSpecification(PlugInArgList*& pInArgList)
+{
+   VERIFY((pInArgList = Service<PlugInManagerServices>()->getPlugInArgList()) != NULL);
+   VERIFY(pInArgList->addArg<Progress>(Executable::ProgressArg(), NULL, Executable::ProgressArgDescription()));
+   VERIFY(pInArgList->addArg<SignatureSet>(Importer::ImportElementArg(), NULL, "Spectral library to be imported."));
+   return true;
+}
+
+bool PackedLibraryImporter::getOutputSpecification(PlugInArgList*& pOutArgList)
+{
+   pOutArgList = NULL;
+   return true;
+}
+
+bool PackedLibraryImporter::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
+{
+   VERIFY(pInArgList != NULL);
+   ProgressTracker progress(pInArgList->getPlugInArgValue<Progress>(Executable::ProgressArg()),
+      "Loading packed spectral library", "spectral", "57B9759A-C8CB-4817-AF52-FF94E461464D");
+
+   SignatureSet* pSignatureSet = pInArgList->getPlugInArgValue<SignatureSet>(Importer::ImportElementArg());
+   VERIFY(pSignatureSet != NULL);
+   DataDescriptor* pDataDescriptor = pSignatureSet->getDataDescriptor();
+   VERIFY(pDataDescriptor != NULL);
+   FileDescriptor* pFileDescriptor = pDataDescriptor->getFileDescriptor();
+   VERIFY(pFileDescriptor != NULL);
+   string filename = pFileDescriptor->getFilename().getFullPathAndName();
+   progress.getCurrentStep()->addProperty("filename", filename);
+
+   PackedLibraryFile library;
+   if (library.open(filename) == false)
+   {
+      progress.report("Unable to read the packed spectral library.", 0, ERRORS, true);
+      return false;
+   }
+   progress.report("Verifying the packed spectral library", 0, NORMAL);
+   if (library.verifyChecksum() == false)
+   {
+      progress.report("The packed spectral library is damaged; its contents do not match its checksum.",
+         0, ERRORS, true);
+      return false;
+   }
+
+   Service<ModelServices> pModel;
+   unsigned int numSignatures = library.getNumSignatures();
+   unsigned int numSkipped = 0;
+   vector<Signature*> signatures;
+   signatures.reserve(numSignatures);
+   for (unsigned int index = 0; index < numSignatures; ++index)
+   {
+      if (isAborted())
+      {
+         progress.report("User aborted the operation.", 0, ABORT, true);
+         return false;
+      }
+      progress.report("Importing signature library", static_cast<int>(100.0 * index / numSignatures), NORMAL);
+
+      PackedLibraryFile::PackedSignature packedSignature;
+      FactoryResource<DynamicObject> pMetadata;
+      VERIFY(pMetadata.get() != NULL);
+      if (library.readSignature(index, packedSignature, pMetadata.get()) == false)
+      {
+         ++numSkipped;
+         continue;
+      }
+
+      Signature* pSignature = static_cast<Signature*>(pModel->createElement(
+         getUniqueName(packedSignature.mName, pSignatureSet), TypeConverter::toString<Signature>(), pSignatureSet));
+      if (pSignature == NULL)
+      {
+         ++numSkipped;
+         continue;
+      }
+      pSignature->setData("Wavelength", packedSignature.mWavelengths);
+      pSignature->setData("Reflectance", packedSignature.mValues);
+      pSignature->getMetadata()->merge(pMetadata.get());
+
+      SignatureDataDescriptor* pSigDescriptor = dynamic_cast<SignatureDataDescriptor*>(pSignature->getDataDescriptor());
+      VERIFY(pSigDescriptor != NULL);
+      FactoryResource<Units> pUnits;
+      VERIFY(pUnits.get() != NULL);
+      pUnits->setUnitName(packedSignature.mUnitName);
+      pUnits->setUnitType(packedSignature.mUnitType);
+      pUnits->setScaleFromStandard(packedSignature.mUnitScale);
+      pSigDescriptor->setUnits("Reflectance", pUnits.get());
+
+      signatures.push_back(pSignature);
+   }
+   pSignatureSet->insertSignatures(signatures);
+
+   if (numSkipped > 0)
+   {
+      progress.report("Unable to import " + StringUtilities::toDisplayString(numSkipped) +
+         " of the signatures in the library.", 100, WARNING, true);
+   }
+   progress.report("Packed spectral library loaded", 100, NORMAL);
+   progress.upALevel();
+   return true;
+}
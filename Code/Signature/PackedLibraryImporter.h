@@ -0,0 +1,36 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2011 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef PACKEDLIBRARYIMPORTER_H
+#define PACKEDLIBRARYIMPORTER_H
+
+#include "ImporterShell.h"
+#include <string>
+#include <vector>
+
+/**
+ * Imports a packed spectral library file as a signature set.
+ *
+ * The whole library is in one mapped file, so the signatures are created
+ * directly from the mapped data rather than by importing a file for each.
+ */
+class PackedLibraryImporter : public ImporterShell
+{
+public:
+   PackedLibraryImporter();
+   ~PackedLibraryImporter();
+
+   unsigned char getFileAffinity(const std::string& filename);
+   std::vector<ImportDescriptor*> getImportDescriptors(const std::string& filename);
+   bool getInputSpecification(PlugInArgList*& pInArgList);
+   bool getOutputSpecification(PlugInArgList*& pOutArgList);
+   bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+};
+
+#endif
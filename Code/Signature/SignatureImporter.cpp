@@ -21,6 +21,8 @@
 #include "SignatureDataDescriptor.h"
 #include "SignatureFileDescriptor.h"
 #include "SignatureImporter.h"
+#include "SignatureTextParser.h"
+#include "SpectralUtilities.h"
 #include "SpectralVersion.h"
 #include "StringUtilities.h"
 #include "Units.h"
@@ -33,6 +35,15 @@ using namespace std;
 
 REGISTER_PLUGIN_BASIC(SpectralSignature, SignatureImporter);
 
+namespace
+{
+   struct DecimalTestCase
+   {
+      const char* mpText;
+      bool mExact;      // whether parseDecimal converts it or leaves it to the general conversion
+   };
+}
+
 SignatureImporter::SignatureImporter()
 {
    setDescriptorId("{B9A94AE2-97D2-44d8-9BC9-511C06D050CF}");
@@ -200,83 +211,47 @@ bool SignatureImporter::execute(PlugInArgList* pInArgList, PlugInArgList* OutArg
    VERIFY(pMetadata != NULL);
    string warningMsg;
 
-   LargeFileResource pSigFile;
-   VERIFY(pSigFile.open(pFileDescriptor->getFilename().getFullPathAndName(), O_RDONLY | O_BINARY, S_IREAD));
-
    const Units* pUnits = pSignature->getUnits("Reflectance");
    VERIFY(pUnits != NULL);
 
-   // Read the signature data
-   vector<double> wavelengthData, reflectanceData;
-
-   int64_t fileSize = pSigFile.fileLength();
-   bool readError = false;
-   size_t largeValueCount(0);
-   for (string line = pSigFile.readLine(&readError); readError == false; line = pSigFile.readLine(&readError))
+   // Read the signature data; the data may already have been parsed along with the other files of a library
+   string filename = pFileDescriptor->getFilename().getFullPathAndName();
+   SignatureTextParser::ParsedSignature parsedData;
+   if (SignatureTextParser::takePrefetchedFile(filename, parsedData) == false)
    {
-      if (isAborted())
+      progress.report("Loading signature data", 0, NORMAL);
+      if (SignatureTextParser::parseFile(filename, parsedData) == false)
       {
-         progress.report("Importer aborted", 0, ABORT, true);
+         progress.report("Unable to read signature file", 0, ERRORS, true);
          return false;
       }
-
-      int64_t fileLocation = pSigFile.tell();
-      progress.report("Loading signature data", static_cast<int>(fileLocation * 100.0 / fileSize), NORMAL);
-
-      trim(line);
-      if (line.empty())
-      {
-         continue;
-      }
-      if (line.find('=') == string::npos)
-      {
-         double wavelength = 0.0, reflectance = 0.0;
-         vector<string> dataEntry;
-         split(dataEntry, line, is_space());
-         bool error = true;
-         if (dataEntry.size() >= 1)
-         {
-            wavelength = StringUtilities::fromXmlString<double>(dataEntry[0], &error);
-            if (wavelength > 50.0)
-            {
-               // Assume wavelength values are in nanometers and convert to microns
-               wavelength = Wavelengths::convertValue(wavelength, NANOMETERS, MICRONS);
-            }
-         }
-         if (!error && dataEntry.size() == 2)
-         {
-            reflectance = StringUtilities::fromXmlString<double>(dataEntry[1], &error);
-
-            // Since the signature file may not have contained info on units and unitScale (defaults to values of
-            // "REFLECTANCE" and "1.0"), we need to check that the reflectance value is properly scaled.
-            // In theory, a valid reflectance value should be between 0 and 1, but real data may extend beyond these
-            // limits due to errors that occurred in collection, calibration, conversion, etc. We're assuming that a
-            // value greater than 2.0 indicates that the value was scaled by a factor other than 1.0 - a common data
-            // collection practice is to store a data value as an integer value equal to the actual value multiplied
-            // by a scaling factor. This saves storage space while preserving precision. 10000 is a very common
-            // scaling factor and the one we will assume was used. Right now we'll just count the number of large values.
-            // If more than half the values are large, we will assume they were scaled and divide all the values by 10000.
-            if (pUnits->getUnitType() == REFLECTANCE && pUnits->getScaleFromStandard() == 1.0
-               && fabs(reflectance) > 2.0)
-            {
-               ++largeValueCount;
-            }
-         }
-         if (error)
-         {
-            progress.report("Error parsing signature data", 0, ERRORS, true);
-         }
-
-         wavelengthData.push_back(wavelength);
-         reflectanceData.push_back(reflectance);
-      }
    }
-
-   if ((readError == true) && (pSigFile.eof() != 1))
+   if (isAborted())
    {
-      progress.report("Unable to read signature file", 0, ERRORS, true);
+      progress.report("Importer aborted", 0, ABORT, true);
       return false;
    }
+   if (parsedData.mNumErrors > 0)
+   {
+      progress.report("Error parsing signature data", 0, ERRORS, true);
+   }
+   vector<double>& wavelengthData = parsedData.mWavelengths;
+   vector<double>& reflectanceData = parsedData.mReflectances;
+
+   // Since the signature file may not have contained info on units and unitScale (defaults to values of
+   // "REFLECTANCE" and "1.0"), we need to check that the reflectance value is properly scaled.
+   // In theory, a valid reflectance value should be between 0 and 1, but real data may extend beyond these
+   // limits due to errors that occurred in collection, calibration, conversion, etc. We're assuming that a
+   // value greater than 2.0 indicates that the value was scaled by a factor other than 1.0 - a common data
+   // collection practice is to store a data value as an integer value equal to the actual value multiplied
+   // by a scaling factor. This saves storage space while preserving precision. 10000 is a very common
+   // scaling factor and the one we will assume was used. The parser counts the number of large values.
+   // If more than half the values are large, we will assume they were scaled and divide all the values by 10000.
+   size_t largeValueCount(0);
+   if (pUnits->getUnitType() == REFLECTANCE && pUnits->getScaleFromStandard() == 1.0)
+   {
+      largeValueCount = parsedData.mNumLargeValues;
+   }
 
    // check for need to scale the values, i.e., at least half the values are large
    if (reflectanceData.empty() == false && largeValueCount > 0 && largeValueCount >= (reflectanceData.size() / 2))
@@ -302,3 +277,83 @@ bool SignatureImporter::execute(PlugInArgList* pInArgList, PlugInArgList* OutArg
    progress.upALevel();
    return true;
 }
+
+bool SignatureImporter::runOperationalTests(Progress* pProgress, ostream& failure)
+{
+   return runAllTests(pProgress, failure);
+}
+
+bool SignatureImporter::runAllTests(Progress* pProgress, ostream& failure)
+{
+   if (testParseDecimal(failure) == false)
+   {
+      return false;
+   }
+
+   if (pProgress != NULL)
+   {
+      pProgress->updateProgress("Signature Importer tests complete", 100, NORMAL);
+   }
+   return true;
+}
+
+bool SignatureImporter::testParseDecimal(ostream& failure)
+{
+   // the values at the limits of the exact conversion and the forms it leaves to the general conversion
+   const DecimalTestCase cases[] =
+   {
+      { "123456789012345", true },
+      { "1234567890123456", false },
+      { "0.123456789012345", true },
+      { "1.234567890123456", false },
+      { "1e22", true },
+      { "1e23", false },
+      { "1e-22", true },
+      { "1e-23", false },
+      { "-4.5E+22", true },
+      { "45e22", true },
+      { "45e23", false },
+      { "000123.4500", true },
+      { "0.00000000000000000000123", false },
+      { "0.0000000000000000000123", true },
+      { "-0", true },
+      { "0", true },
+      { "0.0e99", true },
+      { "1.", false },
+      { ".5", false },
+      { "0.1", true },
+      { "-12.5", true },
+      { "4.35", true },
+      { "1e", false },
+      { "abc", false }
+   };
+
+   for (size_t index = 0; index < sizeof(cases) / sizeof(cases[0]); ++index)
+   {
+      string text(cases[index].mpText);
+      double value(0.0);
+      bool exact = SpectralUtilities::parseDecimal(text.data(), text.data() + text.size(), value);
+      if (exact != cases[index].mExact)
+      {
+         failure << "SpectralUtilities::parseDecimal " << (exact ? "converted" : "did not convert") << " \"" <<
+            text << "\"." << endl;
+         return false;
+      }
+      if (exact == false)
+      {
+         continue;
+      }
+
+      bool error(false);
+      double expected = StringUtilities::fromXmlString<double>(text, &error);
+      if (error || value != expected)
+      {
+         failure.precision(17);
+         failure << "SpectralUtilities::parseDecimal converted \"" << text << "\" to " << value <<
+            " instead of " << expected << "." << endl;
+         return false;
+      }
+   }
+
+   return true;
+}
@@ -11,10 +11,11 @@
 #define SIGNATUREIMPORTER_H
 
 #include "ImporterShell.h"
+#include "Testable.h"
 #include <string>
 #include <vector>
 
-class SignatureImporter : public ImporterShell 
+class SignatureImporter : public ImporterShell, public Testable
 {
 public:
    SignatureImporter();
@@ -25,6 +26,12 @@ public:
    bool getInputSpecification(PlugInArgList*& pInArgList);
    bool getOutputSpecification(PlugInArgList*& pOutArgList);
    bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+
+   bool runOperationalTests(Progress* pProgress, std::ostream& failure);
+   bool runAllTests(Progress* pProgress, std::ostream& failure);
+
+private:
+   bool testParseDecimal(std::ostream& failure);
 };
 
 #endif
\ No newline at end of file
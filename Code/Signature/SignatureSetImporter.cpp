@@ -16,7 +16,7 @@
 #include "DynamicObject.h"
 #include "FileResource.h"
 #include "ImportDescriptor.h"
-#include "MessageLogMgr.h"
+#include "ModelServices.h"
 #include "ObjectResource.h"
 #include "PlugInArgList.h"
 #include "PlugInManagerServices.h"
@@ -26,39 +26,362 @@
 #include "SignatureFileDescriptor.h"
 #include "SignatureSet.h"
 #include "SignatureSetImporter.h"
+#include "SignatureTextParser.h"
 #include "SpectralVersion.h"
 #include "StringUtilities.h"
 #include "XercesIncludes.h"
+#include "xmlreader.h"
+
+#include <xercesc/framework/LocalFileInputSource.hpp>
+#include <xercesc/framework/XMLPScanToken.hpp>
+#include <xercesc/sax/SAXException.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/util/BinInputStream.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
 
 XERCES_CPP_NAMESPACE_USE
 using namespace std;
 
 namespace
 {
-   class ImportDescriptorFilter : public DOMNodeFilter
+   // the number of signatures which are parsed together before they are imported
+   const vector<string>::size_type sBatchSize = 256;
+
+   // true if an element has the given name
+   bool isElement(const XMLCh* const pQName, const char* pName)
+   {
+      return XMLString::equals(pQName, X(pName));
+   }
+
+   string getAttribute(const Attributes& attrs, const char* pName)
+   {
+      const XMLCh* pValue = attrs.getValue(X(pName));
+      return pValue == NULL ? string() : A(pValue);
+   }
+
+   // signature filenames are relative to the library file unless they are absolute
+   string getSignatureFilename(const string& signatureFilename, const string& path)
+   {
+      string filename = signatureFilename;
+      if (filename.empty() == false)
+      {
+         QString tempFilename = QString::fromStdString(filename);
+         if (tempFilename.startsWith("./") == true)
+         {
+            tempFilename.replace(0, 1, QString::fromStdString(path));
+            filename = tempFilename.toStdString();
+         }
+         else
+         {
+            QFileInfo fileInfo(tempFilename);
+            if (fileInfo.isRelative() == true)
+            {
+               filename = path + SLASH + filename;
+            }
+         }
+      }
+      return filename;
+   }
+
+   // true for the files the Spectral Signature Importer reads
+   bool isTextSignatureFile(const string& filename)
+   {
+      QString suffix = QFileInfo(QString::fromStdString(filename)).suffix().toLower();
+      return suffix == "sig" || suffix == "elm" || suffix == "txt";
+   }
+
+   // discards the prefetched signatures which were not imported
+   class PrefetchedFiles
+   {
+   public:
+      PrefetchedFiles(const vector<string>& filenames) :
+         mFilenames(filenames)
+      {
+         SignatureTextParser::prefetchFiles(mFilenames);
+      }
+
+      ~PrefetchedFiles()
+      {
+         SignatureTextParser::clearPrefetchedFiles(mFilenames);
+      }
+
+   private:
+      vector<string> mFilenames;
+   };
+
+   // a non-validating reader which throws its fatal errors as exceptions
+   auto_ptr<SAX2XMLReader> createReader(DefaultHandler& handler)
+   {
+      auto_ptr<SAX2XMLReader> pReader(XMLReaderFactory::createXMLReader());
+      pReader->setFeature(XMLUni::fgSAX2CoreNameSpaces, false);
+      pReader->setFeature(XMLUni::fgSAX2CoreValidation, false);
+      pReader->setFeature(XMLUni::fgXercesLoadExternalDTD, false);
+      pReader->setContentHandler(&handler);
+      pReader->setErrorHandler(&handler);
+      return pReader;
+   }
+
+   // counts the bytes read from a stream which it adopts
+   class CountingInputStream : public BinInputStream
+   {
+   public:
+      CountingInputStream(BinInputStream* pStream, XMLFilePos& bytesRead) :
+         mpStream(pStream),
+         mBytesRead(bytesRead)
+      {}
+
+      virtual ~CountingInputStream()
+      {
+         delete mpStream;
+      }
+
+      virtual XMLFilePos curPos() const
+      {
+         return mpStream->curPos();
+      }
+
+      virtual XMLSize_t readBytes(XMLByte* const pToFill, const XMLSize_t maxToRead)
+      {
+         XMLSize_t numRead = mpStream->readBytes(pToFill, maxToRead);
+         mBytesRead += numRead;
+         return numRead;
+      }
+
+      virtual const XMLCh* getContentType() const
+      {
+         return mpStream->getContentType();
+      }
+
+   private:
+      BinInputStream* mpStream;
+      XMLFilePos& mBytesRead;
+   };
+
+   // a local file whose read position is available for progress while it is parsed
+   class ProgressInputSource : public LocalFileInputSource
+   {
+   public:
+      ProgressInputSource(const string& filename) :
+         LocalFileInputSource(X(filename.c_str())),
+         mBytesRead(0)
+      {}
+
+      virtual BinInputStream* makeStream() const
+      {
+         BinInputStream* pStream = LocalFileInputSource::makeStream();
+         return pStream == NULL ? NULL : new CountingInputStream(pStream, mBytesRead);
+      }
+
+      XMLFilePos getBytesRead() const
+      {
+         return mBytesRead;
+      }
+
+   private:
+      mutable XMLFilePos mBytesRead;
+   };
+
+   // records whether the file has a document element
+   class DocumentElementHandler : public DefaultHandler
+   {
+   public:
+      DocumentElementHandler() :
+         mFound(false)
+      {}
+
+      virtual void startElement(const XMLCh* const pUri, const XMLCh* const pLocalName, const XMLCh* const pQName,
+         const Attributes& attrs)
+      {
+         mFound = true;
+      }
+
+      bool isFound() const
+      {
+         return mFound;
+      }
+
+   private:
+      bool mFound;
+   };
+
+   /**
+    * Creates an import descriptor for each signature set as the end of the set is read.
+    *
+    * The descriptors are in the same order as the sets are closed, so a set follows the sets
+    * it contains. The document element is always a set.
+    */
+   class ImportDescriptorHandler : public DefaultHandler
+   {
+   public:
+      ImportDescriptorHandler(const string& filename, vector<ImportDescriptor*>& descriptors) :
+         mFilename(filename),
+         mDescriptors(descriptors),
+         mDatasetNumber(0)
+      {}
+
+      virtual void startElement(const XMLCh* const pUri, const XMLCh* const pLocalName, const XMLCh* const pQName,
+         const Attributes& attrs)
+      {
+         bool isSet = mOpenElements.empty() || isElement(pQName, "signature_set");
+         if (isSet)
+         {
+            OpenSet set;
+            set.mName = StringUtilities::toDisplayString(mDatasetNumber++);
+            mSets.push_back(set);
+         }
+         else if (mOpenElements.back() && isElement(pQName, "metadata"))
+         {
+            string name = getAttribute(attrs, "name");
+            string val = getAttribute(attrs, "value");
+            mSets.back().mMetadata.push_back(make_pair(name, val));
+            if (name == "Name")
+            {
+               mSets.back().mName = val;
+            }
+         }
+         mOpenElements.push_back(isSet);
+      }
+
+      virtual void endElement(const XMLCh* const pUri, const XMLCh* const pLocalName, const XMLCh* const pQName)
+      {
+         bool isSet = mOpenElements.back();
+         mOpenElements.pop_back();
+         if (isSet)
+         {
+            addDescriptor();
+            mSets.pop_back();
+         }
+      }
+
+   private:
+      void addDescriptor()
+      {
+         const OpenSet& set = mSets.back();
+         FactoryResource<DynamicObject> pMetadata;
+         VERIFYNRV(pMetadata.get() != NULL);
+         for (vector<pair<string, string> >::const_iterator item = set.mMetadata.begin();
+            item != set.mMetadata.end(); ++item)
+         {
+            pMetadata->setAttribute(item->first, item->second);
+         }
+
+         vector<string> datasetPath;
+         for (vector<OpenSet>::const_iterator parent = mSets.begin(); parent != mSets.end() - 1; ++parent)
+         {
+            datasetPath.push_back(parent->mName);
+         }
+         ImportDescriptorResource pImportDescriptor(set.mName, "SignatureSet", datasetPath);
+         VERIFYNRV(pImportDescriptor.get() != NULL);
+         DataDescriptor* pDataDescriptor = pImportDescriptor->getDataDescriptor();
+         VERIFYNRV(pDataDescriptor != NULL);
+         FactoryResource<SignatureFileDescriptor> pFileDescriptor;
+         VERIFYNRV(pFileDescriptor.get() != NULL);
+         pFileDescriptor->setFilename(mFilename);
+         datasetPath.push_back(set.mName);
+         string loc = "/" + StringUtilities::join(datasetPath, "/");
+         pFileDescriptor->setDatasetLocation(loc);
+         pDataDescriptor->setFileDescriptor(pFileDescriptor.get());
+         pDataDescriptor->setMetadata(pMetadata.get());
+         mDescriptors.push_back(pImportDescriptor.release());
+      }
+
+      struct OpenSet
+      {
+         string mName;
+         vector<pair<string, string> > mMetadata;
+      };
+
+      string mFilename;
+      vector<ImportDescriptor*>& mDescriptors;
+      unsigned int mDatasetNumber;
+      vector<OpenSet> mSets;
+      vector<bool> mOpenElements;   // true for the sets
+   };
+
+   /**
+    * Collects the signature filenames of the signature set at a dataset location as they are read.
+    *
+    * A set matches when its "Name" metadata is the dataset location part at its depth and its
+    * parent set matches. Signatures read before the name of their set are held until the name
+    * is read, so a set matches regardless of the order of its children.
+    */
+   class SignatureHandler : public DefaultHandler
    {
    public:
-      ImportDescriptorFilter() {}
-      virtual ~ImportDescriptorFilter() {}
-      virtual FilterAction acceptNode(const DOMNode* pNode) const
+      SignatureHandler(const vector<string>& datasetPath, const string& path, vector<string>& filenames) :
+         mDatasetPath(datasetPath),
+         mPath(path),
+         mFilenames(filenames)
+      {}
+
+      virtual void startElement(const XMLCh* const pUri, const XMLCh* const pLocalName, const XMLCh* const pQName,
+         const Attributes& attrs)
       {
-         if (pNode == NULL)
+         bool isSet = isElement(pQName, "signature_set");
+         bool inSet = mOpenElements.empty() == false && mOpenElements.back();
+         if (isSet)
          {
-            return FILTER_REJECT;
+            OpenSet set;
+            set.mMatched = false;
+            set.mCandidate = mSets.size() < mDatasetPath.size() && (mSets.empty() || mSets.back().mMatched);
+            mSets.push_back(set);
          }
-         if (XMLString::equals(pNode->getNodeName(), X("metadata")) ||
-            XMLString::equals(pNode->getNodeName(), X("signature_set")))
+         else if (inSet && mSets.back().mCandidate)
          {
-            return FILTER_ACCEPT;
+            OpenSet& set = mSets.back();
+            if (isElement(pQName, "metadata"))
+            {
+               if (set.mMatched == false && getAttribute(attrs, "name") == "Name" &&
+                  getAttribute(attrs, "value") == mDatasetPath[mSets.size() - 1])
+               {
+                  set.mMatched = true;
+                  mFilenames.insert(mFilenames.end(), set.mPending.begin(), set.mPending.end());
+                  set.mPending.clear();
+               }
+            }
+            else if (isElement(pQName, "signature") && mSets.size() == mDatasetPath.size())
+            {
+               string filename = getSignatureFilename(getAttribute(attrs, "filename"), mPath);
+               (set.mMatched ? mFilenames : set.mPending).push_back(filename);
+            }
          }
-         return FILTER_SKIP;
+         mOpenElements.push_back(isSet);
       }
+
+      virtual void endElement(const XMLCh* const pUri, const XMLCh* const pLocalName, const XMLCh* const pQName)
+      {
+         if (mOpenElements.back())
+         {
+            mSets.pop_back();
+         }
+         mOpenElements.pop_back();
+      }
+
+   private:
+      struct OpenSet
+      {
+         bool mCandidate;
+         bool mMatched;
+         vector<string> mPending;
+      };
+
+      vector<string> mDatasetPath;
+      string mPath;
+      vector<string>& mFilenames;
+      vector<OpenSet> mSets;
+      vector<bool> mOpenElements;   // true for the sets
    };
 };
 
 REGISTER_PLUGIN_BASIC(SpectralSignature, SignatureSetImporter);
 
-SignatureSetImporter::SignatureSetImporter() : mDatasetNumber(0)
+SignatureSetImporter::SignatureSetImporter()
 {
    setDescriptorId("{792F86A1-AAB3-4333-A3DB-39A9B13F6CC6}");
    setName("Spectral Signature Library Importer");
@@ -73,32 +396,27 @@ SignatureSetImporter::SignatureSetImporter() : mDatasetNumber(0)
 }
 
 SignatureSetImporter::~SignatureSetImporter()
-{
-   for (std::map<std::string, XmlReader*>::const_iterator xmlit = mXml.begin(); xmlit != mXml.end(); ++xmlit)
-   {
-      delete xmlit->second;
-   }
-}
-
-void SignatureSetImporter::loadDoc(const std::string& filename)
-{
-   if (mXml.find(filename) == mXml.end())
-   {
-      mXml[filename] = new XmlReader(Service<MessageLogMgr>()->getLog(), false);
-      mDoc[filename] = mXml[filename]->parse(filename);
-   }
-}
+{}
 
 unsigned char SignatureSetImporter::getFileAffinity(const string &filename)
 {
-   // is this an XML file?
-   // This is a double parse but ensures that we don't get parse errors on non-xml files
-   loadDoc(filename);
-   if (mDoc[filename] == NULL || mDoc[filename]->getDocumentElement() == NULL)
+   // is this a well-formed XML file? the whole file is scanned, but no descriptors are built
+   if (filename.empty())
    {
       return CAN_NOT_LOAD;
    }
-   return getImportDescriptors(filename).empty() ? CAN_NOT_LOAD : CAN_LOAD;
+   try
+   {
+      DocumentElementHandler handler;
+      LocalFileInputSource source(X(filename.c_str()));
+      auto_ptr<SAX2XMLReader> pReader = createReader(handler);
+      pReader->parse(source);
+      return handler.isFound() ? CAN_LOAD : CAN_NOT_LOAD;
+   }
+   catch (const SAXException&) {}
+   catch (const XMLException&) {}
+
+   return CAN_NOT_LOAD;
 }
 
 vector<ImportDescriptor*> SignatureSetImporter::getImportDescriptors(const string &filename)
@@ -108,72 +426,25 @@ vector<ImportDescriptor*> SignatureSetImporter::getImportDescriptors(const strin
    {
       return descriptors;
    }
-   mFilename = filename;
    try
    {
-      loadDoc(filename);
-      if (mDoc[filename] == NULL)
-      {
-         return descriptors;
-      }
-      FactoryResource<DynamicObject> pMetadata;
-      VERIFYRV(pMetadata.get() != NULL, descriptors);
-
-      mDatasetNumber = 0;
-      ImportDescriptorFilter filter;
-      DOMTreeWalker* pTree = mDoc[filename]->createTreeWalker(mDoc[filename]->getDocumentElement(), DOMNodeFilter::SHOW_ELEMENT, &filter, false);
-      std::vector<std::string> dummy;
-      descriptors = createImportDescriptors(pTree, dummy);
+      ImportDescriptorHandler handler(filename, descriptors);
+      LocalFileInputSource source(X(filename.c_str()));
+      auto_ptr<SAX2XMLReader> pReader = createReader(handler);
+      pReader->parse(source);
+      return descriptors;
    }
-   catch(const DOMException &) {}
-   catch(const XMLException &) {}
-
-   return descriptors;
-}
+   catch (const SAXException&) {}
+   catch (const XMLException&) {}
 
-vector<ImportDescriptor*> SignatureSetImporter::createImportDescriptors(DOMTreeWalker* pTree, vector<string> &datasetPath)
-{
-   vector<ImportDescriptor*> descriptors;
-   FactoryResource<DynamicObject> pMetadata;
-   VERIFYRV(pMetadata.get() != NULL, descriptors);
-
-   string datasetName = StringUtilities::toDisplayString(mDatasetNumber++);
-   for (DOMNode* pChld = pTree->firstChild(); pChld != NULL; pChld = pTree->nextSibling())
+   // the descriptors of a malformed file are incomplete, so none are returned
+   Service<ModelServices> pModel;
+   for (vector<ImportDescriptor*>::iterator iter = descriptors.begin(); iter != descriptors.end(); ++iter)
    {
-      if (XMLString::equals(pChld->getNodeName(), X("metadata")))
-      {
-         DOMElement* pElmnt = static_cast<DOMElement*>(pChld);
-         string name = A(pElmnt->getAttribute(X("name")));
-         string val = A(pElmnt->getAttribute(X("value")));
-         pMetadata->setAttribute(name, val);
-         if (name == "Name")
-         {
-            datasetName = val;
-         }
-      }
-      else if (XMLString::equals(pChld->getNodeName(), X("signature_set")))
-      {
-         datasetPath.push_back(datasetName);
-         vector<ImportDescriptor*> sub = createImportDescriptors(pTree, datasetPath);
-         datasetPath.pop_back();
-         descriptors.insert(descriptors.end(), sub.begin(), sub.end());
-         pTree->parentNode();
-      }
+      pModel->destroyImportDescriptor(*iter);
    }
-   ImportDescriptorResource pImportDescriptor(datasetName, "SignatureSet", datasetPath);
-   VERIFYRV(pImportDescriptor.get() != NULL, descriptors);
-   DataDescriptor* pDataDescriptor = pImportDescriptor->getDataDescriptor();
-   VERIFYRV(pDataDescriptor != NULL, descriptors);
-   FactoryResource<SignatureFileDescriptor> pFileDescriptor;
-   VERIFYRV(pFileDescriptor.get() != NULL, descriptors);
-   pFileDescriptor->setFilename(mFilename);
-   datasetPath.push_back(datasetName);
-   string loc = "/" + StringUtilities::join(datasetPath, "/");
-   datasetPath.pop_back();
-   pFileDescriptor->setDatasetLocation(loc);
-   pDataDescriptor->setFileDescriptor(pFileDescriptor.get());
-   pDataDescriptor->setMetadata(pMetadata.get());
-   descriptors.push_back(pImportDescriptor.release());
+   descriptors.clear();
+
    return descriptors;
 }
 
@@ -208,89 +479,98 @@ bool SignatureSetImporter::execute(PlugInArgList* pInArgList, PlugInArgList* Out
    progress.getCurrentStep()->addProperty("signature set", pSignatureSet->getName());
    progress.getCurrentStep()->addProperty("dataset location", pFileDescriptor->getDatasetLocation());
 
-   // locate the spot in the tree for this dataset
+   // the signatures of this dataset are imported in batches as the library file is read
+   vector<string> datasetPath;
+   vector<string> parts = StringUtilities::split(pFileDescriptor->getDatasetLocation(), '/');
+   for (vector<string>::iterator part = parts.begin(); part != parts.end(); ++part)
+   {
+      if (!part->empty())
+      {
+         datasetPath.push_back(*part);
+      }
+   }
+   string path = pFileDescriptor->getFilename().getPath();
+   double fileSize = static_cast<double>(QFileInfo(QString::fromStdString(filename)).size());
    try
    {
-      string expr;
-      vector<string> parts = StringUtilities::split(pFileDescriptor->getDatasetLocation(), '/');
-      for (vector<string>::iterator part = parts.begin(); part != parts.end(); ++part)
+      vector<string> signatureFilenames;
+      SignatureHandler handler(datasetPath, path, signatureFilenames);
+      ProgressInputSource source(filename);
+      auto_ptr<SAX2XMLReader> pReader = createReader(handler);
+      XMLPScanToken token;
+      bool more = pReader->parseFirst(source, token);
+      if (more == false)
       {
-         if (!part->empty())
-         {
-            expr += "/signature_set[metadata/@name='Name' and metadata/@value='" + *part + "']";
-         }
+         progress.report("Unable to read the spectral signature library.", 0, ERRORS, true);
+         return false;
       }
-      expr += "/signature";
-      loadDoc(filename);
-      DOMXPathResult* pResult = mXml[filename]->query(expr, DOMXPathResult::SNAPSHOT_RESULT_TYPE);
-      VERIFY(pResult != NULL);
-      int nodeTotal = pResult->getSnapshotLength();
-      for (int nodeNum = 0; nodeNum < nodeTotal; ++nodeNum)
+      while (more || signatureFilenames.empty() == false)
       {
-         if (isAborted())
+         while (more && signatureFilenames.size() < sBatchSize)
          {
-            progress.report("Aborted file " + pFileDescriptor->getFilename().getFullPathAndName(), 0, WARNING, true);
-            progress.report("User aborted the operation.", 0, ABORT, true);
-            return false;
+            more = pReader->parseNext(token);
          }
-         int percent = static_cast<int>(100.0 * nodeNum / nodeTotal);
-         progress.report("Importing signature library", percent, NORMAL);
-         if (!pResult->snapshotItem(nodeNum) || !pResult->isNode())
+         int percent = (fileSize > 0.0) ? static_cast<int>(min(100.0 * source.getBytesRead() / fileSize, 99.0)) : 0;
+
+         // parse the text signature files of the batch in parallel before they are imported one at a time
+         vector<string> batch;
+         batch.swap(signatureFilenames);
+         vector<string> textFilenames;
+         for (vector<string>::const_iterator sigFilename = batch.begin(); sigFilename != batch.end(); ++sigFilename)
          {
-            continue;
+            if (isTextSignatureFile(*sigFilename))
+            {
+               textFilenames.push_back(*sigFilename);
+            }
          }
-         const DOMElement* pElmnt = static_cast<const DOMElement*>(pResult->getNodeValue());
-         string filename = A(pElmnt->getAttribute(X("filename")));
-         if (filename.empty() == false)
+         PrefetchedFiles prefetchedFiles(textFilenames);
+
+         for (vector<string>::const_iterator sigFilename = batch.begin(); sigFilename != batch.end(); ++sigFilename)
          {
-            string path = pFileDescriptor->getFilename().getPath();
+            if (isAborted())
+            {
+               progress.report("Aborted file " + pFileDescriptor->getFilename().getFullPathAndName(), 0, WARNING, true);
+               progress.report("User aborted the operation.", 0, ABORT, true);
+               return false;
+            }
+            progress.report("Importing signature library", percent, NORMAL);
 
-            QString tempFilename = QString::fromStdString(filename);
-            if (tempFilename.startsWith("./") == true)
+            // don't pass progress to importer - the individual signature imports are rapid and passing progress will
+            // cause isAborted() to not function properly.
+            ImporterResource importer("Auto Importer", *sigFilename, NULL);
+            if (importer->getPlugIn() == NULL)
             {
-               tempFilename.replace(0, 1, QString::fromStdString(path));
-               filename = tempFilename.toStdString();
+               progress.report("The \"Auto Importer\" is not available and is required to import signature sets.",
+                  0, ERRORS, true);
+               return false;
             }
-            else
+            if (importer->execute())
             {
-               QFileInfo fileInfo(tempFilename);
-               if (fileInfo.isRelative() == true)
+               vector<DataElement*> elements = importer->getImportedElements();
+               for (vector<DataElement*>::iterator element = elements.begin(); element != elements.end(); ++element)
                {
-                  filename = path + SLASH + filename;
+                  Signature* pSig = dynamic_cast<Signature*>(*element);
+                  if (pSig != NULL)
+                  {
+                     pSignatureSet->insertSignature(pSig);
+                     // reparent the signature
+                     Service<ModelServices>()->setElementParent(pSig, pSignatureSet);
+                  }
                }
             }
-         }
-
-         // don't pass progress to importer - the individual signature imports are rapid and passing progress will
-         // cause isAborted() to not function properly.
-         ImporterResource importer("Auto Importer", filename, NULL);
-         if (importer->getPlugIn() == NULL)
-         {
-            progress.report("The \"Auto Importer\" is not available and is required to import signature sets.", 0, ERRORS, true);
-            return false;
-         }
-         if (importer->execute())
-         {
-            vector<DataElement*> elements = importer->getImportedElements();
-            vector<Signature*> sigs(elements.size(), NULL);
-            for (vector<DataElement*>::iterator element = elements.begin(); element != elements.end(); ++element)
+            else
             {
-               Signature* pSig = dynamic_cast<Signature*>(*element);
-               if (pSig != NULL)
-               {
-                  pSignatureSet->insertSignature(pSig);
-                  // reparent the signature
-                  Service<ModelServices>()->setElementParent(pSig, pSignatureSet);
-               }
+               progress.report("Unable to import signature " + *sigFilename, percent, WARNING, true);
             }
          }
-         else
-         {
-            progress.report("Unable to import signature " + filename, percent, WARNING, true);
-         }
       }
    }
-   catch(DOMException &exc)
+   catch (const SAXException& exc)
+   {
+      progress.report(A(exc.getMessage()), 0, ERRORS, true);
+      return false;
+   }
+   catch (const XMLException& exc)
    {
       progress.report(A(exc.getMessage()), 0, ERRORS, true);
       return false;
@@ -11,11 +11,17 @@
 #define SIGNATURESETIMPORTER_H
 
 #include "ImporterShell.h"
-#include "xmlreader.h"
-#include <map>
 #include <string>
 #include <vector>
 
+/**
+ * Imports the spectral signature library files written by the Spectral Signature Library Exporter.
+ *
+ * The library file is read as a stream rather than as a document, so only the signature sets
+ * which are open at the current point of the file are held in memory. The signatures of a set
+ * are imported in batches as they are read; the text signature files of each batch are parsed
+ * in parallel before the batch is imported.
+ */
 class SignatureSetImporter : public ImporterShell
 {
 public:
@@ -27,15 +33,6 @@ public:
    bool getInputSpecification(PlugInArgList*& pInArgList);
    bool getOutputSpecification(PlugInArgList*& pOutArgList);
    bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
-
-private:
-   std::vector<ImportDescriptor*> createImportDescriptors(XERCES_CPP_NAMESPACE_QUALIFIER DOMTreeWalker* pTree, std::vector<std::string>& datasetPath);
-   void loadDoc(const std::string& filename);
-
-   unsigned int mDatasetNumber;
-   std::map<std::string, XmlReader*> mXml;
-   std::map<std::string, XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument*> mDoc;
-   std::string mFilename;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,323 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QString>
+
+#include "SignatureTextParser.h"
+#include "SpectralUtilities.h"
+#include "StringUtilities.h"
+#include "TypesFile.h"
+#include "Wavelengths.h"
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+
+// The Intel Threading Building Blocks Library (tbb) is not supported on the Solaris Sparc platform
+#ifndef SOLARIS
+#include <tbb/tbb.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+   // files larger than this are split into ranges of about this many bytes which are parsed on separate threads
+   const qint64 sRangeSize = 1 << 20;
+
+   // the characters that are white space in the "C" locale
+   bool isSpace(char value)
+   {
+      return value == ' ' || value == '\t' || value == '\n' || value == '\v' || value == '\f' || value == '\r';
+   }
+
+   // plain decimal numbers are converted exactly; any other token is handled as it always has been
+   double parseValue(const char* pBegin, const char* pEnd, bool& error)
+   {
+      double value(0.0);
+      if (SpectralUtilities::parseDecimal(pBegin, pEnd, value))
+      {
+         error = false;
+         return value;
+      }
+
+      return StringUtilities::fromXmlString<double>(string(pBegin, pEnd), &error);
+   }
+
+   // parses one line the same way as trimming it and splitting it at every white space character
+   void parseLine(const char* pBegin, const char* pEnd, SignatureTextParser::ParsedSignature& signature)
+   {
+      while (pBegin != pEnd && isSpace(*pBegin))
+      {
+         ++pBegin;
+      }
+      while (pEnd != pBegin && isSpace(*(pEnd - 1)))
+      {
+         --pEnd;
+      }
+      if (pBegin == pEnd || std::find(pBegin, pEnd, '=') != pEnd)
+      {
+         return;
+      }
+
+      const char* pFirstEnd = std::find_if(pBegin, pEnd, isSpace);
+      size_t numTokens = 1 + std::count_if(pFirstEnd, pEnd, isSpace);
+
+      bool error(true);
+      double wavelength = parseValue(pBegin, pFirstEnd, error);
+      if (wavelength > 50.0)
+      {
+         // Assume wavelength values are in nanometers and convert to microns
+         wavelength = Wavelengths::convertValue(wavelength, NANOMETERS, MICRONS);
+      }
+      double reflectance(0.0);
+      if (!error && numTokens == 2)
+      {
+         reflectance = parseValue(pFirstEnd + 1, pEnd, error);
+
+         // the importer decides from the units whether the large values are counted
+         if (fabs(reflectance) > 2.0)
+         {
+            ++signature.mNumLargeValues;
+         }
+      }
+      if (error)
+      {
+         ++signature.mNumErrors;
+      }
+
+      signature.mWavelengths.push_back(wavelength);
+      signature.mReflectances.push_back(reflectance);
+   }
+
+   void parseLines(const char* pBegin, const char* pEnd, SignatureTextParser::ParsedSignature& signature)
+   {
+      while (pBegin != pEnd)
+      {
+         const char* pLineEnd = std::find(pBegin, pEnd, '\n');
+         parseLine(pBegin, pLineEnd, signature);
+         pBegin = (pLineEnd == pEnd) ? pEnd : pLineEnd + 1;
+      }
+   }
+
+   class RangeParser
+   {
+   public:
+      RangeParser(const char* pData, const vector<qint64>& rangeStarts,
+         vector<SignatureTextParser::ParsedSignature>& ranges) :
+         mpData(pData),
+         mRangeStarts(rangeStarts),
+         mRanges(ranges)
+      {}
+
+      void parse(size_t rangeBegin, size_t rangeEnd) const
+      {
+         for (size_t range = rangeBegin; range < rangeEnd; ++range)
+         {
+            parseLines(mpData + mRangeStarts[range], mpData + mRangeStarts[range + 1], mRanges[range]);
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<size_t>& range) const
+      {
+         parse(range.begin(), range.end());
+      }
+#endif
+
+   private:
+      const char* mpData;
+      const vector<qint64>& mRangeStarts;
+      vector<SignatureTextParser::ParsedSignature>& mRanges;
+   };
+
+   void parseData(const char* pData, qint64 size, SignatureTextParser::ParsedSignature& signature)
+   {
+      // split the data into ranges which each start at the beginning of a line
+      vector<qint64> rangeStarts(1, 0);
+      while (size - rangeStarts.back() > sRangeSize)
+      {
+         const char* pStart = pData + rangeStarts.back() + sRangeSize;
+         const char* pLineEnd = std::find(pStart, pData + size, '\n');
+         if (pLineEnd == pData + size)
+         {
+            break;
+         }
+         rangeStarts.push_back(pLineEnd + 1 - pData);
+      }
+      rangeStarts.push_back(size);
+
+      size_t numRanges = rangeStarts.size() - 1;
+      if (numRanges == 1)
+      {
+         parseLines(pData, pData + size, signature);
+         return;
+      }
+
+      vector<SignatureTextParser::ParsedSignature> ranges(numRanges);
+      RangeParser parser(pData, rangeStarts, ranges);
+#if defined SOLARIS  // tbb not available under solaris so parse the ranges on this thread
+      parser.parse(0, numRanges);
+#else
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, numRanges, 1), parser);
+#endif
+
+      for (vector<SignatureTextParser::ParsedSignature>::const_iterator it = ranges.begin(); it != ranges.end(); ++it)
+      {
+         signature.mWavelengths.insert(signature.mWavelengths.end(), it->mWavelengths.begin(), it->mWavelengths.end());
+         signature.mReflectances.insert(signature.mReflectances.end(), it->mReflectances.begin(),
+            it->mReflectances.end());
+         signature.mNumErrors += it->mNumErrors;
+         signature.mNumLargeValues += it->mNumLargeValues;
+      }
+   }
+
+   struct PrefetchedFile
+   {
+      qint64 mSize;
+      QDateTime mModified;
+      bool mParsed;
+      SignatureTextParser::ParsedSignature mSignature;
+   };
+
+   // only accessed from the thread importing the signatures
+   map<string, PrefetchedFile>& getPrefetchedFiles()
+   {
+      static map<string, PrefetchedFile> sPrefetchedFiles;
+      return sPrefetchedFiles;
+   }
+
+   class FileParser
+   {
+   public:
+      FileParser(const vector<string>& filenames, vector<PrefetchedFile>& files) :
+         mFilenames(filenames),
+         mFiles(files)
+      {}
+
+      void parse(size_t fileBegin, size_t fileEnd) const
+      {
+         for (size_t file = fileBegin; file < fileEnd; ++file)
+         {
+            mFiles[file].mParsed = SignatureTextParser::parseFile(mFilenames[file], mFiles[file].mSignature);
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<size_t>& range) const
+      {
+         parse(range.begin(), range.end());
+      }
+#endif
+
+   private:
+      const vector<string>& mFilenames;
+      vector<PrefetchedFile>& mFiles;
+   };
+}
+
+namespace SignatureTextParser
+{
+   bool parseFile(const string& filename, ParsedSignature& signature)
+   {
+      signature = ParsedSignature();
+      QFile file(QString::fromStdString(filename));
+      if (file.open(QIODevice::ReadOnly) == false)
+      {
+         return false;
+      }
+
+      qint64 size = file.size();
+      if (size <= 0)
+      {
+         return true;
+      }
+
+      // read the file if it can not be mapped
+      const char* pData = reinterpret_cast<const char*>(file.map(0, size));
+      QByteArray contents;
+      if (pData == NULL)
+      {
+         contents = file.readAll();
+         if (static_cast<qint64>(contents.size()) != size)
+         {
+            return false;
+         }
+         pData = contents.constData();
+      }
+
+      parseData(pData, size, signature);
+      return true;
+   }
+
+   void prefetchFiles(const vector<string>& filenames)
+   {
+      // the file information is read first so a file which changes while it is parsed is not used
+      vector<PrefetchedFile> files(filenames.size());
+      for (vector<string>::size_type file = 0; file < filenames.size(); ++file)
+      {
+         QFileInfo fileInfo(QString::fromStdString(filenames[file]));
+         files[file].mSize = fileInfo.size();
+         files[file].mModified = fileInfo.lastModified();
+         files[file].mParsed = false;
+      }
+
+      FileParser parser(filenames, files);
+#if defined SOLARIS  // tbb not available under solaris so parse the files on this thread
+      parser.parse(0, files.size());
+#else
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, files.size(), 1), parser);
+#endif
+
+      map<string, PrefetchedFile>& prefetchedFiles = getPrefetchedFiles();
+      for (vector<string>::size_type file = 0; file < filenames.size(); ++file)
+      {
+         if (files[file].mParsed)
+         {
+            prefetchedFiles[filenames[file]] = files[file];
+         }
+      }
+   }
+
+   bool takePrefetchedFile(const string& filename, ParsedSignature& signature)
+   {
+      map<string, PrefetchedFile>& prefetchedFiles = getPrefetchedFiles();
+      map<string, PrefetchedFile>::iterator it = prefetchedFiles.find(filename);
+      if (it == prefetchedFiles.end())
+      {
+         return false;
+      }
+
+      QFileInfo fileInfo(QString::fromStdString(filename));
+      bool unchanged = (fileInfo.size() == it->second.mSize && fileInfo.lastModified() == it->second.mModified);
+      if (unchanged)
+      {
+         signature.mWavelengths.swap(it->second.mSignature.mWavelengths);
+         signature.mReflectances.swap(it->second.mSignature.mReflectances);
+         signature.mNumErrors = it->second.mSignature.mNumErrors;
+         signature.mNumLargeValues = it->second.mSignature.mNumLargeValues;
+      }
+      prefetchedFiles.erase(it);
+
+      return unchanged;
+   }
+
+   void clearPrefetchedFiles(const vector<string>& filenames)
+   {
+      map<string, PrefetchedFile>& prefetchedFiles = getPrefetchedFiles();
+      for (vector<string>::const_iterator it = filenames.begin(); it != filenames.end(); ++it)
+      {
+         prefetchedFiles.erase(*it);
+      }
+   }
+}
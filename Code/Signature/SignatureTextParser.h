@@ -0,0 +1,89 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef SIGNATURETEXTPARSER_H
+#define SIGNATURETEXTPARSER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Parses the data lines of the text signature files read by the Spectral Signature Importer.
+ *
+ * The file is memory mapped and its lines are parsed in place. Large files are split into
+ * ranges of whole lines which are parsed on separate threads and joined in file order.
+ * Values are converted with an exact fast path for plain decimal numbers and with
+ * StringUtilities::fromXmlString() for anything else, so the values are the same as
+ * converting each token with StringUtilities.
+ *
+ * Nothing here touches the Opticks model, so several files can also be parsed at once.
+ */
+namespace SignatureTextParser
+{
+   struct ParsedSignature
+   {
+      ParsedSignature() :
+         mNumErrors(0),
+         mNumLargeValues(0)
+      {}
+
+      std::vector<double> mWavelengths;   // in microns; values over 50 are converted from nanometers
+      std::vector<double> mReflectances;  // unscaled
+      unsigned int mNumErrors;            // data lines with a value which could not be converted
+      size_t mNumLargeValues;             // reflectances with a magnitude over 2.0
+   };
+
+   /**
+    * Parses the data lines of a signature file.
+    *
+    * Blank lines and lines containing '=' are skipped. Every other line adds a wavelength and
+    * a reflectance; the reflectance is only read from lines with exactly two values.
+    *
+    * @param filename
+    *        The full path of the file.
+    * @param signature
+    *        Receives the data of the file.
+    *
+    * @return \c true if the file could be read, \c false otherwise.
+    */
+   bool parseFile(const std::string& filename, ParsedSignature& signature);
+
+   /**
+    * Parses several signature files at once and keeps the data for the importer.
+    *
+    * A later takePrefetchedFile() for one of the files returns its data instead of parsing
+    * it again, so importing a list of files one at a time still parses them in parallel.
+    *
+    * @param filenames
+    *        The full paths of the files.
+    */
+   void prefetchFiles(const std::vector<std::string>& filenames);
+
+   /**
+    * Removes the data of a prefetched file.
+    *
+    * @param filename
+    *        The full path of the file.
+    * @param signature
+    *        Receives the data of the file.
+    *
+    * @return \c true if the file was prefetched and has not changed since, \c false otherwise.
+    */
+   bool takePrefetchedFile(const std::string& filename, ParsedSignature& signature);
+
+   /**
+    * Discards the data of any of the files which have not been taken.
+    *
+    * @param filenames
+    *        The full paths of the files.
+    */
+   void clearPrefetchedFiles(const std::vector<std::string>& filenames);
+}
+
+#endif
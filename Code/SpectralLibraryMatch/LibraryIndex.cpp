@@ -0,0 +1,108 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+// Keep this include here..it uses an OpenCV macro X.
+// Moving this after Opticks includes will incorrectly use the Xerces X macro.
+#include <cstddef>
+#include <opencv/cv.h>
+
+#include "AppVerify.h"
+#include "LibraryIndex.h"
+#include "SpectralLibraryMatch.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace SpectralLibraryMatch
+{
+   LibraryIndex::LibraryIndex() :
+      mNumSignatures(0),
+      mNumBands(0),
+      mpIndex(NULL)
+   {}
+
+   LibraryIndex::~LibraryIndex()
+   {
+      delete mpIndex;
+   }
+
+   bool LibraryIndex::build(const LibraryStatistics& libStats, unsigned int numTrees)
+   {
+      VERIFY(libStats.mNumSignatures > 0 && libStats.mNumBands > 1 && numTrees > 0 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+
+      delete mpIndex;
+      mpIndex = NULL;
+      mNumSignatures = 0;
+      mNumBands = libStats.mNumBands;
+      mData.assign(libStats.mNormalizedData.begin(), libStats.mNormalizedData.end());
+
+      cv::Mat features(static_cast<int>(libStats.mNumSignatures), static_cast<int>(mNumBands), CV_32F,
+         &mData.front());
+      mpIndex = new cv::flann::Index(features, cv::flann::KDTreeIndexParams(static_cast<int>(numTrees)));
+      mNumSignatures = libStats.mNumSignatures;
+
+      return true;
+   }
+
+   unsigned int LibraryIndex::getNumSignatures() const
+   {
+      return mNumSignatures;
+   }
+
+   bool LibraryIndex::findCandidates(const double* pTarget, unsigned int numCandidates, unsigned int numChecks,
+      std::vector<int>& candidates) const
+   {
+      VERIFY(pTarget != NULL && mpIndex != NULL);
+      numCandidates = std::min(numCandidates, mNumSignatures);
+      candidates.clear();
+      if (numCandidates == 0)
+      {
+         return true;
+      }
+
+      double sumSquares(0.0);
+      for (unsigned int band = 0; band < mNumBands; ++band)
+      {
+         sumSquares += pTarget[band] * pTarget[band];
+      }
+      if (sumSquares <= 0.0)
+      {
+         // a zero target is 90 degrees from every signature so the earliest signatures are the best matches
+         for (unsigned int sig = 0; sig < numCandidates; ++sig)
+         {
+            candidates.push_back(static_cast<int>(sig));
+         }
+         return true;
+      }
+
+      double scale = 1.0 / sqrt(sumSquares);
+      std::vector<float> query(mNumBands);
+      for (unsigned int band = 0; band < mNumBands; ++band)
+      {
+         query[band] = static_cast<float>(pTarget[band] * scale);
+      }
+
+      std::vector<int> indices(numCandidates);
+      std::vector<float> dists(numCandidates);
+      mpIndex->knnSearch(query, indices, dists, static_cast<int>(numCandidates),
+         cv::flann::SearchParams(static_cast<int>(std::max(numChecks, numCandidates))));
+
+      candidates.reserve(numCandidates);
+      for (std::vector<int>::const_iterator it = indices.begin(); it != indices.end(); ++it)
+      {
+         if (*it >= 0 && static_cast<unsigned int>(*it) < mNumSignatures)
+         {
+            candidates.push_back(*it);
+         }
+      }
+
+      return true;
+   }
+}
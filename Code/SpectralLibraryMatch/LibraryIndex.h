@@ -0,0 +1,88 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <vector>
+
+namespace cv
+{
+   namespace flann
+   {
+      class Index;
+   }
+}
+
+namespace SpectralLibraryMatch
+{
+   struct LibraryStatistics;
+
+   /**
+    *  Approximate nearest neighbor index of a resampled library.
+    *
+    *  The index is a randomized kd-tree forest built over the unit-normalized library
+    *  rows. The Euclidean distance between two unit vectors increases with the angle
+    *  between them, so the nearest rows to a normalized target are the signatures with
+    *  the smallest spectral angles. The candidates returned by the index are meant to
+    *  be rescored exactly with the selected match algorithm.
+    */
+   class LibraryIndex
+   {
+   public:
+      LibraryIndex();
+      ~LibraryIndex();
+
+      /**
+       *  Builds the index.
+       *
+       *  @param   libStats
+       *           The statistics of the resampled library. The normalized rows are copied.
+       *  @param   numTrees
+       *           The number of randomized kd-trees in the forest.
+       *
+       *  @return  \c true if the index was built, \c false otherwise.
+       */
+      bool build(const LibraryStatistics& libStats, unsigned int numTrees);
+
+      /**
+       *  Returns the number of signatures in the index or zero if it has not been built.
+       */
+      unsigned int getNumSignatures() const;
+
+      /**
+       *  Finds the library signatures closest in angle to a target.
+       *
+       *  @param   pTarget
+       *           The target spectrum. It does not need to be normalized.
+       *  @param   numCandidates
+       *           The number of signatures to return.
+       *  @param   numChecks
+       *           The number of leaves to visit while searching. Larger values give a
+       *           more accurate but slower search.
+       *  @param   candidates
+       *           Receives the row indices of the signatures closest to \em pTarget.
+       *
+       *  @return  \c true if the search succeeded, \c false otherwise.
+       */
+      bool findCandidates(const double* pTarget, unsigned int numCandidates, unsigned int numChecks,
+         std::vector<int>& candidates) const;
+
+   private:
+      LibraryIndex(const LibraryIndex& rhs);
+      LibraryIndex& operator=(const LibraryIndex& rhs);
+
+      unsigned int mNumSignatures;
+      unsigned int mNumBands;
+      std::vector<float> mData;     // the index refers to these rows so they are kept for its lifetime
+      cv::flann::Index* mpIndex;
+   };
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+// Keep this include here..it uses an OpenCV macro X.
+// Moving this after Opticks includes will incorrectly use the Xerces X macro.
+#include <cstddef>
+#include <opencv/cv.h>
+
+#include "AppVerify.h"
+#include "LibraryProjection.h"
+#include "SpectralLibraryMatch.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace SpectralLibraryMatch
+{
+   LibraryProjection::LibraryProjection() :
+      mNumSignatures(0),
+      mNumBands(0),
+      mNumComponents(0)
+   {}
+
+   LibraryProjection::~LibraryProjection()
+   {}
+
+   bool LibraryProjection::build(const LibraryStatistics& libStats, unsigned int numComponents)
+   {
+      VERIFY(libStats.mNumSignatures > 0 && libStats.mNumBands > 1 && numComponents > 0 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+
+      mNumSignatures = 0;
+      mNumBands = libStats.mNumBands;
+      mNumComponents = std::min(numComponents, std::min(libStats.mNumBands, libStats.mNumSignatures));
+
+      // the rows of the eigenvectors are in order of decreasing eigenvalue
+      cv::Mat rows(static_cast<int>(libStats.mNumSignatures), static_cast<int>(mNumBands), CV_64F,
+         const_cast<double*>(&libStats.mNormalizedData.front()));
+      cv::Mat scatter;
+      cv::mulTransposed(rows, scatter, true);
+      cv::Mat eigenvalues;
+      cv::Mat eigenvectors;
+      VERIFY(cv::eigen(scatter, eigenvalues, eigenvectors));
+
+      mBasis.resize(static_cast<size_t>(mNumComponents) * mNumBands);
+      for (unsigned int component = 0; component < mNumComponents; ++component)
+      {
+         const double* pVector = eigenvectors.ptr<double>(static_cast<int>(component));
+         std::copy(pVector, pVector + mNumBands, mBasis.begin() + static_cast<size_t>(component) * mNumBands);
+      }
+
+      mProjectedData.resize(static_cast<size_t>(libStats.mNumSignatures) * mNumComponents);
+      mResidualNorms.resize(libStats.mNumSignatures);
+      for (unsigned int sig = 0; sig < libStats.mNumSignatures; ++sig)
+      {
+         double* pComponents = &mProjectedData[static_cast<size_t>(sig) * mNumComponents];
+         project(&libStats.mNormalizedData[static_cast<size_t>(sig) * mNumBands], pComponents);
+
+         // a zero signature has a normalized row of zeros and so no residual
+         double sumSquares(0.0);
+         for (unsigned int component = 0; component < mNumComponents; ++component)
+         {
+            sumSquares += pComponents[component] * pComponents[component];
+         }
+         double rowSquares = (libStats.mNorms[sig] > 0.0) ? 1.0 : 0.0;
+         mResidualNorms[sig] = sqrt(std::max(rowSquares - sumSquares, 0.0));
+      }
+      mNumSignatures = libStats.mNumSignatures;
+
+      return true;
+   }
+
+   unsigned int LibraryProjection::getNumSignatures() const
+   {
+      return mNumSignatures;
+   }
+
+   unsigned int LibraryProjection::getNumBands() const
+   {
+      return mNumBands;
+   }
+
+   unsigned int LibraryProjection::getNumComponents() const
+   {
+      return mNumComponents;
+   }
+
+   void LibraryProjection::project(const double* pTarget, double* pComponents) const
+   {
+      const double* pBasis = mBasis.empty() ? NULL : &mBasis.front();
+      for (unsigned int component = 0; component < mNumComponents; ++component, pBasis += mNumBands)
+      {
+         double value(0.0);
+         for (unsigned int band = 0; band < mNumBands; ++band)
+         {
+            value += pTarget[band] * pBasis[band];
+         }
+         pComponents[component] = value;
+      }
+   }
+
+   const double* LibraryProjection::getComponents(unsigned int sig) const
+   {
+      return &mProjectedData[static_cast<size_t>(sig) * mNumComponents];
+   }
+
+   double LibraryProjection::getResidualNorm(unsigned int sig) const
+   {
+      return mResidualNorms[sig];
+   }
+}
@@ -0,0 +1,97 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef LIBRARYPROJECTION_H
+#define LIBRARYPROJECTION_H
+
+#include <vector>
+
+namespace SpectralLibraryMatch
+{
+   struct LibraryStatistics;
+
+   /**
+    *  Projection of a resampled library onto its leading principal components.
+    *
+    *  The components are the eigenvectors of the uncentered scatter matrix of the
+    *  unit-normalized library rows, so they form an orthonormal basis for the
+    *  subspace holding most of the energy of the library. Splitting a target and a
+    *  row into their parts in and out of that subspace bounds their product:
+    *  t.l = Pt.Pl + Rt.Rl and |Rt.Rl| <= |Rt||Rl|. The bound needs only the few
+    *  projected values and the two residual lengths, so it is much cheaper to
+    *  compute than the product over every band.
+    */
+   class LibraryProjection
+   {
+   public:
+      LibraryProjection();
+      ~LibraryProjection();
+
+      /**
+       *  Computes the principal components and projects the library onto them.
+       *
+       *  @param   libStats
+       *           The statistics of the resampled library.
+       *  @param   numComponents
+       *           The number of components to keep. Fewer are kept if the library
+       *           has fewer bands or signatures.
+       *
+       *  @return  \c true if the projection was built, \c false otherwise.
+       */
+      bool build(const LibraryStatistics& libStats, unsigned int numComponents);
+
+      /**
+       *  Returns the number of signatures in the projection or zero if it has not been built.
+       */
+      unsigned int getNumSignatures() const;
+
+      /**
+       *  Returns the number of bands of the projected library.
+       */
+      unsigned int getNumBands() const;
+
+      /**
+       *  Returns the number of principal components.
+       */
+      unsigned int getNumComponents() const;
+
+      /**
+       *  Projects a target onto the principal components.
+       *
+       *  @param   pTarget
+       *           The target spectrum with a value for each band.
+       *  @param   pComponents
+       *           Receives the component values of the target.
+       */
+      void project(const double* pTarget, double* pComponents) const;
+
+      /**
+       *  Returns the component values of a unit-normalized library row.
+       */
+      const double* getComponents(unsigned int sig) const;
+
+      /**
+       *  Returns the length of the part of a unit-normalized library row outside of the components.
+       */
+      double getResidualNorm(unsigned int sig) const;
+
+   private:
+      LibraryProjection(const LibraryProjection& rhs);
+      LibraryProjection& operator=(const LibraryProjection& rhs);
+
+      unsigned int mNumSignatures;
+      unsigned int mNumBands;
+      unsigned int mNumComponents;
+      std::vector<double> mBasis;           // components x bands
+      std::vector<double> mProjectedData;   // signatures x components
+      std::vector<double> mResidualNorms;
+   };
+}
+
+#endif
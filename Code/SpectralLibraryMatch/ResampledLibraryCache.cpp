@@ -0,0 +1,258 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AppVerify.h"
+#include "ConfigurationSettings.h"
+#include "DataVariant.h"
+#include "ResampledLibraryCache.h"
+#include "Signature.h"
+#include "SpectralLibraryMatch.h"
+#include "SpectralLibraryMatchOptions.h"
+#include "Units.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStringList>
+#include <QtGui/QDesktopServices>
+
+#include <string.h>
+
+namespace
+{
+   // Increment the version when the file layout or the resampling changes so old files are ignored.
+   const char sCacheMagic[8] = { 'S', 'L', 'M', 'C', 'A', 'C', 'H', 'E' };
+   const quint32 sCacheVersion = 1;
+   const quint32 sByteOrderMark = 0x01020304;
+
+   // the least recently written files are removed once the cache files are larger than this in total
+   const qint64 sMaxCacheBytes = static_cast<qint64>(512) * 1024 * 1024;
+
+   struct CacheHeader
+   {
+      char mMagic[8];
+      quint32 mVersion;
+      quint32 mByteOrder;
+      quint32 mNumSignatures;
+      quint32 mNumRows;
+      quint32 mNumBands;
+      quint32 mReserved;
+   };
+
+   // the rows of doubles start on an eight byte boundary after the header and the signature indices
+   qint64 getDataOffset(quint32 numRows)
+   {
+      qint64 offset = static_cast<qint64>(sizeof(CacheHeader)) + static_cast<qint64>(numRows) * sizeof(quint32);
+      return (offset + 7) & ~static_cast<qint64>(7);
+   }
+
+   QString getCacheFilename(const std::string& fingerprint)
+   {
+      return QDir(QString::fromStdString(ResampledLibraryCache::getCacheDirectory())).filePath(
+         QString::fromStdString(fingerprint) + ".slc");
+   }
+
+   void addToHash(QCryptographicHash& hash, const void* pData, size_t numBytes)
+   {
+      hash.addData(reinterpret_cast<const char*>(pData), static_cast<int>(numBytes));
+   }
+
+   void addToHash(QCryptographicHash& hash, const std::vector<double>& values)
+   {
+      quint32 count = static_cast<quint32>(values.size());
+      addToHash(hash, &count, sizeof(count));
+      if (values.empty() == false)
+      {
+         addToHash(hash, &values.front(), values.size() * sizeof(double));
+      }
+   }
+
+   // The Resampler options are read by key because the Resampler plug-in does not export its options class.
+   void addSettingToHash(QCryptographicHash& hash, const std::string& key)
+   {
+      std::string value = Service<ConfigurationSettings>()->getSetting(key).toXmlString();
+      quint32 count = static_cast<quint32>(value.size());
+      addToHash(hash, &count, sizeof(count));
+      addToHash(hash, value.data(), value.size());
+   }
+
+   void pruneCache(const QString& keepFilename)
+   {
+      QDir cacheDir(QString::fromStdString(ResampledLibraryCache::getCacheDirectory()));
+      QFileInfoList files = cacheDir.entryInfoList(QStringList() << "*.slc", QDir::Files, QDir::Time);
+      qint64 totalBytes = 0;
+      for (QFileInfoList::const_iterator it = files.begin(); it != files.end(); ++it)
+      {
+         if (totalBytes + it->size() > sMaxCacheBytes && it->fileName() != keepFilename)
+         {
+            QFile::remove(it->absoluteFilePath());
+            continue;
+         }
+         totalBytes += it->size();
+      }
+   }
+}
+
+namespace ResampledLibraryCache
+{
+   std::string getCacheDirectory()
+   {
+      std::string directory = SpectralLibraryMatchOptions::getSettingResampledLibraryCachePath();
+      if (directory.empty())
+      {
+         directory = QDir(QDesktopServices::storageLocation(QDesktopServices::CacheLocation)).filePath(
+            "SpectralLibraryMatch").toStdString();
+      }
+
+      return directory;
+   }
+
+   bool getFingerprint(const std::vector<Signature*>& signatures, UnitType units,
+      const std::vector<double>& wavelengths, const std::vector<double>& fwhm, std::string& fingerprint)
+   {
+      QCryptographicHash hash(QCryptographicHash::Sha1);
+      addToHash(hash, &sCacheVersion, sizeof(sCacheVersion));
+      int unitValue = static_cast<int>(units);
+      addToHash(hash, &unitValue, sizeof(unitValue));
+      quint32 numSignatures = static_cast<quint32>(signatures.size());
+      addToHash(hash, &numSignatures, sizeof(numSignatures));
+      for (std::vector<Signature*>::const_iterator it = signatures.begin(); it != signatures.end(); ++it)
+      {
+         VERIFY(*it != NULL);
+         const std::vector<double>* pWaves = dv_cast<std::vector<double> >(
+            &(*it)->getData(SpectralLibraryMatch::getNameSignatureWavelengthData()));
+         const std::vector<double>* pValues = dv_cast<std::vector<double> >(
+            &(*it)->getData(SpectralLibraryMatch::getNameSignatureAmplitudeData()));
+         const Units* pUnits = (*it)->getUnits(SpectralLibraryMatch::getNameSignatureAmplitudeData());
+         VERIFY(pWaves != NULL && pValues != NULL && pUnits != NULL);
+         double scaleFactor = pUnits->getScaleFromStandard();
+         addToHash(hash, *pWaves);
+         addToHash(hash, *pValues);
+         addToHash(hash, &scaleFactor, sizeof(scaleFactor));
+      }
+      addToHash(hash, wavelengths);
+      addToHash(hash, fwhm);
+
+      // the same Resampler options which key the Resampler's own matrix cache
+      addSettingToHash(hash, "Resampler/ResamplerMethod");
+      addSettingToHash(hash, "Resampler/DropOutWindow");
+      addSettingToHash(hash, "Resampler/FullWidthHalfMax");
+      addSettingToHash(hash, "Resampler/GaussianSupport");
+      fingerprint = QString(hash.result().toHex()).toStdString();
+
+      return true;
+   }
+
+   bool load(const std::string& fingerprint, unsigned int numSignatures, unsigned int numBands,
+      std::vector<unsigned int>& signatureIndices, std::vector<std::vector<double> >& resampledData)
+   {
+      QFile cacheFile(getCacheFilename(fingerprint));
+      if (cacheFile.exists() == false || cacheFile.open(QIODevice::ReadOnly) == false)
+      {
+         return false;
+      }
+      qint64 fileSize = cacheFile.size();
+      if (fileSize < static_cast<qint64>(sizeof(CacheHeader)))
+      {
+         return false;
+      }
+      const uchar* pFile = cacheFile.map(0, fileSize);
+      if (pFile == NULL)
+      {
+         return false;
+      }
+
+      CacheHeader header;
+      memcpy(&header, pFile, sizeof(header));
+      bool valid = memcmp(header.mMagic, sCacheMagic, sizeof(sCacheMagic)) == 0 &&
+         header.mVersion == sCacheVersion && header.mByteOrder == sByteOrderMark &&
+         header.mNumSignatures == numSignatures && header.mNumBands == numBands &&
+         header.mNumRows <= numSignatures &&
+         fileSize == getDataOffset(header.mNumRows) +
+            static_cast<qint64>(header.mNumRows) * header.mNumBands * sizeof(double);
+      if (valid)
+      {
+         const quint32* pIndices = reinterpret_cast<const quint32*>(pFile + sizeof(CacheHeader));
+         const double* pData = reinterpret_cast<const double*>(pFile + getDataOffset(header.mNumRows));
+         signatureIndices.assign(pIndices, pIndices + header.mNumRows);
+         resampledData.resize(header.mNumRows);
+         for (quint32 row = 0; row < header.mNumRows; ++row, pData += numBands)
+         {
+            valid = valid && signatureIndices[row] < numSignatures;
+            resampledData[row].assign(pData, pData + numBands);
+         }
+      }
+      cacheFile.unmap(const_cast<uchar*>(pFile));
+
+      return valid;
+   }
+
+   bool save(const std::string& fingerprint, unsigned int numSignatures,
+      const std::vector<unsigned int>& signatureIndices, const std::vector<std::vector<double> >& resampledData)
+   {
+      VERIFY(signatureIndices.size() == resampledData.size());
+      if (QDir().mkpath(QString::fromStdString(getCacheDirectory())) == false)
+      {
+         return false;
+      }
+
+      CacheHeader header;
+      memcpy(header.mMagic, sCacheMagic, sizeof(sCacheMagic));
+      header.mVersion = sCacheVersion;
+      header.mByteOrder = sByteOrderMark;
+      header.mNumSignatures = numSignatures;
+      header.mNumRows = static_cast<quint32>(resampledData.size());
+      header.mNumBands = resampledData.empty() ? 0 : static_cast<quint32>(resampledData.front().size());
+      header.mReserved = 0;
+
+      QString filename = getCacheFilename(fingerprint);
+      QString tempFilename = filename + ".tmp";
+      QFile cacheFile(tempFilename);
+      if (cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+      {
+         return false;
+      }
+
+      QByteArray preamble(static_cast<int>(getDataOffset(header.mNumRows)), '\0');
+      memcpy(preamble.data(), &header, sizeof(header));
+      for (quint32 row = 0; row < header.mNumRows; ++row)
+      {
+         quint32 index = signatureIndices[row];
+         memcpy(preamble.data() + sizeof(header) + row * sizeof(quint32), &index, sizeof(index));
+      }
+      bool success = cacheFile.write(preamble) == preamble.size();
+      for (std::vector<std::vector<double> >::const_iterator it = resampledData.begin();
+         success && it != resampledData.end(); ++it)
+      {
+         qint64 numBytes = static_cast<qint64>(header.mNumBands * sizeof(double));
+         success = it->size() == header.mNumBands &&
+            cacheFile.write(reinterpret_cast<const char*>(&it->front()), numBytes) == numBytes;
+      }
+      cacheFile.close();
+
+      // replace any older file for the same fingerprint with the complete file
+      if (success)
+      {
+         QFile::remove(filename);
+         success = QFile::rename(tempFilename, filename);
+      }
+      if (success == false)
+      {
+         QFile::remove(tempFilename);
+      }
+      else
+      {
+         pruneCache(QFileInfo(filename).fileName());
+      }
+
+      return success;
+   }
+}
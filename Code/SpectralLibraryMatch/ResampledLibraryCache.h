@@ -0,0 +1,102 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef RESAMPLEDLIBRARYCACHE_H
+#define RESAMPLEDLIBRARYCACHE_H
+
+#include "TypesFile.h"
+
+#include <string>
+#include <vector>
+
+class Signature;
+
+/**
+ * On-disk cache of resampled spectral libraries.
+ *
+ * Each cache file holds the resampled rows of one library for one set of
+ * band wavelengths. The file is named by a fingerprint of the library
+ * contents, the wavelengths and the Resampler options, so any later scene
+ * from the same sensor finds it regardless of which session or element it
+ * came from. The files are read by mapping them into memory. The least
+ * recently written files are removed when the cache grows past 512 MB.
+ */
+namespace ResampledLibraryCache
+{
+   /**
+    *  Returns the directory holding the cache files.
+    *
+    *  This is the cache path from the Spectral Library Match options, or a
+    *  directory in the user's cache location if the option is empty.
+    */
+   std::string getCacheDirectory();
+
+   /**
+    *  Computes the fingerprint of a library resampled to a set of bands with
+    *  the current Resampler options.
+    *
+    *  @param   signatures
+    *           The library signatures in library order.
+    *  @param   units
+    *           The unit type of the library.
+    *  @param   wavelengths
+    *           The center wavelengths of the bands.
+    *  @param   fwhm
+    *           The full width at half maximum of the bands. This may be empty.
+    *  @param   fingerprint
+    *           Receives the fingerprint as a hexadecimal string.
+    *
+    *  @return  \c true if the fingerprint was computed, \c false if a signature
+    *           does not contain valid data.
+    */
+   bool getFingerprint(const std::vector<Signature*>& signatures, UnitType units,
+      const std::vector<double>& wavelengths, const std::vector<double>& fwhm, std::string& fingerprint);
+
+   /**
+    *  Reads a resampled library from the cache.
+    *
+    *  @param   fingerprint
+    *           The fingerprint from getFingerprint().
+    *  @param   numSignatures
+    *           The number of signatures in the library.
+    *  @param   numBands
+    *           The number of bands the library was resampled to.
+    *  @param   signatureIndices
+    *           Receives the library index of the signature in each resampled row.
+    *  @param   resampledData
+    *           Receives the resampled rows.
+    *
+    *  @return  \c true if a valid cache file was read, \c false otherwise.
+    */
+   bool load(const std::string& fingerprint, unsigned int numSignatures, unsigned int numBands,
+      std::vector<unsigned int>& signatureIndices, std::vector<std::vector<double> >& resampledData);
+
+   /**
+    *  Writes a resampled library to the cache.
+    *
+    *  The file is written under a temporary name and then renamed, so a
+    *  partially written file is never read. The least recently written files
+    *  are then removed until the cache is within its size limit.
+    *
+    *  @param   fingerprint
+    *           The fingerprint from getFingerprint().
+    *  @param   numSignatures
+    *           The number of signatures in the library.
+    *  @param   signatureIndices
+    *           The library index of the signature in each resampled row.
+    *  @param   resampledData
+    *           The resampled rows. Every row must have the same number of bands.
+    *
+    *  @return  \c true if the cache file was written, \c false otherwise.
+    */
+   bool save(const std::string& fingerprint, unsigned int numSignatures,
+      const std::vector<unsigned int>& signatureIndices, const std::vector<std::vector<double> >& resampledData);
+}
+
+#endif
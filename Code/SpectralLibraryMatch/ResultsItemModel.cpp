@@ -10,25 +10,97 @@
 #include "PlugIn.h"
 #include "PlugInManagerServices.h"
 #include "Progress.h"
-#include "ResultsItem.h"
 #include "ResultsItemModel.h"
 #include "Signature.h"
 #include "SpectralLibraryManager.h"
 #include "SpectralLibraryMatch.h"
 #include "Subject.h"
 
-#include <QtCore/QtAlgorithms>
-#include <QtCore/QList>
-#include <QtCore/QListIterator>
+#include <QtCore/QByteArray>
+#include <QtCore/QModelIndexList>
 #include <QtCore/QString>
 #include <QtGui/QBrush>
-#include <QtGui/QIcon>
+#include <QtGui/QColor>
 #include <QtGui/QPainter>
 #include <QtGui/QPen>
 #include <QtGui/QPixmap>
 
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+   // targets which are not pixels sort ahead of all pixels
+   Opticks::PixelLocation getPixelLocation(const std::string& targetName)
+   {
+      int column(0);
+      int row(0);
+      int length(0);
+      if (sscanf(targetName.c_str(), "Pixel (%d, %d)%n", &column, &row, &length) == 2 &&
+         static_cast<std::string::size_type>(length) == targetName.size())
+      {
+         return Opticks::PixelLocation(column, row);
+      }
+
+      return Opticks::PixelLocation(-999, -999);
+   }
+
+   uint getLookupKey(const std::string& targetName, SpectralLibraryMatch::MatchAlgorithm algType)
+   {
+      return qHash(QByteArray::fromRawData(targetName.data(), static_cast<int>(targetName.size()))) ^
+         static_cast<uint>(algType);
+   }
+
+   // orders targets by row then column when ascending and by column then row when descending
+   class TargetOrder
+   {
+   public:
+      TargetOrder(const std::vector<Opticks::PixelLocation>& pixels, bool rowMajor) :
+         mPixels(pixels),
+         mRowMajor(rowMajor)
+      {}
+
+      bool operator()(unsigned int lhs, unsigned int rhs) const
+      {
+         const Opticks::PixelLocation& left = mPixels[lhs];
+         const Opticks::PixelLocation& right = mPixels[rhs];
+         if (mRowMajor)
+         {
+            if (left.mY != right.mY)
+            {
+               return left.mY < right.mY;
+            }
+            if (left.mX != right.mX)
+            {
+               return left.mX < right.mX;
+            }
+         }
+         else
+         {
+            if (left.mX != right.mX)
+            {
+               return left.mX < right.mX;
+            }
+            if (left.mY != right.mY)
+            {
+               return left.mY < right.mY;
+            }
+         }
+
+         return lhs < rhs;  // targets at the same location stay in the order they were added
+      }
+
+   private:
+      const std::vector<Opticks::PixelLocation>& mPixels;
+      bool mRowMajor;
+   };
+}
+
 ResultsItemModel::ResultsItemModel(QObject* pParent) :
    QAbstractItemModel(pParent),
+   mNumStaleMatches(0),
+   mSorted(false),
+   mSortOrder(Qt::AscendingOrder),
    mAddingResults(false)
 {
    std::vector<PlugIn*> plugIns = Service<PlugInManagerServices>()->getPlugInInstances(
@@ -68,147 +140,320 @@ void ResultsItemModel::addResults(const std::vector<SpectralLibraryMatch::MatchR
       return;
    }
 
-   bool findPrevious = (rowCount() > 0);  // don't look for previous results if model is empty.
+   bool findPrevious = (mMatchStarts.empty() == false);  // don't look for previous results if model is empty.
    if (pProgress != NULL)
    {
       pProgress->updateProgress("Adding Match Results to Results Window...", 0, NORMAL);
    }
    unsigned int resultCount(0);
    unsigned int numResults = theResults.size();
-   mResults.reserve(mResults.size() + numResults);
+   int percentDone(0);
+   std::vector<unsigned int>::size_type numShown = mRowTargets.size();
+   bool aborted(false);
    for (std::vector<SpectralLibraryMatch::MatchResults>::const_iterator it = theResults.begin();
       it != theResults.end(); ++it)
    {
       if (pAbort != NULL && *pAbort)
       {
-         if (pProgress != NULL)
-         {
-            pProgress->updateProgress("Adding Match Results to Results Window canceled by user", 0, ABORT);
-         }
-         return;
+         aborted = true;
+         break;
       }
 
-      // Get the results item if it already exists
-      ResultsItem* pItem(NULL);
-      bool newItem(false);
+      // Get the target if it already exists
+      int target(-1);
       if (findPrevious)
       {
-         pItem = findResult(it->mTargetName, it->mAlgorithmUsed);
+         target = findTarget(it->mTargetName, it->mAlgorithmUsed);
       }
 
-      // Add the top-level item for the results
-      if (pItem == NULL)
+      if (target < 0)
       {
-         int resultsRow = static_cast<int>(mResults.size());
-         beginInsertRows(QModelIndex(), resultsRow, resultsRow);
-
-         // Set the target name and algorithm name in the item constructor so that they will be available when
-         // the sort model automatically sorts the top-level results items when endInsertRows() is called
-         QString targetName = QString::fromStdString(it->mTargetName);
-         QString algorithmName = QString::fromStdString(
-            StringUtilities::toDisplayString<SpectralLibraryMatch::MatchAlgorithm>(it->mAlgorithmUsed));
-
-         pItem = new ResultsItem(targetName, algorithmName);
-         newItem = true;
-         mItemMap[getKeyString(it->mTargetName, it->mAlgorithmUsed)] = pItem;
-         mResults.push_back(pItem);
+         // New targets are shown together once all of the results have been stored
+         setMatches(addTarget(it->mTargetName, it->mAlgorithmUsed), *it, colorMap);
+      }
+      else if (static_cast<unsigned int>(target) >= numShown)
+      {
+         mNumStaleMatches += mMatchCounts[target];
+         mMatchCounts[target] = 0;
+         setMatches(target, *it, colorMap);
+      }
+      else
+      {
+         // Replace the signature match rows of the existing target
+         QModelIndex resultsIndex = index(mTargetRows[target], 0);
+         mAddingResults = true;
+         beginRemoveRows(resultsIndex, 0, std::max(mMatchCounts[target], 1U) - 1);
+         mNumStaleMatches += mMatchCounts[target];
+         mMatchCounts[target] = 0;
+         endRemoveRows();
 
+         // Include the row indicating no matches are found
+         beginInsertRows(resultsIndex, 0, std::max(static_cast<int>(it->mResults.size()), 1) - 1);
+         setMatches(target, *it, colorMap);
          endInsertRows();
+         mAddingResults = false;
       }
 
-      // Get the index for the top-level results item
-      int resultsRow = getRow(pItem);
-      QModelIndex resultsIndex = index(resultsRow, 0);
+      // Update the progress
+      ++resultCount;
+      if (pProgress != NULL && resultCount * 100 / numResults != percentDone)
+      {
+         percentDone = resultCount * 100 / numResults;
+         pProgress->updateProgress("Adding Match Results to Results Window...", percentDone, NORMAL);
+      }
+   }
 
-      // If the results item already exists, remove any existing signature match rows
-      if (newItem == false)
+   // Add the rows for the new targets and merge them into the sorted rows
+   if (mMatchStarts.size() > numShown)
+   {
+      beginInsertRows(QModelIndex(), static_cast<int>(numShown), static_cast<int>(mMatchStarts.size()) - 1);
+      for (unsigned int target = numShown; target < mMatchStarts.size(); ++target)
       {
-         int signatureRows = pItem->rows();
-         if (signatureRows <= 0)
-         {
-            // Set the number of rows to 1 to account for the row indicating no matches are found
-            signatureRows = 1;
-         }
+         mTargetRows.push_back(mRowTargets.size());
+         mRowTargets.push_back(target);
+      }
+      endInsertRows();
 
-         beginRemoveRows(resultsIndex, 0, signatureRows - 1);
-         pItem->clear();
-         endRemoveRows();
+      if (mSorted)
+      {
+         reorderRows(numShown);
       }
+   }
+   if (mNumStaleMatches > mMatchEntries.size() / 2)
+   {
+      compactMatches();
+   }
 
-      // Add the updated signature match rows
-      int signatureRows = it->mResults.size();
-      if (signatureRows <= 0)
+   if (pProgress != NULL)
+   {
+      if (aborted)
       {
-         // Set the number of rows to 1 to account for the row indicating no matches are found
-         signatureRows = 1;
+         pProgress->updateProgress("Adding Match Results to Results Window canceled by user", 0, ABORT);
       }
+      else
+      {
+         pProgress->updateProgress("Finished adding Match Results to Results Window.", 100, NORMAL);
+      }
+   }
+}
 
-      mAddingResults = true;
-      beginInsertRows(resultsIndex, 0, signatureRows - 1);
-      pItem->setData(*it, colorMap);
-      endInsertRows();
-      mAddingResults = false;
+int ResultsItemModel::findTarget(const std::string& targetName, SpectralLibraryMatch::MatchAlgorithm algType) const
+{
+   if (targetName.empty() || algType.isValid() == false)
+   {
+      return -1;
+   }
 
-      // Update the progress
-      if (pProgress != NULL)
+   uint key = getLookupKey(targetName, algType);
+   for (QMultiHash<uint, unsigned int>::const_iterator it = mTargetLookup.find(key);
+      it != mTargetLookup.end() && it.key() == key; ++it)
+   {
+      unsigned int target = it.value();
+      std::string::size_type length = mNameOffsets[target + 1] - mNameOffsets[target];
+      if (mTargetAlgorithms[target] == static_cast<unsigned char>(algType) &&
+         mTargetNames.compare(mNameOffsets[target], length, targetName) == 0)
       {
-         ++resultCount;
-         pProgress->updateProgress("Adding Match Results to Results Window...",
-            resultCount * 100 / numResults, NORMAL);
+         return static_cast<int>(target);
       }
    }
-   if (pProgress != NULL)
+
+   return -1;
+}
+
+unsigned int ResultsItemModel::addTarget(const std::string& targetName, SpectralLibraryMatch::MatchAlgorithm algType)
+{
+   unsigned int target = mMatchStarts.size();
+   if (mNameOffsets.empty())
    {
-      pProgress->updateProgress("Finished adding Match Results to Results Window.", 100, NORMAL);
+      mNameOffsets.push_back(0);
    }
+   mTargetNames += targetName;
+   mNameOffsets.push_back(mTargetNames.size());
+   mTargetAlgorithms.push_back(static_cast<unsigned char>(algType));
+   mTargetPixels.push_back(getPixelLocation(targetName));
+   mMatchStarts.push_back(mMatchEntries.size());
+   mMatchCounts.push_back(0);
+   mTargetLookup.insert(getLookupKey(targetName, algType), target);
+
+   return target;
 }
 
-std::string ResultsItemModel::getKeyString(const std::string& sigName, SpectralLibraryMatch::MatchAlgorithm algType)
+QString ResultsItemModel::getTargetName(unsigned int target) const
 {
-   return sigName + StringUtilities::toDisplayString<SpectralLibraryMatch::MatchAlgorithm>(algType);
+   return QString::fromAscii(mTargetNames.data() + mNameOffsets[target],
+      static_cast<int>(mNameOffsets[target + 1] - mNameOffsets[target]));
 }
 
-ResultsItem* ResultsItemModel::findResult(const std::string& sigName, SpectralLibraryMatch::MatchAlgorithm algType)
+void ResultsItemModel::setMatches(unsigned int target, const SpectralLibraryMatch::MatchResults& theResults,
+   const std::map<Signature*, ColorType>& colorMap)
 {
-   if (sigName.empty() || algType.isValid() == false)
+   // the previous matches of the target must already have been released
+   VERIFYNRV(mMatchCounts[target] == 0);
+   mMatchStarts[target] = mMatchEntries.size();
+   for (std::vector<std::pair<Signature*, float> >::const_iterator it = theResults.mResults.begin();
+      it != theResults.mResults.end(); ++it)
+   {
+      mMatchEntries.push_back(getSignatureEntry(it->first, colorMap));
+      mMatchScores.push_back(it->second);
+   }
+   mMatchCounts[target] = theResults.mResults.size();
+}
+
+unsigned int ResultsItemModel::getSignatureEntry(Signature* pSignature,
+   const std::map<Signature*, ColorType>& colorMap)
+{
+   // only create icons if colorMap has entries
+   unsigned int colorKey(0);
+   QColor color(Qt::white);  // set white as default in case signature doesn't have an entry
+   if (colorMap.empty() == false)
+   {
+      std::map<Signature*, ColorType>::const_iterator mit = colorMap.find(pSignature);
+      if (mit != colorMap.end())
+      {
+         color = COLORTYPE_TO_QCOLOR(mit->second);
+      }
+      colorKey = 0xff000000 | color.rgb();
+   }
+
+   std::pair<Signature*, unsigned int> key(pSignature, colorKey);
+   std::map<std::pair<Signature*, unsigned int>, unsigned int>::const_iterator eit = mEntryLookup.find(key);
+   if (eit != mEntryLookup.end())
    {
-      return NULL;
+      return eit->second;
    }
 
-   std::map<std::string, ResultsItem*>::const_iterator it = mItemMap.find(getKeyString(sigName, algType));
-   if (it != mItemMap.end())
+   QIcon icon;
+   if (colorKey != 0)
    {
-      return it->second;
+      QColor borderColor = QColor(127, 157, 185);
+      QPen pen(borderColor);
+      QPixmap pix = QPixmap(16, 16);
+      QRectF rect(0, 0, 15, 15);
+      QPainter p;
+      QBrush brush(color);
+      p.begin(&pix);
+      p.fillRect(rect, brush);
+      p.setPen(pen);
+      p.drawRect(rect);
+      p.end();
+      icon = QIcon(pix);
    }
 
-   return NULL;
+   unsigned int entry = mEntrySignatures.size();
+   mEntrySignatures.push_back(pSignature);
+   mEntryIcons.push_back(icon);
+   mEntryLookup[key] = entry;
+
+   return entry;
+}
+
+void ResultsItemModel::compactMatches()
+{
+   std::vector<unsigned int> entries;
+   std::vector<float> scores;
+   entries.reserve(mMatchEntries.size() - mNumStaleMatches);
+   scores.reserve(entries.capacity());
+   for (unsigned int target = 0; target < mMatchStarts.size(); ++target)
+   {
+      unsigned int start = mMatchStarts[target];
+      unsigned int end = start + mMatchCounts[target];
+      mMatchStarts[target] = entries.size();
+      entries.insert(entries.end(), mMatchEntries.begin() + start, mMatchEntries.begin() + end);
+      scores.insert(scores.end(), mMatchScores.begin() + start, mMatchScores.begin() + end);
+   }
+   mMatchEntries.swap(entries);
+   mMatchScores.swap(scores);
+   mNumStaleMatches = 0;
+}
+
+void ResultsItemModel::reorderRows(std::vector<unsigned int>::size_type numSortedRows)
+{
+   emit layoutAboutToBeChanged();
+
+   // the child rows do not move, so only the persistent indexes of the targets need to be updated
+   QModelIndexList oldIndexes = persistentIndexList();
+   std::vector<int> indexTargets;
+   indexTargets.reserve(oldIndexes.size());
+   for (QModelIndexList::const_iterator it = oldIndexes.begin(); it != oldIndexes.end(); ++it)
+   {
+      indexTargets.push_back(it->internalId() == 0 ? getTarget(*it) : -1);
+   }
+
+   TargetOrder order(mTargetPixels, mSortOrder == Qt::AscendingOrder);
+   std::vector<unsigned int>::iterator middle = mRowTargets.begin() + numSortedRows;
+   std::sort(middle, mRowTargets.end(), order);
+   std::inplace_merge(mRowTargets.begin(), middle, mRowTargets.end(), order);
+   for (unsigned int row = 0; row < mRowTargets.size(); ++row)
+   {
+      mTargetRows[mRowTargets[row]] = row;
+   }
+
+   QModelIndexList newIndexes;
+   for (int i = 0; i < oldIndexes.size(); ++i)
+   {
+      if (indexTargets[i] >= 0)
+      {
+         newIndexes.append(index(mTargetRows[indexTargets[i]], oldIndexes[i].column()));
+      }
+      else
+      {
+         newIndexes.append(oldIndexes[i]);
+      }
+   }
+   changePersistentIndexList(oldIndexes, newIndexes);
+
+   emit layoutChanged();
+}
+
+int ResultsItemModel::getTarget(const QModelIndex& index) const
+{
+   if (index.isValid() == false)
+   {
+      return -1;
+   }
+   if (index.internalId() != 0)
+   {
+      return static_cast<int>(index.internalId() - 1);
+   }
+   if (static_cast<unsigned int>(index.row()) < mRowTargets.size())
+   {
+      return static_cast<int>(mRowTargets[index.row()]);
+   }
+
+   return -1;
 }
 
 QVariant ResultsItemModel::data(const QModelIndex& index, int role) const
 {
-   if (!index.isValid())
+   int target = getTarget(index);
+   if (target < 0)
    {
       return QVariant();
    }
 
-   ResultsItem* pItem = reinterpret_cast<ResultsItem*>(index.internalPointer());
-   if (pItem == NULL)  // main node so only has display role 
+   if (index.internalId() == 0)  // main node so only has display role
    {
       if (role == Qt::DisplayRole)
       {
-         pItem = getItem(index.row());
          if (index.column() == 0)
          {
-            return QVariant(pItem->getTargetName());
+            return QVariant(getTargetName(target));
          }
          else if (index.column() == 1)
          {
-            return QVariant(pItem->getAlgorithmName());
+            SpectralLibraryMatch::MatchAlgorithm algorithm =
+               static_cast<SpectralLibraryMatch::MatchAlgorithmEnum>(mTargetAlgorithms[target]);
+            return QVariant(QString::fromStdString(
+               StringUtilities::toDisplayString<SpectralLibraryMatch::MatchAlgorithm>(algorithm)));
          }
       }
    }
    else  // want a result
    {
+      // the row indicating no matches are found has no signature
+      unsigned int row = static_cast<unsigned int>(index.row());
+      bool isMatch = row < mMatchCounts[target];
+      unsigned int match = mMatchStarts[target] + row;
       switch (role)
       {
       case Qt::DisplayRole:
@@ -216,7 +461,7 @@ QVariant ResultsItemModel::data(const QModelIndex& index, int role) const
          {
             QString signatureName = "No matches found";
 
-            Signature* pSignature = pItem->getSignature(index.row());
+            Signature* pSignature = isMatch ? mEntrySignatures[mMatchEntries[match]] : NULL;
             if (pSignature != NULL)
             {
                signatureName = QString::fromStdString(pSignature->getDisplayName(true));
@@ -224,21 +469,21 @@ QVariant ResultsItemModel::data(const QModelIndex& index, int role) const
 
             return QVariant(signatureName);
          }
-         else if (index.column() == 1)
+         else if (index.column() == 1 && isMatch)
          {
-            return QVariant(pItem->getValueStr(index.row()));
+            return QVariant(QString::number(mMatchScores[match], 'f', 4));
          }
          break;
       case Qt::UserRole:
          if (index.column() == 0)
          {
-            return QVariant::fromValue(pItem->getSignature(index.row()));
+            return QVariant::fromValue(isMatch ? mEntrySignatures[mMatchEntries[match]] : NULL);
          }
          break;
       case Qt::DecorationRole:
-         if (index.column() == 0)
+         if (index.column() == 0 && isMatch)
          {
-            return QVariant(pItem->getIcon(index.row()));
+            return QVariant(mEntryIcons[mMatchEntries[match]]);
          }
       }
    }
@@ -253,6 +498,11 @@ QVariant ResultsItemModel::headerData(int section, Qt::Orientation orientation,
       switch (section)
       {
       case 0:
+         if (mSorted)
+         {
+            return QVariant(mSortOrder == Qt::AscendingOrder ? "Signature  (sorted by row)" :
+               "Signature  (sorted by column)");
+         }
          return QVariant("Signature");
          break;
 
@@ -275,24 +525,26 @@ QModelIndex ResultsItemModel::index(int row, int column, const QModelIndex& pare
       return createIndex(row, column);
    }
 
-   if (parent.internalPointer() != NULL)
+   if (parent.internalId() != 0)
+   {
+      return QModelIndex();
+   }
+
+   int target = getTarget(parent);
+   if (target < 0)
    {
       return QModelIndex();
    }
 
-   ResultsItem* pItem = getItem(parent.row());
-   return createIndex(row, column, pItem);
+   // the children of a target carry the target so data() does not need to find their parent
+   return createIndex(row, column, static_cast<quint32>(target + 1));
 }
 
 QModelIndex ResultsItemModel::parent(const QModelIndex& index) const
 {
-   if (index.isValid())  // not root item
+   if (index.isValid() && index.internalId() != 0)  // child result
    {
-      ResultsItem* pItem = reinterpret_cast<ResultsItem*>(index.internalPointer());
-      if (pItem != NULL)  // child result 
-      {
-         return createIndex(getRow(pItem), 0);
-      }
+      return createIndex(mTargetRows[index.internalId() - 1], 0);
    }
 
    return QModelIndex();
@@ -302,16 +554,15 @@ int ResultsItemModel::rowCount(const QModelIndex& parent) const
 {
    if (parent.isValid() == false)  // root element
    {
-      return mResults.size();
+      return mRowTargets.size();
    }
 
-   ResultsItem* pItem = reinterpret_cast<ResultsItem*>(parent.internalPointer());
-   if (pItem == NULL)  // top level node
+   if (parent.internalId() == 0)  // top level node
    {
-      pItem = getItem(parent.row());
-      if (pItem != NULL)
+      int target = getTarget(parent);
+      if (target >= 0)
       {
-         int rows = pItem->rows();
+         int rows = mMatchCounts[target];
          if ((rows == 0) && (mAddingResults == false))
          {
             return 1;
@@ -330,56 +581,72 @@ int ResultsItemModel::columnCount(const QModelIndex& parent) const
    return 2;
 }
 
-void ResultsItemModel::clear()
-{
-   beginResetModel();
-   for (std::map<std::string, ResultsItem*>::iterator it = mItemMap.begin(); it != mItemMap.end(); ++it)
-   {
-      delete it->second;
-   }
-   mItemMap.clear();
-   mResults.clear();
-   endResetModel();
-}
-
-int ResultsItemModel::getRow(const ResultsItem* pItem) const
+void ResultsItemModel::sort(int column, Qt::SortOrder order)
 {
-   std::vector<ResultsItem*>::const_iterator it = std::find(mResults.begin(), mResults.end(), pItem);
-   if (it != mResults.end())
+   // only sort by first column (0 based)
+   if (column != 0)
    {
-      return static_cast<int>(it - mResults.begin());
+      return;
    }
 
-   return -1;  // note if item not found, return invalid row number
+   mSorted = true;
+   mSortOrder = order;
+   reorderRows(0);
+   emit headerDataChanged(Qt::Horizontal, 0, 0);
 }
 
-ResultsItem* ResultsItemModel::getItem(int row) const
+void ResultsItemModel::clear()
 {
-   ResultsItem* pItem(NULL);
-   if (static_cast<unsigned int>(row) < mResults.size())
-   {
-      pItem = mResults[row];
-   }
-
-   return pItem;
+   beginResetModel();
+   mTargetNames.clear();
+   mNameOffsets.clear();
+   mTargetAlgorithms.clear();
+   mTargetPixels.clear();
+   mMatchStarts.clear();
+   mMatchCounts.clear();
+   mTargetLookup.clear();
+   mMatchEntries.clear();
+   mMatchScores.clear();
+   mNumStaleMatches = 0;
+   mEntrySignatures.clear();
+   mEntryIcons.clear();
+   mEntryLookup.clear();
+   mRowTargets.clear();
+   mTargetRows.clear();
+   endResetModel();
 }
 
 QModelIndex ResultsItemModel::getItemIndex(const std::string& name,
    const SpectralLibraryMatch::MatchAlgorithm& algoType)
 {
-   ResultsItem* pItem = findResult(name, algoType);
-   return index(getRow(pItem), 0);
+   int target = findTarget(name, algoType);
+   if (target < 0 || static_cast<unsigned int>(target) >= mTargetRows.size())
+   {
+      return QModelIndex();
+   }
+
+   return index(mTargetRows[target], 0);
 }
 
-const ResultsItem* ResultsItemModel::getResult(const std::string& key) const
+void ResultsItemModel::getSignatures(const QModelIndex& index, std::vector<Signature*>& signatures) const
 {
-   std::map<std::string, ResultsItem*>::const_iterator it = mItemMap.find(key);
-   if (it != mItemMap.end())
+   int target = getTarget(index);
+   if (target < 0)
    {
-      return it->second;
+      return;
    }
 
-   return NULL;
+   // a target item includes the signatures of all of its matches
+   unsigned int first = index.internalId() == 0 ? 0 : static_cast<unsigned int>(index.row());
+   unsigned int last = index.internalId() == 0 ? mMatchCounts[target] : first + 1;
+   for (unsigned int row = first; row < last && row < mMatchCounts[target]; ++row)
+   {
+      Signature* pSignature = mEntrySignatures[mMatchEntries[mMatchStarts[target] + row]];
+      if (pSignature != NULL)
+      {
+         signatures.push_back(pSignature);
+      }
+   }
 }
 
 void ResultsItemModel::signatureDeleted(Subject& subject, const std::string& signal, const boost::any& value)
@@ -390,28 +657,53 @@ void ResultsItemModel::signatureDeleted(Subject& subject, const std::string& sig
       return;
    }
 
-   for (std::vector<ResultsItem*>::iterator iter = mResults.begin(); iter != mResults.end(); ++iter)
+   // Release the table entries for the signature so a new signature at the same address gets new entries
+   std::vector<bool> isDeleted(mEntrySignatures.size(), false);
+   bool found(false);
+   std::map<std::pair<Signature*, unsigned int>, unsigned int>::iterator eit =
+      mEntryLookup.lower_bound(std::make_pair(pSignature, 0U));
+   while (eit != mEntryLookup.end() && eit->first.first == pSignature)
+   {
+      isDeleted[eit->second] = true;
+      mEntrySignatures[eit->second] = NULL;
+      mEntryIcons[eit->second] = QIcon();
+      mEntryLookup.erase(eit++);
+      found = true;
+   }
+   if (found == false)
+   {
+      return;
+   }
+
+   for (unsigned int target = 0; target < mTargetRows.size(); ++target)
    {
-      ResultsItem* pItem = *iter;
-      if (pItem != NULL)
+      std::vector<unsigned int>::iterator entries = mMatchEntries.begin() + mMatchStarts[target];
+      std::vector<float>::iterator scores = mMatchScores.begin() + mMatchStarts[target];
+      for (unsigned int row = 0; row < mMatchCounts[target]; )
       {
-         int signatureRow = pItem->getRow(pSignature);
-         if (signatureRow > -1)
+         if (isDeleted[entries[row]] == false)
          {
-            // Remove the signature row
-            int resultsRow = getRow(pItem);
-            QModelIndex resultsIndex = index(resultsRow, 0);
-            beginRemoveRows(resultsIndex, signatureRow, signatureRow);
-            pItem->deleteResultsForSignature(pSignature);
-            endRemoveRows();
-
-            // If no signature matches remain, add the row indicating no matches are found
-            if (pItem->rows() == 0)
-            {
-               beginInsertRows(resultsIndex, 0, 0);
-               endInsertRows();
-            }
+            ++row;
+            continue;
+         }
+
+         // Remove the signature row
+         QModelIndex resultsIndex = index(mTargetRows[target], 0);
+         mAddingResults = true;
+         beginRemoveRows(resultsIndex, row, row);
+         std::copy(entries + row + 1, entries + mMatchCounts[target], entries + row);
+         std::copy(scores + row + 1, scores + mMatchCounts[target], scores + row);
+         --mMatchCounts[target];
+         ++mNumStaleMatches;
+         endRemoveRows();
+         mAddingResults = false;
+
+         // If no signature matches remain, add the row indicating no matches are found
+         if (mMatchCounts[target] == 0)
+         {
+            beginInsertRows(resultsIndex, 0, 0);
+            endInsertRows();
          }
       }
    }
-}
\ No newline at end of file
+}
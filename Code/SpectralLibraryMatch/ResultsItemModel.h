@@ -11,24 +11,40 @@
 #define RESULTSITEMMODEL_H
 
 #include "ColorType.h"
+#include "Location.h"
 #include "SpectralLibraryMatch.h"
 
 #include <QtCore/QAbstractItemModel>
 #include <QtCore/QMetaType>
 #include <QtCore/QModelIndex>
+#include <QtCore/QMultiHash>
 #include <QtCore/QVariant>
+#include <QtGui/QIcon>
 
 #include <boost/any.hpp>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 class Progress;
-class ResultsItem;
 class Signature;
 class Subject;
 
 Q_DECLARE_METATYPE(Signature*)
 
+/**
+ * Item model of the spectral library match results for one raster element.
+ *
+ * The results are held in columns rather than as an item per target and
+ * match: each target is an entry in a few parallel arrays and each match is
+ * a signature table index and a score, with the matches of a target stored
+ * contiguously. The rows shown by a view are generated from these arrays in
+ * data(), so the memory used is proportional to the number of scores.
+ *
+ * The targets are sorted by pixel location on the arrays themselves. Newly
+ * added targets are sorted separately and merged into the existing order.
+ */
 class ResultsItemModel : public QAbstractItemModel
 {
 public:
@@ -44,20 +60,49 @@ public:
    virtual QModelIndex parent(const QModelIndex& index) const;
    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
    virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+   virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
    QModelIndex getItemIndex(const std::string& name, const SpectralLibraryMatch::MatchAlgorithm& algoType);
-   const ResultsItem* getResult(const std::string& key) const;
+   void getSignatures(const QModelIndex& index, std::vector<Signature*>& signatures) const;
 
 protected:
-   ResultsItem* findResult(const std::string& sigName, SpectralLibraryMatch::MatchAlgorithm algType);
-   std::string getKeyString(const std::string& sigName, SpectralLibraryMatch::MatchAlgorithm algType);
-   int getRow(const ResultsItem* pItem) const;
-   ResultsItem* getItem(int row) const;
+   int findTarget(const std::string& targetName, SpectralLibraryMatch::MatchAlgorithm algType) const;
+   unsigned int addTarget(const std::string& targetName, SpectralLibraryMatch::MatchAlgorithm algType);
+   QString getTargetName(unsigned int target) const;
+   void setMatches(unsigned int target, const SpectralLibraryMatch::MatchResults& theResults,
+      const std::map<Signature*, ColorType>& colorMap);
+   unsigned int getSignatureEntry(Signature* pSignature, const std::map<Signature*, ColorType>& colorMap);
+   void compactMatches();
+   void reorderRows(std::vector<unsigned int>::size_type numSortedRows);
+   int getTarget(const QModelIndex& index) const;
 
    void signatureDeleted(Subject& subject, const std::string& signal, const boost::any& value);
 
 private:
-   std::map<std::string, ResultsItem*> mItemMap;  // provides fast find of a result item by pixel location and algorithm
-   std::vector<ResultsItem*> mResults;            // provides fast access to item by row and getting row for an item
+   // one entry per target in the order the targets were added
+   std::string mTargetNames;                           // all of the target names end to end
+   std::vector<std::string::size_type> mNameOffsets;   // start of each name in mTargetNames plus the end
+   std::vector<unsigned char> mTargetAlgorithms;
+   std::vector<Opticks::PixelLocation> mTargetPixels;  // parsed from the name for sorting
+   std::vector<unsigned int> mMatchStarts;
+   std::vector<unsigned int> mMatchCounts;
+   QMultiHash<uint, unsigned int> mTargetLookup;       // hash of name and algorithm to target
+
+   // one entry per match, best match first within each target
+   std::vector<unsigned int> mMatchEntries;            // index into the signature table
+   std::vector<float> mMatchScores;
+   std::vector<unsigned int>::size_type mNumStaleMatches;
+
+   // signature table; a signature has an entry for each color it has been shown with
+   std::vector<Signature*> mEntrySignatures;
+   std::vector<QIcon> mEntryIcons;
+   std::map<std::pair<Signature*, unsigned int>, unsigned int> mEntryLookup;
+
+   // display order of the targets
+   std::vector<unsigned int> mRowTargets;
+   std::vector<unsigned int> mTargetRows;
+   bool mSorted;
+   Qt::SortOrder mSortOrder;
+
    bool mAddingResults;
 };
 
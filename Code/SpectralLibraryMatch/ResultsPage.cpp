@@ -8,10 +8,8 @@
  */
 
 #include "ColorType.h"
-#include "ResultsItem.h"
 #include "ResultsItemModel.h"
 #include "ResultsPage.h"
-#include "ResultsSortFilter.h"
 #include "Signature.h"
 #include "SpectralLibraryMatchOptions.h"
 #include "StringUtilities.h"
@@ -31,12 +29,16 @@
 #include <QtGui/QPixmap>
 
 #include <algorithm>
+#include <set>
 #include <string>
 
 namespace
 {
    static const int gcSignatureNameColumn(0);
    static const int gcAlgorithmNameColumn(1);
+
+   // expanding every target of a large match is slower than adding the results
+   const std::vector<SpectralLibraryMatch::MatchResults>::size_type sMaxExpandedResults = 1000;
 }
 
 ResultsPage::ResultsPage(QWidget* pParent) :
@@ -45,7 +47,7 @@ ResultsPage::ResultsPage(QWidget* pParent) :
 {
    setRootIsDecorated(true);
    setSortingEnabled(true);
-   setModel(new ResultsSortFilter(this));
+   setModel(new ResultsItemModel(this));
    setSelectionMode(QAbstractItemView::ExtendedSelection);
    setSelectionBehavior(QAbstractItemView::SelectRows);
    setAllColumnsShowFocus(true);
@@ -72,9 +74,7 @@ void ResultsPage::addResults(const std::vector<SpectralLibraryMatch::MatchResult
    {
       clear();
    }
-   ResultsSortFilter* pFilter = dynamic_cast<ResultsSortFilter*>(model());
-   VERIFYNRV(pFilter != NULL);
-   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(pFilter->sourceModel());
+   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(model());
    VERIFYNRV(pModel != NULL);
    pModel->addResults(theResults, colorMap, pProgress, pAbort);
    if (pAbort == NULL || *pAbort == false)
@@ -85,8 +85,7 @@ void ResultsPage::addResults(const std::vector<SpectralLibraryMatch::MatchResult
 
 void ResultsPage::clear()
 {
-   ResultsSortFilter* pFilter = dynamic_cast<ResultsSortFilter*>(model());
-   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(pFilter->sourceModel());
+   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(model());
    VERIFYNRV(pModel != NULL);
    pModel->clear();
 }
@@ -101,73 +100,23 @@ void ResultsPage::getSelectedSignatures(std::vector<Signature*>& signatures)
    {
       return;
    }
-   QModelIndexList selectedCol1 = pSelectModel->selectedRows(1);
 
-   std::vector<std::string> resultKeys;
-   std::vector<Signature*>::iterator sit;
-   ResultsSortFilter* pFilter = dynamic_cast<ResultsSortFilter*>(model());
-   VERIFYNRV(pFilter != NULL);
-   Signature* pSignature(NULL);
-   for (int i = 0; i < selectedCol0.size(); ++i)
-   {
-      QModelIndex index = selectedCol0[i];
-      if (index.isValid() == false)
-      {
-         continue;
-      }
-      QVariant variant = pFilter->data(index, Qt::UserRole);
-      if (variant.isValid())
-      {
-         pSignature = variant.value<Signature*>();
-         if (pSignature != NULL)  // a result of "No Matches found" will return NULL so skip them.
-         {
-            sit = std::find(signatures.begin(), signatures.end(), pSignature);
-            if (sit == signatures.end())
-            {
-               signatures.push_back(pSignature);
-            }
-         }
-      }
-      else   // If item doesn't contain data (a Signature*), it's a pixel name item with children.
-             // It was selected, so we need to get the data from its children to include those Signatures.
-      {
-         QVariant var = pFilter->data(index);
-         std::string keyStr;
-         if (var.isValid())
-         {
-            keyStr = var.toString().toStdString();
-            index = selectedCol1[i];
-            var = pFilter->data(index);
-            if (var.isValid())
-            {
-               keyStr += var.toString().toStdString();
-               resultKeys.push_back(keyStr);
-            }
-         }
-      }
-   }
+   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(model());
+   VERIFYNRV(pModel != NULL);
 
-   if (resultKeys.empty() == false)
+   // A selected pixel name item includes the Signatures of all of its matches.
+   // A result of "No Matches found" has no Signature so it is skipped.
+   std::vector<Signature*> selected;
+   std::set<Signature*> found;
+   for (int i = 0; i < selectedCol0.size(); ++i)
    {
-      ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(pFilter->sourceModel());
-      VERIFYNRV(pModel != NULL);
-      for (unsigned int i = 0; i < resultKeys.size(); ++i)
+      selected.clear();
+      pModel->getSignatures(selectedCol0[i], selected);
+      for (std::vector<Signature*>::iterator sit = selected.begin(); sit != selected.end(); ++sit)
       {
-         const ResultsItem* pItem = pModel->getResult(resultKeys[i]);
-         if (pItem != NULL)
+         if (found.insert(*sit).second)
          {
-            for (int row = 0; row < pItem->rows(); ++row)
-            {
-               pSignature = pItem->getSignature(row);
-               if (pSignature != NULL)
-               {
-                  sit = std::find(signatures.begin(), signatures.end(), pSignature);
-                  if (sit == signatures.end())
-                  {
-                     signatures.push_back(pSignature);
-                  }
-               }
-            }
+            signatures.push_back(*sit);
          }
       }
    }
@@ -175,18 +124,16 @@ void ResultsPage::getSelectedSignatures(std::vector<Signature*>& signatures)
 
 void ResultsPage::expandAddedResults(const std::vector<SpectralLibraryMatch::MatchResults>& added)
 {
-   if (added.empty())
+   if (added.empty() || added.size() > sMaxExpandedResults)
    {
       return;
    }
 
-   QSortFilterProxyModel* pFilterModel = dynamic_cast<QSortFilterProxyModel*>(model());
-   VERIFYNRV(pFilterModel != NULL);
-   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(pFilterModel->sourceModel());
+   ResultsItemModel* pModel = dynamic_cast<ResultsItemModel*>(model());
+   VERIFYNRV(pModel != NULL);
    for (std::vector<SpectralLibraryMatch::MatchResults>::const_iterator it = added.begin(); it != added.end(); ++it)
    {
-      QModelIndex index = pModel->getItemIndex(it->mTargetName, it->mAlgorithmUsed);
-      expand(pFilterModel->mapFromSource(index));
+      expand(pModel->getItemIndex(it->mTargetName, it->mAlgorithmUsed));
    }
 }
 
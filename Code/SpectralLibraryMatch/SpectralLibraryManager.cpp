@@ -13,6 +13,8 @@
 #include "DesktopServices.h"
 #include "DynamicObject.h"
 #include "LibraryEditDlg.h"
+#include "LibraryIndex.h"
+#include "LibraryProjection.h"
 #include "MessageLogResource.h"
 #include "ModelServices.h"
 #include "ObjectResource.h"
@@ -23,6 +25,7 @@
 #include "RasterDataDescriptor.h"
 #include "RasterElement.h"
 #include "RasterUtilities.h"
+#include "ResampledLibraryCache.h"
 #include "Resampler.h"
 #include "SessionItemDeserializer.h"
 #include "SessionItemSerializer.h"
@@ -32,6 +35,7 @@
 #include "Slot.h"
 #include "SpectralLibraryManager.h"
 #include "SpectralLibraryMatch.h"
+#include "SpectralLibraryMatchOptions.h"
 #include "SpectralVersion.h"
 #include "Subject.h"
 #include "ToolBar.h"
@@ -42,6 +46,8 @@
 #include "xmlreader.h"
 #include "xmlwriter.h"
 
+#include <algorithm>
+
 #include <QtGui/QAction>
 #include <QtGui/QPixmap>
 
@@ -78,6 +84,9 @@ namespace
       ".@@@@@@@@@@@@.  ",
       ".@@@@@@@@@@@@.  ",
       "..............  "   };
+
+   // number of randomized kd-trees in the approximate search index of a resampled library
+   const unsigned int sNumIndexTrees = 4;
 }
 
 SpectralLibraryManager::SpectralLibraryManager() :
@@ -265,10 +274,6 @@ bool SpectralLibraryManager::generateResampledLibrary(const RasterElement* pRast
    FactoryResource<Wavelengths> pWavelengths;
    pWavelengths->initializeFromDynamicObject(pRaster->getMetadata(), false);
 
-   // populate the library with the resampled signatures
-   PlugInResource pPlugIn("Resampler");
-   Resampler* pResampler = dynamic_cast<Resampler*>(pPlugIn.get());
-   VERIFY(pResampler != NULL);
    if (pWavelengths->getNumWavelengths() != pDesc->getBandCount())
    {
       mpProgress->updateProgress("Wavelength information in metadata does not match the number of bands "
@@ -289,32 +294,75 @@ bool SpectralLibraryManager::generateResampledLibrary(const RasterElement* pRast
    std::vector<double> resampledValues;
    std::vector<int> bandIndex;
    DataVariant data;
-   for (std::vector<Signature*>::const_iterator it = mSignatures.begin(); it != mSignatures.end(); ++it)
-   {
-      data = (*it)->getData(SpectralLibraryMatch::getNameSignatureWavelengthData());
-      VERIFY(data.isValid());
-      VERIFY(data.getValue(sigWaves));
-      resampledValues.clear();
-      data = (*it)->getData(SpectralLibraryMatch::getNameSignatureAmplitudeData());
-      VERIFY(data.isValid());
-      VERIFY(data.getValue(sigValues));
-      double scaleFactor = (*it)->getUnits(
-         SpectralLibraryMatch::getNameSignatureAmplitudeData())->getScaleFromStandard();
-      for (std::vector<double>::iterator sit = sigValues.begin(); sit != sigValues.end(); ++sit)
+
+   // a library already resampled to the same bands, possibly in an earlier session, is read from the cache
+   std::string fingerprint;
+   bool useCache = SpectralLibraryMatchOptions::getSettingCacheResampledLibraries() &&
+      ResampledLibraryCache::getFingerprint(mSignatures, mLibraryUnitType, rasterWaves, rasterFwhm, fingerprint);
+   std::vector<unsigned int> signatureIndices;
+   if (useCache && ResampledLibraryCache::load(fingerprint, static_cast<unsigned int>(mSignatures.size()),
+      static_cast<unsigned int>(rasterWaves.size()), signatureIndices, resampledData))
+   {
+      std::vector<bool> isResampled(mSignatures.size(), false);
+      for (std::vector<unsigned int>::const_iterator it = signatureIndices.begin();
+         it != signatureIndices.end(); ++it)
+      {
+         resampledSignatures.push_back(mSignatures[*it]);
+         isResampled[*it] = true;
+      }
+      for (std::vector<Signature*>::size_type index = 0; index < mSignatures.size(); ++index)
       {
-         *sit *= scaleFactor;
+         if (isResampled[index] == false)
+         {
+            unsuitableSignatures.push_back(mSignatures[index]->getName());
+         }
       }
+   }
+   else
+   {
+      signatureIndices.clear();
+      resampledData.clear();
 
-      std::string msg;
-      if (pResampler->execute(sigValues, resampledValues, sigWaves, rasterWaves, rasterFwhm, bandIndex, msg) == false
-         || resampledValues.size() != rasterWaves.size())
+      // populate the library with the resampled signatures
+      PlugInResource pPlugIn("Resampler");
+      Resampler* pResampler = dynamic_cast<Resampler*>(pPlugIn.get());
+      VERIFY(pResampler != NULL);
+      for (std::vector<Signature*>::size_type index = 0; index < mSignatures.size(); ++index)
       {
-         unsuitableSignatures.push_back((*it)->getName());
-         continue;
+         Signature* pSignature = mSignatures[index];
+         data = pSignature->getData(SpectralLibraryMatch::getNameSignatureWavelengthData());
+         VERIFY(data.isValid());
+         VERIFY(data.getValue(sigWaves));
+         resampledValues.clear();
+         data = pSignature->getData(SpectralLibraryMatch::getNameSignatureAmplitudeData());
+         VERIFY(data.isValid());
+         VERIFY(data.getValue(sigValues));
+         double scaleFactor = pSignature->getUnits(
+            SpectralLibraryMatch::getNameSignatureAmplitudeData())->getScaleFromStandard();
+         for (std::vector<double>::iterator sit = sigValues.begin(); sit != sigValues.end(); ++sit)
+         {
+            *sit *= scaleFactor;
+         }
+
+         std::string msg;
+         if (pResampler->execute(sigValues, resampledValues, sigWaves, rasterWaves, rasterFwhm, bandIndex,
+            msg) == false || resampledValues.size() != rasterWaves.size())
+         {
+            unsuitableSignatures.push_back(pSignature->getName());
+            continue;
+         }
+
+         resampledData.push_back(resampledValues);
+         resampledSignatures.push_back(pSignature);
+         signatureIndices.push_back(static_cast<unsigned int>(index));
       }
 
-      resampledData.push_back(resampledValues);
-      resampledSignatures.push_back(*it);
+      // a cache file that cannot be written only means the library is resampled again next time
+      if (useCache && resampledSignatures.empty() == false)
+      {
+         ResampledLibraryCache::save(fingerprint, static_cast<unsigned int>(mSignatures.size()), signatureIndices,
+            resampledData);
+      }
    }
 
    if (resampledSignatures.empty())
@@ -400,9 +448,19 @@ bool SpectralLibraryManager::generateResampledLibrary(const RasterElement* pRast
       pLibDesc->setUnits(libUnits.get());
    }
 
+   // the library side of the match metrics does not change until the library is resampled again
+   SpectralLibraryMatch::LibraryStatistics libStats;
+   if (SpectralLibraryMatch::computeLibraryStatistics(pLib, libStats) == false)
+   {
+      mpProgress->updateProgress("Error occurred while trying to compute the resampled spectral library statistics",
+         0, ERRORS);
+      return false;
+   }
+
    pLib->attach(SIGNAL_NAME(Subject, Deleted), Slot(this, &SpectralLibraryManager::resampledElementDeleted));
    mLibraries[pRaster] = pLib;
    mResampledSignatures[pLib] = resampledSignatures;
+   mLibraryStatistics[pLib] = libStats;
 
    const_cast<RasterElement*>(pRaster)->attach(SIGNAL_NAME(Subject, Deleted),
       Slot(this, &SpectralLibraryManager::elementDeleted));
@@ -424,6 +482,9 @@ void SpectralLibraryManager::elementDeleted(Subject& subject, const std::string&
          {
             mResampledSignatures.erase(sit);
          }
+         mLibraryStatistics.erase(rit->second);
+         destroyLibraryIndex(rit->second);
+         destroyLibraryProjection(rit->second);
          mLibraries.erase(rit);
       }
    }
@@ -446,6 +507,9 @@ void SpectralLibraryManager::resampledElementDeleted(Subject& subject, const std
             {
                mResampledSignatures.erase(sit);
             }
+            mLibraryStatistics.erase(pLib);
+            destroyLibraryIndex(pLib);
+            destroyLibraryProjection(pLib);
             mLibraries.erase(it);
             return;
          }
@@ -498,6 +562,41 @@ void SpectralLibraryManager::invalidateLibraries()
    }
    mLibraries.clear();
    mResampledSignatures.clear();
+   mLibraryStatistics.clear();
+   for (std::map<const RasterElement*, SpectralLibraryMatch::LibraryIndex*>::iterator it = mLibraryIndices.begin();
+      it != mLibraryIndices.end(); ++it)
+   {
+      delete it->second;
+   }
+   mLibraryIndices.clear();
+   for (std::map<const RasterElement*, SpectralLibraryMatch::LibraryProjection*>::iterator it =
+      mLibraryProjections.begin(); it != mLibraryProjections.end(); ++it)
+   {
+      delete it->second;
+   }
+   mLibraryProjections.clear();
+}
+
+void SpectralLibraryManager::destroyLibraryIndex(const RasterElement* pResampledLib)
+{
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryIndex*>::iterator it =
+      mLibraryIndices.find(pResampledLib);
+   if (it != mLibraryIndices.end())
+   {
+      delete it->second;
+      mLibraryIndices.erase(it);
+   }
+}
+
+void SpectralLibraryManager::destroyLibraryProjection(const RasterElement* pResampledLib)
+{
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryProjection*>::iterator it =
+      mLibraryProjections.find(pResampledLib);
+   if (it != mLibraryProjections.end())
+   {
+      delete it->second;
+      mLibraryProjections.erase(it);
+   }
 }
 
 void SpectralLibraryManager::clearLibrary()
@@ -694,6 +793,109 @@ const std::vector<Signature*>* SpectralLibraryManager::getResampledLibrarySignat
    return NULL;
 }
 
+const SpectralLibraryMatch::LibraryStatistics* SpectralLibraryManager::getResampledLibraryStatistics(
+   const RasterElement* pResampledLib) const
+{
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryStatistics>::const_iterator it =
+      mLibraryStatistics.find(pResampledLib);
+   if (it != mLibraryStatistics.end())
+   {
+      return &(it->second);
+   }
+
+   return NULL;
+}
+
+const SpectralLibraryMatch::LibraryStatistics* SpectralLibraryManager::getResampledLibrarySidStatistics(
+   const RasterElement* pResampledLib)
+{
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryStatistics>::iterator it =
+      mLibraryStatistics.find(pResampledLib);
+   if (it == mLibraryStatistics.end())
+   {
+      return NULL;
+   }
+
+   // the divergence tables are as large as the library, so they are only built the first time they are needed
+   if (it->second.mSidProbabilities.empty() &&
+      SpectralLibraryMatch::computeSidStatistics(pResampledLib, it->second) == false)
+   {
+      return NULL;
+   }
+
+   return &(it->second);
+}
+
+const SpectralLibraryMatch::LibraryIndex* SpectralLibraryManager::getResampledLibraryIndex(
+   const RasterElement* pResampledLib)
+{
+   if (SpectralLibraryMatchOptions::getSettingUseApproximateSearch() == false)
+   {
+      return NULL;
+   }
+
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryIndex*>::const_iterator it =
+      mLibraryIndices.find(pResampledLib);
+   if (it != mLibraryIndices.end())
+   {
+      return it->second;
+   }
+
+   // the index is only built the first time it is needed so libraries matched exactly do not pay for it
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats = getResampledLibraryStatistics(pResampledLib);
+   if (pLibStats == NULL || pLibStats->mNumSignatures == 0)
+   {
+      return NULL;
+   }
+   SpectralLibraryMatch::LibraryIndex* pIndex = new SpectralLibraryMatch::LibraryIndex();
+   if (pIndex->build(*pLibStats, sNumIndexTrees) == false)
+   {
+      delete pIndex;
+      return NULL;
+   }
+   mLibraryIndices[pResampledLib] = pIndex;
+
+   return pIndex;
+}
+
+const SpectralLibraryMatch::LibraryProjection* SpectralLibraryManager::getResampledLibraryProjection(
+   const RasterElement* pResampledLib)
+{
+   if (SpectralLibraryMatchOptions::getSettingUsePrincipalComponentPrefilter() == false)
+   {
+      return NULL;
+   }
+
+   // the projection is only built the first time it is needed, like the approximate search index
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats = getResampledLibraryStatistics(pResampledLib);
+   if (pLibStats == NULL || pLibStats->mNumSignatures == 0)
+   {
+      return NULL;
+   }
+   unsigned int numComponents = SpectralLibraryMatchOptions::getSettingPrefilterComponents();
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryProjection*>::const_iterator it =
+      mLibraryProjections.find(pResampledLib);
+   if (it != mLibraryProjections.end())
+   {
+      if (it->second->getNumComponents() ==
+         std::min(numComponents, std::min(pLibStats->mNumBands, pLibStats->mNumSignatures)))
+      {
+         return it->second;
+      }
+      destroyLibraryProjection(pResampledLib);  // the number of components option has changed
+   }
+
+   SpectralLibraryMatch::LibraryProjection* pProjection = new SpectralLibraryMatch::LibraryProjection();
+   if (pProjection->build(*pLibStats, numComponents) == false)
+   {
+      delete pProjection;
+      return NULL;
+   }
+   mLibraryProjections[pResampledLib] = pProjection;
+
+   return pProjection;
+}
+
 const std::string& SpectralLibraryManager::getObjectType() const
 {
    static std::string type("SpectralLibraryManager");
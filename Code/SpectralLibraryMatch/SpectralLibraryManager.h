@@ -11,6 +11,7 @@
 #define SPECTRALLIBRARYMANAGER_H
 
 #include "ExecutableShell.h"
+#include "SpectralLibraryMatch.h"
 #include "SubjectAdapter.h"
 
 #include <boost/any.hpp>
@@ -54,6 +55,13 @@ public:
    void clearLibrary();
    const RasterElement* getResampledLibraryData(const RasterElement* pRaster);
    const std::vector<Signature*>* getResampledLibrarySignatures(const RasterElement* pResampledLib) const;
+   const SpectralLibraryMatch::LibraryStatistics* getResampledLibraryStatistics(
+      const RasterElement* pResampledLib) const;
+   const SpectralLibraryMatch::LibraryStatistics* getResampledLibrarySidStatistics(
+      const RasterElement* pResampledLib);
+   const SpectralLibraryMatch::LibraryIndex* getResampledLibraryIndex(const RasterElement* pResampledLib);
+   const SpectralLibraryMatch::LibraryProjection* getResampledLibraryProjection(
+      const RasterElement* pResampledLib);
    Signature* getLibrarySignature(unsigned int index);
    int getSignatureIndex(const Signature* pSignature) const;
    bool getResampledSignatureValues(const RasterElement* pRaster, const Signature* pSignature,
@@ -72,12 +80,17 @@ protected:
    void resampledElementDeleted(Subject& subject, const std::string& signal, const boost::any& value);
    void signatureDeleted(Subject& subject, const std::string& signal, const boost::any& value);
    void invalidateLibraries();
+   void destroyLibraryIndex(const RasterElement* pResampledLib);
+   void destroyLibraryProjection(const RasterElement* pResampledLib);
 
 private:
    std::vector<Signature*> mSignatures;
    UnitType mLibraryUnitType;
    std::map<const RasterElement*, RasterElement*> mLibraries;
    std::map<const RasterElement*, std::vector<Signature*> > mResampledSignatures;
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryStatistics> mLibraryStatistics;
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryIndex*> mLibraryIndices;
+   std::map<const RasterElement*, SpectralLibraryMatch::LibraryProjection*> mLibraryProjections;
    Progress* mpProgress;
    QAction* mpEditSpectralLibraryAction;
 };
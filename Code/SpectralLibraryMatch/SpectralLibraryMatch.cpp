@@ -11,16 +11,14 @@
 #include "AoiLayer.h"
 #include "AppConfig.h"
 #include "AppVerify.h"
-#include "DataAccessorImpl.h"
-#include "DataRequest.h"
 #include "DesktopServices.h"
 #include "DynamicObject.h"
 #include "LayerList.h"
-#include "ObjectResource.h"
+#include "LibraryIndex.h"
+#include "LibraryProjection.h"
 #include "Progress.h"
 #include "RasterDataDescriptor.h"
 #include "RasterElement.h"
-#include "RasterUtilities.h"
 #include "Signature.h"
 #include "SpatialDataView.h"
 #include "SpectralLibraryMatch.h"
@@ -31,7 +29,32 @@
 #include "Wavelengths.h"
 
 #include <algorithm>
-#include <numeric>
+#include <limits>
+#include <math.h>
+
+// The Intel Threading Building Blocks Library (tbb) is not supported on the Solaris Sparc platform
+#ifndef SOLARIS
+#include <tbb/tbb.h>
+#endif
+
+namespace
+{
+   // The scores are computed in tiles of targets by library signatures. A tile of library rows
+   // is small enough to stay in cache while it is compared against each target in the tile.
+   const unsigned int sTargetBlockSize = 16;
+   const unsigned int sLibraryBlockSize = 128;
+
+   // One target in this many is also matched against the whole library to measure the recall of an index search.
+   const unsigned int sRecallSampleInterval = 32;
+
+   // Values are raised to this floor before a spectrum is treated as a probability distribution
+   // so the spectral information divergence is defined for spectra with zero or negative bands.
+   const double sSidMinimumValue = 1.0e-6;
+
+   // The bounds from a principal component projection are widened by this fraction of the target length
+   // to cover the rounding of the projected and full products, so pruning never removes an exact match.
+   const double sPrefilterTolerance = 1.0e-6;
+}
 
 namespace StringUtilities
 {
@@ -46,6 +69,15 @@ namespace StringUtilities
          "constrained_energy_minimization")
       ADD_ENUM_MAPPING(SpectralLibraryMatch::SLLA_WBI, "Wang-Bovik Index", "wang_bovik_index")
    END_ENUM_MAPPING()
+
+   BEGIN_ENUM_MAPPING_ALIAS(SpectralLibraryMatch::MatchMetric, Match_Metric)
+      ADD_ENUM_MAPPING(SpectralLibraryMatch::SLMM_SAM, "Spectral Angle", "spectral_angle")
+      ADD_ENUM_MAPPING(SpectralLibraryMatch::SLMM_WBI, "Wang-Bovik Index", "wang_bovik_index")
+      ADD_ENUM_MAPPING(SpectralLibraryMatch::SLMM_EUCLIDEAN, "Euclidean Distance", "euclidean_distance")
+      ADD_ENUM_MAPPING(SpectralLibraryMatch::SLMM_CORRELATION, "Spectral Correlation", "spectral_correlation")
+      ADD_ENUM_MAPPING(SpectralLibraryMatch::SLMM_SID, "Spectral Information Divergence",
+         "spectral_information_divergence")
+   END_ENUM_MAPPING()
 }
 
 namespace SpectralLibraryMatch
@@ -119,6 +151,11 @@ namespace SpectralLibraryMatch
       return mThresholdType;
    }
 
+   void MatchLimits::setThresholdType(PassArea thresholdType)
+   {
+      mThresholdType = thresholdType;
+   }
+
    bool MatchLimits::passesThreshold(const double value) const
    {
       if (mThresholdType.isValid())
@@ -144,214 +181,403 @@ namespace SpectralLibraryMatch
       mThresholdLimit = threshold;
    }
 
-   double getSpectralAngle(const std::vector<double>& targetSig, const std::vector<double>& libSig)
+   namespace
    {
-      VERIFYRV(targetSig.size() == libSig.size(), 90.0);
-      double targetMag = sqrt(inner_product(targetSig.begin(),
-         targetSig.end(), targetSig.begin(), 0.0));
-      double libMag = sqrt(inner_product(libSig.begin(), libSig.end(),
-         libSig.begin(), 0.0));
-      double samValue = inner_product(targetSig.begin(), targetSig.end(),
-         libSig.begin(), 0.0);
-      if (targetMag <= 0.0 || libMag <= 0.0)  // set to arbitrary low values so samValue will be very large
+      struct TargetStatistics
+      {
+         double mNorm;
+         double mMean;
+         double mVariance;
+      };
+
+      TargetStatistics getTargetStatistics(const double* pTarget, unsigned int numBands, bool computeVariance)
       {
-         targetMag = 0.001;
-         libMag = 0.001;
+         double sum(0.0);
+         double sumSquares(0.0);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            sum += pTarget[band];
+            sumSquares += pTarget[band] * pTarget[band];
+         }
+
+         TargetStatistics targetStats;
+         targetStats.mNorm = sqrt(sumSquares);
+         targetStats.mMean = sum / static_cast<double>(numBands);
+         targetStats.mVariance = 0.0;
+         if (computeVariance)
+         {
+            for (unsigned int band = 0; band < numBands; ++band)
+            {
+               double centered = pTarget[band] - targetStats.mMean;
+               targetStats.mVariance += centered * centered;
+            }
+            targetStats.mVariance /= static_cast<double>(numBands - 1);
+         }
+
+         return targetStats;
       }
-      samValue /= (targetMag * libMag);
-      if (samValue < -1.0)
+
+      // floors the values and scales them to sum to one, returning the sum of p * log(p)
+      double getSidProbabilities(const double* pValues, unsigned int numBands, double* pProbabilities,
+         double* pLogs)
       {
-         samValue = -1.0;
+         double sum(0.0);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            pProbabilities[band] = std::max(pValues[band], sSidMinimumValue);
+            sum += pProbabilities[band];
+         }
+
+         double sumPLogP(0.0);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            pProbabilities[band] /= sum;
+            pLogs[band] = log(pProbabilities[band]);
+            sumPLogP += pProbabilities[band] * pLogs[band];
+         }
+
+         return sumPLogP;
       }
-      else if (samValue > 1.0)
+
+      // unitDot is the product of the target with the unit length library row
+      double getSpectralAngle(double unitDot, const TargetStatistics& targetStats, const LibraryStatistics& libStats,
+         unsigned int sig)
       {
-         samValue = 1.0;
+         // a zero spectrum gives an angle of 90 degrees
+         if (targetStats.mNorm <= 0.0 || libStats.mNorms[sig] <= 0.0)
+         {
+            return 90.0;
+         }
+         double samValue = unitDot / targetStats.mNorm;
+         if (samValue < -1.0)
+         {
+            samValue = -1.0;
+         }
+         else if (samValue > 1.0)
+         {
+            samValue = 1.0;
+         }
+
+         return (180.0 / PI) * acos(samValue);
       }
-      samValue = (180.0 / PI) * acos(samValue);
 
-      return samValue;
-   }
+      double getWangBovikIndex(double unitDot, const TargetStatistics& targetStats, const LibraryStatistics& libStats,
+         unsigned int sig)
+      {
+         const double wangBovikConst(4.0);  // from Wang, Bovik, "A Universal Image Quality Index",
+                                            // IEEE Signal Processing Letters, Vol 9, No. 3, March 2002
+         double numBands = static_cast<double>(libStats.mNumBands);
+         double targetMean = targetStats.mMean;
+         double libMean = libStats.mMeans[sig];
+         double libStdDev = libStats.mStdDevs[sig];
 
-   double getWangBovikIndex(const std::vector<double>& targetSig, const std::vector<double>& libSig)
-   {
-      VERIFYRV(targetSig.size() == libSig.size(), -1.0);
-      const double wangBovikConst(4.0);  // from Wang, Bovik, "A Universal Image Quality Index",
-                                         // IEEE Signal Processing Letters, Vol 9, No. 3, March 2002
-      unsigned int numBands = static_cast<unsigned int>(targetSig.size());
-      double targetMean =
-         std::accumulate(targetSig.begin(), targetSig.end(), 0.0) / static_cast<double>(numBands);
-      double libMean =
-         std::accumulate(libSig.begin(), libSig.end(), 0.0) / static_cast<double>(numBands);
-      double targetLibCovar(0.0);
-      double targetVariance(0.0);
-      double libVariance(0.0);
-      for (unsigned int band = 0; band < numBands; ++band)
-      {
-         double normTarget = targetSig[band] - targetMean;
-         double normLib = libSig[band] - libMean;
-         targetLibCovar += normTarget * normLib;
-         targetVariance += normTarget * normTarget;
-         libVariance += normLib * normLib;
-      }
-      targetLibCovar /= static_cast<double>(numBands - 1.0);
-      targetVariance /= static_cast<double>(numBands - 1.0);
-      libVariance /= static_cast<double>(numBands - 1.0);
-      double numerator = wangBovikConst * targetLibCovar * targetMean * libMean;
-      double denominator = (targetMean * targetMean + libMean * libMean) * (targetVariance + libVariance);
-      double wbiValue(-99.0);  // initialize to bad value
-      if (abs(denominator) > std::numeric_limits<double>::epsilon())
-      {
-         wbiValue = numerator / denominator;
-      }
-      return wbiValue;
+         // sum((t - tMean) * (l - lMean)) = t.l - n * tMean * lMean, where t.l is recovered from the unit row
+         double dot = unitDot * libStats.mNorms[sig];
+         double targetLibCovar = (dot - numBands * targetMean * libMean) / (numBands - 1.0);
+         double numerator = wangBovikConst * targetLibCovar * targetMean * libMean;
+         double denominator = (targetMean * targetMean + libMean * libMean) *
+            (targetStats.mVariance + libStdDev * libStdDev);
+         double wbiValue(-99.0);  // initialize to bad value
+         if (fabs(denominator) > std::numeric_limits<double>::epsilon())
+         {
+            wbiValue = numerator / denominator;
+         }
+         return wbiValue;
+      }
+
+      double getEuclideanDistance(double unitDot, const TargetStatistics& targetStats,
+         const LibraryStatistics& libStats, unsigned int sig)
+      {
+         // |t - l|^2 = |t|^2 + |l|^2 - 2 t.l, which can round to slightly below zero for nearly equal spectra
+         double libNorm = libStats.mNorms[sig];
+         double distanceSquared = targetStats.mNorm * targetStats.mNorm + libNorm * libNorm - 2.0 * unitDot * libNorm;
+         return sqrt(std::max(distanceSquared, 0.0));
+      }
+
+      double getCorrelation(double unitDot, const TargetStatistics& targetStats, const LibraryStatistics& libStats,
+         unsigned int sig)
+      {
+         // a flat spectrum is not correlated with anything
+         double libStdDev = libStats.mStdDevs[sig];
+         if (targetStats.mVariance <= 0.0 || libStdDev <= 0.0)
+         {
+            return 0.0;
+         }
+         double numBands = static_cast<double>(libStats.mNumBands);
+         double dot = unitDot * libStats.mNorms[sig];
+         double targetLibCovar = (dot - numBands * targetStats.mMean * libStats.mMeans[sig]) / (numBands - 1.0);
+         return targetLibCovar / (sqrt(targetStats.mVariance) * libStdDev);
+      }
+
+      // targetPLogQ is the target probabilities times the library logs and targetLogPQ the reverse
+      double getSpectralInformationDivergence(double targetSumPLogP, double targetPLogQ, double targetLogPQ,
+         const LibraryStatistics& libStats, unsigned int sig)
+      {
+         // D(p||q) + D(q||p) = sum(p log p) - sum(p log q) + sum(q log q) - sum(q log p)
+         return std::max(targetSumPLogP + libStats.mSidEntropies[sig] - targetPLogQ - targetLogPQ, 0.0);
+      }
    }
 
-#if defined SOLARIS  // declare older non-ttb functions since tbb not supported under Solaris
-   bool computeSpectralAngle(const std::vector<double>& targetValues, const RasterElement* pLib,
-      RasterElement* pResults)
+   bool computeLibraryStatistics(const RasterElement* pLib, LibraryStatistics& libStats)
    {
-      VERIFY(pLib != NULL && targetValues.empty() == false && pResults != NULL);
+      VERIFY(pLib != NULL);
       const RasterDataDescriptor* pLibDesc = dynamic_cast<const RasterDataDescriptor*>(pLib->getDataDescriptor());
-      const RasterDataDescriptor* pResultsDesc =
-         dynamic_cast<const RasterDataDescriptor*>(pResults->getDataDescriptor());
-      VERIFY(pLibDesc != NULL && pResultsDesc != NULL && pLibDesc->getRowCount() == pResultsDesc->getRowCount());
-      FactoryResource<DataRequest> libRqt;
-      libRqt->setInterleaveFormat(BIP);
-      DataAccessor libAcc = pLib->getDataAccessor(libRqt.release());
-      FactoryResource<DataRequest> resultsRqt;
-      resultsRqt->setWritable(true);
-      DataAccessor resultsAcc = pResults->getDataAccessor(resultsRqt.release());
-      unsigned int numRows = pLibDesc->getRowCount();
+      VERIFY(pLibDesc != NULL && pLibDesc->getDataType() == FLT8BYTES && pLibDesc->getInterleaveFormat() == BIP);
+
+      // since pLib is always created in memory, we can just grab a raw pointer to the block of doubles
+      const double* pLibData = reinterpret_cast<const double*>(pLib->getRawData());
+      VERIFY(pLibData != NULL);
+      unsigned int numSignatures = pLibDesc->getRowCount();
       unsigned int numBands = pLibDesc->getBandCount();
-      std::vector<double> libValues(numBands);
-      double* pData(NULL);
-      for (unsigned int row = 0; row < numRows; ++row)
+      VERIFY(numBands > 1);
+
+      libStats.mNumSignatures = numSignatures;
+      libStats.mNumBands = numBands;
+      libStats.mNorms.resize(numSignatures);
+      libStats.mMeans.resize(numSignatures);
+      libStats.mStdDevs.resize(numSignatures);
+      libStats.mNormalizedData.resize(static_cast<size_t>(numSignatures) * numBands);
+      libStats.mSidEntropies.clear();
+      libStats.mSidProbabilities.clear();
+      libStats.mSidLogs.clear();
+      double* pNormalized = libStats.mNormalizedData.empty() ? NULL : &libStats.mNormalizedData.front();
+      for (unsigned int sig = 0; sig < numSignatures; ++sig, pLibData += numBands, pNormalized += numBands)
       {
-         VERIFY(libAcc.isValid() && resultsAcc.isValid());
-         memcpy(&libValues[0], libAcc->getColumn(), numBands * sizeof(double));
-         double samValue = getSpectralAngle(targetValues, libValues);
-         pData = reinterpret_cast<double*>(resultsAcc->getColumn());
-         *pData = samValue;
-         libAcc->nextColumn();
-         libAcc->nextRow();
-         resultsAcc->nextColumn();
-         resultsAcc->nextRow();
+         double sum(0.0);
+         double sumSquares(0.0);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            sum += pLibData[band];
+            sumSquares += pLibData[band] * pLibData[band];
+         }
+         double mean = sum / static_cast<double>(numBands);
+         double variance(0.0);
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            double centered = pLibData[band] - mean;
+            variance += centered * centered;
+         }
+         variance /= static_cast<double>(numBands - 1);
+
+         double norm = sqrt(sumSquares);
+         double scale = (norm > 0.0) ? 1.0 / norm : 0.0;  // a zero signature stays zero
+         for (unsigned int band = 0; band < numBands; ++band)
+         {
+            pNormalized[band] = pLibData[band] * scale;
+         }
+         libStats.mNorms[sig] = norm;
+         libStats.mMeans[sig] = mean;
+         libStats.mStdDevs[sig] = sqrt(variance);
       }
 
       return true;
    }
-   bool computeWangBovikIndex(const std::vector<double>& targetValues, const RasterElement* pLib,
-      RasterElement* pResults)
+
+   bool computeSidStatistics(const RasterElement* pLib, LibraryStatistics& libStats)
    {
-      VERIFY(pLib != NULL && targetValues.empty() == false && pResults != NULL);
+      VERIFY(pLib != NULL);
       const RasterDataDescriptor* pLibDesc = dynamic_cast<const RasterDataDescriptor*>(pLib->getDataDescriptor());
-      const RasterDataDescriptor* pResultsDesc =
-         dynamic_cast<const RasterDataDescriptor*>(pResults->getDataDescriptor());
-      VERIFY(pLibDesc != NULL && pResultsDesc != NULL && pLibDesc->getRowCount() == pResultsDesc->getRowCount());
-      FactoryResource<DataRequest> libRqt;
-      libRqt->setInterleaveFormat(BIP);
-      DataAccessor libAcc = pLib->getDataAccessor(libRqt.release());
-      FactoryResource<DataRequest> resultsRqt;
-      resultsRqt->setWritable(true);
-      DataAccessor resultsAcc = pResults->getDataAccessor(resultsRqt.release());
-      unsigned int numRows = pLibDesc->getRowCount();
-      unsigned int numBands = pLibDesc->getBandCount();
-      std::vector<double> libValues(numBands);
-      double* pData(NULL);
-      for (unsigned int row = 0; row < numRows; ++row)
+      VERIFY(pLibDesc != NULL && pLibDesc->getDataType() == FLT8BYTES && pLibDesc->getInterleaveFormat() == BIP);
+      VERIFY(pLibDesc->getRowCount() == libStats.mNumSignatures && pLibDesc->getBandCount() == libStats.mNumBands);
+
+      const double* pLibData = reinterpret_cast<const double*>(pLib->getRawData());
+      VERIFY(pLibData != NULL);
+      unsigned int numSignatures = libStats.mNumSignatures;
+      unsigned int numBands = libStats.mNumBands;
+
+      libStats.mSidEntropies.resize(numSignatures);
+      libStats.mSidProbabilities.resize(static_cast<size_t>(numSignatures) * numBands);
+      libStats.mSidLogs.resize(libStats.mSidProbabilities.size());
+      double* pSidProbabilities = libStats.mSidProbabilities.empty() ? NULL : &libStats.mSidProbabilities.front();
+      double* pSidLogs = libStats.mSidLogs.empty() ? NULL : &libStats.mSidLogs.front();
+      for (unsigned int sig = 0; sig < numSignatures; ++sig, pLibData += numBands, pSidProbabilities += numBands,
+         pSidLogs += numBands)
       {
-         VERIFY(libAcc.isValid() && resultsAcc.isValid());
-         memcpy(&libValues[0], libAcc->getColumn(), numBands * sizeof(double));
-         double wbiValue = getWangBovikIndex(targetValues, libValues);
-         pData = reinterpret_cast<double*>(resultsAcc->getColumn());
-         *pData = wbiValue;
-         libAcc->nextColumn();
-         libAcc->nextRow();
-         resultsAcc->nextColumn();
-         resultsAcc->nextRow();
+         libStats.mSidEntropies[sig] = getSidProbabilities(pLibData, numBands, pSidProbabilities, pSidLogs);
       }
 
       return true;
    }
-#else
-   MatchMetrics::MatchMetrics(double* pLibData, unsigned int numSignatures,
-      MatchResults* pMatchInfo, double* pResultsData) :
-      mpLibData(pLibData),
-      mNumSignatures(numSignatures),
-      mpMatchInfo(pMatchInfo),
-      mpResultsData(pResultsData),
-      mNumBands(pMatchInfo->mTargetValues.size())
-   {}
-
-   MatchMetrics::~MatchMetrics()
-   {}
 
-   void MatchMetrics::operator() (tbb::blocked_range<unsigned int>& range) const
+   class MatchScores
    {
-      const double* pLibData = mpLibData + mNumBands * range.begin();
-      double* pMetricValue = mpResultsData + range.begin();
-      const std::vector<double>& targetValues = mpMatchInfo->mTargetValues;
+   public:
+      MatchScores(const double* pTargets, const LibraryStatistics& libStats, MatchAlgorithm algorithm) :
+         mpTargets(pTargets),
+         mLibStats(libStats),
+         mNumBands(libStats.mNumBands),
+         mAlgorithm(algorithm)
+      {}
 
-      // set up function for metric computation
-      double (*computeFunc)(const std::vector<double>& targetSig, const std::vector<double>& libSig);
-      switch (mpMatchInfo->mAlgorithmUsed)
+      // pScores is the score of targetBegin against sigBegin, and each target's scores start rowStride later
+      void compute(unsigned int targetBegin, unsigned int targetEnd, unsigned int sigBegin, unsigned int sigEnd,
+         double* pScores, size_t rowStride) const
       {
-      case SLMA_SAM:
-         computeFunc = getSpectralAngle;
-         break;
+         // Score the targets against one block of library rows at a time so that the block stays in cache.
+         // Four library rows are accumulated together so each target value is loaded once per four products.
+         // The library rows are pre-normalized, so each product is the target projected onto a unit signature.
+         // The target statistics do not depend on the library block, so they are computed once per target.
+         std::vector<TargetStatistics> targetStats(targetEnd - targetBegin);
+         for (unsigned int target = targetBegin; target < targetEnd; ++target)
+         {
+            targetStats[target - targetBegin] = getTargetStatistics(mpTargets + static_cast<size_t>(target) * mNumBands,
+               mNumBands, mAlgorithm == SLMA_WBI);
+         }
 
-     case SLMA_WBI:
-        computeFunc = getWangBovikIndex;
-        break;
+         const double* pLibData = &mLibStats.mNormalizedData.front();
+         for (unsigned int libBegin = sigBegin; libBegin < sigEnd; libBegin += sLibraryBlockSize)
+         {
+            unsigned int libEnd = std::min(libBegin + sLibraryBlockSize, sigEnd);
+            for (unsigned int target = targetBegin; target < targetEnd; ++target)
+            {
+               const double* pTarget = mpTargets + static_cast<size_t>(target) * mNumBands;
+               double* pTargetScores = pScores + static_cast<size_t>(target - targetBegin) * rowStride;
+               const TargetStatistics& stats = targetStats[target - targetBegin];
 
-      default:
-         return;
+               unsigned int sig = libBegin;
+               for (; sig + 4 <= libEnd; sig += 4)
+               {
+                  const double* pLib0 = pLibData + static_cast<size_t>(sig) * mNumBands;
+                  const double* pLib1 = pLib0 + mNumBands;
+                  const double* pLib2 = pLib1 + mNumBands;
+                  const double* pLib3 = pLib2 + mNumBands;
+                  double dot0(0.0);
+                  double dot1(0.0);
+                  double dot2(0.0);
+                  double dot3(0.0);
+                  for (unsigned int band = 0; band < mNumBands; ++band)
+                  {
+                     double value = pTarget[band];
+                     dot0 += value * pLib0[band];
+                     dot1 += value * pLib1[band];
+                     dot2 += value * pLib2[band];
+                     dot3 += value * pLib3[band];
+                  }
+                  pTargetScores[sig - sigBegin] = getScore(dot0, stats, sig);
+                  pTargetScores[sig - sigBegin + 1] = getScore(dot1, stats, sig + 1);
+                  pTargetScores[sig - sigBegin + 2] = getScore(dot2, stats, sig + 2);
+                  pTargetScores[sig - sigBegin + 3] = getScore(dot3, stats, sig + 3);
+               }
+               for (; sig < libEnd; ++sig)
+               {
+                  const double* pLib = pLibData + static_cast<size_t>(sig) * mNumBands;
+                  double dot(0.0);
+                  for (unsigned int band = 0; band < mNumBands; ++band)
+                  {
+                     dot += pTarget[band] * pLib[band];
+                  }
+                  pTargetScores[sig - sigBegin] = getScore(dot, stats, sig);
+               }
+            }
+         }
+      }
+
+      // scores one target against the listed library rows
+      void compute(unsigned int target, const std::vector<int>& signatures, std::vector<double>& scores) const
+      {
+         const double* pTarget = mpTargets + static_cast<size_t>(target) * mNumBands;
+         TargetStatistics targetStats = getTargetStatistics(pTarget, mNumBands, mAlgorithm == SLMA_WBI);
+         scores.resize(signatures.size());
+         for (std::vector<int>::size_type index = 0; index < signatures.size(); ++index)
+         {
+            unsigned int sig = static_cast<unsigned int>(signatures[index]);
+            const double* pLib = &mLibStats.mNormalizedData.front() + static_cast<size_t>(sig) * mNumBands;
+            double dot(0.0);
+            for (unsigned int band = 0; band < mNumBands; ++band)
+            {
+               dot += pTarget[band] * pLib[band];
+            }
+            scores[index] = getScore(dot, targetStats, sig);
+         }
       }
-      unsigned int sigsize(mNumBands * sizeof(double));
-      std::vector<double> libValues(mNumBands);
-      for (unsigned int row = range.begin(); row < range.end(); ++row)
+
+      const double* getTarget(unsigned int target) const
       {
-         memcpy(&libValues[0], pLibData, sigsize);
-         *pMetricValue = computeFunc(mpMatchInfo->mTargetValues, libValues);
-         pLibData += mNumBands;
-         ++pMetricValue;
+         return mpTargets + static_cast<size_t>(target) * mNumBands;
       }
-   }
 
-   bool generateMetrics(const RasterElement* pLib, MatchResults& matchInfo, RasterElement* pResults)
-   {
-      VERIFY(pLib != NULL && matchInfo.mTargetValues.empty() == false && pResults != NULL);
+      TargetStatistics getStatistics(unsigned int target) const
+      {
+         return getTargetStatistics(mpTargets + static_cast<size_t>(target) * mNumBands, mNumBands,
+            mAlgorithm == SLMA_WBI);
+      }
 
-      const RasterDataDescriptor* pLibDesc = dynamic_cast<const RasterDataDescriptor*>(pLib->getDataDescriptor());
-      const RasterDataDescriptor* pResultsDesc =
-         dynamic_cast<const RasterDataDescriptor*>(pResults->getDataDescriptor());
-      VERIFY(pLibDesc != NULL && pResultsDesc != NULL && pLibDesc->getRowCount() == pResultsDesc->getRowCount());
-
-      // since pLib and pResults are always created in memory, we can just grab raw pointers to the blocks of doubles
-      double* pLibData = reinterpret_cast<double*>(const_cast<void*>(pLib->getRawData()));
-      double* pResultsData = reinterpret_cast<double*>(const_cast<void*>(pResults->getRawData()));
-      VERIFY(pLibData != NULL && pResultsData != NULL);
-      unsigned int numSignatures = pLibDesc->getRowCount();
-      unsigned int numBands = pLibDesc->getBandCount();
+      // the score is monotonic in unitDot for every algorithm, so a range of products gives a range of scores
+      double getScore(double unitDot, const TargetStatistics& targetStats, unsigned int sig) const
+      {
+         switch (mAlgorithm)
+         {
+         case SLMA_SAM:
+            return getSpectralAngle(unitDot, targetStats, mLibStats, sig);
 
-      MatchMetrics metrics(pLibData, numSignatures, &matchInfo, pResultsData);
+         case SLMA_WBI:
+            return getWangBovikIndex(unitDot, targetStats, mLibStats, sig);
 
-      // granularity of 50 was the optimum determined from testing using library with 464 signatures
-      unsigned int granularity(50);
-      tbb::parallel_for(tbb::blocked_range<unsigned int>(0, numSignatures, granularity), metrics, tbb::simple_partitioner());
+         default:
+            return 0.0;
+         }
+      }
 
-      return true;
-   }
-#endif
+   private:
+      const double* mpTargets;
+      const LibraryStatistics& mLibStats;
+      unsigned int mNumBands;
+      MatchAlgorithmEnum mAlgorithm;
+   };
 
-   bool lessThan(std::pair<Signature*, float>& lhs, std::pair<Signature*, float>& rhs)
+   class ScoreMatrix
    {
-      return lhs.second < rhs.second;
-   }
+   public:
+      ScoreMatrix(const MatchScores& matchScores, double* pScores, unsigned int numSignatures) :
+         mMatchScores(matchScores),
+         mpScores(pScores),
+         mNumSignatures(numSignatures)
+      {}
+
+      void compute(unsigned int targetBegin, unsigned int targetEnd, unsigned int sigBegin, unsigned int sigEnd) const
+      {
+         mMatchScores.compute(targetBegin, targetEnd, sigBegin, sigEnd,
+            mpScores + static_cast<size_t>(targetBegin) * mNumSignatures + sigBegin, mNumSignatures);
+      }
 
-   bool greaterThan(std::pair<Signature*, float>& lhs, std::pair<Signature*, float>& rhs)
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range2d<unsigned int>& range) const
+      {
+         compute(range.rows().begin(), range.rows().end(), range.cols().begin(), range.cols().end());
+      }
+#endif
+
+   private:
+      const MatchScores& mMatchScores;
+      double* mpScores;
+      unsigned int mNumSignatures;
+   };
+
+   bool computeMatchScores(const LibraryStatistics& libStats, MatchAlgorithm algorithm, const double* pTargets,
+      unsigned int numTargets, std::vector<double>& scores)
    {
-      return lhs.second > rhs.second;
+      VERIFY(pTargets != NULL && numTargets > 0 && algorithm.isValid());
+      VERIFY(libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+
+      unsigned int numSignatures = libStats.mNumSignatures;
+      scores.resize(static_cast<size_t>(numTargets) * numSignatures);
+      if (scores.empty())
+      {
+         return true;
+      }
+      MatchScores matchScores(pTargets, libStats, algorithm);
+      ScoreMatrix scoreMatrix(matchScores, &scores.front(), numSignatures);
+
+#if defined SOLARIS  // tbb not available under solaris so score all of the targets on this thread
+      scoreMatrix.compute(0, numTargets, 0, numSignatures);
+#else
+      // split on both targets and signatures so a single target against a large library is still parallel
+      tbb::parallel_for(tbb::blocked_range2d<unsigned int>(0, numTargets, sTargetBlockSize,
+         0, numSignatures, sLibraryBlockSize), scoreMatrix, tbb::simple_partitioner());
+#endif
+
+      return true;
    }
 
    AlgorithmSortOrder getAlgorithmSortOrder(MatchAlgorithm algType)
@@ -374,51 +600,730 @@ namespace SpectralLibraryMatch
       return sortOrder;
    }
 
-   void generateSortedResults(RasterElement* pAlgOutput, const std::vector<Signature*> libSignatures,
-                              MatchResults& theResults)
+   class MatchCandidates
+   {
+   public:
+      typedef std::pair<float, unsigned int> Candidate;
+
+      MatchCandidates(bool ascending, unsigned int maxCandidates, unsigned int numSignatures) :
+         mOrder(ascending),
+         mMaxCandidates(maxCandidates),
+         mBounded(maxCandidates < numSignatures)
+      {}
+
+      void add(float score, unsigned int sig)
+      {
+         Candidate candidate(score, sig);
+         if (mCandidates.size() < mMaxCandidates)
+         {
+            mCandidates.push_back(candidate);
+            if (mBounded)
+            {
+               std::push_heap(mCandidates.begin(), mCandidates.end(), mOrder);
+            }
+         }
+         else if (mMaxCandidates > 0 && mOrder(candidate, mCandidates.front()))
+         {
+            // the heap keeps the worst of the kept candidates on top so it is the one replaced
+            std::pop_heap(mCandidates.begin(), mCandidates.end(), mOrder);
+            mCandidates.back() = candidate;
+            std::push_heap(mCandidates.begin(), mCandidates.end(), mOrder);
+         }
+      }
+
+      void merge(const MatchCandidates& other)
+      {
+         for (std::vector<Candidate>::const_iterator it = other.mCandidates.begin();
+            it != other.mCandidates.end(); ++it)
+         {
+            add(it->first, it->second);
+         }
+      }
+
+      void getResults(const std::vector<Signature*>& libSignatures,
+         std::vector<std::pair<Signature*, float> >& results)
+      {
+         if (mBounded)
+         {
+            std::sort_heap(mCandidates.begin(), mCandidates.end(), mOrder);
+         }
+         else
+         {
+            std::sort(mCandidates.begin(), mCandidates.end(), mOrder);
+         }
+
+         results.clear();
+         results.reserve(mCandidates.size());
+         for (std::vector<Candidate>::const_iterator it = mCandidates.begin(); it != mCandidates.end(); ++it)
+         {
+            results.push_back(std::pair<Signature*, float>(libSignatures[it->second], it->first));
+         }
+      }
+
+      // writes the best count candidates in match order, padding with an index of -1 and a score of zero
+      void getMatches(unsigned int count, int* pIndices, float* pScores)
+      {
+         if (mBounded)
+         {
+            std::sort_heap(mCandidates.begin(), mCandidates.end(), mOrder);
+         }
+         else
+         {
+            std::sort(mCandidates.begin(), mCandidates.end(), mOrder);
+         }
+         mBounded = false;  // the candidates are no longer a heap
+
+         for (unsigned int match = 0; match < count; ++match)
+         {
+            if (match < mCandidates.size())
+            {
+               pIndices[match] = static_cast<int>(mCandidates[match].second);
+               pScores[match] = mCandidates[match].first;
+            }
+            else
+            {
+               pIndices[match] = -1;
+               pScores[match] = 0.0f;
+            }
+         }
+      }
+
+   private:
+      // returns true if lhs is a better match than rhs; ties go to the earlier library signature
+      struct CandidateOrder
+      {
+         CandidateOrder(bool ascending) :
+            mAscending(ascending)
+         {}
+
+         bool operator()(const Candidate& lhs, const Candidate& rhs) const
+         {
+            if (lhs.first != rhs.first)
+            {
+               return mAscending ? (lhs.first < rhs.first) : (lhs.first > rhs.first);
+            }
+            return lhs.second < rhs.second;
+         }
+
+         bool mAscending;
+      };
+
+      CandidateOrder mOrder;
+      unsigned int mMaxCandidates;
+      bool mBounded;
+      std::vector<Candidate> mCandidates;
+   };
+
+   class MatchSelection
+   {
+   public:
+      MatchSelection(const MatchScores& matchScores, unsigned int numTargets, unsigned int numSignatures,
+         bool ascending, const MatchLimits& limits) :
+         mMatchScores(matchScores),
+         mNumTargets(numTargets),
+         mNumSignatures(numSignatures),
+         mAscending(ascending),
+         mMaxCandidates(limits.getLimitByNum() ? limits.getMaxNum() : numSignatures),
+         mLimits(limits),
+         mLimitByThreshold(limits.getLimitByThreshold() && limits.getThresholdType().isValid())
+      {
+         // an invalid threshold type is logged and the results are not limited by threshold
+         VERIFYNR(limits.getLimitByThreshold() == false || limits.getThresholdType().isValid());
+         mCandidates.resize(mNumTargets, MatchCandidates(mAscending, mMaxCandidates, mNumSignatures));
+      }
+
+#ifndef SOLARIS
+      MatchSelection(MatchSelection& other, tbb::split) :
+         mMatchScores(other.mMatchScores),
+         mNumTargets(other.mNumTargets),
+         mNumSignatures(other.mNumSignatures),
+         mAscending(other.mAscending),
+         mMaxCandidates(other.mMaxCandidates),
+         mLimits(other.mLimits),
+         mLimitByThreshold(other.mLimitByThreshold),
+         mCandidates(other.mNumTargets, MatchCandidates(other.mAscending, other.mMaxCandidates, other.mNumSignatures))
+      {}
+#endif
+
+      void select(unsigned int sigBegin, unsigned int sigEnd)
+      {
+         // Each tile of scores is filtered and offered to the bounded candidate lists as soon as it is computed,
+         // so the full set of scores is never stored or sorted.
+         std::vector<double> tile(static_cast<size_t>(sTargetBlockSize) * sLibraryBlockSize);
+         for (unsigned int libBegin = sigBegin; libBegin < sigEnd; libBegin += sLibraryBlockSize)
+         {
+            unsigned int libEnd = std::min(libBegin + sLibraryBlockSize, sigEnd);
+            for (unsigned int targetBegin = 0; targetBegin < mNumTargets; targetBegin += sTargetBlockSize)
+            {
+               unsigned int targetEnd = std::min(targetBegin + sTargetBlockSize, mNumTargets);
+               mMatchScores.compute(targetBegin, targetEnd, libBegin, libEnd, &tile.front(), libEnd - libBegin);
+
+               const double* pScore = &tile.front();
+               for (unsigned int target = targetBegin; target < targetEnd; ++target)
+               {
+                  MatchCandidates& candidates = mCandidates[target];
+                  for (unsigned int sig = libBegin; sig < libEnd; ++sig, ++pScore)
+                  {
+                     float score = static_cast<float>(*pScore);
+                     if (mLimitByThreshold == false || mLimits.passesThreshold(static_cast<double>(score)))
+                     {
+                        candidates.add(score, sig);
+                     }
+                  }
+               }
+            }
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<unsigned int>& range)
+      {
+         select(range.begin(), range.end());
+      }
+
+      void join(const MatchSelection& other)
+      {
+         for (unsigned int target = 0; target < mNumTargets; ++target)
+         {
+            mCandidates[target].merge(other.mCandidates[target]);
+         }
+      }
+#endif
+
+      void getResults(unsigned int target, const std::vector<Signature*>& libSignatures,
+         std::vector<std::pair<Signature*, float> >& results)
+      {
+         mCandidates[target].getResults(libSignatures, results);
+      }
+
+      void getMatches(unsigned int target, unsigned int count, int* pIndices, float* pScores)
+      {
+         mCandidates[target].getMatches(count, pIndices, pScores);
+      }
+
+   private:
+      const MatchScores& mMatchScores;
+      unsigned int mNumTargets;
+      unsigned int mNumSignatures;
+      bool mAscending;
+      unsigned int mMaxCandidates;
+      const MatchLimits& mLimits;
+      bool mLimitByThreshold;
+      std::vector<MatchCandidates> mCandidates;
+   };
+
+   class ApproximateSelection
+   {
+   public:
+      ApproximateSelection(const MatchScores& matchScores, const LibraryIndex& libIndex, const double* pTargets,
+         unsigned int numBands, unsigned int numCandidates, unsigned int numChecks, bool ascending,
+         const MatchLimits& limits, const std::vector<Signature*>& libSignatures,
+         std::vector<MatchResults>& theResults) :
+         mMatchScores(matchScores),
+         mLibIndex(libIndex),
+         mpTargets(pTargets),
+         mNumBands(numBands),
+         mNumCandidates(numCandidates),
+         mNumChecks(numChecks),
+         mAscending(ascending),
+         mLimits(limits),
+         mLimitByThreshold(limits.getLimitByThreshold() && limits.getThresholdType().isValid()),
+         mLibSignatures(libSignatures),
+         mResults(theResults)
+      {
+         // an invalid threshold type is logged and the results are not limited by threshold
+         VERIFYNR(limits.getLimitByThreshold() == false || limits.getThresholdType().isValid());
+      }
+
+      void select(unsigned int targetBegin, unsigned int targetEnd) const
+      {
+         unsigned int numSignatures = static_cast<unsigned int>(mLibSignatures.size());
+         std::vector<int> candidates;
+         std::vector<double> scores;
+         for (unsigned int target = targetBegin; target < targetEnd; ++target)
+         {
+            MatchCandidates matches(mAscending, mLimits.getMaxNum(), numSignatures);
+            if (mLibIndex.findCandidates(mpTargets + static_cast<size_t>(target) * mNumBands, mNumCandidates,
+               mNumChecks, candidates))
+            {
+               mMatchScores.compute(target, candidates, scores);
+               for (std::vector<int>::size_type index = 0; index < candidates.size(); ++index)
+               {
+                  float score = static_cast<float>(scores[index]);
+                  if (mLimitByThreshold == false || mLimits.passesThreshold(static_cast<double>(score)))
+                  {
+                     matches.add(score, static_cast<unsigned int>(candidates[index]));
+                  }
+               }
+            }
+            matches.getResults(mLibSignatures, mResults[target].mResults);
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<unsigned int>& range) const
+      {
+         select(range.begin(), range.end());
+      }
+#endif
+
+   private:
+      const MatchScores& mMatchScores;
+      const LibraryIndex& mLibIndex;
+      const double* mpTargets;
+      unsigned int mNumBands;
+      unsigned int mNumCandidates;
+      unsigned int mNumChecks;
+      bool mAscending;
+      const MatchLimits& mLimits;
+      bool mLimitByThreshold;
+      const std::vector<Signature*>& mLibSignatures;
+      std::vector<MatchResults>& mResults;
+   };
+
+   class PrefilteredSelection
    {
-      theResults.mResults.clear();
-      if (pAlgOutput == NULL || libSignatures.empty())
+   public:
+      PrefilteredSelection(const MatchScores& matchScores, const LibraryProjection& libProjection,
+         bool ascending, const MatchLimits& limits, std::vector<MatchCandidates>& candidates,
+         std::vector<unsigned int>& numRescored) :
+         mMatchScores(matchScores),
+         mLibProjection(libProjection),
+         mAscending(ascending),
+         mLimits(limits),
+         mLimitByThreshold(limits.getLimitByThreshold() && limits.getThresholdType().isValid()),
+         mCandidates(candidates),
+         mNumRescored(numRescored)
       {
-         return;
+         // an invalid threshold type is logged and the results are not limited by threshold
+         VERIFYNR(limits.getLimitByThreshold() == false || limits.getThresholdType().isValid());
       }
-      bool (*sortOrderFunc)(std::pair<Signature*, float>& lhs, std::pair<Signature*, float>& rhs);
-      switch (getAlgorithmSortOrder(theResults.mAlgorithmUsed))
+
+      void select(unsigned int targetBegin, unsigned int targetEnd) const
+      {
+         unsigned int numSignatures = mLibProjection.getNumSignatures();
+         unsigned int numComponents = mLibProjection.getNumComponents();
+         unsigned int maxMatches = mLimits.getMaxNum();
+         std::vector<double> targetComponents(numComponents);
+         std::vector<float> bestScores(numSignatures);
+         std::vector<float> worstScores(numSignatures);
+         std::vector<float> cutoffScores;
+         std::vector<int> survivors;
+         std::vector<double> scores;
+         for (unsigned int target = targetBegin; target < targetEnd; ++target)
+         {
+            // bound the product of the target with each unit row from the projected values and residual lengths
+            TargetStatistics targetStats = mMatchScores.getStatistics(target);
+            mLibProjection.project(mMatchScores.getTarget(target), &targetComponents.front());
+            double projectedSquares(0.0);
+            for (unsigned int component = 0; component < numComponents; ++component)
+            {
+               projectedSquares += targetComponents[component] * targetComponents[component];
+            }
+            double targetResidual = sqrt(std::max(targetStats.mNorm * targetStats.mNorm - projectedSquares, 0.0));
+            double tolerance = sPrefilterTolerance * targetStats.mNorm;
+
+            // The bounds are compared as the float scores which are reported. The float of an exact score is
+            // between the floats of its bounds, so a signature whose best bound is worse than the worst bounds
+            // of the maximum number of other signatures is worse than each of them and cannot be a match.
+            cutoffScores.clear();
+            for (unsigned int sig = 0; sig < numSignatures; ++sig)
+            {
+               const double* pSigComponents = mLibProjection.getComponents(sig);
+               double projectedDot(0.0);
+               for (unsigned int component = 0; component < numComponents; ++component)
+               {
+                  projectedDot += targetComponents[component] * pSigComponents[component];
+               }
+               double spread = targetResidual * mLibProjection.getResidualNorm(sig) + tolerance;
+               float lowDotScore = static_cast<float>(mMatchScores.getScore(projectedDot - spread, targetStats, sig));
+               float highDotScore = static_cast<float>(mMatchScores.getScore(projectedDot + spread, targetStats, sig));
+               bestScores[sig] = isBetter(lowDotScore, highDotScore) ? lowDotScore : highDotScore;
+               worstScores[sig] = isBetter(lowDotScore, highDotScore) ? highDotScore : lowDotScore;
+               // an exact score between two bounds which pass a one-sided threshold passes it too
+               if (mLimitByThreshold == false || (mLimits.passesThreshold(static_cast<double>(bestScores[sig])) &&
+                  mLimits.passesThreshold(static_cast<double>(worstScores[sig]))))
+               {
+                  cutoffScores.push_back(worstScores[sig]);
+               }
+            }
+
+            bool limitByCutoff = cutoffScores.size() >= maxMatches && maxMatches > 0;
+            float cutoff(0.0f);
+            if (limitByCutoff)
+            {
+               std::vector<float>::iterator cutoffIter = cutoffScores.begin() + (maxMatches - 1);
+               std::nth_element(cutoffScores.begin(), cutoffIter, cutoffScores.end(), ScoreOrder(mAscending));
+               cutoff = *cutoffIter;
+            }
+
+            survivors.clear();
+            for (unsigned int sig = 0; sig < numSignatures; ++sig)
+            {
+               float bestScore = bestScores[sig];
+               if ((limitByCutoff == false || isBetter(cutoff, bestScore) == false) &&
+                  (mLimitByThreshold == false || mLimits.passesThreshold(static_cast<double>(bestScore)) ||
+                  mLimits.passesThreshold(static_cast<double>(worstScores[sig]))))
+               {
+                  survivors.push_back(static_cast<int>(sig));
+               }
+            }
+
+            // only the survivors are scored over every band
+            MatchCandidates& matches = mCandidates[target];
+            mMatchScores.compute(target, survivors, scores);
+            for (std::vector<int>::size_type index = 0; index < survivors.size(); ++index)
+            {
+               float score = static_cast<float>(scores[index]);
+               if (mLimitByThreshold == false || mLimits.passesThreshold(static_cast<double>(score)))
+               {
+                  matches.add(score, static_cast<unsigned int>(survivors[index]));
+               }
+            }
+            mNumRescored[target] = static_cast<unsigned int>(survivors.size());
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<unsigned int>& range) const
+      {
+         select(range.begin(), range.end());
+      }
+#endif
+
+   private:
+      struct ScoreOrder
       {
-      case ASO_ASCENDING:
-         sortOrderFunc = lessThan;
+         ScoreOrder(bool ascending) :
+            mAscending(ascending)
+         {}
+
+         bool operator()(float lhs, float rhs) const
+         {
+            return mAscending ? (lhs < rhs) : (lhs > rhs);
+         }
+
+         bool mAscending;
+      };
+
+      bool isBetter(float lhs, float rhs) const
+      {
+         return ScoreOrder(mAscending)(lhs, rhs);
+      }
+
+      const MatchScores& mMatchScores;
+      const LibraryProjection& mLibProjection;
+      bool mAscending;
+      const MatchLimits& mLimits;
+      bool mLimitByThreshold;
+      std::vector<MatchCandidates>& mCandidates;
+      std::vector<unsigned int>& mNumRescored;
+   };
+
+   AlgorithmSortOrder getMetricSortOrder(MatchMetric metric)
+   {
+      AlgorithmSortOrder sortOrder;
+      switch (metric)
+      {
+      case SLMM_SAM:          // fall through
+      case SLMM_EUCLIDEAN:    // fall through
+      case SLMM_SID:
+         sortOrder = ASO_ASCENDING;
          break;
 
-      case ASO_DESCENDING:
-         sortOrderFunc = greaterThan;
+      case SLMM_WBI:          // fall through
+      case SLMM_CORRELATION:
+         sortOrder = ASO_DESCENDING;
          break;
 
-      default:    // invalid sort order, so exit
-         return;
+      default:     // return invalid enum
+         break;
       }
 
-      RasterDataDescriptor* pDesc = dynamic_cast<RasterDataDescriptor*>(pAlgOutput->getDataDescriptor());
-      VERIFYNRV(pDesc != NULL);
-      VERIFYNRV(pDesc->getRowCount() == libSignatures.size());
-      theResults.mResults.reserve(libSignatures.size());
-      FactoryResource<DataRequest> pRqt;
-      pRqt->setInterleaveFormat(BIP);
-      pRqt->setRows(pDesc->getActiveRow(0), pDesc->getActiveRow(pDesc->getRowCount() - 1), 1);
-      DataAccessor acc = pAlgOutput->getDataAccessor(pRqt.release());
-      VERIFYNRV(acc.isValid());
-      for (std::vector<Signature*>::const_iterator libIt = libSignatures.begin();
-         libIt != libSignatures.end() && acc.isValid(); ++libIt)
+      return sortOrder;
+   }
+
+   class MetricSelection
+   {
+   public:
+      MetricSelection(const double* pTargets, const LibraryStatistics& libStats,
+         const std::vector<MatchMetric>& metrics, bool computeConsensus, unsigned int maxMatches,
+         const std::vector<Signature*>& libSignatures, std::vector<MetricMatchResults>& theResults) :
+         mpTargets(pTargets),
+         mLibStats(libStats),
+         mNumBands(libStats.mNumBands),
+         mNumSignatures(libStats.mNumSignatures),
+         mComputeConsensus(computeConsensus && metrics.size() > 1),
+         mMaxMatches((maxMatches == 0) ? libStats.mNumSignatures : std::min(maxMatches, libStats.mNumSignatures)),
+         mComputeVariance(false),
+         mComputeSid(false),
+         mLibSignatures(libSignatures),
+         mResults(theResults)
       {
-         double* pData = reinterpret_cast<double*>(acc->getColumn());
-         theResults.mResults.push_back(std::pair<Signature*, float>(*libIt, static_cast<float>(*pData)));
-         acc->nextRow();
+         for (std::vector<MatchMetric>::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+         {
+            mMetrics.push_back(*it);
+            mAscending.push_back(getMetricSortOrder(*it) == ASO_ASCENDING);
+            mComputeVariance = mComputeVariance || *it == SLMM_WBI || *it == SLMM_CORRELATION;
+            mComputeSid = mComputeSid || *it == SLMM_SID;
+         }
       }
 
-      VERIFYNRV(theResults.mResults.size() == libSignatures.size());
+      void select(unsigned int targetBegin, unsigned int targetEnd) const
+      {
+         // The scores of a block of targets are kept for every metric and signature so each signature
+         // can be ranked against the whole library. The blocks are small enough that this stays modest.
+         unsigned int numMetrics = static_cast<unsigned int>(mMetrics.size());
+         size_t metricStride = static_cast<size_t>(sTargetBlockSize) * mNumSignatures;
+         std::vector<double> scores(numMetrics * metricStride);
+         std::vector<TargetStatistics> targetStats(sTargetBlockSize);
+         std::vector<double> targetSumPLogP(sTargetBlockSize);
+         std::vector<double> targetProbabilities;
+         std::vector<double> targetLogs;
+         if (mComputeSid)
+         {
+            targetProbabilities.resize(static_cast<size_t>(sTargetBlockSize) * mNumBands);
+            targetLogs.resize(targetProbabilities.size());
+         }
 
-      std::make_heap(theResults.mResults.begin(), theResults.mResults.end(), sortOrderFunc);
-      std::sort_heap(theResults.mResults.begin(), theResults.mResults.end(), sortOrderFunc);
-   }
+         for (unsigned int blockBegin = targetBegin; blockBegin < targetEnd; blockBegin += sTargetBlockSize)
+         {
+            unsigned int blockEnd = std::min(blockBegin + sTargetBlockSize, targetEnd);
+            for (unsigned int target = blockBegin; target < blockEnd; ++target)
+            {
+               unsigned int offset = target - blockBegin;
+               const double* pTarget = mpTargets + static_cast<size_t>(target) * mNumBands;
+               targetStats[offset] = getTargetStatistics(pTarget, mNumBands, mComputeVariance);
+               if (mComputeSid)
+               {
+                  targetSumPLogP[offset] = getSidProbabilities(pTarget, mNumBands,
+                     &targetProbabilities[static_cast<size_t>(offset) * mNumBands],
+                     &targetLogs[static_cast<size_t>(offset) * mNumBands]);
+               }
+            }
+
+            computeScores(blockBegin, blockEnd, targetStats, targetSumPLogP, targetProbabilities, targetLogs,
+               scores, metricStride);
+            for (unsigned int target = blockBegin; target < blockEnd; ++target)
+            {
+               selectMatches(&scores[static_cast<size_t>(target - blockBegin) * mNumSignatures], metricStride,
+                  mResults[target].mMatches);
+            }
+         }
+      }
+
+#ifndef SOLARIS
+      void operator() (const tbb::blocked_range<unsigned int>& range) const
+      {
+         select(range.begin(), range.end());
+      }
+#endif
+
+   private:
+      void computeScores(unsigned int blockBegin, unsigned int blockEnd,
+         const std::vector<TargetStatistics>& targetStats, const std::vector<double>& targetSumPLogP,
+         const std::vector<double>& targetProbabilities, const std::vector<double>& targetLogs,
+         std::vector<double>& scores, size_t metricStride) const
+      {
+         // Every metric is finished from the same pass over the bands of a library row: the product with the
+         // unit row gives the angle, distance and covariance terms, and the divergence adds the products of
+         // each spectrum's probabilities with the other's logs.
+         const double* pLibData = &mLibStats.mNormalizedData.front();
+         for (unsigned int libBegin = 0; libBegin < mNumSignatures; libBegin += sLibraryBlockSize)
+         {
+            unsigned int libEnd = std::min(libBegin + sLibraryBlockSize, mNumSignatures);
+            for (unsigned int target = blockBegin; target < blockEnd; ++target)
+            {
+               unsigned int offset = target - blockBegin;
+               const double* pTarget = mpTargets + static_cast<size_t>(target) * mNumBands;
+               const double* pTargetProbabilities = mComputeSid ?
+                  &targetProbabilities[static_cast<size_t>(offset) * mNumBands] : NULL;
+               const double* pTargetLogs = mComputeSid ? &targetLogs[static_cast<size_t>(offset) * mNumBands] : NULL;
+               double* pTargetScores = &scores[static_cast<size_t>(offset) * mNumSignatures];
+               for (unsigned int sig = libBegin; sig < libEnd; ++sig)
+               {
+                  size_t rowOffset = static_cast<size_t>(sig) * mNumBands;
+                  const double* pLib = pLibData + rowOffset;
+                  double unitDot(0.0);
+                  double targetPLogQ(0.0);
+                  double targetLogPQ(0.0);
+                  if (mComputeSid)
+                  {
+                     const double* pLibProbabilities = &mLibStats.mSidProbabilities[rowOffset];
+                     const double* pLibLogs = &mLibStats.mSidLogs[rowOffset];
+                     for (unsigned int band = 0; band < mNumBands; ++band)
+                     {
+                        unitDot += pTarget[band] * pLib[band];
+                        targetPLogQ += pTargetProbabilities[band] * pLibLogs[band];
+                        targetLogPQ += pTargetLogs[band] * pLibProbabilities[band];
+                     }
+                  }
+                  else
+                  {
+                     for (unsigned int band = 0; band < mNumBands; ++band)
+                     {
+                        unitDot += pTarget[band] * pLib[band];
+                     }
+                  }
+
+                  const TargetStatistics& stats = targetStats[offset];
+                  for (std::vector<MatchMetric>::size_type metric = 0; metric < mMetrics.size(); ++metric)
+                  {
+                     double score(0.0);
+                     switch (mMetrics[metric])
+                     {
+                     case SLMM_SAM:
+                        score = getSpectralAngle(unitDot, stats, mLibStats, sig);
+                        break;
+
+                     case SLMM_WBI:
+                        score = getWangBovikIndex(unitDot, stats, mLibStats, sig);
+                        break;
+
+                     case SLMM_EUCLIDEAN:
+                        score = getEuclideanDistance(unitDot, stats, mLibStats, sig);
+                        break;
+
+                     case SLMM_CORRELATION:
+                        score = getCorrelation(unitDot, stats, mLibStats, sig);
+                        break;
+
+                     case SLMM_SID:
+                        score = getSpectralInformationDivergence(targetSumPLogP[offset], targetPLogQ, targetLogPQ,
+                           mLibStats, sig);
+                        break;
+
+                     default:
+                        break;
+                     }
+                     pTargetScores[metric * metricStride + sig] = score;
+                  }
+               }
+            }
+         }
+      }
+
+      // pScores is the target's score for the first metric and the scores of each later metric start metricStride on
+      void selectMatches(const double* pScores, size_t metricStride, std::vector<MetricMatch>& matches) const
+      {
+         // rank the signatures by each metric; equal scores share the best of their ranks
+         unsigned int numMetrics = static_cast<unsigned int>(mMetrics.size());
+         std::vector<unsigned int> ranks(static_cast<size_t>(numMetrics) * mNumSignatures);
+         std::vector<unsigned int> order(mNumSignatures);
+         for (unsigned int metric = 0; metric < numMetrics; ++metric)
+         {
+            const double* pMetricScores = pScores + metric * metricStride;
+            for (unsigned int sig = 0; sig < mNumSignatures; ++sig)
+            {
+               order[sig] = sig;
+            }
+            std::sort(order.begin(), order.end(), ScoreOrder(pMetricScores, mAscending[metric]));
+
+            unsigned int* pRanks = &ranks[static_cast<size_t>(metric) * mNumSignatures];
+            for (unsigned int position = 0; position < mNumSignatures; ++position)
+            {
+               unsigned int sig = order[position];
+               if (position > 0 && pMetricScores[sig] == pMetricScores[order[position - 1]])
+               {
+                  pRanks[sig] = pRanks[order[position - 1]];
+               }
+               else
+               {
+                  pRanks[sig] = position + 1;
+               }
+            }
+         }
+
+         std::vector<float> keys(mNumSignatures);
+         for (unsigned int sig = 0; sig < mNumSignatures; ++sig)
+         {
+            if (mComputeConsensus)
+            {
+               unsigned int rankSum(0);
+               for (unsigned int metric = 0; metric < numMetrics; ++metric)
+               {
+                  rankSum += ranks[static_cast<size_t>(metric) * mNumSignatures + sig];
+               }
+               keys[sig] = static_cast<float>(rankSum) / static_cast<float>(numMetrics);
+            }
+            else
+            {
+               keys[sig] = static_cast<float>(ranks[sig]);
+            }
+            order[sig] = sig;
+         }
+         std::partial_sort(order.begin(), order.begin() + mMaxMatches, order.end(), KeyOrder(&keys.front()));
+
+         matches.resize(mMaxMatches);
+         for (unsigned int match = 0; match < mMaxMatches; ++match)
+         {
+            unsigned int sig = order[match];
+            MetricMatch& theMatch = matches[match];
+            theMatch.mpSignature = mLibSignatures[sig];
+            theMatch.mConsensus = mComputeConsensus ? keys[sig] : 0.0f;
+            theMatch.mScores.resize(numMetrics);
+            theMatch.mRanks.resize(numMetrics);
+            for (unsigned int metric = 0; metric < numMetrics; ++metric)
+            {
+               theMatch.mScores[metric] = static_cast<float>(pScores[metric * metricStride + sig]);
+               theMatch.mRanks[metric] = ranks[static_cast<size_t>(metric) * mNumSignatures + sig];
+            }
+         }
+      }
+
+      // orders signatures from best to worst score; ties go to the earlier library signature
+      struct ScoreOrder
+      {
+         ScoreOrder(const double* pScores, bool ascending) :
+            mpScores(pScores),
+            mAscending(ascending)
+         {}
+
+         bool operator()(unsigned int lhs, unsigned int rhs) const
+         {
+            if (mpScores[lhs] != mpScores[rhs])
+            {
+               return mAscending ? (mpScores[lhs] < mpScores[rhs]) : (mpScores[lhs] > mpScores[rhs]);
+            }
+            return lhs < rhs;
+         }
+
+         const double* mpScores;
+         bool mAscending;
+      };
+
+      // orders signatures by increasing rank key; ties go to the earlier library signature
+      struct KeyOrder
+      {
+         KeyOrder(const float* pKeys) :
+            mpKeys(pKeys)
+         {}
+
+         bool operator()(unsigned int lhs, unsigned int rhs) const
+         {
+            if (mpKeys[lhs] != mpKeys[rhs])
+            {
+               return mpKeys[lhs] < mpKeys[rhs];
+            }
+            return lhs < rhs;
+         }
+
+         const float* mpKeys;
+      };
+
+      const double* mpTargets;
+      const LibraryStatistics& mLibStats;
+      unsigned int mNumBands;
+      unsigned int mNumSignatures;
+      std::vector<MatchMetricEnum> mMetrics;
+      std::vector<bool> mAscending;
+      bool mComputeConsensus;
+      unsigned int mMaxMatches;
+      bool mComputeVariance;
+      bool mComputeSid;
+      const std::vector<Signature*>& mLibSignatures;
+      std::vector<MetricMatchResults>& mResults;
+   };
 
    RasterElement* getCurrentRasterElement()
    {
@@ -455,76 +1360,311 @@ namespace SpectralLibraryMatch
    }
 
 
-   void trimSortedResults(MatchResults& theResults, const MatchLimits& limits)
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+      MatchResults& theResults, const MatchLimits& limits)
+   {
+      std::vector<MatchResults> results(1, theResults);
+      if (findSignatureMatches(libStats, libSignatures, results, limits) == false)
+      {
+         return false;
+      }
+
+      theResults.mResults.swap(results.front().mResults);
+      return true;
+   }
+
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+      std::vector<MatchResults>& theResults, const MatchLimits& limits)
+   {
+      if (theResults.empty())
+      {
+         return true;
+      }
+      VERIFY(libStats.mNumSignatures == libSignatures.size() && libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+      unsigned int numSignatures = libStats.mNumSignatures;
+      unsigned int numBands = libStats.mNumBands;
+      unsigned int numTargets = static_cast<unsigned int>(theResults.size());
+      MatchAlgorithmEnum algorithm = theResults.front().mAlgorithmUsed;
+      AlgorithmSortOrder sortOrder = getAlgorithmSortOrder(theResults.front().mAlgorithmUsed);
+      VERIFY(sortOrder.isValid());
+
+      // gather the targets into one matrix so they can be scored in a single pass over the library
+      std::vector<double> targets;
+      targets.reserve(static_cast<size_t>(numTargets) * numBands);
+      for (std::vector<MatchResults>::const_iterator it = theResults.begin(); it != theResults.end(); ++it)
+      {
+         VERIFY(it->mAlgorithmUsed == algorithm && it->mTargetValues.size() == numBands);
+         targets.insert(targets.end(), it->mTargetValues.begin(), it->mTargetValues.end());
+      }
+
+      MatchScores matchScores(&targets.front(), libStats, algorithm);
+      MatchSelection selection(matchScores, numTargets, numSignatures, sortOrder == ASO_ASCENDING, limits);
+
+#if defined SOLARIS  // tbb not available under solaris so select the matches on this thread
+      selection.select(0, numSignatures);
+#else
+      // split on the signatures so every target in the block shares each tile of the library
+      tbb::parallel_reduce(tbb::blocked_range<unsigned int>(0, numSignatures, sLibraryBlockSize), selection);
+#endif
+
+      for (unsigned int target = 0; target < numTargets; ++target)
+      {
+         selection.getResults(target, libSignatures, theResults[target].mResults);
+      }
+
+      return true;
+   }
+
+   bool findLibraryMatches(const LibraryStatistics& libStats, MatchAlgorithm algorithm, const double* pTargets,
+      unsigned int numTargets, const MatchLimits& limits, const LibraryProjection* pLibProjection,
+      std::vector<int>& matchIndices, std::vector<float>& matchValues)
    {
-      if (limits.getLimitByNum())
+      VERIFY(pTargets != NULL && limits.getLimitByNum() && limits.getMaxNum() > 0);
+      VERIFY(libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+      AlgorithmSortOrder sortOrder = getAlgorithmSortOrder(algorithm);
+      VERIFY(sortOrder.isValid());
+
+      unsigned int numMatches = limits.getMaxNum();
+      matchIndices.resize(static_cast<size_t>(numTargets) * numMatches);
+      matchValues.resize(matchIndices.size());
+      if (numTargets == 0)
       {
-         unsigned int maxToDisplay =
-            std::min(limits.getMaxNum(), static_cast<unsigned int>(theResults.mResults.size()));
-         theResults.mResults.erase(theResults.mResults.begin() + maxToDisplay,
-            theResults.mResults.end());
+         return true;
       }
-      if (limits.getLimitByThreshold())
+
+      MatchScores matchScores(pTargets, libStats, algorithm);
+      if (pLibProjection != NULL && numMatches < libStats.mNumSignatures)
       {
-         VERIFYNRV_MSG(limits.getThresholdType().isValid(),
-            "Invalid threshold type, results will not be limited by threshold");
-         std::vector<std::pair<Signature*, float> >::iterator it = theResults.mResults.begin();
-         for (; it != theResults.mResults.end(); ++it)
+         VERIFY(pLibProjection->getNumSignatures() == libStats.mNumSignatures &&
+            pLibProjection->getNumBands() == libStats.mNumBands);
+         std::vector<MatchCandidates> candidates(numTargets,
+            MatchCandidates(sortOrder == ASO_ASCENDING, numMatches, libStats.mNumSignatures));
+         std::vector<unsigned int> numRescored(numTargets);
+         PrefilteredSelection prefiltered(matchScores, *pLibProjection, sortOrder == ASO_ASCENDING, limits,
+            candidates, numRescored);
+
+#if defined SOLARIS  // tbb not available under solaris so select the matches on this thread
+         prefiltered.select(0, numTargets);
+#else
+         tbb::parallel_for(tbb::blocked_range<unsigned int>(0, numTargets), prefiltered);
+#endif
+
+         for (unsigned int target = 0; target < numTargets; ++target)
          {
-            if (limits.passesThreshold(static_cast<double>(it->second)) == false)
-            {
-               break;  // results are in sorted order so when first value to fail is found, erase rest
-            }
+            size_t offset = static_cast<size_t>(target) * numMatches;
+            candidates[target].getMatches(numMatches, &matchIndices[offset], &matchValues[offset]);
          }
-         theResults.mResults.erase(it, theResults.mResults.end());
+         return true;
       }
+
+      MatchSelection selection(matchScores, numTargets, libStats.mNumSignatures, sortOrder == ASO_ASCENDING, limits);
+
+#if defined SOLARIS  // tbb not available under solaris so select the matches on this thread
+      selection.select(0, libStats.mNumSignatures);
+#else
+      tbb::parallel_reduce(tbb::blocked_range<unsigned int>(0, libStats.mNumSignatures, sLibraryBlockSize),
+         selection);
+#endif
+
+      for (unsigned int target = 0; target < numTargets; ++target)
+      {
+         size_t offset = static_cast<size_t>(target) * numMatches;
+         selection.getMatches(target, numMatches, &matchIndices[offset], &matchValues[offset]);
+      }
+
+      return true;
    }
 
-   bool findSignatureMatches(const RasterElement* pLib, const std::vector<Signature*>& libSignatures,
-      MatchResults& theResults, const MatchLimits& limits)
+   bool findPrefilteredSignatureMatches(const LibraryStatistics& libStats, const LibraryProjection& libProjection,
+      const std::vector<Signature*>& libSignatures, std::vector<MatchResults>& theResults,
+      const MatchLimits& limits, double& rescoredFraction)
    {
-      const RasterDataDescriptor* pLibDesc = dynamic_cast<const RasterDataDescriptor*>(pLib->getDataDescriptor());
-      VERIFY(pLibDesc != NULL);
-      ModelResource<RasterElement> pResults(RasterUtilities::createRasterElement("Spectral Library Match Results",
-         pLibDesc->getRowCount(), 1, FLT8BYTES, true, const_cast<RasterElement*>(pLib)));
-      VERIFY(pResults.get() != NULL);
+      rescoredFraction = 1.0;
+      if (limits.getLimitByNum() == false || limits.getMaxNum() >= libStats.mNumSignatures)
+      {
+         // every signature could be a match so none can be pruned
+         return findSignatureMatches(libStats, libSignatures, theResults, limits);
+      }
+      if (theResults.empty())
+      {
+         return true;
+      }
+      VERIFY(libStats.mNumSignatures == libSignatures.size() && libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+      VERIFY(libProjection.getNumSignatures() == libStats.mNumSignatures &&
+         libProjection.getNumBands() == libStats.mNumBands);
+      unsigned int numSignatures = libStats.mNumSignatures;
+      unsigned int numBands = libStats.mNumBands;
+      unsigned int numTargets = static_cast<unsigned int>(theResults.size());
+      MatchAlgorithmEnum algorithm = theResults.front().mAlgorithmUsed;
+      AlgorithmSortOrder sortOrder = getAlgorithmSortOrder(theResults.front().mAlgorithmUsed);
+      VERIFY(sortOrder.isValid());
 
-#if defined SOLARIS  // tbb not available under solaris so use earlier code
-      bool (*computeFunc)(const std::vector<double>& targetValues, const RasterElement* pLib, RasterElement* pResults);
-      switch (theResults.mAlgorithmUsed)
+      std::vector<double> targets;
+      targets.reserve(static_cast<size_t>(numTargets) * numBands);
+      for (std::vector<MatchResults>::const_iterator it = theResults.begin(); it != theResults.end(); ++it)
       {
-      case SLMA_SAM:
-         computeFunc = computeSpectralAngle;
-         break;
-      case SLMA_WBI:
-         computeFunc = computeWangBovikIndex;
-      default:
-         return false;
+         VERIFY(it->mAlgorithmUsed == algorithm && it->mTargetValues.size() == numBands);
+         targets.insert(targets.end(), it->mTargetValues.begin(), it->mTargetValues.end());
       }
 
-      if (computeFunc(theResults.mTargetValues, pLib, pResults.get()) == false)
+      MatchScores matchScores(&targets.front(), libStats, algorithm);
+      std::vector<MatchCandidates> candidates(numTargets,
+         MatchCandidates(sortOrder == ASO_ASCENDING, limits.getMaxNum(), numSignatures));
+      std::vector<unsigned int> numRescored(numTargets);
+      PrefilteredSelection selection(matchScores, libProjection, sortOrder == ASO_ASCENDING, limits, candidates,
+         numRescored);
+
+#if defined SOLARIS  // tbb not available under solaris so select the matches on this thread
+      selection.select(0, numTargets);
+#else
+      tbb::parallel_for(tbb::blocked_range<unsigned int>(0, numTargets), selection);
+#endif
+
+      double totalRescored(0.0);
+      for (unsigned int target = 0; target < numTargets; ++target)
       {
-         return false;
+         candidates[target].getResults(libSignatures, theResults[target].mResults);
+         totalRescored += numRescored[target];
       }
-#else                // use newer tbb based code for other platforms
-      if (generateMetrics(pLib, theResults, pResults.get()) == false)
+      rescoredFraction = totalRescored / (static_cast<double>(numTargets) * numSignatures);
+
+      return true;
+   }
+
+   bool findApproximateSignatureMatches(const LibraryStatistics& libStats, const LibraryIndex& libIndex,
+      const std::vector<Signature*>& libSignatures, std::vector<MatchResults>& theResults,
+      const MatchLimits& limits, unsigned int numCandidates, unsigned int numChecks, double& recall)
+   {
+      recall = 1.0;
+      numCandidates = std::max(numCandidates, limits.getMaxNum());
+      if (limits.getLimitByNum() == false || numCandidates >= libStats.mNumSignatures)
       {
-         return false;
+         // every signature would be a candidate so the index cannot save any work
+         return findSignatureMatches(libStats, libSignatures, theResults, limits);
+      }
+      if (theResults.empty())
+      {
+         return true;
+      }
+      VERIFY(libStats.mNumSignatures == libSignatures.size() && libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+      VERIFY(libIndex.getNumSignatures() == libStats.mNumSignatures);
+      unsigned int numBands = libStats.mNumBands;
+      unsigned int numTargets = static_cast<unsigned int>(theResults.size());
+      MatchAlgorithmEnum algorithm = theResults.front().mAlgorithmUsed;
+      AlgorithmSortOrder sortOrder = getAlgorithmSortOrder(theResults.front().mAlgorithmUsed);
+      VERIFY(sortOrder.isValid());
+
+      std::vector<double> targets;
+      targets.reserve(static_cast<size_t>(numTargets) * numBands);
+      for (std::vector<MatchResults>::const_iterator it = theResults.begin(); it != theResults.end(); ++it)
+      {
+         VERIFY(it->mAlgorithmUsed == algorithm && it->mTargetValues.size() == numBands);
+         targets.insert(targets.end(), it->mTargetValues.begin(), it->mTargetValues.end());
       }
+
+      MatchScores matchScores(&targets.front(), libStats, algorithm);
+      ApproximateSelection selection(matchScores, libIndex, &targets.front(), numBands, numCandidates, numChecks,
+         sortOrder == ASO_ASCENDING, limits, libSignatures, theResults);
+
+#if defined SOLARIS  // tbb not available under solaris so search for the matches on this thread
+      selection.select(0, numTargets);
+#else
+      tbb::parallel_for(tbb::blocked_range<unsigned int>(0, numTargets), selection);
 #endif
 
-      // sort results
-      generateSortedResults(pResults.get(), libSignatures, theResults);
-      trimSortedResults(theResults, limits);
+      // compare the matches of a sample of the targets with the matches from the whole library
+      std::vector<MatchResults> exactResults;
+      for (unsigned int target = 0; target < numTargets; target += sRecallSampleInterval)
+      {
+         exactResults.push_back(theResults[target]);
+      }
+      if (findSignatureMatches(libStats, libSignatures, exactResults, limits) == false)
+      {
+         return false;
+      }
+
+      size_t numExact(0);
+      size_t numFound(0);
+      for (unsigned int sample = 0; sample < exactResults.size(); ++sample)
+      {
+         const std::vector<std::pair<Signature*, float> >& approximate =
+            theResults[sample * sRecallSampleInterval].mResults;
+         const std::vector<std::pair<Signature*, float> >& exact = exactResults[sample].mResults;
+         for (std::vector<std::pair<Signature*, float> >::const_iterator eit = exact.begin();
+            eit != exact.end(); ++eit)
+         {
+            for (std::vector<std::pair<Signature*, float> >::const_iterator ait = approximate.begin();
+               ait != approximate.end(); ++ait)
+            {
+               if (ait->first == eit->first)
+               {
+                  ++numFound;
+                  break;
+               }
+            }
+         }
+         numExact += exact.size();
+      }
+      if (numExact > 0)
+      {
+         recall = static_cast<double>(numFound) / static_cast<double>(numExact);
+      }
+
+      return true;
+   }
+
+   bool findMetricMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+      const std::vector<MatchMetric>& metrics, bool computeConsensus, unsigned int maxMatches,
+      std::vector<MetricMatchResults>& theResults)
+   {
+      VERIFY(metrics.empty() == false);
+      std::vector<bool> isRequested(SLMM_SID + 1, false);
+      for (std::vector<MatchMetric>::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+      {
+         VERIFY(getMetricSortOrder(*it).isValid() && isRequested[*it] == false);
+         isRequested[*it] = true;
+      }
+      if (theResults.empty())
+      {
+         return true;
+      }
+      VERIFY(libStats.mNumSignatures == libSignatures.size() && libStats.mNumSignatures > 0 &&
+         libStats.mNumBands > 1 &&
+         libStats.mNormalizedData.size() == static_cast<size_t>(libStats.mNumSignatures) * libStats.mNumBands);
+      VERIFY(isRequested[SLMM_SID] == false || libStats.mSidProbabilities.size() == libStats.mNormalizedData.size());
+      unsigned int numBands = libStats.mNumBands;
+      unsigned int numTargets = static_cast<unsigned int>(theResults.size());
+
+      std::vector<double> targets;
+      targets.reserve(static_cast<size_t>(numTargets) * numBands);
+      for (std::vector<MetricMatchResults>::const_iterator it = theResults.begin(); it != theResults.end(); ++it)
+      {
+         VERIFY(it->mTargetValues.size() == numBands);
+         targets.insert(targets.end(), it->mTargetValues.begin(), it->mTargetValues.end());
+      }
+
+      MetricSelection selection(&targets.front(), libStats, metrics, computeConsensus, maxMatches, libSignatures,
+         theResults);
+
+#if defined SOLARIS  // tbb not available under solaris so score the targets on this thread
+      selection.select(0, numTargets);
+#else
+      // each block of targets is scored against the whole library so its signatures can be ranked
+      tbb::parallel_for(tbb::blocked_range<unsigned int>(0, numTargets, sTargetBlockSize), selection);
+#endif
 
       return true;
    }
 
-   bool findSignatureMatches(const RasterElement* pLib, const std::vector<Signature*>& libSignatures,
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
       MatchResults& theResults)
    {
       MatchLimits limits;
-      return findSignatureMatches(pLib, libSignatures, theResults, limits);
+      return findSignatureMatches(libStats, libSignatures, theResults, limits);
    }
 
    bool getScaledValuesFromSignature(std::vector<double>& values, const Signature* pSignature)
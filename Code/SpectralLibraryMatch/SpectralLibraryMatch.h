@@ -15,11 +15,6 @@
 #include "StringUtilities.h"
 #include "TypesFile.h"
 
-// The Intel Threading Building Blocks Library (tbb) is not supported on the Solaris Sparc platform
-#ifndef SOLARIS
-#include <tbb/tbb.h>
-#endif
-
 #include <string>
 #include <vector>
 
@@ -29,6 +24,9 @@ class Signature;
 
 namespace SpectralLibraryMatch
 {
+   class LibraryIndex;
+   class LibraryProjection;
+
    enum MatchAlgorithmEnum
    {
       SLMA_SAM,
@@ -44,6 +42,16 @@ namespace SpectralLibraryMatch
    };
    typedef EnumWrapper<LocateAlgorithmEnum> LocateAlgorithm;
 
+   enum MatchMetricEnum
+   {
+      SLMM_SAM,
+      SLMM_WBI,
+      SLMM_EUCLIDEAN,
+      SLMM_CORRELATION,
+      SLMM_SID
+   };
+   typedef EnumWrapper<MatchMetricEnum> MatchMetric;
+
    enum AlgorithmSortOrderEnum
    {
       ASO_ASCENDING,
@@ -78,6 +86,55 @@ namespace SpectralLibraryMatch
       MatchAlgorithm mAlgorithmUsed;
    };
 
+   struct MetricMatch
+   {
+      MetricMatch() :
+         mpSignature(NULL),
+         mConsensus(0.0f)
+      {}
+
+      Signature* mpSignature;
+      float mConsensus;                  // mean rank over the metrics, or zero without a consensus
+      std::vector<float> mScores;        // score for each metric in the order they were requested
+      std::vector<unsigned int> mRanks;  // rank in the library for each metric, one is the best
+   };
+
+   struct MetricMatchResults
+   {
+      MetricMatchResults() :
+         mpRaster(NULL)
+      {}
+
+      const RasterElement* mpRaster;
+      std::string mTargetName;
+      std::vector<double> mTargetValues;
+      std::vector<MetricMatch> mMatches;  // best match first
+   };
+
+   /**
+    *  Quantities of each signature in a resampled library which do not depend on the
+    *  target being matched. They are computed once when the library is resampled,
+    *  except for the spectral information divergence tables which are only computed
+    *  by computeSidStatistics() when that metric is first used.
+    */
+   struct LibraryStatistics
+   {
+      LibraryStatistics() :
+         mNumSignatures(0),
+         mNumBands(0)
+      {}
+
+      unsigned int mNumSignatures;
+      unsigned int mNumBands;
+      std::vector<double> mNorms;            // Euclidean norm of each signature
+      std::vector<double> mMeans;            // mean of the values of each signature
+      std::vector<double> mStdDevs;          // sample standard deviation of the values of each signature
+      std::vector<double> mNormalizedData;   // signatures x bands, each row scaled to unit length
+      std::vector<double> mSidEntropies;     // sum of p * log(p) over the band probabilities of each signature
+      std::vector<double> mSidProbabilities; // signatures x bands, each floored row scaled to sum to one
+      std::vector<double> mSidLogs;          // signatures x bands, log of each of mSidProbabilities
+   };
+
    class MatchLimits
    {
    public:
@@ -93,6 +150,7 @@ namespace SpectralLibraryMatch
       double getThresholdLimit() const;
       void setThresholdLimit(double threshold);
       PassArea getThresholdType() const;
+      void setThresholdType(PassArea thresholdType);
       bool passesThreshold(const double value) const;
 
    private:
@@ -103,24 +161,6 @@ namespace SpectralLibraryMatch
       PassArea mThresholdType;
    };
 
-#ifndef SOLARIS
-   class MatchMetrics
-   {
-   public:
-      MatchMetrics(double* pLibData, unsigned int numSignatures,
-         MatchResults* pMatchInfo, double* pResultsData);
-      ~MatchMetrics();
-
-      void operator() (tbb::blocked_range<unsigned int>& range) const;
-
-      double* mpLibData;
-      unsigned int mNumSignatures;
-      MatchResults* mpMatchInfo;
-      double* mpResultsData;
-      unsigned int mNumBands;
-   };
-#endif
-
    static const std::string& getNameLibraryManagerPlugIn()
    {
       static std::string var = "Spectral Library Manager";
@@ -165,13 +205,204 @@ namespace SpectralLibraryMatch
    AoiElement* getCurrentAoi();
 
    // function uses default options limits
-   bool findSignatureMatches(const RasterElement* pLib, const std::vector<Signature*>& libSignatures,
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
       MatchResults& theResults);
 
    // function requires instance of MatchLimits 
-   bool findSignatureMatches(const RasterElement* pLib, const std::vector<Signature*>& libSignatures,
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
                              MatchResults& theResults, const MatchLimits& limits);
 
+   // function requires instance of MatchLimits and matches all targets with a single pass over the library;
+   // every element of theResults must use the same algorithm and number of target values
+   bool findSignatureMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+                             std::vector<MatchResults>& theResults, const MatchLimits& limits);
+
+   /**
+    *  Finds the best library matches for a block of target spectra.
+    *
+    *  This selects the same matches as findSignatureMatches() but returns the library row
+    *  of each match instead of its signature, so large numbers of pixels can be matched
+    *  without building a MatchResults for each one.
+    *
+    *  @param   libStats
+    *           The statistics of the resampled library.
+    *  @param   algorithm
+    *           The metric used to score the matches.
+    *  @param   pTargets
+    *           The \em numTargets x bands row-major matrix of target spectra.
+    *  @param   numTargets
+    *           The number of target spectra in \em pTargets.
+    *  @param   limits
+    *           The limits to apply to the matches of each target. The matches must be
+    *           limited by number.
+    *  @param   pLibProjection
+    *           The principal component projection of the resampled library used to
+    *           prefilter the matches as in findPrefilteredSignatureMatches(), or \c NULL
+    *           to score every signature.
+    *  @param   matchIndices
+    *           Receives the \em numTargets x maximum number of matches row-major matrix of
+    *           library rows, best match first. Rows with fewer matches are padded with -1.
+    *  @param   matchValues
+    *           Receives the scores of the matches in \em matchIndices. Padded matches
+    *           have a score of zero.
+    *
+    *  @return  \c true if the matches were found, \c false otherwise.
+    */
+   bool findLibraryMatches(const LibraryStatistics& libStats, MatchAlgorithm algorithm, const double* pTargets,
+      unsigned int numTargets, const MatchLimits& limits, const LibraryProjection* pLibProjection,
+      std::vector<int>& matchIndices, std::vector<float>& matchValues);
+
+   /**
+    *  Matches a block of targets, pruning signatures with a principal component projection.
+    *
+    *  Each target is projected onto the components of the library and the bound on its
+    *  product with each library row gives a range for each score. A signature is only
+    *  scored over every band if its best possible score is at least as good as the worst
+    *  possible score of the signature ranked at the maximum number of matches. The pruned
+    *  signatures cannot be among the matches, so the matches and scores are the same as
+    *  from findSignatureMatches(). If the results are not limited by number or the maximum
+    *  includes every signature, the whole library is scored instead.
+    *
+    *  @param   libStats
+    *           The statistics of the resampled library.
+    *  @param   libProjection
+    *           The principal component projection of the resampled library.
+    *  @param   libSignatures
+    *           The library signatures in the same order as the rows of the library.
+    *  @param   theResults
+    *           The targets to match. Every element must use the same algorithm and
+    *           number of target values.
+    *  @param   limits
+    *           The limits to apply to the matches of each target.
+    *  @param   rescoredFraction
+    *           Receives the fraction of the target and signature pairs which were scored
+    *           over every band.
+    *
+    *  @return  \c true if the matches were found, \c false otherwise.
+    */
+   bool findPrefilteredSignatureMatches(const LibraryStatistics& libStats, const LibraryProjection& libProjection,
+      const std::vector<Signature*>& libSignatures, std::vector<MatchResults>& theResults,
+      const MatchLimits& limits, double& rescoredFraction);
+
+   /**
+    *  Matches a block of targets using candidates from an approximate index of the library.
+    *
+    *  The closest signatures in angle to each target are found with the index and are then
+    *  scored exactly with the algorithm of the results, so the reported scores are the same
+    *  as from findSignatureMatches(). If the results are not limited by number or the index
+    *  would return every signature, the whole library is scored instead.
+    *
+    *  A sample of the targets is also matched against the whole library to measure how many
+    *  of the exact matches the index found.
+    *
+    *  @param   libStats
+    *           The statistics of the resampled library.
+    *  @param   libIndex
+    *           The approximate index of the resampled library.
+    *  @param   libSignatures
+    *           The library signatures in the same order as the rows of the library.
+    *  @param   theResults
+    *           The targets to match. Every element must use the same algorithm and
+    *           number of target values.
+    *  @param   limits
+    *           The limits to apply to the matches of each target.
+    *  @param   numCandidates
+    *           The minimum number of candidates to rescore for each target. At least the
+    *           maximum number of matches is always rescored.
+    *  @param   numChecks
+    *           The number of index leaves to visit for each target.
+    *  @param   recall
+    *           Receives the fraction of the exact matches of the sampled targets which
+    *           were also found using the index.
+    *
+    *  @return  \c true if the matches were found, \c false otherwise.
+    */
+   bool findApproximateSignatureMatches(const LibraryStatistics& libStats, const LibraryIndex& libIndex,
+      const std::vector<Signature*>& libSignatures, std::vector<MatchResults>& theResults,
+      const MatchLimits& limits, unsigned int numCandidates, unsigned int numChecks, double& recall);
+
+   /**
+    *  Scores targets with several metrics in a single pass over the library.
+    *
+    *  Every metric is computed from the same products of each target with the
+    *  library rows, so the library is read once however many metrics are used.
+    *  Each signature is ranked by each metric, and the consensus of a signature
+    *  is its mean rank over the metrics. The matches are ordered by consensus
+    *  when it is computed and by the first metric otherwise.
+    *
+    *  The spectral information divergence treats each spectrum as a probability
+    *  distribution over the bands, so values below a small positive floor are
+    *  raised to the floor first.
+    *
+    *  @param   libStats
+    *           The statistics of the resampled library. If the spectral information
+    *           divergence is requested, they must include its tables from computeSidStatistics().
+    *  @param   libSignatures
+    *           The library signatures in the same order as the rows of the library.
+    *  @param   metrics
+    *           The metrics to compute. Each metric may only be listed once.
+    *  @param   computeConsensus
+    *           \c true to order the matches by their mean rank over the metrics.
+    *  @param   maxMatches
+    *           The number of matches to keep for each target, or zero to keep every signature.
+    *  @param   theResults
+    *           The targets to match. Every element must have the same number of target values.
+    *
+    *  @return  \c true if the matches were found, \c false otherwise.
+    */
+   bool findMetricMatches(const LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+      const std::vector<MatchMetric>& metrics, bool computeConsensus, unsigned int maxMatches,
+      std::vector<MetricMatchResults>& theResults);
+
+   /**
+    *  Computes the statistics of a resampled library.
+    *
+    *  @param   pLib
+    *           The resampled library. Each row holds one signature.
+    *  @param   libStats
+    *           Receives the statistics and normalized rows of \em pLib.
+    *
+    *  @return  \c true if the statistics were computed, \c false otherwise.
+    */
+   bool computeLibraryStatistics(const RasterElement* pLib, LibraryStatistics& libStats);
+
+   /**
+    *  Computes the spectral information divergence tables of a resampled library.
+    *
+    *  @param   pLib
+    *           The resampled library. Each row holds one signature.
+    *  @param   libStats
+    *           The statistics from computeLibraryStatistics() for \em pLib. Receives
+    *           the entropies, probabilities and logs of each signature.
+    *
+    *  @return  \c true if the tables were computed, \c false otherwise.
+    */
+   bool computeSidStatistics(const RasterElement* pLib, LibraryStatistics& libStats);
+
+   /**
+    *  Scores a block of target spectra against every signature in a resampled library.
+    *
+    *  The scores for all of the targets are computed as one blocked matrix product of
+    *  the targets with the normalized library rows, so each block of library rows is
+    *  read once per block of targets instead of once per target. The metrics are
+    *  finished from the products and the precomputed library statistics.
+    *
+    *  @param   libStats
+    *           The statistics of the resampled library.
+    *  @param   algorithm
+    *           The metric to compute.
+    *  @param   pTargets
+    *           The \em numTargets x bands row-major matrix of target spectra.
+    *  @param   numTargets
+    *           The number of target spectra in \em pTargets.
+    *  @param   scores
+    *           Receives the \em numTargets x signatures row-major matrix of scores.
+    *
+    *  @return  \c true if the scores were computed, \c false otherwise.
+    */
+   bool computeMatchScores(const LibraryStatistics& libStats, MatchAlgorithm algorithm, const double* pTargets,
+      unsigned int numTargets, std::vector<double>& scores);
+
    bool getScaledValuesFromSignature(std::vector<double>& values, const Signature* pSignature);
 }
 
@@ -232,6 +463,34 @@ namespace StringUtilities
    template<>
    std::vector<SpectralLibraryMatch::LocateAlgorithm> fromXmlString<std::vector<
       SpectralLibraryMatch::LocateAlgorithm> >(std::string valueText, bool* pError);
+
+   template<>
+   std::string toDisplayString(const SpectralLibraryMatch::MatchMetric& value, bool* pError);
+
+   template<>
+   std::string toXmlString(const SpectralLibraryMatch::MatchMetric& value, bool* pError);
+
+   template<>
+   SpectralLibraryMatch::MatchMetric fromDisplayString<SpectralLibraryMatch::MatchMetric>(
+      std::string valueText, bool* pError);
+
+   template<>
+   SpectralLibraryMatch::MatchMetric fromXmlString<SpectralLibraryMatch::MatchMetric>(
+      std::string valueText, bool* pError);
+
+   template<>
+   std::string toDisplayString(const std::vector<SpectralLibraryMatch::MatchMetric>& value, bool* pError);
+
+   template<>
+   std::string toXmlString(const std::vector<SpectralLibraryMatch::MatchMetric>& value, bool* pError);
+
+   template<>
+   std::vector<SpectralLibraryMatch::MatchMetric> fromDisplayString<
+      std::vector<SpectralLibraryMatch::MatchMetric> >(std::string valueText, bool* pError);
+
+   template<>
+   std::vector<SpectralLibraryMatch::MatchMetric> fromXmlString<std::vector<
+      SpectralLibraryMatch::MatchMetric> >(std::string valueText, bool* pError);
 }
 
 #endif
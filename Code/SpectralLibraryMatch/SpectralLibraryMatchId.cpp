@@ -53,6 +53,7 @@
 #include "XercesIncludes.h"
 #include "xmlwriter.h"
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <math.h>
@@ -72,6 +73,9 @@ REGISTER_PLUGIN_BASIC(SpectralSpectralLibraryMatch, SpectralLibraryMatchId);
 
 namespace
 {
+   // number of AOI pixels scored against the library together
+   const std::vector<SpectralLibraryMatch::MatchResults>::size_type sPixelBlockSize = 256;
+
    template<class T>
    void setValue(T* pData, int& classId)
    {
@@ -148,6 +152,22 @@ bool SpectralLibraryMatchId::getInputSpecification(PlugInArgList*& pArgList)
       VERIFY(pArgList->addArg<Filename>("Match Results Filename", NULL, "Filename for saving the match results. "
          "Optional for Opticks but must be specified when run in OpticksBatch. If specified for Opticks, the match "
          "results will be saved to this file and not displayed in the Spectral Library Match Results window."));
+
+      // build list of valid match metric names for arg description
+      std::string matchMetricDesc = "Comma separated names of match metrics to compute together in one pass over "
+         "the library. If any are given, each signature is ranked by every metric, the match algorithm and "
+         "threshold are not used and the results are saved to the match results filename, which must be "
+         "specified. Default is no metrics. Valid metric names are:";
+      std::vector<std::string> metricNames =
+         StringUtilities::getAllEnumValuesAsXmlString<SpectralLibraryMatch::MatchMetric>();
+      for (std::vector<std::string>::iterator it = metricNames.begin(); it != metricNames.end(); ++it)
+      {
+         matchMetricDesc += "\n";
+         matchMetricDesc += *it;
+      }
+      VERIFY(pArgList->addArg<std::string>("Match Metric Names", std::string(), matchMetricDesc));
+      VERIFY(pArgList->addArg<bool>("Compute Consensus", true, "Flag to order the matches by their mean rank over "
+         "the match metrics. If false, the matches are ordered by the first metric. Default is true."));
    }
 
    return true;
@@ -199,6 +219,8 @@ bool SpectralLibraryMatchId::execute(PlugInArgList* pInArgList, PlugInArgList* p
    bool matchEachPixel(false);
 
    SpectralLibraryMatch::MatchLimits limits;  // c'tor initialized instance to user option settings
+   std::vector<SpectralLibraryMatch::MatchMetric> metrics;
+   bool computeConsensus(true);
    if (isBatch() == false)
    {
       // check that at least one aoi exists for the raster element
@@ -313,6 +335,47 @@ bool SpectralLibraryMatchId::execute(PlugInArgList* pInArgList, PlugInArgList* p
       {
          mMatchResultsFilename = pResultFilename->getFullPathAndName();
       }
+
+      // check for match metrics to compute instead of the match algorithm
+      std::string metricStr;
+      VERIFY(pInArgList->getPlugInArgValue("Match Metric Names", metricStr));
+      VERIFY(pInArgList->getPlugInArgValue("Compute Consensus", computeConsensus));
+      std::vector<std::string> metricNames = StringUtilities::split(metricStr, ',');
+      for (std::vector<std::string>::iterator it = metricNames.begin(); it != metricNames.end(); ++it)
+      {
+         std::string metricName = StringUtilities::stripWhitespace(*it);
+         if (metricName.empty())
+         {
+            continue;
+         }
+         SpectralLibraryMatch::MatchMetric metric =
+            StringUtilities::fromXmlString<SpectralLibraryMatch::MatchMetric>(metricName);
+         if (metric.isValid() == false)
+         {
+            metric = StringUtilities::fromDisplayString<SpectralLibraryMatch::MatchMetric>(metricName);
+         }
+         if (metric.isValid() == false)
+         {
+            updateProgress("The input match metric name \"" + metricName + "\" is invalid.", 0, ERRORS);
+            return false;
+         }
+         for (std::vector<SpectralLibraryMatch::MatchMetric>::const_iterator mit = metrics.begin();
+            mit != metrics.end(); ++mit)
+         {
+            if (*mit == static_cast<SpectralLibraryMatch::MatchMetricEnum>(metric))
+            {
+               updateProgress("The match metric \"" + metricName + "\" is listed more than once.", 0, ERRORS);
+               return false;
+            }
+         }
+         metrics.push_back(metric);
+      }
+      if (metrics.empty() == false && mMatchResultsFilename.empty())
+      {
+         updateProgress("The input argument \"Match Results Filename\" must be specified when match metrics "
+            "are computed.", 0, ERRORS);
+         return false;
+      }
    }
 
    // get library info
@@ -329,9 +392,15 @@ bool SpectralLibraryMatchId::execute(PlugInArgList* pInArgList, PlugInArgList* p
    }
    const std::vector<Signature*>* pLibSignatures = pLibMgr->getResampledLibrarySignatures(pLib);
    VERIFY(pLibSignatures != NULL && pLibSignatures->empty() == false);
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats =
+      std::find(metrics.begin(), metrics.end(), SpectralLibraryMatch::SLMM_SID) == metrics.end() ?
+      pLibMgr->getResampledLibraryStatistics(pLib) : pLibMgr->getResampledLibrarySidStatistics(pLib);
+   VERIFY(pLibStats != NULL);
 
    // now find matches
    std::vector<SpectralLibraryMatch::MatchResults> pixelResults;
+   std::vector<SpectralLibraryMatch::MetricMatchResults> metricResults;
+   unsigned int maxMetricMatches = limits.getLimitByNum() ? limits.getMaxNum() : 0;
    std::map<Signature*, ColorType> colorMap;
    if (matchEachPixel)  // send output to results window and generate pseudocolor layer
    {
@@ -365,40 +434,126 @@ bool SpectralLibraryMatchId::execute(PlugInArgList* pInArgList, PlugInArgList* p
       FactoryResource<DataRequest> pRqt;
       pRqt->setInterleaveFormat(BIP);
       DataAccessor acc = pRaster->getDataAccessor(pRqt.release());
-      theResults.mTargetValues.resize(numBands);
+
+      // the approximate index is only available when it is enabled in the options
+      const SpectralLibraryMatch::LibraryIndex* pLibIndex = pLibMgr->getResampledLibraryIndex(pLib);
+      unsigned int numCandidates = SpectralLibraryMatchOptions::getSettingApproximateSearchCandidates();
+      unsigned int numChecks = SpectralLibraryMatchOptions::getSettingApproximateSearchChecks();
+      double recallSum(0.0);
+
+      // the exact prefilter is used when the approximate index is not
+      const SpectralLibraryMatch::LibraryProjection* pLibProjection =
+         (pLibIndex == NULL) ? pLibMgr->getResampledLibraryProjection(pLib) : NULL;
+      double rescoredSum(0.0);
+
+      // gather the pixels in blocks which are each scored against the library in a single pass
+      std::vector<SpectralLibraryMatch::MatchResults> blockResults;
+      blockResults.reserve(sPixelBlockSize);
       while (bit != bit.end())
       {
-         Opticks::PixelLocation pixel(bit.getPixelColumnLocation(), bit.getPixelRowLocation());
-
-         // convert to original pixel values for display
-         Opticks::PixelLocation display;
-         display.mX = static_cast<int>(pDesc->getActiveColumn(pixel.mX).getOriginalNumber());
-         display.mY = static_cast<int>(pDesc->getActiveRow(pixel.mY).getOriginalNumber());
-         theResults.mTargetName = "Pixel (" + StringUtilities::toDisplayString<int>(display.mX + 1) + ", " +
-            StringUtilities::toDisplayString<int>(display.mY + 1) + ")";
-         acc->toPixel(pixel.mY, pixel.mX);
-         VERIFY(acc.isValid());
-         switchOnEncoding(eType, SpectralLibraryMatch::getScaledPixelValues, acc->getColumn(),
-            theResults.mTargetValues, numBands, scaleFactor);
-         if (SpectralLibraryMatch::findSignatureMatches(pLib, *pLibSignatures, theResults, limits))
+         blockResults.clear();
+         while (bit != bit.end() && blockResults.size() < sPixelBlockSize)
+         {
+            Opticks::PixelLocation pixel(bit.getPixelColumnLocation(), bit.getPixelRowLocation());
+
+            // convert to original pixel values for display
+            Opticks::PixelLocation display;
+            display.mX = static_cast<int>(pDesc->getActiveColumn(pixel.mX).getOriginalNumber());
+            display.mY = static_cast<int>(pDesc->getActiveRow(pixel.mY).getOriginalNumber());
+            blockResults.push_back(theResults);
+            SpectralLibraryMatch::MatchResults& pixelResult = blockResults.back();
+            pixelResult.mTargetName = "Pixel (" + StringUtilities::toDisplayString<int>(display.mX + 1) + ", " +
+               StringUtilities::toDisplayString<int>(display.mY + 1) + ")";
+            acc->toPixel(pixel.mY, pixel.mX);
+            VERIFY(acc.isValid());
+            switchOnEncoding(eType, SpectralLibraryMatch::getScaledPixelValues, acc->getColumn(),
+               pixelResult.mTargetValues, numBands, scaleFactor);
+            bit.nextPixel();
+         }
+
+         if (metrics.empty() == false)
+         {
+            if (matchMetrics(blockResults, *pLibStats, *pLibSignatures, metrics, computeConsensus,
+               maxMetricMatches, metricResults) == false)
+            {
+               updateProgress("Unable to compute the match metrics.", 0, ERRORS);
+               return false;
+            }
+            if (isAborted())
+            {
+               updateProgress("Spectral Library Match aborted by user.", 0, ABORT);
+               return false;
+            }
+            numProcessed += static_cast<int>(blockResults.size());
+            updateProgress("Matching AOI pixels...", 100 * numProcessed / numSigs, NORMAL);
+            continue;
+         }
+
+         bool matched(false);
+         if (pLibIndex != NULL)
+         {
+            double blockRecall(1.0);
+            matched = SpectralLibraryMatch::findApproximateSignatureMatches(*pLibStats, *pLibIndex,
+               *pLibSignatures, blockResults, limits, numCandidates, numChecks, blockRecall);
+            recallSum += blockRecall * blockResults.size();
+         }
+         else if (pLibProjection != NULL)
+         {
+            double blockRescored(1.0);
+            matched = SpectralLibraryMatch::findPrefilteredSignatureMatches(*pLibStats, *pLibProjection,
+               *pLibSignatures, blockResults, limits, blockRescored);
+            rescoredSum += blockRescored * blockResults.size();
+         }
+         else
+         {
+            matched = SpectralLibraryMatch::findSignatureMatches(*pLibStats, *pLibSignatures, blockResults, limits);
+         }
+         if (matched)
          {
-            pixelResults.push_back(theResults);
+            for (std::vector<SpectralLibraryMatch::MatchResults>::const_iterator it = blockResults.begin();
+               it != blockResults.end(); ++it)
+            {
+               pixelResults.push_back(*it);
+               if (it->mResults.empty() == false)  // only save if there was a best match
+               {
+                  bestMatches.push_back(it->mResults.front());
+                  pixelNames.push_back(it->mTargetName);
+               }
+            }
          }
          if (isAborted())
          {
             updateProgress("Spectral Library Match aborted by user.", 0, ABORT);
             return false;
          }
-         if (theResults.mResults.empty() == false)  // only save if there was a best match
+         numProcessed += static_cast<int>(blockResults.size());
+         updateProgress("Matching AOI pixels...", 100 * numProcessed / numSigs, NORMAL);
+      }
+      if (pLibIndex != NULL && numProcessed > 0)
+      {
+         double recall = recallSum / numProcessed;
+         if (mpStep != NULL)
          {
-            bestMatches.push_back(theResults.mResults.front());
-            pixelNames.push_back(theResults.mTargetName);
+            mpStep->addProperty("Approximate Search Recall", recall);
          }
-         ++numProcessed;
-         bit.nextPixel();
-         updateProgress("Matching AOI pixels...", 100 * numProcessed / numSigs, NORMAL);
+         updateProgress("Approximate library search found " + StringUtilities::toDisplayString(100.0 * recall) +
+            "% of the brute force matches.", 99, NORMAL);
+      }
+      if (pLibProjection != NULL && numProcessed > 0)
+      {
+         double rescored = rescoredSum / numProcessed;
+         if (mpStep != NULL)
+         {
+            mpStep->addProperty("Prefilter Rescored Fraction", rescored);
+         }
+         updateProgress("Principal component prefilter scored " + StringUtilities::toDisplayString(100.0 * rescored) +
+            "% of the library over every band.", 99, NORMAL);
       }
       updateProgress("Finished matching AOI pixels.", 100, NORMAL);
+      if (metrics.empty() == false)
+      {
+         return writeMetricResultsToFile(metricResults, metrics, computeConsensus, limits, mMatchResultsFilename);
+      }
       generatePseudocolorLayer(bestMatches, colorMap, pixelNames, resultsLayerName);
 
       // now output results
@@ -435,7 +590,18 @@ bool SpectralLibraryMatchId::execute(PlugInArgList* pInArgList, PlugInArgList* p
 
       theResults.mTargetName = pSignature->getDisplayName(true);
       VERIFY(SpectralLibraryMatch::getScaledValuesFromSignature(theResults.mTargetValues, pSignature));
-      if (SpectralLibraryMatch::findSignatureMatches(pLib, *pLibSignatures, theResults, limits))
+      if (metrics.empty() == false)
+      {
+         pixelResults.push_back(theResults);
+         if (matchMetrics(pixelResults, *pLibStats, *pLibSignatures, metrics, computeConsensus,
+            maxMetricMatches, metricResults) == false ||
+            writeMetricResultsToFile(metricResults, metrics, computeConsensus, limits, mMatchResultsFilename) == false)
+         {
+            updateProgress("Unable to compute the match metrics.", 0, ERRORS);
+            return false;
+         }
+      }
+      else if (SpectralLibraryMatch::findSignatureMatches(*pLibStats, *pLibSignatures, theResults, limits))
       {
          pixelResults.push_back(theResults);
          if (outputResults(pixelResults, limits, colorMap) == false)
@@ -789,6 +955,138 @@ bool SpectralLibraryMatchId::writeResultsToFile(std::vector<SpectralLibraryMatch
    return true;
 }
 
+bool SpectralLibraryMatchId::matchMetrics(const std::vector<SpectralLibraryMatch::MatchResults>& targets,
+                                          const SpectralLibraryMatch::LibraryStatistics& libStats,
+                                          const std::vector<Signature*>& libSignatures,
+                                          const std::vector<SpectralLibraryMatch::MatchMetric>& metrics,
+                                          bool computeConsensus, unsigned int maxMatches,
+                                          std::vector<SpectralLibraryMatch::MetricMatchResults>& theResults)
+{
+   std::vector<SpectralLibraryMatch::MetricMatchResults> blockResults(targets.size());
+   for (std::vector<SpectralLibraryMatch::MatchResults>::size_type index = 0; index < targets.size(); ++index)
+   {
+      blockResults[index].mpRaster = targets[index].mpRaster;
+      blockResults[index].mTargetName = targets[index].mTargetName;
+      blockResults[index].mTargetValues = targets[index].mTargetValues;
+   }
+   if (SpectralLibraryMatch::findMetricMatches(libStats, libSignatures, metrics, computeConsensus, maxMatches,
+      blockResults) == false)
+   {
+      return false;
+   }
+
+   theResults.insert(theResults.end(), blockResults.begin(), blockResults.end());
+   return true;
+}
+
+bool SpectralLibraryMatchId::writeMetricResultsToFile(
+   const std::vector<SpectralLibraryMatch::MetricMatchResults>& theResults,
+   const std::vector<SpectralLibraryMatch::MatchMetric>& metrics, bool computeConsensus,
+   const SpectralLibraryMatch::MatchLimits& limits, const std::string& filename)
+{
+   if (theResults.empty() || filename.empty())
+   {
+      return false;
+   }
+
+   // make sure filename has extension of ".slim"
+   QString actualFilename = QString::fromStdString(filename);
+   QString extension(".slim");
+   if (!actualFilename.endsWith(extension, Qt::CaseInsensitive))
+   {
+      actualFilename += extension;
+   }
+
+   // make sure we can create the file for output
+   QFile file(actualFilename);
+   if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+   {
+      updateProgress("Unable to open file for saving Spectral Library Match results.", 0, ERRORS);
+      return false;
+   }
+
+   QTextStream out(&file);
+
+   // we will replace any embedded tabs in data set, target and signature names with 4 spaces.
+   QString tabRepl("    ");
+
+   // write header info
+   bool consensus = computeConsensus && metrics.size() > 1;
+   out << "OID" << "\t" << "oid:/UID/Opticks/3/0/1" << "\n";
+   out << "AnalysisTime" << "\t" << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+   out << "Dataset" << "\t" <<
+      QString::fromStdString(theResults.front().mpRaster->getName()).replace("\t", tabRepl) << "\n";
+   out << "MatchMetrics";
+   for (std::vector<SpectralLibraryMatch::MatchMetric>::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+   {
+      out << "\t" << QString::fromStdString(StringUtilities::toXmlString<SpectralLibraryMatch::MatchMetric>(*it));
+   }
+   out << "\n";
+   out << "Match order" << "\t" << (consensus ? "Consensus rank" : "First metric rank") << "\n";
+   out << "Max number of matches" << "\t";
+   if (limits.getLimitByNum())
+   {
+      out <<  limits.getMaxNum() << "\n";
+   }
+   else
+   {
+      out << "Not limited\n";
+   }
+   out << "Target Name";
+
+   // find max number of matches for a pixel so we can output correct number of header columns
+   std::vector<SpectralLibraryMatch::MetricMatch>::size_type maxMatches(0);
+   for (std::vector<SpectralLibraryMatch::MetricMatchResults>::const_iterator it = theResults.begin();
+      it != theResults.end(); ++it)
+   {
+      maxMatches = std::max(maxMatches, it->mMatches.size());
+   }
+   for (std::vector<SpectralLibraryMatch::MetricMatch>::size_type i = 0; i < maxMatches; ++i)
+   {
+      out << "\t" << "Signature Name";
+      if (consensus)
+      {
+         out << "\t" << "Consensus Rank";
+      }
+      for (std::vector<SpectralLibraryMatch::MatchMetric>::const_iterator it = metrics.begin();
+         it != metrics.end(); ++it)
+      {
+         QString metricName = QString::fromStdString(
+            StringUtilities::toDisplayString<SpectralLibraryMatch::MatchMetric>(*it));
+         out << "\t" << metricName << " Value" << "\t" << metricName << " Rank";
+      }
+   }
+   out << "\n";
+   for (std::vector<SpectralLibraryMatch::MetricMatchResults>::const_iterator it = theResults.begin();
+      it != theResults.end(); ++it)
+   {
+      out << QString::fromStdString(it->mTargetName).replace("\t", tabRepl);
+      if (it->mMatches.empty())
+      {
+         out << "\t" << "No matches found\n";
+         continue;
+      }
+      for (std::vector<SpectralLibraryMatch::MetricMatch>::const_iterator mit = it->mMatches.begin();
+         mit != it->mMatches.end(); ++mit)
+      {
+         out << "\t" << QString::fromStdString(mit->mpSignature->getName()).replace("\t", tabRepl);
+         if (consensus)
+         {
+            out << "\t" << mit->mConsensus;
+         }
+         for (std::vector<float>::size_type metric = 0; metric < mit->mScores.size(); ++metric)
+         {
+            out << "\t" << mit->mScores[metric] << "\t" << mit->mRanks[metric];
+         }
+      }
+      out << "\n";
+   }
+
+   file.close();
+
+   return true;
+}
+
 bool SpectralLibraryMatchId::sendResultsToWindow(std::vector<SpectralLibraryMatch::MatchResults>& theResults,
                                                  const std::map<Signature*, ColorType>& colorMap)
 {
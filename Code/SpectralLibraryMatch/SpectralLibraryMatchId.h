@@ -53,6 +53,13 @@ protected:
       SpectralLibraryMatch::MatchLimits& limits, const std::string& filename);
    bool sendResultsToWindow(std::vector<SpectralLibraryMatch::MatchResults>& theResults,
       const std::map<Signature*, ColorType>& colorMap);
+   bool matchMetrics(const std::vector<SpectralLibraryMatch::MatchResults>& targets,
+      const SpectralLibraryMatch::LibraryStatistics& libStats, const std::vector<Signature*>& libSignatures,
+      const std::vector<SpectralLibraryMatch::MatchMetric>& metrics, bool computeConsensus, unsigned int maxMatches,
+      std::vector<SpectralLibraryMatch::MetricMatchResults>& theResults);
+   bool writeMetricResultsToFile(const std::vector<SpectralLibraryMatch::MetricMatchResults>& theResults,
+      const std::vector<SpectralLibraryMatch::MatchMetric>& metrics, bool computeConsensus,
+      const SpectralLibraryMatch::MatchLimits& limits, const std::string& filename);
 
 private:
    Progress* mpProgress;
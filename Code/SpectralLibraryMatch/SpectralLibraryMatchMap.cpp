@@ -0,0 +1,496 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#include "AoiElement.h"
+#include "ApplicationServices.h"
+#include "AppVerify.h"
+#include "BitMaskIterator.h"
+#include "ColorType.h"
+#include "DataAccessor.h"
+#include "DataAccessorImpl.h"
+#include "DataRequest.h"
+#include "DesktopServices.h"
+#include "DynamicObject.h"
+#include "LayerList.h"
+#include "ModelServices.h"
+#include "ObjectResource.h"
+#include "PlugIn.h"
+#include "PlugInArgList.h"
+#include "PlugInManagerServices.h"
+#include "PlugInRegistration.h"
+#include "ProgressTracker.h"
+#include "PseudocolorLayer.h"
+#include "RasterDataDescriptor.h"
+#include "RasterElement.h"
+#include "RasterUtilities.h"
+#include "Signature.h"
+#include "SignatureSet.h"
+#include "SpatialDataView.h"
+#include "SpectralLibraryManager.h"
+#include "SpectralLibraryMatch.h"
+#include "SpectralLibraryMatchMap.h"
+#include "SpectralLibraryMatchOptions.h"
+#include "SpectralVersion.h"
+#include "Statistics.h"
+#include "StringUtilities.h"
+#include "switchOnEncoding.h"
+#include "TypeConverter.h"
+#include "Units.h"
+#include "Wavelengths.h"
+
+#include <algorithm>
+#include <string.h>
+#include <string>
+#include <vector>
+
+REGISTER_PLUGIN_BASIC(SpectralSpectralLibraryMatch, SpectralLibraryMatchMap);
+
+namespace
+{
+   // number of pixels scored against the library together; large enough that each block of library
+   // rows is reused by many pixels while the block of scores still fits in cache
+   const unsigned int sPixelBlockSize = 1024;
+
+   const char* const sIndexMapName = "Best Library Match Index";
+   const char* const sScoreMapName = "Best Library Match Score";
+   const char* const sTopMatchesName = "Top Library Match Indices";
+}
+
+SpectralLibraryMatchMap::SpectralLibraryMatchMap() :
+   mbDisplayResults(Service<ApplicationServices>()->isInteractive())
+{
+   setName("Spectral Library Match Map");
+   setVersion(SPECTRAL_VERSION_NUMBER);
+   setCreator("Ball Aerospace & Technologies Corp.");
+   setCopyright(SPECTRAL_COPYRIGHT);
+   setShortDescription("Map the best spectral library match of every pixel");
+   setDescription("Match every pixel in a raster element or AOI to the signatures in the spectral library and "
+      "create rasters of the best matching signature and its score.");
+   setMenuLocation("[Spectral]\\Material ID\\Spectral Library Match Map");
+   setDescriptorId("{3A6E1C52-7B94-4D0F-A81E-5C29F04B7D63}");
+   setAbortSupported(true);
+   allowMultipleInstances(false);
+   setProductionStatus(SPECTRAL_IS_PRODUCTION_RELEASE);
+}
+
+SpectralLibraryMatchMap::~SpectralLibraryMatchMap()
+{}
+
+bool SpectralLibraryMatchMap::getInputSpecification(PlugInArgList*& pInArgList)
+{
+   VERIFY(pInArgList = Service<PlugInManagerServices>()->getPlugInArgList());
+   VERIFY(pInArgList->addArg<Progress>(Executable::ProgressArg(), NULL, Executable::ProgressArgDescription()));
+   VERIFY(pInArgList->addArg<RasterElement>(Executable::DataElementArg(), NULL, "The raster element to match "
+      "against the signatures in the spectral library."));
+
+   if (isBatch())
+   {
+      VERIFY(pInArgList->addArg<AoiElement>("AOI Element", NULL, "Optional argument: The AOI over which to limit "
+         "spectral library matching. If not specified, every pixel in the raster element is matched."));
+
+      // build list of valid match algorithm names for arg description
+      std::string matchAlgDesc = "Valid algorithm names are:";
+      std::vector<std::string> algNames =
+         StringUtilities::getAllEnumValuesAsXmlString<SpectralLibraryMatch::MatchAlgorithm>();
+      for (std::vector<std::string>::iterator it = algNames.begin(); it != algNames.end(); ++it)
+      {
+         matchAlgDesc += "\n";
+         matchAlgDesc += *it;
+      }
+      VERIFY(pInArgList->addArg<std::string>("Match Algorithm Name",
+         SpectralLibraryMatchOptions::getSettingMatchAlgorithm(), matchAlgDesc));
+      VERIFY(pInArgList->addArg<unsigned int>("Number of Matches", 1, "The number of best matches to keep for each "
+         "pixel. If greater than one, a raster with a band for each match is also created. Default is 1."));
+      VERIFY(pInArgList->addArg<bool>("Limit matches by threshold", true,
+         "Flag to filter the matches for each pixel by a threshold. Default is true."));
+      VERIFY(pInArgList->addArg<double>("Threshold cutoff for match", 5.0,
+         "The floating point value of the threshold filter. "
+         "How the filter is applied is dependent on the match algorithm used. Default is 5.0."));
+      VERIFY(pInArgList->addArg<DataElement>("Signatures Data Element", NULL,
+         "The SignatureSet or SignatureLibrary containing the signatures to be loaded into the Spectral Library. "
+         "Optional for Opticks but it must be specified when run in OpticksBatch."));
+      VERIFY(pInArgList->addArg<bool>("Display Results", mbDisplayResults, "Optional Argument: Whether or not "
+         "to display the best match map. Default is true in interactive application mode, false "
+         "in batch application mode."));
+   }
+
+   return true;
+}
+
+bool SpectralLibraryMatchMap::getOutputSpecification(PlugInArgList*& pOutArgList)
+{
+   VERIFY(pOutArgList = Service<PlugInManagerServices>()->getPlugInArgList());
+   VERIFY(pOutArgList->addArg<RasterElement>(sIndexMapName, NULL, "Raster element containing the library row of "
+      "the best match for each pixel plus one. Pixels which were not matched are zero. The signature names are in "
+      "the \"Signature Names\" metadata attribute."));
+   VERIFY(pOutArgList->addArg<RasterElement>(sScoreMapName, NULL, "Raster element containing the match value of "
+      "the best match for each pixel. Pixels which were not matched are set to the bad value, which is 181 for SAM "
+      "and -99 for WBI."));
+   VERIFY(pOutArgList->addArg<RasterElement>(sTopMatchesName, NULL, "Raster element with a band for each of the "
+      "best matches of each pixel, ordered as in the best match index raster. This is only created when more than "
+      "one match is kept."));
+
+   return true;
+}
+
+bool SpectralLibraryMatchMap::execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList)
+{
+   VERIFY(pInArgList != NULL);
+   ProgressTracker progress(pInArgList->getPlugInArgValue<Progress>(Executable::ProgressArg()),
+      "Mapping spectral library matches", "spectral", "{9D27F4B3-1C68-4E5A-B0D9-6A3E82C157F4}");
+   RasterElement* pRaster = pInArgList->getPlugInArgValue<RasterElement>(Executable::DataElementArg());
+   if (pRaster == NULL)
+   {
+      progress.report("The input raster element was null", 0, ERRORS, true);
+      return false;
+   }
+   if (Wavelengths::getNumWavelengths(pRaster->getMetadata()) < 2)
+   {
+      progress.report("Raster element does not contain sufficient wavelength information", 0, ERRORS, true);
+      return false;
+   }
+
+   Service<PlugInManagerServices> pPlugInMgr;
+   std::vector<PlugIn*> plugIns = pPlugInMgr->getPlugInInstances(SpectralLibraryMatch::getNameLibraryManagerPlugIn());
+   VERIFY(!plugIns.empty());
+   SpectralLibraryManager* pLibMgr = dynamic_cast<SpectralLibraryManager*>(plugIns.front());
+   VERIFY(pLibMgr != NULL);
+
+   AoiElement* pAoi(NULL);
+   SpectralLibraryMatch::MatchAlgorithm algorithm =
+      StringUtilities::fromXmlString<SpectralLibraryMatch::MatchAlgorithm>(
+      SpectralLibraryMatchOptions::getSettingMatchAlgorithm());
+   unsigned int numMatches(1);
+   bool limitByThreshold(SpectralLibraryMatchOptions::getSettingLimitByThreshold());
+   double threshold(0.0);
+   if (isBatch())
+   {
+      pAoi = pInArgList->getPlugInArgValue<AoiElement>("AOI Element");
+      std::string algStr;
+      VERIFY(pInArgList->getPlugInArgValue("Match Algorithm Name", algStr));
+      algorithm = StringUtilities::fromXmlString<SpectralLibraryMatch::MatchAlgorithm>(algStr);
+      if (algorithm.isValid() == false)
+      {
+         algorithm = StringUtilities::fromDisplayString<SpectralLibraryMatch::MatchAlgorithm>(algStr);
+      }
+      VERIFY(pInArgList->getPlugInArgValue("Number of Matches", numMatches));
+      VERIFY(pInArgList->getPlugInArgValue("Limit matches by threshold", limitByThreshold));
+      VERIFY(pInArgList->getPlugInArgValue("Threshold cutoff for match", threshold));
+      VERIFY(pInArgList->getPlugInArgValue("Display Results", mbDisplayResults));
+
+      DataElement* pSigData = pInArgList->getPlugInArgValue<DataElement>("Signatures Data Element");
+      if (Service<ApplicationServices>()->isBatch() && pSigData == NULL)
+      {
+         progress.report("No source was provided for the signatures to load into the Spectral Library.",
+            0, ERRORS, true);
+         return false;
+      }
+      if (pSigData != NULL)
+      {
+         // Note: we're only interested in the signatures so a SignatureLibrary can also be cast to a SignatureSet.
+         const SignatureSet* pSigSet = dynamic_cast<const SignatureSet*>(pSigData);
+         if (pSigSet == NULL || (pLibMgr->addSignatures(pSigSet->getSignatures()) == false && pLibMgr->isEmpty()))
+         {
+            progress.report("Error occurred while trying to load signatures from data element:\n" +
+               pSigData->getDisplayName(true), 0, ERRORS, true);
+            return false;
+         }
+      }
+   }
+   else
+   {
+      // match the active AOI if there is one, otherwise the whole scene
+      pAoi = SpectralLibraryMatch::getCurrentAoi();
+   }
+   if (algorithm.isValid() == false)
+   {
+      progress.report("The match algorithm name is invalid.", 0, ERRORS, true);
+      return false;
+   }
+   if (numMatches == 0)
+   {
+      progress.report("The number of matches must be at least one.", 0, ERRORS, true);
+      return false;
+   }
+
+   // the score bad values are outside the range of each metric, as in the SAM and WBI plug-ins
+   int scoreBadValue = 0;
+   SpectralLibraryMatch::MatchLimits limits;
+   limits.setLimitByNum(true);
+   limits.setMaxNum(numMatches);
+   limits.setLimitByThreshold(limitByThreshold);
+   switch (algorithm)
+   {
+   case SpectralLibraryMatch::SLMA_SAM:
+      limits.setThresholdLimit(isBatch() ? threshold : SpectralLibraryMatchOptions::getSettingMatchSamThreshold());
+      limits.setThresholdType(LOWER);
+      scoreBadValue = 181;
+      break;
+
+   case SpectralLibraryMatch::SLMA_WBI:
+      limits.setThresholdLimit(isBatch() ? threshold : SpectralLibraryMatchOptions::getSettingMatchWbiThreshold());
+      limits.setThresholdType(UPPER);
+      scoreBadValue = -99;
+      break;
+
+   default:
+      break;
+   }
+
+   // get library info
+   if (pLibMgr->isEmpty())
+   {
+      progress.report("The Spectral Library is empty.", 0, ERRORS, true);
+      return false;
+   }
+   const RasterElement* pLib = pLibMgr->getResampledLibraryData(pRaster);
+   if (pLib == NULL)
+   {
+      progress.report("Unable to obtain library data.", 0, ERRORS, true);
+      return false;
+   }
+   const std::vector<Signature*>* pLibSignatures = pLibMgr->getResampledLibrarySignatures(pLib);
+   VERIFY(pLibSignatures != NULL && pLibSignatures->empty() == false);
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats = pLibMgr->getResampledLibraryStatistics(pLib);
+   VERIFY(pLibStats != NULL);
+   const SpectralLibraryMatch::LibraryProjection* pLibProjection = pLibMgr->getResampledLibraryProjection(pLib);
+
+   const RasterDataDescriptor* pDesc = dynamic_cast<const RasterDataDescriptor*>(pRaster->getDataDescriptor());
+   VERIFY(pDesc != NULL);
+   const Units* pUnits = pDesc->getUnits();
+   VERIFY(pUnits != NULL);
+   double scaleFactor = pUnits->getScaleFromStandard();
+   unsigned int numBands = pDesc->getBandCount();
+   unsigned int numColumns = pDesc->getColumnCount();
+   EncodingType eType = pDesc->getDataType();
+   VERIFY(numBands == pLibStats->mNumBands);
+
+   BitMaskIterator bit(pAoi == NULL ? NULL : pAoi->getSelectedPoints(), pRaster);
+   if (bit == bit.end())
+   {
+      progress.report("There are no pixels to match.", 0, ERRORS, true);
+      return false;
+   }
+   int numPixels = bit.getCount();
+
+   ModelResource<RasterElement> pIndexMap(createResult(sIndexMapName, pRaster, 1, INT4UBYTES, *pLibSignatures));
+   ModelResource<RasterElement> pScoreMap(createResult(sScoreMapName, pRaster, 1, FLT4BYTES, *pLibSignatures));
+   ModelResource<RasterElement> pTopMatches(numMatches > 1 ?
+      createResult(sTopMatchesName, pRaster, numMatches, INT4UBYTES, *pLibSignatures) : NULL);
+   if (pIndexMap.get() == NULL || pScoreMap.get() == NULL || (numMatches > 1 && pTopMatches.get() == NULL))
+   {
+      progress.report("Unable to create the result raster elements.", 0, ERRORS, true);
+      return false;
+   }
+   unsigned int* pIndexData = reinterpret_cast<unsigned int*>(pIndexMap->getRawData());
+   float* pScoreData = reinterpret_cast<float*>(pScoreMap->getRawData());
+
+   // the scores of unmatched pixels and pixels outside of the AOI are the bad value
+   std::vector<int> badValues(1, scoreBadValue);
+   RasterDataDescriptor* pScoreDesc = static_cast<RasterDataDescriptor*>(pScoreMap->getDataDescriptor());
+   pScoreDesc->setBadValues(badValues);
+   Statistics* pScoreStatistics = pScoreMap->getStatistics();
+   VERIFY(pScoreStatistics != NULL);
+   pScoreStatistics->setBadValues(badValues);
+   std::fill(pScoreData, pScoreData + static_cast<size_t>(pDesc->getRowCount()) * numColumns,
+      static_cast<float>(scoreBadValue));
+   unsigned int* pTopData = pTopMatches.get() == NULL ? NULL :
+      reinterpret_cast<unsigned int*>(pTopMatches->getRawData());
+
+   FactoryResource<DataRequest> pRqt;
+   pRqt->setInterleaveFormat(BIP);
+   DataAccessor acc = pRaster->getDataAccessor(pRqt.release());
+
+   // gather the pixels in blocks which are each scored against the library in a single pass
+   std::vector<double> targets;
+   targets.reserve(static_cast<size_t>(sPixelBlockSize) * numBands);
+   std::vector<size_t> locations;
+   locations.reserve(sPixelBlockSize);
+   std::vector<double> pixelValues;
+   std::vector<int> matchIndices;
+   std::vector<float> matchValues;
+   std::vector<bool> isMatched(pLibSignatures->size(), false);
+   int numProcessed(0);
+   while (bit != bit.end())
+   {
+      targets.clear();
+      locations.clear();
+      while (bit != bit.end() && locations.size() < sPixelBlockSize)
+      {
+         int row = bit.getPixelRowLocation();
+         int column = bit.getPixelColumnLocation();
+         acc->toPixel(row, column);
+         VERIFY(acc.isValid());
+         switchOnEncoding(eType, SpectralLibraryMatch::getScaledPixelValues, acc->getColumn(),
+            pixelValues, numBands, scaleFactor);
+         targets.insert(targets.end(), pixelValues.begin(), pixelValues.end());
+         locations.push_back(static_cast<size_t>(row) * numColumns + column);
+         bit.nextPixel();
+      }
+
+      unsigned int numTargets = static_cast<unsigned int>(locations.size());
+      if (SpectralLibraryMatch::findLibraryMatches(*pLibStats, algorithm, &targets.front(), numTargets, limits,
+         pLibProjection, matchIndices, matchValues) == false)
+      {
+         progress.report("Unable to match the pixels to the library.", 0, ERRORS, true);
+         return false;
+      }
+      for (unsigned int target = 0; target < numTargets; ++target)
+      {
+         const int* pMatches = &matchIndices[static_cast<size_t>(target) * numMatches];
+         size_t location = locations[target];
+         if (pMatches[0] >= 0)
+         {
+            isMatched[pMatches[0]] = true;
+         }
+         pIndexData[location] = static_cast<unsigned int>(pMatches[0] + 1);
+         pScoreData[location] = pMatches[0] < 0 ? static_cast<float>(scoreBadValue) :
+            matchValues[static_cast<size_t>(target) * numMatches];
+         if (pTopData != NULL)
+         {
+            unsigned int* pTop = pTopData + location * numMatches;
+            for (unsigned int match = 0; match < numMatches; ++match)
+            {
+               pTop[match] = static_cast<unsigned int>(pMatches[match] + 1);
+            }
+         }
+      }
+
+      if (isAborted())
+      {
+         progress.report("Spectral Library Match Map aborted by user.", 0, ABORT, true);
+         return false;
+      }
+      numProcessed += static_cast<int>(numTargets);
+      progress.report("Matching pixels...", static_cast<int>(99.0 * numProcessed / numPixels), NORMAL);
+   }
+
+   pIndexMap->updateData();
+   pScoreMap->updateData();
+   if (pTopMatches.get() != NULL)
+   {
+      pTopMatches->updateData();
+   }
+
+   if (mbDisplayResults && Service<ApplicationServices>()->isInteractive())
+   {
+      if (displayMap(pIndexMap.get(), *pLibSignatures, isMatched) == false)
+      {
+         progress.report("Unable to display the best match map.", 0, WARNING, true);
+      }
+   }
+
+   if (pOutArgList != NULL)
+   {
+      pOutArgList->setPlugInArgValue(sIndexMapName, pIndexMap.get());
+      pOutArgList->setPlugInArgValue(sScoreMapName, pScoreMap.get());
+      if (pTopMatches.get() != NULL)
+      {
+         pOutArgList->setPlugInArgValue(sTopMatchesName, pTopMatches.get());
+      }
+   }
+
+   pIndexMap.release();
+   pScoreMap.release();
+   pTopMatches.release();
+   progress.report("Spectral Library Match Map complete", 100, NORMAL);
+   progress.upALevel();
+   return true;
+}
+
+RasterElement* SpectralLibraryMatchMap::createResult(const std::string& name, RasterElement* pParent,
+   unsigned int numBands, EncodingType dataType, const std::vector<Signature*>& libSignatures)
+{
+   VERIFY(pParent != NULL);
+   Service<ModelServices> pModel;
+   DataElement* pExisting = pModel->getElement(name, TypeConverter::toString<RasterElement>(), pParent);
+   if (pExisting != NULL)
+   {
+      pModel->destroyElement(pExisting);
+   }
+
+   const RasterDataDescriptor* pDesc = dynamic_cast<const RasterDataDescriptor*>(pParent->getDataDescriptor());
+   VERIFY(pDesc != NULL);
+   RasterElement* pResult = RasterUtilities::createRasterElement(name, pDesc->getRowCount(),
+      pDesc->getColumnCount(), numBands, dataType, BIP, true, pParent);
+   if (pResult == NULL || pResult->getRawData() == NULL)
+   {
+      pModel->destroyElement(pResult);
+      return NULL;
+   }
+
+   // the unmatched pixels outside of the AOI are zero; the score map then sets its bad value
+   const RasterDataDescriptor* pResultDesc = static_cast<const RasterDataDescriptor*>(pResult->getDataDescriptor());
+   memset(pResult->getRawData(), 0, static_cast<size_t>(pDesc->getRowCount()) * pDesc->getColumnCount() *
+      numBands * pResultDesc->getBytesPerElement());
+
+   std::vector<std::string> sigNames;
+   sigNames.reserve(libSignatures.size());
+   for (std::vector<Signature*>::const_iterator it = libSignatures.begin(); it != libSignatures.end(); ++it)
+   {
+      sigNames.push_back((*it)->getName());
+   }
+   pResult->getMetadata()->setAttribute("Signature Names", sigNames);
+
+   return pResult;
+}
+
+bool SpectralLibraryMatchMap::displayMap(RasterElement* pIndexMap, const std::vector<Signature*>& libSignatures,
+   const std::vector<bool>& isMatched)
+{
+   VERIFY(pIndexMap != NULL && libSignatures.size() == isMatched.size());
+
+   // the map can only be shown over the raster element it was made from
+   SpatialDataView* pView = dynamic_cast<SpatialDataView*>(Service<DesktopServices>()->getCurrentWorkspaceWindowView());
+   if (pView == NULL)
+   {
+      return false;
+   }
+   LayerList* pLayerList = pView->getLayerList();
+   VERIFY(pLayerList != NULL);
+   if (pLayerList->getPrimaryRasterElement() != pIndexMap->getParent())
+   {
+      return false;
+   }
+
+   PseudocolorLayer* pLayer = static_cast<PseudocolorLayer*>(pView->createLayer(PSEUDOCOLOR, pIndexMap));
+   if (pLayer == NULL)
+   {
+      return false;
+   }
+
+   // only the matched signatures get a class so the number of colors stays manageable
+   std::vector<unsigned int> classRows;
+   for (std::vector<bool>::size_type row = 0; row < isMatched.size(); ++row)
+   {
+      if (isMatched[row])
+      {
+         classRows.push_back(static_cast<unsigned int>(row));
+      }
+   }
+   std::vector<ColorType> layerColors;
+   if (classRows.empty() == false)
+   {
+      std::vector<ColorType> excludeColors;
+      excludeColors.push_back(ColorType(0, 0, 0));
+      excludeColors.push_back(ColorType(255, 255, 255));
+      if (ColorType::getUniqueColors(classRows.size(), layerColors, excludeColors) != classRows.size())
+      {
+         return false;
+      }
+   }
+   for (std::vector<unsigned int>::size_type index = 0; index < classRows.size(); ++index)
+   {
+      unsigned int row = classRows[index];
+      VERIFY(pLayer->addInitializedClass(libSignatures[row]->getName(), static_cast<int>(row + 1),
+         layerColors[index]) != -1);
+   }
+
+   return true;
+}
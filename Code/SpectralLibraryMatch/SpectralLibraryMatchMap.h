@@ -0,0 +1,49 @@
+/*
+ * The information in this file is
+ * Copyright(c) 2010 Ball Aerospace & Technologies Corporation
+ * and is subject to the terms and conditions of the
+ * GNU Lesser General Public License Version 2.1
+ * The license text is available from   
+ * http://www.gnu.org/licenses/lgpl.html
+ */
+
+#ifndef SPECTRALLIBRARYMATCHMAP_H
+#define SPECTRALLIBRARYMATCHMAP_H
+
+#include "AlgorithmShell.h"
+
+#include <string>
+#include <vector>
+
+class RasterElement;
+class Signature;
+
+/**
+ * Maps the best spectral library match of every pixel in a raster or AOI.
+ *
+ * The pixels are read in blocks and each block is scored against the whole
+ * resampled library at once. The results are a raster of the best matching
+ * library signature for each pixel, a raster of its score and, optionally,
+ * a raster with a band for each of the top matches.
+ */
+class SpectralLibraryMatchMap : public AlgorithmShell
+{
+public:
+   SpectralLibraryMatchMap();
+   virtual ~SpectralLibraryMatchMap();
+
+   virtual bool getInputSpecification(PlugInArgList*& pInArgList);
+   virtual bool getOutputSpecification(PlugInArgList*& pOutArgList);
+   virtual bool execute(PlugInArgList* pInArgList, PlugInArgList* pOutArgList);
+
+protected:
+   RasterElement* createResult(const std::string& name, RasterElement* pParent, unsigned int numBands,
+      EncodingType dataType, const std::vector<Signature*>& libSignatures);
+   bool displayMap(RasterElement* pIndexMap, const std::vector<Signature*>& libSignatures,
+      const std::vector<bool>& isMatched);
+
+private:
+   bool mbDisplayResults;
+};
+
+#endif
@@ -44,6 +44,30 @@ SpectralLibraryMatchOptions::SpectralLibraryMatchOptions()
    mpAutoclear = new QCheckBox("Autoclear Results", pMatchWidget);
    mpAutoclear->setToolTip("Check to clear existing results before adding new results.\nIf not checked, new results "
       "will be added to existing results.");
+   mpUseApproximateSearch = new QCheckBox("Use approximate library search", pMatchWidget);
+   mpUseApproximateSearch->setToolTip("Check to find candidate matches for each pixel with an approximate nearest "
+      "neighbor index of the library.\nThe candidates are scored exactly, but a best match may occasionally be "
+      "missed.");
+   QLabel* pCandidatesLabel = new QLabel("Search candidates:", pMatchWidget);
+   mpSearchCandidates = new QSpinBox(pMatchWidget);
+   mpSearchCandidates->setRange(1, 10000);
+   mpSearchCandidates->setToolTip("The number of candidate signatures scored for each pixel");
+   QLabel* pChecksLabel = new QLabel("Search checks:", pMatchWidget);
+   mpSearchChecks = new QSpinBox(pMatchWidget);
+   mpSearchChecks->setRange(1, 100000);
+   mpSearchChecks->setToolTip("The number of index leaves visited for each pixel.\n"
+      "Larger values find more of the exact matches but take longer.");
+   mpUsePrefilter = new QCheckBox("Use principal component prefilter", pMatchWidget);
+   mpUsePrefilter->setToolTip("Check to skip scoring signatures over every band when a bound from the principal "
+      "components of the library shows they cannot be a match.\nThe matches are the same as without the prefilter. "
+      "It is not used with the approximate library search.");
+   QLabel* pComponentsLabel = new QLabel("Prefilter components:", pMatchWidget);
+   mpPrefilterComponents = new QSpinBox(pMatchWidget);
+   mpPrefilterComponents->setRange(1, 1000);
+   mpPrefilterComponents->setToolTip("The number of principal components of the library used by the prefilter");
+   mpCacheLibraries = new QCheckBox("Cache resampled libraries", pMatchWidget);
+   mpCacheLibraries->setToolTip("Check to save each resampled library to disk so that later data sets "
+      "with the same wavelengths do not need to resample the library again");
    pMatchLayout->setMargin(0);
    pMatchLayout->setSpacing(5);
    pMatchLayout->addWidget(pMatchAlgLabel, 0, 0, Qt::AlignRight);
@@ -55,6 +79,15 @@ SpectralLibraryMatchOptions::SpectralLibraryMatchOptions()
    pMatchLayout->addWidget(mpLimitByThreshold, 3, 0);
    pMatchLayout->addWidget(mpMatchThreshold, 3, 1);
    pMatchLayout->addWidget(mpAutoclear, 4, 0);
+   pMatchLayout->addWidget(mpUseApproximateSearch, 5, 0, 1, 2);
+   pMatchLayout->addWidget(pCandidatesLabel, 6, 0, Qt::AlignRight);
+   pMatchLayout->addWidget(mpSearchCandidates, 6, 1);
+   pMatchLayout->addWidget(pChecksLabel, 7, 0, Qt::AlignRight);
+   pMatchLayout->addWidget(mpSearchChecks, 7, 1);
+   pMatchLayout->addWidget(mpUsePrefilter, 8, 0, 1, 2);
+   pMatchLayout->addWidget(pComponentsLabel, 9, 0, Qt::AlignRight);
+   pMatchLayout->addWidget(mpPrefilterComponents, 9, 1);
+   pMatchLayout->addWidget(mpCacheLibraries, 10, 0, 1, 2);
    LabeledSection* pMatchSection = new LabeledSection(pMatchWidget, "Spectral Library Match Options", this);
 
    // locate options section
@@ -106,6 +139,12 @@ SpectralLibraryMatchOptions::SpectralLibraryMatchOptions()
       mpMaxDisplayed, SLOT(setEnabled(bool))));
    VERIFYNR(connect(mpLimitByThreshold, SIGNAL(toggled(bool)),
       mpMatchThreshold, SLOT(setEnabled(bool))));
+   VERIFYNR(connect(mpUseApproximateSearch, SIGNAL(toggled(bool)),
+      mpSearchCandidates, SLOT(setEnabled(bool))));
+   VERIFYNR(connect(mpUseApproximateSearch, SIGNAL(toggled(bool)),
+      mpSearchChecks, SLOT(setEnabled(bool))));
+   VERIFYNR(connect(mpUsePrefilter, SIGNAL(toggled(bool)),
+      mpPrefilterComponents, SLOT(setEnabled(bool))));
    VERIFYNR(connect(mpMatchThreshold, SIGNAL(valueChanged(double)),
       this, SLOT(matchThresholdChanged(double))));
    VERIFYNR(connect(mpLocateThreshold, SIGNAL(valueChanged(double)),
@@ -195,6 +234,17 @@ SpectralLibraryMatchOptions::SpectralLibraryMatchOptions()
    mpMatchThreshold->setEnabled(limit);
    bool autoClear = SpectralLibraryMatchOptions::getSettingAutoclear();
    mpAutoclear->setChecked(autoClear);
+   bool approximate = SpectralLibraryMatchOptions::getSettingUseApproximateSearch();
+   mpUseApproximateSearch->setChecked(approximate);
+   mpSearchCandidates->setValue(SpectralLibraryMatchOptions::getSettingApproximateSearchCandidates());
+   mpSearchCandidates->setEnabled(approximate);
+   mpSearchChecks->setValue(SpectralLibraryMatchOptions::getSettingApproximateSearchChecks());
+   mpSearchChecks->setEnabled(approximate);
+   bool prefilter = SpectralLibraryMatchOptions::getSettingUsePrincipalComponentPrefilter();
+   mpUsePrefilter->setChecked(prefilter);
+   mpPrefilterComponents->setValue(SpectralLibraryMatchOptions::getSettingPrefilterComponents());
+   mpPrefilterComponents->setEnabled(prefilter);
+   mpCacheLibraries->setChecked(SpectralLibraryMatchOptions::getSettingCacheResampledLibraries());
    SpectralLibraryMatch::LocateAlgorithm locType =
       StringUtilities::fromXmlString<SpectralLibraryMatch::LocateAlgorithm>(
       SpectralLibraryMatchOptions::getSettingLocateAlgorithm());
@@ -214,6 +264,12 @@ void SpectralLibraryMatchOptions::applyChanges()
    SpectralLibraryMatchOptions::setSettingMaxDisplayed(mpMaxDisplayed->value());
    SpectralLibraryMatchOptions::setSettingLimitByThreshold(mpLimitByThreshold->isChecked());
    SpectralLibraryMatchOptions::setSettingAutoclear(mpAutoclear->isChecked());
+   SpectralLibraryMatchOptions::setSettingUseApproximateSearch(mpUseApproximateSearch->isChecked());
+   SpectralLibraryMatchOptions::setSettingApproximateSearchCandidates(mpSearchCandidates->value());
+   SpectralLibraryMatchOptions::setSettingApproximateSearchChecks(mpSearchChecks->value());
+   SpectralLibraryMatchOptions::setSettingUsePrincipalComponentPrefilter(mpUsePrefilter->isChecked());
+   SpectralLibraryMatchOptions::setSettingPrefilterComponents(mpPrefilterComponents->value());
+   SpectralLibraryMatchOptions::setSettingCacheResampledLibraries(mpCacheLibraries->isChecked());
    SpectralLibraryMatch::MatchAlgorithm matType =
       StringUtilities::fromDisplayString<SpectralLibraryMatch::MatchAlgorithm>(
       mpMatchAlgCombo->currentText().toStdString());
@@ -46,6 +46,13 @@ public:
    SETTING(LocateWbiThreshold, SpectralLibraryMatch, float, 0.5f);
    SETTING(DisplayLocateOptions, SpectralLibraryMatch, bool, false);
    SETTING(Autoclear, SpectralLibraryMatch, bool, false);
+   SETTING(UseApproximateSearch, SpectralLibraryMatch, bool, false);
+   SETTING(ApproximateSearchCandidates, SpectralLibraryMatch, unsigned int, 50);
+   SETTING(ApproximateSearchChecks, SpectralLibraryMatch, unsigned int, 128);
+   SETTING(UsePrincipalComponentPrefilter, SpectralLibraryMatch, bool, false);
+   SETTING(PrefilterComponents, SpectralLibraryMatch, unsigned int, 32);
+   SETTING(CacheResampledLibraries, SpectralLibraryMatch, bool, true);
+   SETTING(ResampledLibraryCachePath, SpectralLibraryMatch, std::string, "");
 
    void applyChanges();
 
@@ -116,6 +123,12 @@ private:
    QCheckBox* mpLimitByThreshold;
    QDoubleSpinBox* mpMatchThreshold;
    QCheckBox* mpAutoclear;
+   QCheckBox* mpUseApproximateSearch;
+   QSpinBox* mpSearchCandidates;
+   QSpinBox* mpSearchChecks;
+   QCheckBox* mpUsePrefilter;
+   QSpinBox* mpPrefilterComponents;
+   QCheckBox* mpCacheLibraries;
    QComboBox* mpLocateAlgCombo;
    QDoubleSpinBox* mpLocateThreshold;
    QCheckBox* mpDisplayLocateOptions;
@@ -401,7 +401,10 @@ bool SpectralLibraryMatchTools::eventFilter(QObject* pObject, QEvent* pEvent)
                               const std::vector<Signature*>* pLibSignatures =
                                  mpLibMgr->getResampledLibrarySignatures(pLib);
                               VERIFY(pLibSignatures != NULL && pLibSignatures->empty() == false);
-                              if (SpectralLibraryMatch::findSignatureMatches(pLib, *pLibSignatures, theResults))
+                              const SpectralLibraryMatch::LibraryStatistics* pLibStats =
+                                 mpLibMgr->getResampledLibraryStatistics(pLib);
+                              VERIFY(pLibStats != NULL);
+                              if (SpectralLibraryMatch::findSignatureMatches(*pLibStats, *pLibSignatures, theResults))
                               {
                                  // display results in results window
                                  VERIFY(mpResults != NULL);
@@ -637,6 +640,8 @@ void SpectralLibraryMatchTools::matchAoiPixels()
    }
    const std::vector<Signature*>* pLibSignatures = mpLibMgr->getResampledLibrarySignatures(pLib);
    VERIFYNRV(pLibSignatures != NULL && pLibSignatures->empty() == false);
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats = mpLibMgr->getResampledLibraryStatistics(pLib);
+   VERIFYNRV(pLibStats != NULL);
 
    // loop through the aoi spectra and generate sorted results
    updateProgress("Matching AOI pixels...", 0, NORMAL);
@@ -682,7 +687,7 @@ void SpectralLibraryMatchTools::matchAoiPixels()
       VERIFYNRV(acc.isValid());
       switchOnEncoding(eType, SpectralLibraryMatch::getScaledPixelValues, acc->getColumn(),
          theResults.mTargetValues, numBands, scaleFactor);
-      if (SpectralLibraryMatch::findSignatureMatches(pLib, *pLibSignatures, theResults))
+      if (SpectralLibraryMatch::findSignatureMatches(*pLibStats, *pLibSignatures, theResults))
       {
          if (isAborted())
          {
@@ -785,7 +790,9 @@ void SpectralLibraryMatchTools::matchAoiAverageSpectrum()
    }
    const std::vector<Signature*>* pLibSignatures = mpLibMgr->getResampledLibrarySignatures(pLib);
    VERIFYNRV(pLibSignatures != NULL && pLibSignatures->empty() == false);
-   if (SpectralLibraryMatch::findSignatureMatches(pLib, *pLibSignatures, theResults))
+   const SpectralLibraryMatch::LibraryStatistics* pLibStats = mpLibMgr->getResampledLibraryStatistics(pLib);
+   VERIFYNRV(pLibStats != NULL);
+   if (SpectralLibraryMatch::findSignatureMatches(*pLibStats, *pLibSignatures, theResults))
    {
       VERIFYNRV(mpResults != NULL);
       mpResults->addResults(theResults, mpProgress);
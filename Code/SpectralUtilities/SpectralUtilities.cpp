@@ -16,10 +16,15 @@
 #include "DateTime.h"
 #include "DataVariant.h"
 #include "MessageLogResource.h"
+#include "ModelServices.h"
 #include "ObjectResource.h"
+#include "PlugInResource.h"
 #include "Progress.h"
 #include "RasterDataDescriptor.h"
 #include "RasterElement.h"
+#include "RasterPager.h"
+#include "RasterUtilities.h"
+#include "Resampler.h"
 #include "Signature.h"
 #include "SignatureDataDescriptor.h"
 #include "SignatureSet.h"
@@ -37,6 +42,19 @@
 
 namespace
 {
+   // the largest number of significant digits whose value is always exact in a double
+   const int sMaxExactDigits = 15;
+
+   // the powers of ten which are exact in a double
+   const double sPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+   const int sMaxExactPower = 22;
+
+   bool isDigit(char value)
+   {
+      return value >= '0' && value <= '9';
+   }
+
    template<typename T>
    void averageSignatureAccum(T* pPtr, std::vector<double>& accum)
    {
@@ -571,6 +589,148 @@ std::vector<double> SpectralUtilities::calculateMeans(const RasterElement* pElem
 }
 #endif
 
+bool SpectralUtilities::resampleSignatures(const std::vector<Signature*>& signatures, const RasterElement* pElement,
+   const Wavelengths* pWavelengths, std::vector<double>& spectra, std::vector<std::vector<int> >& resampledBands,
+   std::string& errorMessage)
+{
+   spectra.clear();
+   resampledBands.clear();
+   errorMessage.clear();
+   VERIFY(pElement != NULL);
+   const RasterDataDescriptor* pDescriptor = dynamic_cast<const RasterDataDescriptor*>(pElement->getDataDescriptor());
+   VERIFY(pDescriptor != NULL);
+
+   bool hasWavelengths = (pWavelengths != NULL && pWavelengths->isEmpty() == false);
+   std::vector<double> centerValues;
+   std::vector<double> fwhm;
+   if (hasWavelengths)
+   {
+      centerValues = pWavelengths->getCenterValues();
+      fwhm = pWavelengths->getFwhm();
+   }
+
+   const std::vector<double>::size_type numBands = hasWavelengths ? centerValues.size() : pDescriptor->getBandCount();
+   spectra.resize(signatures.size() * numBands, 0.0);
+   resampledBands.resize(signatures.size());
+
+   PlugInResource resampler("Resampler");
+   Resampler* pResampler = dynamic_cast<Resampler*>(resampler.get());
+   if (hasWavelengths && pResampler == NULL)
+   {
+      errorMessage = "The resampler plug-in could not be created.";
+      return false;
+   }
+
+   std::vector<double> resampledValues;
+   for (std::vector<Signature*>::size_type sigIndex = 0; sigIndex < signatures.size(); ++sigIndex)
+   {
+      const Signature* pSignature = signatures[sigIndex];
+      VERIFY(pSignature != NULL);
+
+      std::vector<int>& bands = resampledBands[sigIndex];
+      double* pSpectrum = numBands == 0 ? NULL : &spectra[sigIndex * numBands];
+      if (hasWavelengths == false)
+      {
+         if (pSignature->getParent() != pElement)
+         {
+            errorMessage = "The data set wavelengths are invalid.";
+            return false;
+         }
+
+         // In-scene signature
+         const std::vector<double>* pReflectance =
+            dv_cast<std::vector<double> >(&pSignature->getData("Reflectance"));
+         if (pReflectance == NULL || pReflectance->size() > numBands)
+         {
+            errorMessage = "The in-scene signature " + pSignature->getName() + " does not match the data set bands.";
+            return false;
+         }
+
+         for (std::vector<double>::size_type band = 0; band < pReflectance->size(); ++band)
+         {
+            pSpectrum[band] = (*pReflectance)[band];
+            bands.push_back(static_cast<int>(band));
+         }
+
+         continue;
+      }
+
+      const std::vector<double>* pReflectance = dv_cast<std::vector<double> >(&pSignature->getData("Reflectance"));
+      const std::vector<double>* pWavelength = dv_cast<std::vector<double> >(&pSignature->getData("Wavelength"));
+      if (pReflectance == NULL || pWavelength == NULL)
+      {
+         errorMessage = "Resampling failed: the signature " + pSignature->getName() +
+            " does not contain reflectance and wavelength data.";
+         return false;
+      }
+
+      std::string err;
+      if (pResampler->execute(*pReflectance, resampledValues, *pWavelength, centerValues, fwhm, bands, err) == false)
+      {
+         errorMessage = "Resampling failed: " + err;
+         return false;
+      }
+
+      VERIFY(resampledValues.size() == bands.size());
+      for (std::vector<int>::size_type index = 0; index < bands.size(); ++index)
+      {
+         VERIFY(bands[index] >= 0 && static_cast<std::vector<double>::size_type>(bands[index]) < numBands);
+         pSpectrum[bands[index]] = resampledValues[index];
+      }
+   }
+
+   return true;
+}
+
+RasterElement* SpectralUtilities::createGainOffsetElement(const std::string& name, RasterElement* pSource,
+   const std::vector<double>& gains, const std::vector<double>& offsets, EncodingType dataType)
+{
+   VERIFYRV(pSource != NULL, NULL);
+   const RasterDataDescriptor* pSourceDescriptor =
+      dynamic_cast<const RasterDataDescriptor*>(pSource->getDataDescriptor());
+   VERIFYRV(pSourceDescriptor != NULL, NULL);
+   const unsigned int numBands = pSourceDescriptor->getBandCount();
+   if (gains.size() != numBands || offsets.size() != numBands)
+   {
+      return NULL;
+   }
+
+   RasterDataDescriptor* pDescriptor = RasterUtilities::generateRasterDataDescriptor(name, pSource,
+      pSourceDescriptor->getRowCount(), pSourceDescriptor->getColumnCount(), numBands,
+      pSourceDescriptor->getInterleaveFormat(), dataType, ON_DISK_READ_ONLY);
+   VERIFYRV(pDescriptor != NULL, NULL);
+
+   ModelResource<RasterElement> pElement(
+      dynamic_cast<RasterElement*>(Service<ModelServices>()->createElement(pDescriptor)));
+   if (pElement.get() == NULL)
+   {
+      return NULL;
+   }
+
+   std::vector<double> pagerGains(gains);
+   std::vector<double> pagerOffsets(offsets);
+   ExecutableResource pPager("Gain Offset Pager");
+   VERIFYRV(pPager->getPlugIn() != NULL, NULL);
+   pPager->getInArgList().setPlugInArgValue("Raster Element", pElement.get());
+   pPager->getInArgList().setPlugInArgValue("Source Element", pSource);
+   pPager->getInArgList().setPlugInArgValue("Gains", &pagerGains);
+   pPager->getInArgList().setPlugInArgValue("Offsets", &pagerOffsets);
+   if (pPager->execute() == false)
+   {
+      return NULL;
+   }
+
+   RasterPager* pRasterPager = dynamic_cast<RasterPager*>(pPager->getPlugIn());
+   if (pRasterPager == NULL)
+   {
+      return NULL;
+   }
+
+   pPager->releasePlugIn();
+   pElement->setPager(pRasterPager);
+   return pElement.release();
+}
+
 double SpectralUtilities::determineReflectanceConversionFactor(double solarElevationAngleInDegrees,
    double solarIrradiance, const DateTime& date)
 {
@@ -630,3 +790,73 @@ double SpectralUtilities::determineEarthSunDistance(const DateTime& date)
    double earthSunDistance = 1.00014 - 0.01671 * cos(gInRadians) - 0.00014 * cos(2 * gInRadians);
    return earthSunDistance; //in AU - Astronomical Units, expect between 0.983 and 1.017
 }
+
+bool SpectralUtilities::parseDecimal(const char* pBegin, const char* pEnd, double& value)
+{
+   const char* pChar = pBegin;
+   bool negative = (pChar != pEnd && *pChar == '-');
+   if (negative)
+   {
+      ++pChar;
+   }
+
+   double digits(0.0);
+   int numDigits(0);
+   int exponent(0);
+   bool exact = (pChar != pEnd && isDigit(*pChar));
+   for (; pChar != pEnd && isDigit(*pChar); ++pChar)
+   {
+      if (digits != 0.0 || *pChar != '0')
+      {
+         digits = digits * 10.0 + (*pChar - '0');
+         ++numDigits;
+      }
+   }
+   if (exact && pChar != pEnd && *pChar == '.')
+   {
+      ++pChar;
+      exact = (pChar != pEnd && isDigit(*pChar));
+      for (; pChar != pEnd && isDigit(*pChar); ++pChar)
+      {
+         if (digits != 0.0 || *pChar != '0')
+         {
+            digits = digits * 10.0 + (*pChar - '0');
+            ++numDigits;
+         }
+         --exponent;
+      }
+   }
+   if (exact && pChar != pEnd && (*pChar == 'e' || *pChar == 'E'))
+   {
+      ++pChar;
+      bool negativeExponent = (pChar != pEnd && *pChar == '-');
+      if (pChar != pEnd && (*pChar == '-' || *pChar == '+'))
+      {
+         ++pChar;
+      }
+      exact = (pChar != pEnd && isDigit(*pChar) && pEnd - pChar <= 4);
+      int exponentValue(0);
+      for (; exact && pChar != pEnd && isDigit(*pChar); ++pChar)
+      {
+         exponentValue = exponentValue * 10 + (*pChar - '0');
+      }
+      exponent += negativeExponent ? -exponentValue : exponentValue;
+   }
+
+   if (exact == false || pChar != pEnd || numDigits > sMaxExactDigits ||
+      (digits != 0.0 && (exponent < -sMaxExactPower || exponent > sMaxExactPower)))
+   {
+      return false;
+   }
+
+   value = 0.0;
+   if (digits != 0.0)
+   {
+      value = (exponent < 0) ? digits / sPowersOfTen[-exponent] : digits * sPowersOfTen[exponent];
+   }
+   if (negative)
+   {
+      value = -value;
+   }
+   return true;
+}
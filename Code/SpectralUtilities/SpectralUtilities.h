@@ -12,6 +12,7 @@
 
 #include "Location.h"
 #include "ProgressTracker.h"
+#include "TypesFile.h"
 
 #include <QtCore/qglobal.h>
 #include <string>
@@ -24,6 +25,7 @@ class DateTime;
 class Progress;
 class RasterElement;
 class Signature;
+class Wavelengths;
 
 /**
  * This namespace contains a number of convenience functions
@@ -163,6 +165,68 @@ namespace SpectralUtilities
       BitMaskIterator& iter, ProgressTracker& progress, bool* pAbort = NULL);
 #endif
 
+   /**
+    *  Resamples a set of signatures to the bands of a data set.
+    *
+    *  A single "Resampler" plug-in is used for all of the signatures, so
+    *  signatures which share wavelengths, such as those from a library,
+    *  reuse the same resampling weights. A signature without wavelengths
+    *  whose parent is \em pElement is treated as an in-scene signature and
+    *  its values are used for every band.
+    *
+    *  @param   signatures
+    *           The signatures to resample. Signature sets should be expanded
+    *           with extractSignatures() first.
+    *  @param   pElement
+    *           The data set to which the signatures are resampled. This must
+    *           be non-\c NULL.
+    *  @param   pWavelengths
+    *           The wavelengths of \em pElement. This may be \c NULL or empty
+    *           if all of the signatures are in-scene signatures.
+    *  @param   spectra
+    *           Receives a dense signatures x bands row-major matrix. Values for
+    *           bands a signature does not cover are set to zero. The number of
+    *           bands is the number of center wavelengths in \em pWavelengths, or
+    *           the band count of \em pElement if there are no wavelengths.
+    *  @param   resampledBands
+    *           Receives, for each signature, the ascending indices of the bands
+    *           covered by that signature.
+    *  @param   errorMessage
+    *           Receives the reason for a failure.
+    *
+    *  @return  \c true if every signature was resampled, \c false otherwise.
+    */
+   bool resampleSignatures(const std::vector<Signature*>& signatures, const RasterElement* pElement,
+      const Wavelengths* pWavelengths, std::vector<double>& spectra, std::vector<std::vector<int> >& resampledBands,
+      std::string& errorMessage);
+
+   /**
+    *  Creates a RasterElement whose data is computed on demand from another
+    *  RasterElement as source * gain + offset for each band.
+    *
+    *  The new element is paged by the "Gain Offset Pager" plug-in, so no data is
+    *  copied when it is created. Each page is read from \em pSource and converted
+    *  to \em dataType when it is accessed. The new element is a child of
+    *  \em pSource so it cannot outlive the data it reads. It is read-only;
+    *  exporting it writes out the corrected values.
+    *
+    *  @param   name
+    *           The name of the new element.
+    *  @param   pSource
+    *           The element supplying the uncorrected data.
+    *  @param   gains
+    *           The gain for each active band of \em pSource.
+    *  @param   offsets
+    *           The offset for each active band of \em pSource, added after the gain is applied.
+    *  @param   dataType
+    *           The data type of the new element.
+    *
+    *  @return  The new element, or \c NULL if it could not be created. The caller
+    *           should copy any metadata, units or classification it needs.
+    */
+   RasterElement* createGainOffsetElement(const std::string& name, RasterElement* pSource,
+      const std::vector<double>& gains, const std::vector<double>& offsets, EncodingType dataType);
+
    /**
     *  Calculates the reflectance factor using the following equations:
     *  - earthSunDistance = &lt;calculated using
@@ -206,6 +270,25 @@ namespace SpectralUtilities
     * @return The earth-sun distance in Astronomical Units (AU).
     */
    double determineEarthSunDistance(const DateTime& date);
+
+   /**
+    * Converts a plain decimal number exactly.
+    *
+    * Numbers of the form -?digits(.digits)?([eE][+-]?digits)? with at most 15 significant
+    * digits and a power of ten of at most 22 are converted by scaling their digits with an
+    * exact power of ten, so the single rounding gives the correctly rounded value. This is
+    * much faster than a general conversion for the values found in text signature files.
+    *
+    * @param pBegin
+    *        The first character of the number.
+    * @param pEnd
+    *        One past the last character of the number.
+    * @param value
+    *        Receives the value of the number.
+    *
+    * @return \c true if the number was converted, \c false if it needs a general conversion.
+    */
+   bool parseDecimal(const char* pBegin, const char* pEnd, double& value);
 }
 
 #endif
@@ -27,12 +27,10 @@
 #include "ObjectResource.h"
 #include "PlugInArgList.h"
 #include "PlugInRegistration.h"
-#include "PlugInResource.h"
 #include "ProgressTracker.h"
 #include "RasterDataDescriptor.h"
 #include "RasterElement.h"
 #include "RasterUtilities.h"
-#include "Resampler.h"
 #include "Signature.h"
 #include "SpectralUtilities.h"
 #include "SpectralVersion.h"
@@ -343,6 +341,18 @@ bool WangBovikAlgorithm::processAll()
 
    ModelResource<RasterElement> pResults(reinterpret_cast<RasterElement*>(NULL));
 
+   // Resample all of the signatures to the data set bands up front
+   vector<double> resampledSpectra;
+   vector<vector<int> > resampledBandSets;
+   string resampleError;
+   if (!SpectralUtilities::resampleSignatures(mInputs.mSignatures, pElement, pWavelengths.get(),
+      resampledSpectra, resampledBandSets, resampleError))
+   {
+      progress.report(resampleError, 0, ERRORS, true);
+      return false;
+   }
+   const vector<double>::size_type numSpectrumBands = resampledSpectra.size() / iSignatureCount;
+
    // Processes each selected signature one at a time and
    // accumulates results
    for (sig_index = 0; bSuccess && (sig_index < iSignatureCount) && !mAbortFlag; sig_index++)
@@ -377,9 +387,13 @@ bool WangBovikAlgorithm::processAll()
          .arg(sig_index+1).arg(iSignatureCount).arg(QString::fromStdString(sigNames.back()));
       string message = messageSigNumber.toStdString();
 
+      const vector<int>& resampledBands = resampledBandSets[sig_index];
       vector<double> spectrumValues;
-      vector<int> resampledBands;
-      bSuccess = resampleSpectrum(pSignature, spectrumValues, pWavelengths.get(), resampledBands);
+      spectrumValues.reserve(resampledBands.size());
+      for (vector<int>::const_iterator band = resampledBands.begin(); band != resampledBands.end(); ++band)
+      {
+         spectrumValues.push_back(resampledSpectra[sig_index * numSpectrumBands + *band]);
+      }
 
       // adjust signature values for the scaling factor
       const Units* pSigUnits = pSignature->getUnits("Reflectance");
@@ -591,82 +605,6 @@ bool WangBovikAlgorithm::processAll()
    return bSuccess;
 }
 
-bool WangBovikAlgorithm::resampleSpectrum(Signature* pSignature, vector<double>& resampledAmplitude,
-                                    Wavelengths* pWavelengths, vector<int>& resampledBands)
-{
-   StepResource pStep("Resample Signature", "spectral", "933ECFAA-1F9E-495B-9CF1-AACC0EF2D2E5");
-
-   Progress* pProgress = getProgress();
-   if ((pWavelengths == NULL) || (pWavelengths->isEmpty()))
-   {
-      // Check for an in-scene signature
-      RasterElement* pElement = getRasterElement();
-      VERIFY(pElement != NULL);
-
-      if (pSignature->getParent() == pElement)
-      {
-         vector<double> sigReflectances =
-            dv_cast<vector<double> >(pSignature->getData("Reflectance"), vector<double>());
-         resampledAmplitude = sigReflectances;
-
-         resampledBands.clear();
-         for (vector<double>::size_type i = 0; i < sigReflectances.size(); ++i)
-         {
-            resampledBands.push_back(static_cast<int>(i));
-         }
-
-         pStep->finalize(Message::Success);
-         return true;
-      }
-
-      string messageText = "The data set wavelengths are invalid.";
-      if (pProgress != NULL) pProgress->updateProgress(messageText, 0, ERRORS);
-      pStep->finalize(Message::Failure, messageText);
-      return false;
-   }
-
-   vector<double> fwhm = pWavelengths->getFwhm();
-   PlugInResource resampler("Resampler");
-   Resampler* pResampler = dynamic_cast<Resampler*>(resampler.get());
-   if (pResampler == NULL)
-   {
-      string messageText = "The resampler plug-in could not be created.";
-      if (pProgress != NULL) pProgress->updateProgress(messageText, 0, ERRORS);
-      pStep->finalize(Message::Failure, messageText);
-      return false;
-   }
-   string err;
-   try
-   {
-      vector<double> sigReflectance = dv_cast<vector<double> >(pSignature->getData("Reflectance"));
-      resampledAmplitude.reserve(sigReflectance.size());
-      resampledBands.reserve(sigReflectance.size());
-      if (!pResampler->execute(sigReflectance,
-                              resampledAmplitude,
-                              dv_cast<vector<double> >(pSignature->getData("Wavelength")),
-                              pWavelengths->getCenterValues(),
-                              fwhm,
-                              resampledBands,
-                              err))
-      {
-         string messageText = "Resampling failed: " + err;
-         if (pProgress != NULL) pProgress->updateProgress(messageText, 0, ERRORS);
-         pStep->finalize(Message::Failure, messageText);
-         return false;
-      }
-   }
-   catch(std::bad_cast&)
-   {
-      string messageText = "Resampling failed: " + err;
-      if (pProgress != NULL) pProgress->updateProgress(messageText, 0, ERRORS);
-      pStep->finalize(Message::Failure, messageText);
-      return false;
-   }
-
-   pStep->finalize(Message::Success);
-   return true;
-}
-
 RasterElement* WangBovikAlgorithm::createResults(int numRows, int numColumns, int numBands, const string& sigName)
 {
    RasterElement* pElement = getRasterElement();
@@ -51,8 +51,6 @@ class WangBovikAlgorithm : public AlgorithmPattern
    bool postprocess();
    bool initialize(void* pAlgorithmData);
    RasterElement* createResults(int numRows, int numColumns, int numBands, const std::string& sigName);
-   bool resampleSpectrum(Signature* pSignature, std::vector<double>& resampledAmplitude,
-      Wavelengths* pWavelengths, std::vector<int>& resampledBands);
    bool canAbort() const;
    bool doAbort();
 